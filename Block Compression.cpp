@@ -0,0 +1,239 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include "Block Compression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+size_t getCompressedSize(uint32_t width, uint32_t height, uint32_t blockSize) {
+    return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+}
+
+static void loadBlock(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+                      uint8_t texels[16][4]) {
+    for (uint32_t y = 0; y < 4; y++)
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+            uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+
+            memcpy(texels[y * 4 + x], rgba + ((size_t) sourceY * width + sourceX) * 4, 4);
+        }
+}
+
+// Writes bitCount bits of value at bitOffset, LSB first.
+static void putBits(uint8_t *block, uint32_t *bitOffset, uint32_t value, uint32_t bitCount) {
+    for (uint32_t i = 0; i < bitCount; i++, (*bitOffset)++)
+        if ((value >> i) & 1)
+            block[*bitOffset / 8] |= (uint8_t) (1 << (*bitOffset % 8));
+}
+
+static void compressBC7Block(uint8_t texels[16][4], uint8_t *block) {
+    static const uint32_t weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float mean[4] = {};
+
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            mean[c] += texels[i][c] / 16.0f;
+
+    float covariance[4][4] = {};
+
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < 4; a++)
+            for (int b = 0; b < 4; b++)
+                covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+
+    // Principal axis by power iteration, the covariance is tiny so a few steps are plenty.
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+
+        for (int a = 0; a < 4; a++)
+            for (int b = 0; b < 4; b++)
+                next[a] += covariance[a][b] * axis[b];
+
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+
+        if (length < 1e-6f)
+            break;
+
+        for (int c = 0; c < 4; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float minProjection = 0.0f, maxProjection = 0.0f;
+
+    for (int i = 0; i < 16; i++) {
+        float projection = 0.0f;
+
+        for (int c = 0; c < 4; c++)
+            projection += (texels[i][c] - mean[c]) * axis[c];
+
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    // 7 bit endpoints plus a shared p-bit each, the p-bit that quantizes the endpoint best wins.
+    uint32_t endpoints[2][4];
+    uint32_t pBits[2];
+
+    for (int e = 0; e < 2; e++) {
+        float projection = (e == 0) ? (minProjection) : (maxProjection);
+        float bestError = -1.0f;
+
+        for (uint32_t p = 0; p < 2; p++) {
+            uint32_t quantized[4];
+            float error = 0.0f;
+
+            for (int c = 0; c < 4; c++) {
+                float value = std::min(std::max(mean[c] + axis[c] * projection, 0.0f), 255.0f);
+                int q = (int) std::lround((value - p) / 2.0f);
+
+                quantized[c] = (uint32_t) std::min(std::max(q, 0), 127);
+
+                float difference = value - (float) ((quantized[c] << 1) | p);
+
+                error += difference * difference;
+            }
+
+            if (bestError < 0.0f || error < bestError) {
+                bestError = error;
+                memcpy(endpoints[e], quantized, sizeof(quantized));
+                pBits[e] = p;
+            }
+        }
+    }
+
+    uint32_t palette[16][4];
+
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++) {
+            uint32_t e0 = (endpoints[0][c] << 1) | pBits[0];
+            uint32_t e1 = (endpoints[1][c] << 1) | pBits[1];
+
+            palette[i][c] = ((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6;
+        }
+
+    uint32_t indices[16];
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t bestError = UINT32_MAX;
+
+        for (uint32_t p = 0; p < 16; p++) {
+            uint32_t error = 0;
+
+            for (int c = 0; c < 4; c++) {
+                int difference = (int) texels[i][c] - (int) palette[p][c];
+
+                error += (uint32_t) (difference * difference);
+            }
+
+            if (error < bestError) {
+                bestError = error;
+                indices[i] = p;
+            }
+        }
+    }
+
+    // The MSB of the first index is implied zero, swapping the endpoints makes it so.
+    if (indices[0] >= 8) {
+        std::swap(endpoints[0], endpoints[1]);
+        std::swap(pBits[0], pBits[1]);
+
+        for (int i = 0; i < 16; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    memset(block, 0, 16);
+
+    uint32_t bitOffset = 0;
+
+    putBits(block, &bitOffset, 1 << 6, 7);
+
+    for (int c = 0; c < 4; c++) {
+        putBits(block, &bitOffset, endpoints[0][c], 7);
+        putBits(block, &bitOffset, endpoints[1][c], 7);
+    }
+
+    putBits(block, &bitOffset, pBits[0], 1);
+    putBits(block, &bitOffset, pBits[1], 1);
+
+    for (int i = 0; i < 16; i++)
+        putBits(block, &bitOffset, indices[i], (i == 0) ? (3) : (4));
+}
+
+static void compressBC4Block(uint8_t texels[16][4], int channel, uint8_t *block) {
+    uint32_t minValue = 255, maxValue = 0;
+
+    for (int i = 0; i < 16; i++) {
+        minValue = std::min<uint32_t>(minValue, texels[i][channel]);
+        maxValue = std::max<uint32_t>(maxValue, texels[i][channel]);
+    }
+
+    memset(block, 0, 8);
+
+    block[0] = (uint8_t) maxValue;
+    block[1] = (uint8_t) minValue;
+
+    // All indices zero decode to the first endpoint.
+    if (maxValue == minValue)
+        return;
+
+    // First endpoint greater than the second: both endpoints plus six values between them.
+    uint32_t palette[8] = {maxValue, minValue};
+
+    for (uint32_t i = 2; i < 8; i++)
+        palette[i] = ((8 - i) * maxValue + (i - 1) * minValue) / 7;
+
+    uint32_t bitOffset = 16;
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t bestIndex = 0;
+        int bestError = 256;
+
+        for (uint32_t p = 0; p < 8; p++) {
+            int error = std::abs((int) texels[i][channel] - (int) palette[p]);
+
+            if (error < bestError) {
+                bestError = error;
+                bestIndex = p;
+            }
+        }
+
+        putBits(block, &bitOffset, bestIndex, 3);
+    }
+}
+
+void compressBC7(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks) {
+    uint8_t texels[16][4];
+
+    for (uint32_t blockY = 0; blockY < (height + 3) / 4; blockY++)
+        for (uint32_t blockX = 0; blockX < (width + 3) / 4; blockX++, blocks += 16) {
+            loadBlock(rgba, width, height, blockX, blockY, texels);
+            compressBC7Block(texels, blocks);
+        }
+}
+
+void compressBC5(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks) {
+    uint8_t texels[16][4];
+
+    for (uint32_t blockY = 0; blockY < (height + 3) / 4; blockY++)
+        for (uint32_t blockX = 0; blockX < (width + 3) / 4; blockX++, blocks += 16) {
+            loadBlock(rgba, width, height, blockX, blockY, texels);
+            compressBC4Block(texels, 0, blocks);
+            compressBC4Block(texels, 1, blocks + 8);
+        }
+}
+
+void compressBC4(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks) {
+    uint8_t texels[16][4];
+
+    for (uint32_t blockY = 0; blockY < (height + 3) / 4; blockY++)
+        for (uint32_t blockX = 0; blockX < (width + 3) / 4; blockX++, blocks += 8) {
+            loadBlock(rgba, width, height, blockX, blockY, texels);
+            compressBC4Block(texels, 0, blocks);
+        }
+}
@@ -0,0 +1,28 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_BLOCK_COMPRESSION_H
+#define VULKAN_TEST_BLOCK_COMPRESSION_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Offline BC encoders for the texture compressor. Blocks cover 4x4 texels, partial blocks at the right and bottom
+// edges repeat the last column and row.
+
+// 16 bytes per block, mode 6 only: RGBA endpoints along the principal axis, 4 bit indices.
+void compressBC7(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks);
+
+// 16 bytes per block, red and green of rgba each encoded as a BC4 block.
+void compressBC5(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks);
+
+// 8 bytes per block, red of rgba.
+void compressBC4(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks);
+
+size_t getCompressedSize(uint32_t width, uint32_t height, uint32_t blockSize);
+
+
+#endif //VULKAN_TEST_BLOCK_COMPRESSION_H
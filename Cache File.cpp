@@ -0,0 +1,42 @@
+//
+// Created by chakmeshma on 18.10.2026.
+//
+
+#include <cstdio>
+#include "Cache File.h"
+
+static const uint64_t fnvPrime = 1099511628211ULL;
+
+uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *) data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= fnvPrime;
+    }
+
+    return hash;
+}
+
+bool writeFileAtomically(const std::string &path, const std::function<void(std::ofstream &file)> &write) {
+    std::string temporaryPath = path + ".tmp";
+
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+        return false;
+
+    write(file);
+
+    file.close();
+
+    if (!file) {
+        std::remove(temporaryPath.c_str());
+
+        return false;
+    }
+
+    std::remove(path.c_str());
+
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
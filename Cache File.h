@@ -0,0 +1,28 @@
+//
+// Created by chakmeshma on 18.10.2026.
+//
+
+#ifndef VULKAN_TEST_CACHE_FILE_H
+#define VULKAN_TEST_CACHE_FILE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <fstream>
+#include <functional>
+#include <string>
+
+// Shared by the mesh, SPIR-V and pipeline caches.
+
+#define FNV1A_OFFSET_BASIS 14695981039346656037ULL
+
+// 64 bit FNV-1a, continued from hash. Start with FNV1A_OFFSET_BASIS.
+uint64_t fnv1a(uint64_t hash, const void *data, size_t size);
+
+// Has write fill a temporary file next to path, then renames it over path, so a crash mid-write never leaves a
+// half-valid cache behind. False if the file couldn't be opened, written or renamed.
+bool writeFileAtomically(const std::string &path, const std::function<void(std::ofstream &file)> &write);
+
+
+#endif //VULKAN_TEST_CACHE_FILE_H
@@ -0,0 +1,532 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include <algorithm>
+#include <iterator>
+#include "Device Memory Allocator.h"
+#include "Vulkan Engine Exception.h"
+
+static const VkDeviceSize smallAllocationLimit = 256 * 1024;
+static const VkDeviceSize smallBlockSize = 4 * 1024 * 1024;
+static const VkDeviceSize largeBlockSize = 64 * 1024 * 1024;
+
+struct MemoryRange {
+    VkDeviceSize size;
+    MemoryResourceKind kind;
+};
+
+struct MemoryBlock {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    uint32_t memoryTypeIndex = UINT32_MAX;
+    uint8_t *mappedData = nullptr;
+    bool dedicated = false;
+    bool linear = false;                                // owned by a LinearMemoryPool
+    int sizeClass = -1;
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;    // offset -> size, never adjacent to each other
+    std::map<VkDeviceSize, MemoryRange> allocations;    // offset -> size and kind
+    VkDeviceSize usedBytes = 0;
+};
+
+static VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator() = default;
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator() {
+    destroy();
+}
+
+void DeviceMemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+    this->device = device;
+
+    VkPhysicalDeviceProperties deviceProperties;
+
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    bufferImageGranularity = std::max<VkDeviceSize>(1, deviceProperties.limits.bufferImageGranularity);
+    nonCoherentAtomSize = std::max<VkDeviceSize>(1, deviceProperties.limits.nonCoherentAtomSize);
+    maxMemoryAllocationCount = deviceProperties.limits.maxMemoryAllocationCount;
+}
+
+void DeviceMemoryAllocator::destroy() {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    if (device == VK_NULL_HANDLE)
+        return;
+
+    for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < VK_MAX_MEMORY_TYPES; memoryTypeIndex++) {
+        for (uint32_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++) {
+            for (MemoryBlock *block : blocks[memoryTypeIndex][sizeClass])
+                destroyBlock(block);
+
+            blocks[memoryTypeIndex][sizeClass].clear();
+        }
+
+        for (MemoryBlock *block : dedicatedBlocks[memoryTypeIndex])
+            destroyBlock(block);
+
+        dedicatedBlocks[memoryTypeIndex].clear();
+    }
+
+    for (LinearMemoryPool *pool : linearPools) {
+        destroyBlock(pool->block);
+        delete pool;
+    }
+
+    linearPools.clear();
+
+    device = VK_NULL_HANDLE;
+}
+
+uint32_t DeviceMemoryAllocator::findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags requiredFlags,
+                                               VkMemoryPropertyFlags preferredFlags) const {
+    uint32_t fallbackMemoryTypeIndex = UINT32_MAX;
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[i].propertyFlags;
+
+        if ((memoryTypeBits & (1u << i)) == 0 || (propertyFlags & requiredFlags) != requiredFlags)
+            continue;
+
+        if ((propertyFlags & preferredFlags) == preferredFlags)
+            return i;
+
+        if (fallbackMemoryTypeIndex == UINT32_MAX)
+            fallbackMemoryTypeIndex = i;
+    }
+
+    return fallbackMemoryTypeIndex;
+}
+
+void DeviceMemoryAllocator::allocate(const VkMemoryRequirements &memoryRequirements,
+                                     VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags,
+                                     MemoryResourceKind kind, MemoryAllocation *allocation) {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    // Every type with the preferred flags first, so running out of e.g. device local memory falls back to whatever
+    // else is allowed instead of failing.
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[i].propertyFlags;
+
+            if ((memoryRequirements.memoryTypeBits & (1u << i)) == 0 ||
+                (propertyFlags & requiredFlags) != requiredFlags ||
+                ((propertyFlags & preferredFlags) == preferredFlags) != (pass == 0))
+                continue;
+
+            if (allocateFromMemoryType(i, memoryRequirements, kind, allocation))
+                return;
+        }
+    }
+
+    throw VulkanException("Couldn't allocate device memory.");
+}
+
+void DeviceMemoryAllocator::allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags requiredFlags,
+                                                 VkMemoryPropertyFlags preferredFlags, MemoryAllocation *allocation) {
+    VkMemoryRequirements memoryRequirements;
+
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+    allocate(memoryRequirements, requiredFlags, preferredFlags, MEMORY_RESOURCE_LINEAR, allocation);
+
+    if (vkBindBufferMemory(device, buffer, allocation->memory, allocation->offset) != VK_SUCCESS)
+        throw VulkanException("Couldn't bind buffer memory.");
+}
+
+void DeviceMemoryAllocator::allocateImageMemory(VkImage image, VkImageTiling tiling,
+                                                VkMemoryPropertyFlags requiredFlags,
+                                                VkMemoryPropertyFlags preferredFlags, MemoryAllocation *allocation) {
+    VkMemoryRequirements memoryRequirements;
+
+    vkGetImageMemoryRequirements(device, image, &memoryRequirements);
+
+    allocate(memoryRequirements, requiredFlags, preferredFlags,
+             (tiling == VK_IMAGE_TILING_OPTIMAL) ? (MEMORY_RESOURCE_OPTIMAL) : (MEMORY_RESOURCE_LINEAR), allocation);
+
+    if (vkBindImageMemory(device, image, allocation->memory, allocation->offset) != VK_SUCCESS)
+        throw VulkanException("Couldn't bind image memory.");
+}
+
+void DeviceMemoryAllocator::free(MemoryAllocation *allocation) {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    MemoryBlock *block = allocation->block;
+    VkDeviceSize offset = allocation->offset;
+
+    *allocation = MemoryAllocation();
+
+    // Linear pool allocations are only released by resetLinearPool().
+    if (block == nullptr || block->linear)
+        return;
+
+    std::map<VkDeviceSize, MemoryRange>::iterator allocated = block->allocations.find(offset);
+
+    if (allocated == block->allocations.end())
+        throw VulkanException("Freeing memory that wasn't allocated.");
+
+    VkDeviceSize size = allocated->second.size;
+
+    block->allocations.erase(allocated);
+    block->usedBytes -= size;
+
+    // Coalesce with the free ranges right before and after the allocation.
+    std::map<VkDeviceSize, VkDeviceSize>::iterator freed = block->freeRanges.emplace(offset, size).first;
+    std::map<VkDeviceSize, VkDeviceSize>::iterator next = std::next(freed);
+
+    if (next != block->freeRanges.end() && freed->first + freed->second == next->first) {
+        freed->second += next->second;
+        block->freeRanges.erase(next);
+    }
+
+    if (freed != block->freeRanges.begin()) {
+        std::map<VkDeviceSize, VkDeviceSize>::iterator previous = std::prev(freed);
+
+        if (previous->first + previous->second == freed->first) {
+            previous->second += freed->second;
+            block->freeRanges.erase(freed);
+        }
+    }
+
+    if (!block->allocations.empty())
+        return;
+
+    std::vector<MemoryBlock *> &pool = (block->dedicated) ? (dedicatedBlocks[block->memoryTypeIndex])
+                                                          : (blocks[block->memoryTypeIndex][block->sizeClass]);
+
+    // One empty block is kept around per size class, so a free/allocate pair doesn't hit vkAllocateMemory.
+    if (!block->dedicated &&
+        std::count_if(pool.begin(), pool.end(), [](MemoryBlock *poolBlock) { return poolBlock->allocations.empty(); }) <
+        2)
+        return;
+
+    pool.erase(std::find(pool.begin(), pool.end(), block));
+
+    destroyBlock(block);
+}
+
+LinearMemoryPool *DeviceMemoryAllocator::createLinearPool(VkDeviceSize size, uint32_t memoryTypeBits,
+                                                          VkMemoryPropertyFlags requiredFlags,
+                                                          VkMemoryPropertyFlags preferredFlags) {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    uint32_t memoryTypeIndex = findMemoryType(memoryTypeBits, requiredFlags, preferredFlags);
+
+    if (memoryTypeIndex == UINT32_MAX)
+        throw VulkanException("No memory type suitable for the linear memory pool found.");
+
+    MemoryBlock *block = createBlock(memoryTypeIndex, size);
+
+    if (block == nullptr)
+        throw VulkanException("Couldn't allocate device memory for the linear memory pool.");
+
+    block->linear = true;
+
+    LinearMemoryPool *pool = new LinearMemoryPool;
+    pool->block = block;
+
+    linearPools.push_back(pool);
+
+    return pool;
+}
+
+bool DeviceMemoryAllocator::allocateLinear(LinearMemoryPool *pool, const VkMemoryRequirements &memoryRequirements,
+                                           MemoryResourceKind kind, MemoryAllocation *allocation) {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    MemoryBlock *block = pool->block;
+
+    if ((memoryRequirements.memoryTypeBits & (1u << block->memoryTypeIndex)) == 0)
+        return false;
+
+    VkDeviceSize offset = alignUp(pool->top, memoryRequirements.alignment);
+
+    if (pool->allocationCount > 0 && pool->lastAllocationKind != kind && onSamePage(pool->lastAllocationEnd, offset))
+        offset = alignUp(offset, bufferImageGranularity);
+
+    if (offset + memoryRequirements.size > block->size)
+        return false;
+
+    pool->top = offset + memoryRequirements.size;
+    pool->lastAllocationEnd = pool->top;
+    pool->lastAllocationKind = kind;
+    pool->allocationCount++;
+
+    allocation->memory = block->memory;
+    allocation->offset = offset;
+    allocation->size = memoryRequirements.size;
+    allocation->mappedData = (block->mappedData != nullptr) ? (block->mappedData + offset) : (nullptr);
+    allocation->memoryTypeIndex = block->memoryTypeIndex;
+    allocation->block = block;
+
+    return true;
+}
+
+void DeviceMemoryAllocator::resetLinearPool(LinearMemoryPool *pool) {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    pool->top = 0;
+    pool->lastAllocationEnd = 0;
+    pool->allocationCount = 0;
+}
+
+void DeviceMemoryAllocator::destroyLinearPool(LinearMemoryPool *pool) {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    linearPools.erase(std::remove(linearPools.begin(), linearPools.end(), pool), linearPools.end());
+
+    destroyBlock(pool->block);
+
+    delete pool;
+}
+
+void DeviceMemoryAllocator::flush(const MemoryAllocation &allocation) {
+    VkDeviceSize offset = 0;
+
+    flush(allocation, 1, &offset, &allocation.size);
+}
+
+void DeviceMemoryAllocator::flush(const MemoryAllocation &allocation, uint32_t rangeCount, const VkDeviceSize *offsets,
+                                  const VkDeviceSize *sizes) {
+    if (allocation.block == nullptr || allocation.mappedData == nullptr || rangeCount == 0 ||
+        (memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags &
+         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0)
+        return;
+
+    std::vector<VkMappedMemoryRange> memoryRanges(rangeCount);
+
+    // Flushed ranges have to start and end on nonCoherentAtomSize multiples, or at the end of the memory object.
+    for (uint32_t i = 0; i < rangeCount; i++) {
+        VkDeviceSize end = alignUp(allocation.offset + offsets[i] + sizes[i], nonCoherentAtomSize);
+
+        memoryRanges[i].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        memoryRanges[i].pNext = nullptr;
+        memoryRanges[i].memory = allocation.memory;
+        memoryRanges[i].offset = (allocation.offset + offsets[i]) & ~(nonCoherentAtomSize - 1);
+        memoryRanges[i].size = (end >= allocation.block->size) ? (VK_WHOLE_SIZE) : (end - memoryRanges[i].offset);
+    }
+
+    if (vkFlushMappedMemoryRanges(device, rangeCount, memoryRanges.data()) != VK_SUCCESS)
+        throw VulkanException("Couldn't flush mapped memory ranges.");
+}
+
+MemoryTypeStatistics DeviceMemoryAllocator::getStatistics(uint32_t memoryTypeIndex) {
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    MemoryTypeStatistics statistics;
+
+    std::vector<MemoryBlock *> memoryTypeBlocks(dedicatedBlocks[memoryTypeIndex]);
+
+    for (uint32_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; sizeClass++)
+        memoryTypeBlocks.insert(memoryTypeBlocks.end(), blocks[memoryTypeIndex][sizeClass].begin(),
+                                blocks[memoryTypeIndex][sizeClass].end());
+
+    for (MemoryBlock *block : memoryTypeBlocks) {
+        statistics.blockCount++;
+        statistics.dedicatedBlockCount += (block->dedicated) ? (1) : (0);
+        statistics.allocationCount += (uint32_t) block->allocations.size();
+        statistics.reservedBytes += block->size;
+        statistics.usedBytes += block->usedBytes;
+
+        for (const std::pair<const VkDeviceSize, VkDeviceSize> &freeRange : block->freeRanges)
+            statistics.largestFreeRange = std::max(statistics.largestFreeRange, freeRange.second);
+    }
+
+    for (LinearMemoryPool *pool : linearPools) {
+        if (pool->block->memoryTypeIndex != memoryTypeIndex)
+            continue;
+
+        statistics.blockCount++;
+        statistics.allocationCount += pool->allocationCount;
+        statistics.reservedBytes += pool->block->size;
+        statistics.usedBytes += pool->top;
+        statistics.largestFreeRange = std::max(statistics.largestFreeRange, pool->block->size - pool->top);
+    }
+
+    return statistics;
+}
+
+void DeviceMemoryAllocator::dumpStatistics(std::ostream &out) {
+    uint32_t memoryObjectCount;
+
+    {
+        std::lock_guard<std::mutex> lock(allocatorMutex);
+        memoryObjectCount = deviceMemoryCount;
+    }
+
+    out << "Device memory: " << memoryObjectCount << " of at most " << maxMemoryAllocationCount
+        << " VkDeviceMemory objects in use." << std::endl;
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        MemoryTypeStatistics statistics = getStatistics(i);
+
+        if (statistics.blockCount == 0)
+            continue;
+
+        out << "\tMemory type " << i << ": " << statistics.blockCount << " blocks (" << statistics.dedicatedBlockCount
+            << " dedicated), " << (double) statistics.reservedBytes / (1024 * 1024) << " MB reserved, "
+            << (double) statistics.usedBytes / (1024 * 1024) << " MB used by " << statistics.allocationCount
+            << " allocations, largest free range " << (double) statistics.largestFreeRange / 1024 << " KB"
+            << std::endl;
+    }
+}
+
+VkDeviceSize DeviceMemoryAllocator::getBlockSize(uint32_t memoryTypeIndex, SizeClass sizeClass) const {
+    // Small heaps (e.g. the 256 MB device local and host visible heap on some GPUs) would otherwise be eaten up by
+    // a handful of blocks.
+    VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+    VkDeviceSize blockSize = (sizeClass == SIZE_CLASS_SMALL) ? (smallBlockSize) : (largeBlockSize);
+
+    return std::max<VkDeviceSize>(std::min<VkDeviceSize>(blockSize, heapSize / 8), smallAllocationLimit);
+}
+
+MemoryBlock *DeviceMemoryAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size) {
+    if (deviceMemoryCount >= maxMemoryAllocationCount)
+        return nullptr;
+
+    VkMemoryAllocateInfo memoryAllocateInfo = {};
+    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocateInfo.pNext = nullptr;
+    memoryAllocateInfo.allocationSize = size;
+    memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory;
+    void *mappedData = nullptr;
+
+    if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS)
+        return nullptr;
+
+    if ((memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 &&
+        vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mappedData) != VK_SUCCESS) {
+        vkFreeMemory(device, memory, nullptr);
+
+        return nullptr;
+    }
+
+    MemoryBlock *block = new MemoryBlock;
+    block->memory = memory;
+    block->size = size;
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->mappedData = (uint8_t *) mappedData;
+    block->freeRanges[0] = size;
+
+    deviceMemoryCount++;
+
+    return block;
+}
+
+void DeviceMemoryAllocator::destroyBlock(MemoryBlock *block) {
+    if (block->mappedData != nullptr)
+        vkUnmapMemory(device, block->memory);
+
+    vkFreeMemory(device, block->memory, nullptr);
+
+    deviceMemoryCount--;
+
+    delete block;
+}
+
+bool DeviceMemoryAllocator::onSamePage(VkDeviceSize endOfFirst, VkDeviceSize beginningOfSecond) const {
+    if (bufferImageGranularity <= 1 || endOfFirst == 0)
+        return false;
+
+    VkDeviceSize pageMask = ~(bufferImageGranularity - 1);
+
+    return ((endOfFirst - 1) & pageMask) == (beginningOfSecond & pageMask);
+}
+
+bool DeviceMemoryAllocator::allocateFromBlock(MemoryBlock *block, VkDeviceSize size, VkDeviceSize alignment,
+                                              MemoryResourceKind kind, MemoryAllocation *allocation) {
+    std::map<VkDeviceSize, VkDeviceSize>::iterator bestFreeRange = block->freeRanges.end();
+    VkDeviceSize bestOffset = 0;
+
+    // Best fit: the smallest free range the allocation fits in, padding included.
+    for (std::map<VkDeviceSize, VkDeviceSize>::iterator freeRange = block->freeRanges.begin();
+         freeRange != block->freeRanges.end(); ++freeRange) {
+        VkDeviceSize freeRangeEnd = freeRange->first + freeRange->second;
+        VkDeviceSize offset = alignUp(freeRange->first, alignment);
+
+        // Free ranges never touch each other, so the neighbours of one are allocations.
+        std::map<VkDeviceSize, MemoryRange>::iterator next = block->allocations.lower_bound(freeRangeEnd);
+
+        if (next != block->allocations.begin()) {
+            std::map<VkDeviceSize, MemoryRange>::iterator previous = std::prev(next);
+
+            if (previous->second.kind != kind && onSamePage(previous->first + previous->second.size, offset))
+                offset = alignUp(offset, bufferImageGranularity);
+        }
+
+        if (offset + size > freeRangeEnd)
+            continue;
+
+        if (next != block->allocations.end() && next->second.kind != kind && onSamePage(offset + size, next->first))
+            continue;
+
+        if (bestFreeRange == block->freeRanges.end() || freeRange->second < bestFreeRange->second) {
+            bestFreeRange = freeRange;
+            bestOffset = offset;
+        }
+    }
+
+    if (bestFreeRange == block->freeRanges.end())
+        return false;
+
+    VkDeviceSize freeRangeBeginning = bestFreeRange->first;
+    VkDeviceSize freeRangeEnd = bestFreeRange->first + bestFreeRange->second;
+
+    block->freeRanges.erase(bestFreeRange);
+
+    if (bestOffset > freeRangeBeginning)
+        block->freeRanges[freeRangeBeginning] = bestOffset - freeRangeBeginning;
+
+    if (bestOffset + size < freeRangeEnd)
+        block->freeRanges[bestOffset + size] = freeRangeEnd - (bestOffset + size);
+
+    block->allocations[bestOffset] = {size, kind};
+    block->usedBytes += size;
+
+    allocation->memory = block->memory;
+    allocation->offset = bestOffset;
+    allocation->size = size;
+    allocation->mappedData = (block->mappedData != nullptr) ? (block->mappedData + bestOffset) : (nullptr);
+    allocation->memoryTypeIndex = block->memoryTypeIndex;
+    allocation->block = block;
+
+    return true;
+}
+
+bool DeviceMemoryAllocator::allocateFromMemoryType(uint32_t memoryTypeIndex,
+                                                   const VkMemoryRequirements &memoryRequirements,
+                                                   MemoryResourceKind kind, MemoryAllocation *allocation) {
+    if (memoryRequirements.size > getBlockSize(memoryTypeIndex, SIZE_CLASS_LARGE) / 2) {
+        MemoryBlock *block = createBlock(memoryTypeIndex, memoryRequirements.size);
+
+        if (block == nullptr)
+            return false;
+
+        block->dedicated = true;
+        dedicatedBlocks[memoryTypeIndex].push_back(block);
+
+        return allocateFromBlock(block, memoryRequirements.size, memoryRequirements.alignment, kind, allocation);
+    }
+
+    SizeClass sizeClass = (memoryRequirements.size <= smallAllocationLimit) ? (SIZE_CLASS_SMALL) : (SIZE_CLASS_LARGE);
+
+    for (MemoryBlock *block : blocks[memoryTypeIndex][sizeClass])
+        if (allocateFromBlock(block, memoryRequirements.size, memoryRequirements.alignment, kind, allocation))
+            return true;
+
+    MemoryBlock *block = createBlock(memoryTypeIndex, getBlockSize(memoryTypeIndex, sizeClass));
+
+    if (block == nullptr)
+        return false;
+
+    block->sizeClass = sizeClass;
+    blocks[memoryTypeIndex][sizeClass].push_back(block);
+
+    return allocateFromBlock(block, memoryRequirements.size, memoryRequirements.alignment, kind, allocation);
+}
@@ -0,0 +1,146 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_DEVICE_MEMORY_ALLOCATOR_H
+#define VULKAN_TEST_DEVICE_MEMORY_ALLOCATOR_H
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Buffers and linear images may not share a bufferImageGranularity page with optimal images.
+enum MemoryResourceKind {
+    MEMORY_RESOURCE_LINEAR = 0,
+    MEMORY_RESOURCE_OPTIMAL = 1
+};
+
+struct MemoryBlock;
+
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    uint8_t *mappedData = nullptr;          // points at offset, host visible memory types only
+    uint32_t memoryTypeIndex = UINT32_MAX;
+    MemoryBlock *block = nullptr;
+};
+
+// Bump allocator over a single block, allocations are released all at once by resetLinearPool().
+struct LinearMemoryPool {
+    MemoryBlock *block = nullptr;
+    VkDeviceSize top = 0;
+    VkDeviceSize lastAllocationEnd = 0;
+    MemoryResourceKind lastAllocationKind = MEMORY_RESOURCE_LINEAR;
+    uint32_t allocationCount = 0;
+};
+
+struct MemoryTypeStatistics {
+    uint32_t blockCount = 0;                // VkDeviceMemory objects, dedicated ones included
+    uint32_t dedicatedBlockCount = 0;
+    uint32_t allocationCount = 0;
+    VkDeviceSize reservedBytes = 0;         // sum of the block sizes
+    VkDeviceSize usedBytes = 0;             // sum of the allocation sizes, alignment padding excluded
+    VkDeviceSize largestFreeRange = 0;
+};
+
+// Sub-allocates VkDeviceMemory for the engine. Requests are split into size classes per memory type:
+//  - small ones share small blocks, so they never fragment the big ones
+//  - large ones share large blocks, best fit with coalescing on free
+//  - anything over half a large block gets a VkDeviceMemory of its own
+// Host visible blocks are mapped once, for their whole lifetime. All members are safe to call from several threads.
+class DeviceMemoryAllocator {
+public:
+    DeviceMemoryAllocator();
+
+    ~DeviceMemoryAllocator();
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device);
+
+    // Frees every block, whether or not the allocations in it were freed.
+    void destroy();
+
+    // Among memoryTypeBits, the first type with all requiredFlags that also has preferredFlags, else the first type
+    // with requiredFlags. UINT32_MAX if there is none.
+    uint32_t findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags requiredFlags,
+                            VkMemoryPropertyFlags preferredFlags) const;
+
+    // Throws VulkanException when no memory type fits or the device is out of memory.
+    void allocate(const VkMemoryRequirements &memoryRequirements, VkMemoryPropertyFlags requiredFlags,
+                  VkMemoryPropertyFlags preferredFlags, MemoryResourceKind kind, MemoryAllocation *allocation);
+
+    // Allocates for and binds the buffer or image.
+    void allocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags requiredFlags,
+                              VkMemoryPropertyFlags preferredFlags, MemoryAllocation *allocation);
+
+    void allocateImageMemory(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags requiredFlags,
+                             VkMemoryPropertyFlags preferredFlags, MemoryAllocation *allocation);
+
+    void free(MemoryAllocation *allocation);
+
+    LinearMemoryPool *createLinearPool(VkDeviceSize size, uint32_t memoryTypeBits, VkMemoryPropertyFlags requiredFlags,
+                                       VkMemoryPropertyFlags preferredFlags);
+
+    // Returns false when the pool is exhausted.
+    bool allocateLinear(LinearMemoryPool *pool, const VkMemoryRequirements &memoryRequirements,
+                        MemoryResourceKind kind, MemoryAllocation *allocation);
+
+    void resetLinearPool(LinearMemoryPool *pool);
+
+    void destroyLinearPool(LinearMemoryPool *pool);
+
+    // Makes host writes visible to the device, a no-op on host coherent memory.
+    void flush(const MemoryAllocation &allocation);
+
+    // Same, for rangeCount ranges relative to the allocation, all of them in one vkFlushMappedMemoryRanges call.
+    void flush(const MemoryAllocation &allocation, uint32_t rangeCount, const VkDeviceSize *offsets,
+               const VkDeviceSize *sizes);
+
+    MemoryTypeStatistics getStatistics(uint32_t memoryTypeIndex);
+
+    void dumpStatistics(std::ostream &out);
+
+private:
+    enum SizeClass {
+        SIZE_CLASS_SMALL = 0,
+        SIZE_CLASS_LARGE = 1,
+        SIZE_CLASS_COUNT = 2
+    };
+
+    DeviceMemoryAllocator(const DeviceMemoryAllocator &) = delete;
+
+    DeviceMemoryAllocator &operator=(const DeviceMemoryAllocator &) = delete;
+
+    VkDeviceSize getBlockSize(uint32_t memoryTypeIndex, SizeClass sizeClass) const;
+
+    MemoryBlock *createBlock(uint32_t memoryTypeIndex, VkDeviceSize size);
+
+    void destroyBlock(MemoryBlock *block);
+
+    bool allocateFromBlock(MemoryBlock *block, VkDeviceSize size, VkDeviceSize alignment, MemoryResourceKind kind,
+                           MemoryAllocation *allocation);
+
+    bool allocateFromMemoryType(uint32_t memoryTypeIndex, const VkMemoryRequirements &memoryRequirements,
+                                MemoryResourceKind kind, MemoryAllocation *allocation);
+
+    bool onSamePage(VkDeviceSize endOfFirst, VkDeviceSize beginningOfSecond) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+    VkDeviceSize bufferImageGranularity = 1;
+    VkDeviceSize nonCoherentAtomSize = 1;
+    uint32_t maxMemoryAllocationCount = 0;
+    uint32_t deviceMemoryCount = 0;
+    std::vector<MemoryBlock *> blocks[VK_MAX_MEMORY_TYPES][SIZE_CLASS_COUNT];
+    std::vector<MemoryBlock *> dedicatedBlocks[VK_MAX_MEMORY_TYPES];
+    std::vector<LinearMemoryPool *> linearPools;
+    std::mutex allocatorMutex;
+};
+
+
+#endif //VULKAN_TEST_DEVICE_MEMORY_ALLOCATOR_H
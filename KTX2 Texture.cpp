@@ -0,0 +1,272 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include "KTX2 Texture.h"
+#include "Mip Chain.h"
+#include <algorithm>
+#include <cstring>
+
+static const uint8_t ktx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+// Identifier, then the header and index fields in file order, all little endian.
+struct Ktx2Header {
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct Ktx2LevelIndexEntry {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be packed");
+static_assert(sizeof(Ktx2LevelIndexEntry) == 24, "KTX2 level index entry must be packed");
+
+// Khronos Data Format color models of the block compressed formats.
+enum {
+    KHR_DF_MODEL_RGBSDA = 1,
+    KHR_DF_MODEL_BC4 = 131,
+    KHR_DF_MODEL_BC5 = 132,
+    KHR_DF_MODEL_BC7 = 134
+};
+
+uint32_t getKtx2BlockSize(VkFormat format, uint32_t *blockExtent) {
+    *blockExtent = 4;
+
+    switch (format) {
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            return 16;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+            *blockExtent = 1;
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+size_t getKtx2LevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t level) {
+    uint32_t blockExtent;
+    uint32_t blockSize = getKtx2BlockSize(format, &blockExtent);
+    uint32_t levelWidth = std::max(width >> level, 1u);
+    uint32_t levelHeight = std::max(height >> level, 1u);
+
+    return (size_t) ((levelWidth + blockExtent - 1) / blockExtent) * ((levelHeight + blockExtent - 1) / blockExtent) *
+           blockSize;
+}
+
+// Basic data format descriptor block, one sample per plane of the block.
+static std::vector<uint32_t> createDataFormatDescriptor(VkFormat format) {
+    uint32_t blockExtent;
+    uint32_t blockSize = getKtx2BlockSize(format, &blockExtent);
+    uint32_t colorModel;
+    std::vector<uint32_t> samples;              // four words each: bit offset/length/channel, position, lower, upper
+
+    switch (format) {
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            colorModel = KHR_DF_MODEL_BC4;
+            samples = {0 | (63 << 16) | (0 << 24), 0, 0, UINT32_MAX};
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            colorModel = KHR_DF_MODEL_BC5;
+            samples = {0 | (63 << 16) | (0 << 24), 0, 0, UINT32_MAX,
+                       64 | (63 << 16) | (1 << 24), 0, 0, UINT32_MAX};
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            colorModel = KHR_DF_MODEL_BC7;
+            samples = {0 | (127 << 16) | (0 << 24), 0, 0, UINT32_MAX};
+            break;
+        default:
+            colorModel = KHR_DF_MODEL_RGBSDA;
+
+            for (uint32_t channel = 0; channel < 4; channel++) {
+                // Alpha is channel 15 in the RGBSDA model.
+                uint32_t channelType = (channel == 3) ? (15) : (channel);
+
+                samples.insert(samples.end(), {(channel * 8) | (7 << 16) | (channelType << 24), 0, 0, 255});
+            }
+    }
+
+    uint32_t blockByteSize = 24 + (uint32_t) samples.size() * 4;
+    uint32_t dimension = blockExtent - 1;
+
+    std::vector<uint32_t> descriptor = {
+            4 + blockByteSize,                                          // dfdTotalSize
+            0,                                                          // Khronos vendor, basic descriptor type
+            2 | (blockByteSize << 16),                                  // version 1.3, block size
+            colorModel | (1 << 8) | (1 << 16),                          // BT.709 primaries, linear transfer
+            dimension | (dimension << 8),                               // texel block dimensions minus one
+            blockSize,                                                  // bytes of plane 0
+            0
+    };
+
+    descriptor.insert(descriptor.end(), samples.begin(), samples.end());
+
+    return descriptor;
+}
+
+bool writeKtx2Texture(const std::string &path, VkFormat format, uint32_t width, uint32_t height,
+                      uint32_t levelCount, const std::vector<std::vector<uint8_t>> &levels) {
+    uint32_t blockExtent;
+    uint32_t blockSize = getKtx2BlockSize(format, &blockExtent);
+
+    if (blockSize == 0 || levelCount == 0 || levels.size() != levelCount)
+        return false;
+
+    std::vector<uint32_t> descriptor = createDataFormatDescriptor(format);
+
+    Ktx2Header header = {};
+    memcpy(header.identifier, ktx2Identifier, sizeof(ktx2Identifier));
+    header.vkFormat = (uint32_t) format;
+    header.typeSize = 1;                        // block compressed, or 8 bit components
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndexEntry);
+    header.dfdByteLength = (uint32_t) (descriptor.size() * sizeof(uint32_t));
+
+    // Level data follows smallest level first, each aligned to the block size (a multiple of 4 here).
+    std::vector<Ktx2LevelIndexEntry> levelIndex(levelCount);
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+
+    for (uint32_t level = levelCount; level-- > 0;) {
+        if (levels[level].size() != getKtx2LevelSize(format, width, height, level))
+            return false;
+
+        offset = (offset + blockSize - 1) / blockSize * blockSize;
+
+        levelIndex[level].byteOffset = offset;
+        levelIndex[level].byteLength = levels[level].size();
+        levelIndex[level].uncompressedByteLength = levels[level].size();
+
+        offset += levels[level].size();
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+        return false;
+
+    file.write((const char *) &header, sizeof(header));
+    file.write((const char *) levelIndex.data(), levelIndex.size() * sizeof(Ktx2LevelIndexEntry));
+    file.write((const char *) descriptor.data(), descriptor.size() * sizeof(uint32_t));
+
+    for (uint32_t level = levelCount; level-- > 0;) {
+        static const char padding[16] = {};
+
+        file.write(padding, levelIndex[level].byteOffset - (uint64_t) file.tellp());
+        file.write((const char *) levels[level].data(), levels[level].size());
+    }
+
+    return file.good();
+}
+
+bool Ktx2Texture::open(const std::string &path) {
+    close();
+
+    file.open(path, std::ios::binary);
+
+    if (!file.is_open())
+        return false;
+
+    Ktx2Header header;
+
+    if (!file.read((char *) &header, sizeof(header)) ||
+        memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0 ||
+        header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1 ||
+        header.faceCount != 1 || header.levelCount == 0 || header.supercompressionScheme != 0) {
+        close();
+
+        return false;
+    }
+
+    uint32_t blockExtent;
+
+    if (getKtx2BlockSize((VkFormat) header.vkFormat, &blockExtent) == 0) {
+        close();
+
+        return false;
+    }
+
+    // Checked before the level index is allocated, a corrupt count could otherwise ask for up to 96 GiB.
+    if (header.levelCount > getMipLevelCount(header.pixelWidth, header.pixelHeight)) {
+        close();
+
+        return false;
+    }
+
+    format = (VkFormat) header.vkFormat;
+    width = header.pixelWidth;
+    height = header.pixelHeight;
+    levelCount = header.levelCount;
+
+    std::vector<Ktx2LevelIndexEntry> levelIndex(levelCount);
+
+    if (!file.read((char *) levelIndex.data(), levelIndex.size() * sizeof(Ktx2LevelIndexEntry))) {
+        close();
+
+        return false;
+    }
+
+    // readLevel seeks to each level, nothing reads on from here.
+    file.seekg(0, std::ios::end);
+
+    uint64_t fileSize = (uint64_t) file.tellg();
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        // Both fit into the file, checked without overflowing their sum.
+        if (levelIndex[level].byteLength != getKtx2LevelSize(format, width, height, level) ||
+            levelIndex[level].byteOffset > fileSize ||
+            levelIndex[level].byteLength > fileSize - levelIndex[level].byteOffset) {
+            close();
+
+            return false;
+        }
+
+        levels.push_back({levelIndex[level].byteOffset, levelIndex[level].byteLength});
+    }
+
+    return true;
+}
+
+void Ktx2Texture::close() {
+    if (file.is_open())
+        file.close();
+
+    file.clear();
+    levels.clear();
+    format = VK_FORMAT_UNDEFINED;
+    width = height = levelCount = 0;
+}
+
+bool Ktx2Texture::readLevel(uint32_t level, size_t offset, size_t size, void *dst) {
+    if (level >= levels.size() || offset > levels[level].byteLength || size > levels[level].byteLength - offset)
+        return false;
+
+    file.seekg((std::streamoff) (levels[level].byteOffset + offset));
+
+    return (bool) file.read((char *) dst, (std::streamsize) size);
+}
+
+size_t Ktx2Texture::getLevelSize(uint32_t level) const {
+    return (level < levels.size()) ? ((size_t) levels[level].byteLength) : (0);
+}
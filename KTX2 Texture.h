@@ -0,0 +1,57 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_KTX2_TEXTURE_H
+#define VULKAN_TEST_KTX2_TEXTURE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Only the subset the engine reads and the texture compressor writes: a single 2D image with a full or partial mip
+// chain, no array layers, faces or supercompression. Formats are limited to the ones getKtx2BlockSize() knows.
+
+// Bytes per 4x4 block, or per texel for uncompressed formats (blockExtent 1). 0 for unsupported formats.
+uint32_t getKtx2BlockSize(VkFormat format, uint32_t *blockExtent);
+
+size_t getKtx2LevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t level);
+
+// levels holds levelCount tightly packed levels, level 0 first.
+bool writeKtx2Texture(const std::string &path, VkFormat format, uint32_t width, uint32_t height,
+                      uint32_t levelCount, const std::vector<std::vector<uint8_t>> &levels);
+
+class Ktx2Texture {
+public:
+    // Reads and validates the header and level index, level data is only read by readLevel().
+    bool open(const std::string &path);
+
+    void close();
+
+    // Reads size bytes of the level into dst, starting offset bytes into it.
+    bool readLevel(uint32_t level, size_t offset, size_t size, void *dst);
+
+    size_t getLevelSize(uint32_t level) const;
+
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t levelCount = 0;
+
+private:
+    struct Level {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+    };
+
+    std::ifstream file;
+    std::vector<Level> levels;
+};
+
+
+#endif //VULKAN_TEST_KTX2_TEXTURE_H
@@ -0,0 +1,226 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include <cstring>
+#include <fstream>
+#include "Mesh Cache.h"
+#include "Cache File.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char meshCacheMagic[4] = {'V', 'T', 'M', 'C'};
+static uint64_t alignOffset(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+bool hashMeshSource(const std::string &sourcePath, uint32_t importFlags, uint64_t *hash) {
+    std::ifstream sourceFile(sourcePath, std::ios::binary);
+
+    if (!sourceFile.is_open())
+        return false;
+
+    uint32_t version = MESH_CACHE_VERSION;
+
+    uint64_t result = FNV1A_OFFSET_BASIS;
+    result = fnv1a(result, &version, sizeof(version));
+    result = fnv1a(result, &importFlags, sizeof(importFlags));
+
+    char chunk[64 * 1024];
+
+    while (sourceFile) {
+        sourceFile.read(chunk, sizeof(chunk));
+        result = fnv1a(result, chunk, (size_t) sourceFile.gcount());
+    }
+
+    *hash = result;
+
+    return true;
+}
+
+bool writeMeshCache(const std::string &cachePath, uint64_t sourceHash, uint32_t importFlags, uint32_t attributeSize,
+                    const std::vector<MeshCacheSource> &meshes) {
+    MeshCacheHeader header = {};
+    memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.importFlags = importFlags;
+    header.attributeSize = attributeSize;
+    header.meshCount = (uint32_t) meshes.size();
+
+    std::vector<MeshCacheEntry> entries(meshes.size());
+
+    uint64_t lastCoveredSize = sizeof(MeshCacheHeader) + sizeof(MeshCacheEntry) * meshes.size();
+
+    for (size_t meshIndex = 0; meshIndex < meshes.size(); meshIndex++) {
+        entries[meshIndex].vertexCount = meshes[meshIndex].vertexCount;
+        entries[meshIndex].indexCount = meshes[meshIndex].indexCount;
+
+        entries[meshIndex].vertexDataOffset = alignOffset(lastCoveredSize, 16);
+        lastCoveredSize = entries[meshIndex].vertexDataOffset + (uint64_t) attributeSize * meshes[meshIndex].vertexCount;
+
+        entries[meshIndex].indexDataOffset = alignOffset(lastCoveredSize, 16);
+        lastCoveredSize = entries[meshIndex].indexDataOffset + sizeof(uint32_t) * meshes[meshIndex].indexCount;
+    }
+
+    return writeFileAtomically(cachePath, [&](std::ofstream &cacheFile) {
+        cacheFile.write((const char *) &header, sizeof(header));
+        cacheFile.write((const char *) entries.data(), sizeof(MeshCacheEntry) * entries.size());
+
+        const char padding[16] = {};
+        uint64_t writtenSize = sizeof(MeshCacheHeader) + sizeof(MeshCacheEntry) * meshes.size();
+
+        for (size_t meshIndex = 0; meshIndex < meshes.size(); meshIndex++) {
+            cacheFile.write(padding, entries[meshIndex].vertexDataOffset - writtenSize);
+            cacheFile.write((const char *) meshes[meshIndex].vertexData,
+                            (std::streamsize) attributeSize * meshes[meshIndex].vertexCount);
+            writtenSize = entries[meshIndex].vertexDataOffset +
+                          (uint64_t) attributeSize * meshes[meshIndex].vertexCount;
+
+            cacheFile.write(padding, entries[meshIndex].indexDataOffset - writtenSize);
+            cacheFile.write((const char *) meshes[meshIndex].indexData,
+                            (std::streamsize) sizeof(uint32_t) * meshes[meshIndex].indexCount);
+            writtenSize = entries[meshIndex].indexDataOffset + sizeof(uint32_t) * meshes[meshIndex].indexCount;
+        }
+    });
+}
+
+MappedMeshCache::MappedMeshCache() = default;
+
+MappedMeshCache::~MappedMeshCache() {
+    close();
+}
+
+bool MappedMeshCache::open(const std::string &cachePath, uint64_t sourceHash, uint32_t importFlags,
+                           uint32_t attributeSize) {
+    close();
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < (LONGLONG) sizeof(MeshCacheHeader)) {
+        close();
+        return false;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mappingHandle == NULL) {
+        close();
+        return false;
+    }
+
+    mappedData = (const uint8_t *) MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    mappedSize = (size_t) fileSize.QuadPart;
+#else
+    fileDescriptor = ::open(cachePath.c_str(), O_RDONLY);
+
+    if (fileDescriptor == -1)
+        return false;
+
+    struct stat fileStat;
+
+    if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size < (off_t) sizeof(MeshCacheHeader)) {
+        close();
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+    mappedData = (mapping == MAP_FAILED) ? (nullptr) : ((const uint8_t *) mapping);
+    mappedSize = (size_t) fileStat.st_size;
+#endif
+
+    if (mappedData == nullptr || !validate(sourceHash, importFlags, attributeSize)) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedMeshCache::close() {
+#ifdef _WIN32
+    if (mappedData != nullptr)
+        UnmapViewOfFile(mappedData);
+
+    if (mappingHandle != NULL)
+        CloseHandle(mappingHandle);
+
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+
+    mappingHandle = NULL;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (mappedData != nullptr)
+        munmap((void *) mappedData, mappedSize);
+
+    if (fileDescriptor != -1)
+        ::close(fileDescriptor);
+
+    fileDescriptor = -1;
+#endif
+
+    mappedData = nullptr;
+    mappedSize = 0;
+}
+
+bool MappedMeshCache::validate(uint64_t sourceHash, uint32_t importFlags, uint32_t attributeSize) const {
+    const MeshCacheHeader *header = (const MeshCacheHeader *) mappedData;
+
+    if (memcmp(header->magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 ||
+        header->version != MESH_CACHE_VERSION ||
+        header->sourceHash != sourceHash ||
+        header->importFlags != importFlags ||
+        header->attributeSize != attributeSize)
+        return false;
+
+    if (sizeof(MeshCacheHeader) + sizeof(MeshCacheEntry) * (uint64_t) header->meshCount > mappedSize)
+        return false;
+
+    for (uint32_t meshIndex = 0; meshIndex < header->meshCount; meshIndex++) {
+        const MeshCacheEntry *entry = getEntry(meshIndex);
+
+        if (entry->vertexDataOffset + (uint64_t) attributeSize * entry->vertexCount > mappedSize ||
+            entry->indexDataOffset + sizeof(uint32_t) * (uint64_t) entry->indexCount > mappedSize)
+            return false;
+    }
+
+    return true;
+}
+
+const MeshCacheEntry *MappedMeshCache::getEntry(uint32_t meshIndex) const {
+    return ((const MeshCacheEntry *) (mappedData + sizeof(MeshCacheHeader))) + meshIndex;
+}
+
+uint32_t MappedMeshCache::getMeshCount() const {
+    return ((const MeshCacheHeader *) mappedData)->meshCount;
+}
+
+const void *MappedMeshCache::getVertexData(uint32_t meshIndex) const {
+    return mappedData + getEntry(meshIndex)->vertexDataOffset;
+}
+
+uint32_t MappedMeshCache::getVertexCount(uint32_t meshIndex) const {
+    return getEntry(meshIndex)->vertexCount;
+}
+
+const uint32_t *MappedMeshCache::getIndexData(uint32_t meshIndex) const {
+    return (const uint32_t *) (mappedData + getEntry(meshIndex)->indexDataOffset);
+}
+
+uint32_t MappedMeshCache::getIndexCount(uint32_t meshIndex) const {
+    return getEntry(meshIndex)->indexCount;
+}
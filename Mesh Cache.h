@@ -0,0 +1,94 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_MESH_CACHE_H
+#define VULKAN_TEST_MESH_CACHE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Bump whenever the on-disk layout, the vertex conversion in VulkanEngine::importMesh or the mesh optimization changes.
+#define MESH_CACHE_VERSION 2
+
+struct MeshCacheHeader {
+    char magic[4];                  // "VTMC"
+    uint32_t version;
+    uint64_t sourceHash;            // hash of the source file contents, import flags and version
+    uint32_t importFlags;
+    uint32_t attributeSize;         // sizeof(Attribute<float>) at the time the cache was written
+    uint32_t meshCount;
+    uint32_t reserved;
+};
+
+struct MeshCacheEntry {
+    uint64_t vertexDataOffset;      // from the beginning of the file
+    uint64_t indexDataOffset;       // from the beginning of the file
+    uint32_t vertexCount;
+    uint32_t indexCount;
+};
+
+struct MeshCacheSource {
+    const void *vertexData;
+    uint32_t vertexCount;
+    const uint32_t *indexData;
+    uint32_t indexCount;
+};
+
+// FNV-1a over the source file, seeded with the import flags and the cache version. Returns false if the file
+// couldn't be read.
+bool hashMeshSource(const std::string &sourcePath, uint32_t importFlags, uint64_t *hash);
+
+bool writeMeshCache(const std::string &cachePath, uint64_t sourceHash, uint32_t importFlags, uint32_t attributeSize,
+                    const std::vector<MeshCacheSource> &meshes);
+
+// Read-only memory mapping of a cache file. Vertex and index pointers stay valid until close().
+class MappedMeshCache {
+public:
+    MappedMeshCache();
+
+    ~MappedMeshCache();
+
+    bool open(const std::string &cachePath, uint64_t sourceHash, uint32_t importFlags, uint32_t attributeSize);
+
+    void close();
+
+    uint32_t getMeshCount() const;
+
+    const void *getVertexData(uint32_t meshIndex) const;
+
+    uint32_t getVertexCount(uint32_t meshIndex) const;
+
+    const uint32_t *getIndexData(uint32_t meshIndex) const;
+
+    uint32_t getIndexCount(uint32_t meshIndex) const;
+
+private:
+    MappedMeshCache(const MappedMeshCache &) = delete;
+
+    MappedMeshCache &operator=(const MappedMeshCache &) = delete;
+
+    bool validate(uint64_t sourceHash, uint32_t importFlags, uint32_t attributeSize) const;
+
+    const MeshCacheEntry *getEntry(uint32_t meshIndex) const;
+
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#else
+    int fileDescriptor = -1;
+#endif
+    const uint8_t *mappedData = nullptr;
+    size_t mappedSize = 0;
+};
+
+
+#endif //VULKAN_TEST_MESH_CACHE_H
@@ -0,0 +1,286 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include "Mesh Optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+VertexCacheStatistics analyzeVertexCache(const uint32_t *indices, size_t indexCount, uint32_t vertexCount,
+                                         uint32_t cacheSize) {
+    // A vertex is in the cache while fewer than cacheSize misses happened since its own.
+    std::vector<uint32_t> missTimes(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t missCount = 0;
+    uint32_t referencedCount = 0;
+
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t vertex = indices[i];
+
+        if (!referenced[vertex]) {
+            referenced[vertex] = true;
+            referencedCount++;
+        } else if (missCount - missTimes[vertex] < cacheSize) {
+            continue;
+        }
+
+        missTimes[vertex] = ++missCount;
+    }
+
+    VertexCacheStatistics statistics;
+    statistics.transformedVertexCount = missCount;
+    statistics.acmr = (indexCount >= 3) ? ((float) missCount / (indexCount / 3)) : (0.0f);
+    statistics.atvr = (referencedCount > 0) ? ((float) missCount / referencedCount) : (0.0f);
+
+    return statistics;
+}
+
+void optimizeVertexCache(uint32_t *indices, size_t indexCount, uint32_t vertexCount) {
+    size_t triangleCount = indexCount / 3;
+    const int32_t cacheSize = MESH_OPTIMIZER_CACHE_SIZE;
+
+    // The triangles of every vertex, in one array.
+    std::vector<uint32_t> liveCounts(vertexCount, 0);
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        liveCounts[indices[i]]++;
+
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+        adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveCounts[vertex];
+
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[adjacencyFill[indices[i]]++] = (uint32_t) (i / 3);
+
+    std::vector<int32_t> cacheTimes(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> optimized;
+    int32_t time = cacheSize + 1;
+    uint32_t cursor = 0;
+    int64_t fanningVertex = (vertexCount > 0 && triangleCount > 0) ? (indices[0]) : (-1);
+
+    optimized.reserve(triangleCount * 3);
+
+    while (fanningVertex >= 0) {
+        candidates.clear();
+
+        // Every triangle left around the fanning vertex.
+        for (uint32_t i = adjacencyOffsets[fanningVertex]; i < adjacencyOffsets[fanningVertex + 1]; i++) {
+            uint32_t triangle = adjacency[i];
+
+            if (emitted[triangle])
+                continue;
+
+            emitted[triangle] = true;
+
+            for (int corner = 0; corner < 3; corner++) {
+                uint32_t vertex = indices[triangle * 3 + corner];
+
+                optimized.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCounts[vertex]--;
+
+                if (time - cacheTimes[vertex] > cacheSize)
+                    cacheTimes[vertex] = time++;
+            }
+        }
+
+        // The candidate still in the cache after fanning around it, oldest first.
+        fanningVertex = -1;
+        int32_t bestPriority = -1;
+
+        for (uint32_t vertex : candidates) {
+            if (liveCounts[vertex] == 0)
+                continue;
+
+            int32_t priority = 0;
+
+            if (time - cacheTimes[vertex] + 2 * (int32_t) liveCounts[vertex] <= cacheSize)
+                priority = time - cacheTimes[vertex];
+
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanningVertex = vertex;
+            }
+        }
+
+        if (fanningVertex >= 0)
+            continue;
+
+        // Dead end, the most recently used vertex with triangles left, else the next one in input order.
+        while (!deadEnds.empty() && fanningVertex < 0) {
+            if (liveCounts[deadEnds.back()] > 0)
+                fanningVertex = deadEnds.back();
+
+            deadEnds.pop_back();
+        }
+
+        while (fanningVertex < 0 && cursor < vertexCount) {
+            if (liveCounts[cursor] > 0)
+                fanningVertex = cursor;
+
+            cursor++;
+        }
+    }
+
+    memcpy(indices, optimized.data(), optimized.size() * sizeof(uint32_t));
+}
+
+struct TriangleCluster {
+    size_t begin;                       // first index
+    size_t end;
+    float sortKey;
+};
+
+void optimizeOverdraw(uint32_t *indices, size_t indexCount, const float *positions, size_t positionStride,
+                      uint32_t vertexCount, float threshold) {
+    size_t triangleCount = indexCount / 3;
+
+    if (triangleCount < 2)
+        return;
+
+    const uint32_t cacheSize = MESH_OPTIMIZER_CACHE_SIZE;
+    float meshAcmr = analyzeVertexCache(indices, triangleCount * 3, vertexCount, cacheSize).acmr;
+    std::vector<uint32_t> missTimes(vertexCount, 0);
+    std::vector<TriangleCluster> clusters;
+    uint32_t missCount = 0;
+    uint32_t clusterMissCount = 0;
+    size_t clusterBegin = 0;
+
+    // Vertices missed before the cluster began count as misses within it, the cut cost nothing if the cluster keeps
+    // up with the whole list on its own.
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        uint32_t triangleMissCount = 0;
+
+        for (int corner = 0; corner < 3; corner++) {
+            uint32_t vertex = indices[triangle * 3 + corner];
+
+            if (missTimes[vertex] == 0 || missCount - missTimes[vertex] >= cacheSize ||
+                missTimes[vertex] <= missCount - clusterMissCount) {
+                missTimes[vertex] = ++missCount;
+                triangleMissCount++;
+            }
+        }
+
+        // Hard boundary, the triangle shares nothing with the cache.
+        if (triangleMissCount == 3 && triangle > clusterBegin) {
+            clusters.push_back({clusterBegin * 3, triangle * 3, 0.0f});
+            clusterBegin = triangle;
+            clusterMissCount = 0;
+        }
+
+        clusterMissCount += triangleMissCount;
+
+        // Soft boundary.
+        if (clusterMissCount <= threshold * meshAcmr * (triangle + 1 - clusterBegin)) {
+            clusters.push_back({clusterBegin * 3, (triangle + 1) * 3, 0.0f});
+            clusterBegin = triangle + 1;
+            clusterMissCount = 0;
+        }
+    }
+
+    if (clusterBegin < triangleCount)
+        clusters.push_back({clusterBegin * 3, triangleCount * 3, 0.0f});
+
+    if (clusters.size() < 2)
+        return;
+
+    // Area weighted centroids and normals of the clusters, and the mesh's centroid.
+    std::vector<float> clusterCentroids(clusters.size() * 3, 0.0f);
+    std::vector<float> clusterNormals(clusters.size() * 3, 0.0f);
+    float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+    float meshArea = 0.0f;
+
+    for (size_t clusterIndex = 0; clusterIndex < clusters.size(); clusterIndex++) {
+        float *centroid = clusterCentroids.data() + clusterIndex * 3;
+        float *normal = clusterNormals.data() + clusterIndex * 3;
+        float clusterArea = 0.0f;
+
+        for (size_t i = clusters[clusterIndex].begin; i < clusters[clusterIndex].end; i += 3) {
+            const float *p0 = (const float *) ((const uint8_t *) positions + positionStride * indices[i]);
+            const float *p1 = (const float *) ((const uint8_t *) positions + positionStride * indices[i + 1]);
+            const float *p2 = (const float *) ((const uint8_t *) positions + positionStride * indices[i + 2]);
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float cross[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                              e1[0] * e2[1] - e1[1] * e2[0]};
+            float area = sqrtf(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+            for (int axis = 0; axis < 3; axis++) {
+                centroid[axis] += area * (p0[axis] + p1[axis] + p2[axis]) / 3.0f;
+                normal[axis] += cross[axis];
+                meshCentroid[axis] += area * (p0[axis] + p1[axis] + p2[axis]) / 3.0f;
+            }
+
+            clusterArea += area;
+        }
+
+        for (int axis = 0; axis < 3; axis++)
+            centroid[axis] = (clusterArea > 0.0f) ? (centroid[axis] / clusterArea) : (0.0f);
+
+        meshArea += clusterArea;
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+        meshCentroid[axis] = (meshArea > 0.0f) ? (meshCentroid[axis] / meshArea) : (0.0f);
+
+    // How far out the cluster faces.
+    for (size_t clusterIndex = 0; clusterIndex < clusters.size(); clusterIndex++) {
+        const float *centroid = clusterCentroids.data() + clusterIndex * 3;
+        const float *normal = clusterNormals.data() + clusterIndex * 3;
+        float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float dot = 0.0f;
+
+        for (int axis = 0; axis < 3; axis++)
+            dot += (centroid[axis] - meshCentroid[axis]) * normal[axis];
+
+        clusters[clusterIndex].sortKey = (normalLength > 0.0f) ? (dot / normalLength) : (0.0f);
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const TriangleCluster &a, const TriangleCluster &b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> sorted;
+
+    sorted.reserve(triangleCount * 3);
+
+    for (const TriangleCluster &cluster : clusters)
+        sorted.insert(sorted.end(), indices + cluster.begin, indices + cluster.end);
+
+    memcpy(indices, sorted.data(), sorted.size() * sizeof(uint32_t));
+}
+
+uint32_t optimizeVertexFetch(uint32_t *indices, size_t indexCount, void *vertices, uint32_t vertexCount,
+                             size_t vertexSize) {
+    const uint32_t unused = 0xFFFFFFFFu;
+    std::vector<uint32_t> remap(vertexCount, unused);
+    std::vector<uint8_t> fetched;
+    uint32_t fetchedCount = 0;
+
+    fetched.reserve(vertexCount * vertexSize);
+
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t &newIndex = remap[indices[i]];
+
+        if (newIndex == unused) {
+            const uint8_t *vertex = (const uint8_t *) vertices + vertexSize * indices[i];
+
+            fetched.insert(fetched.end(), vertex, vertex + vertexSize);
+            newIndex = fetchedCount++;
+        }
+
+        indices[i] = newIndex;
+    }
+
+    memcpy(vertices, fetched.data(), fetched.size());
+
+    return fetchedCount;
+}
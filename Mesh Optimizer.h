@@ -0,0 +1,44 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_MESH_OPTIMIZER_H
+#define VULKAN_TEST_MESH_OPTIMIZER_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Entries of the FIFO post-transform vertex cache optimizeVertexCache() optimizes for and analyzeVertexCache() models.
+// Small enough to hold on every GPU, larger caches only do better.
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+
+struct VertexCacheStatistics {
+    uint32_t transformedVertexCount;    // cache misses, vertex shader invocations
+    float acmr;                         // average cache miss ratio, transformed vertices per triangle, 0.5 at best
+    float atvr;                         // average transformed vertex ratio, transformed per referenced vertex, 1 at best
+};
+
+// Simulates a FIFO cache of cacheSize entries over the triangle list.
+VertexCacheStatistics analyzeVertexCache(const uint32_t *indices, size_t indexCount, uint32_t vertexCount,
+                                         uint32_t cacheSize);
+
+// Reorders the triangles for post-transform vertex cache locality with Tipsify (Sander, Nehab and Barczak, "Fast
+// Triangle Reordering for Vertex Locality and Reduced Overdraw"), in place. Linear in the triangle count.
+void optimizeVertexCache(uint32_t *indices, size_t indexCount, uint32_t vertexCount);
+
+// Cuts the triangles, in vertex cache order, into clusters wherever the cache was about to be flushed anyway or the
+// cluster's own miss ratio stays within threshold (1.05 is 5%) of the whole list's, then orders the clusters outward
+// facing first, so they tend to occlude the ones drawn after them. positions are 3 floats each, positionStride bytes
+// apart. Keeps the triangles' order within the clusters, in place.
+void optimizeOverdraw(uint32_t *indices, size_t indexCount, const float *positions, size_t positionStride,
+                      uint32_t vertexCount, float threshold);
+
+// Renumbers the vertices in the order the triangles first reference them, moving the vertices (vertexSize bytes
+// each) along so they're fetched front to back. Unreferenced vertices are dropped, returns how many are left.
+uint32_t optimizeVertexFetch(uint32_t *indices, size_t indexCount, void *vertices, uint32_t vertexCount,
+                             size_t vertexSize);
+
+
+#endif //VULKAN_TEST_MESH_OPTIMIZER_H
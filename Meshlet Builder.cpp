@@ -0,0 +1,178 @@
+//
+// Created by chakmeshma on 18.10.2026.
+//
+
+#include "Meshlet Builder.h"
+#include <algorithm>
+#include <cmath>
+
+static const float *vertexAttribute(const float *attribute, size_t vertexStride, uint32_t vertex) {
+    return (const float *) ((const uint8_t *) attribute + vertexStride * vertex);
+}
+
+static void computeMeshletBounds(const uint32_t *indices, const float *positions, const float *normals,
+                                 size_t vertexStride, Meshlet *meshlet) {
+    const uint32_t *triangles = indices + meshlet->firstIndex;
+    size_t cornerCount = meshlet->triangleCount * 3;
+
+    // The sphere around the center of the bounding box, not the tightest one, but never off by much for a meshlet.
+    float boundsMin[3];
+    float boundsMax[3];
+
+    for (size_t i = 0; i < cornerCount; i++) {
+        const float *position = vertexAttribute(positions, vertexStride, triangles[i]);
+
+        for (int axis = 0; axis < 3; axis++) {
+            boundsMin[axis] = (i == 0) ? (position[axis]) : (std::min(boundsMin[axis], position[axis]));
+            boundsMax[axis] = (i == 0) ? (position[axis]) : (std::max(boundsMax[axis], position[axis]));
+        }
+    }
+
+    float radiusSquared = 0.0f;
+
+    for (int axis = 0; axis < 3; axis++)
+        meshlet->center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+
+    for (size_t i = 0; i < cornerCount; i++) {
+        const float *position = vertexAttribute(positions, vertexStride, triangles[i]);
+        float dx = position[0] - meshlet->center[0];
+        float dy = position[1] - meshlet->center[1];
+        float dz = position[2] - meshlet->center[2];
+
+        radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+
+    meshlet->radius = sqrtf(radiusSquared);
+
+    // Unit normals of the triangles, degenerate ones left at 0, and their average as the cone's axis.
+    std::vector<float> triangleNormals(meshlet->triangleCount * 3, 0.0f);
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+
+    for (uint32_t triangle = 0; triangle < meshlet->triangleCount; triangle++) {
+        const float *p0 = vertexAttribute(positions, vertexStride, triangles[triangle * 3]);
+        const float *p1 = vertexAttribute(positions, vertexStride, triangles[triangle * 3 + 1]);
+        const float *p2 = vertexAttribute(positions, vertexStride, triangles[triangle * 3 + 2]);
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2],
+                           e1[0] * e2[1] - e1[1] * e2[0]};
+        float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+        if (length == 0.0f)
+            continue;
+
+        // The pipelines draw both sides, the winding says nothing about which one is the outside.
+        float vertexNormalDot = 0.0f;
+
+        for (int corner = 0; corner < 3; corner++) {
+            const float *vertexNormal = vertexAttribute(normals, vertexStride, triangles[triangle * 3 + corner]);
+
+            vertexNormalDot += normal[0] * vertexNormal[0] + normal[1] * vertexNormal[1] + normal[2] * vertexNormal[2];
+        }
+
+        if (vertexNormalDot < 0.0f)
+            length = -length;
+
+        for (int i = 0; i < 3; i++) {
+            triangleNormals[triangle * 3 + i] = normal[i] / length;
+            axis[i] += normal[i] / length;
+        }
+    }
+
+    float axisLength = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float minDot = 1.0f;
+
+    for (int i = 0; i < 3; i++)
+        axis[i] = (axisLength > 0.0f) ? (axis[i] / axisLength) : (0.0f);
+
+    for (uint32_t triangle = 0; triangle < meshlet->triangleCount; triangle++) {
+        const float *normal = triangleNormals.data() + triangle * 3;
+
+        if (normal[0] != 0.0f || normal[1] != 0.0f || normal[2] != 0.0f)
+            minDot = std::min(minDot, normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2]);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        meshlet->coneApex[i] = meshlet->center[i];
+        meshlet->coneAxis[i] = axis[i];
+    }
+
+    // Some triangle faces sideways or against the axis, or there's no axis at all.
+    if (axisLength == 0.0f || minDot <= 0.0f) {
+        meshlet->coneCutoff = 2.0f;
+
+        return;
+    }
+
+    // Moved back along the axis until the apex is behind every triangle's plane, as meshoptimizer does, so every
+    // viewpoint within the cone is too.
+    float apexDistance = 0.0f;
+
+    for (uint32_t triangle = 0; triangle < meshlet->triangleCount; triangle++) {
+        const float *normal = triangleNormals.data() + triangle * 3;
+        const float *p0 = vertexAttribute(positions, vertexStride, triangles[triangle * 3]);
+        float normalDot = normal[0] * axis[0] + normal[1] * axis[1] + normal[2] * axis[2];
+
+        if (normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f)
+            continue;
+
+        float centerDot = (meshlet->center[0] - p0[0]) * normal[0] + (meshlet->center[1] - p0[1]) * normal[1] +
+                          (meshlet->center[2] - p0[2]) * normal[2];
+
+        apexDistance = std::max(apexDistance, centerDot / normalDot);
+    }
+
+    for (int i = 0; i < 3; i++)
+        meshlet->coneApex[i] = meshlet->center[i] - axis[i] * apexDistance;
+
+    // Triangles within acos(minDot) of the axis all face away from directions within 90 degrees less of it.
+    meshlet->coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+void buildMeshlets(const uint32_t *indices, size_t indexCount, const float *positions, const float *normals,
+                   size_t vertexStride, uint32_t vertexCount, std::vector<Meshlet> *meshlets) {
+    const uint32_t unreferenced = 0xFFFFFFFFu;
+    // The last meshlet that references each vertex.
+    std::vector<uint32_t> vertexMeshlets(vertexCount, unreferenced);
+    size_t triangleCount = indexCount / 3;
+    Meshlet meshlet = {};
+
+    meshlets->clear();
+
+    for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+        const uint32_t *corners = indices + triangle * 3;
+        uint32_t distinctCount = 0;
+        uint32_t newCount = 0;
+
+        for (int corner = 0; corner < 3; corner++) {
+            if ((corner > 0 && corners[corner] == corners[0]) || (corner > 1 && corners[corner] == corners[1]))
+                continue;
+
+            distinctCount++;
+
+            if (vertexMeshlets[corners[corner]] != (uint32_t) meshlets->size())
+                newCount++;
+        }
+
+        if (meshlet.triangleCount > 0 && (meshlet.vertexCount + newCount > MESHLET_MAX_VERTICES ||
+                                          meshlet.triangleCount == MESHLET_MAX_TRIANGLES)) {
+            computeMeshletBounds(indices, positions, normals, vertexStride, &meshlet);
+            meshlets->push_back(meshlet);
+
+            meshlet = {};
+            meshlet.firstIndex = (uint32_t) (triangle * 3);
+            newCount = distinctCount;
+        }
+
+        for (int corner = 0; corner < 3; corner++)
+            vertexMeshlets[corners[corner]] = (uint32_t) meshlets->size();
+
+        meshlet.vertexCount += newCount;
+        meshlet.triangleCount++;
+    }
+
+    if (meshlet.triangleCount > 0) {
+        computeMeshletBounds(indices, positions, normals, vertexStride, &meshlet);
+        meshlets->push_back(meshlet);
+    }
+}
@@ -0,0 +1,40 @@
+//
+// Created by chakmeshma on 18.10.2026.
+//
+
+#ifndef VULKAN_TEST_MESHLET_BUILDER_H
+#define VULKAN_TEST_MESHLET_BUILDER_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Limits of a meshlet, one workgroup of the culling shader copies a triangle per invocation.
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A run of consecutive triangles of a mesh, with the bounds the culling shader tests it by.
+struct Meshlet {
+    uint32_t firstIndex;                // into the mesh's indices
+    uint32_t triangleCount;
+    uint32_t vertexCount;               // distinct vertices the triangles reference
+    float center[3];                    // bounding sphere
+    float radius;
+    // Every triangle faces away from a viewpoint v with dot(normalize(coneApex - v), coneAxis) >= coneCutoff. Above 1
+    // where the triangles face too many ways for that to ever hold.
+    float coneApex[3];
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+// Cuts the triangles, in the order given, into meshlets of at most MESHLET_MAX_VERTICES vertices and
+// MESHLET_MAX_TRIANGLES triangles each. Keeps the order, so a vertex cache optimized list yields compact meshlets and
+// the indices stay as they are. positions and normals are 3 floats each, vertexStride bytes apart. Triangles are
+// oriented along their vertex normals, not their winding.
+void buildMeshlets(const uint32_t *indices, size_t indexCount, const float *positions, const float *normals,
+                   size_t vertexStride, uint32_t vertexCount, std::vector<Meshlet> *meshlets);
+
+
+#endif //VULKAN_TEST_MESHLET_BUILDER_H
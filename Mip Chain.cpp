@@ -0,0 +1,163 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include "Mip Chain.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levelCount = 1;
+
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        levelCount++;
+
+    return levelCount;
+}
+
+size_t getMipChainSize(uint32_t width, uint32_t height, uint32_t firstLevel, uint32_t levelCount) {
+    size_t size = 0;
+
+    for (uint32_t level = firstLevel; level < levelCount; level++)
+        size += (size_t) std::max(width >> level, 1u) * std::max(height >> level, 1u) * 4;
+
+    return size;
+}
+
+static void downsampleRows(const uint8_t *row0, const uint8_t *row1, uint32_t srcWidth, uint32_t dstWidth,
+                           uint8_t *dstRow) {
+    uint32_t x = 0;
+
+#ifdef MIP_CHAIN_SSE2
+    // Two destination pixels out of four source pixels of each row, summed in 16 bits.
+    for (; 2 * x + 4 <= srcWidth && x + 2 <= dstWidth; x += 2) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i a = _mm_loadu_si128((const __m128i *) (row0 + 8 * x));
+        __m128i b = _mm_loadu_si128((const __m128i *) (row1 + 8 * x));
+
+        __m128i sumLow = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i sumHigh = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+        sumLow = _mm_add_epi16(sumLow, _mm_srli_si128(sumLow, 8));
+        sumHigh = _mm_add_epi16(sumHigh, _mm_srli_si128(sumHigh, 8));
+
+        __m128i sum = _mm_unpacklo_epi64(sumLow, sumHigh);
+
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+
+        _mm_storel_epi64((__m128i *) (dstRow + 4 * x), _mm_packus_epi16(sum, sum));
+    }
+#endif
+
+    for (; x < dstWidth; x++) {
+        uint32_t x0 = 2 * x;
+        uint32_t x1 = std::min(x0 + 1, srcWidth - 1);
+
+        for (uint32_t channel = 0; channel < 4; channel++)
+            dstRow[4 * x + channel] = (uint8_t) ((row0[4 * x0 + channel] + row0[4 * x1 + channel] +
+                                                  row1[4 * x0 + channel] + row1[4 * x1 + channel] + 2) >> 2);
+    }
+}
+
+static void renormalize(uint8_t *pixels, size_t pixelCount) {
+    for (size_t i = 0; i < pixelCount; i++) {
+        uint8_t *pixel = pixels + 4 * i;
+        float x = pixel[0] / 127.5f - 1.0f;
+        float y = pixel[1] / 127.5f - 1.0f;
+        float z = pixel[2] / 127.5f - 1.0f;
+        float length = std::sqrt(x * x + y * y + z * z);
+
+        if (length < 1e-6f)
+            continue;
+
+        pixel[0] = (uint8_t) std::lround((x / length + 1.0f) * 127.5f);
+        pixel[1] = (uint8_t) std::lround((y / length + 1.0f) * 127.5f);
+        pixel[2] = (uint8_t) std::lround((z / length + 1.0f) * 127.5f);
+    }
+}
+
+void generateMipChain(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t levelCount, bool normalMap,
+                      uint8_t *mips) {
+    const uint8_t *src = pixels;
+    uint32_t srcWidth = width;
+    uint32_t srcHeight = height;
+
+    for (uint32_t level = 1; level < levelCount; level++) {
+        uint32_t dstWidth = std::max(srcWidth >> 1, 1u);
+        uint32_t dstHeight = std::max(srcHeight >> 1, 1u);
+
+        for (uint32_t y = 0; y < dstHeight; y++) {
+            const uint8_t *row0 = src + (size_t) 2 * y * srcWidth * 4;
+            const uint8_t *row1 = src + (size_t) std::min(2 * y + 1, srcHeight - 1) * srcWidth * 4;
+
+            downsampleRows(row0, row1, srcWidth, dstWidth, mips + (size_t) y * dstWidth * 4);
+        }
+
+        if (normalMap)
+            renormalize(mips, (size_t) dstWidth * dstHeight);
+
+        // Every level is filtered from the previous one.
+        src = mips;
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+        mips += (size_t) dstWidth * dstHeight * 4;
+    }
+}
+
+MipChainWriter::MipChainWriter(uint32_t width, uint32_t height, uint32_t levelCount, bool normalMap, uint8_t *chain)
+        : levels(levelCount), normalMap(normalMap) {
+    for (uint32_t level = 0; level < levelCount; level++) {
+        Level &mipLevel = levels[level];
+
+        mipLevel.width = std::max(width >> level, 1u);
+        mipLevel.height = std::max(height >> level, 1u);
+        mipLevel.rowCount = 0;
+        mipLevel.rows = chain;
+        mipLevel.evenRow.resize((size_t) mipLevel.width * 4);
+        mipLevel.filteredRow.resize((size_t) mipLevel.width * 4);
+
+        chain += (size_t) mipLevel.width * mipLevel.height * 4;
+    }
+}
+
+void MipChainWriter::writeRow(const uint8_t *row) {
+    addRow(0, row);
+}
+
+void MipChainWriter::addRow(uint32_t level, const uint8_t *row) {
+    Level &mipLevel = levels[level];
+    size_t rowSize = (size_t) mipLevel.width * 4;
+    uint32_t y = mipLevel.rowCount++;
+
+    memcpy(mipLevel.rows + y * rowSize, row, rowSize);
+
+    if (level + 1 == levels.size())
+        return;
+
+    Level &nextLevel = levels[level + 1];
+
+    // Like generateMipChain(), destination row y / 2 filters rows y and y + 1 of this level, the last one twice
+    // when there is no row below it.
+    if (y % 2 == 0) {
+        memcpy(mipLevel.evenRow.data(), row, rowSize);
+
+        if (y + 1 < mipLevel.height)
+            return;
+    }
+
+    if (y / 2 >= nextLevel.height)
+        return;
+
+    downsampleRows(mipLevel.evenRow.data(), row, mipLevel.width, nextLevel.width, nextLevel.filteredRow.data());
+
+    if (normalMap)
+        renormalize(nextLevel.filteredRow.data(), nextLevel.width);
+
+    addRow(level + 1, nextLevel.filteredRow.data());
+}
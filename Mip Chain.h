@@ -0,0 +1,53 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_MIP_CHAIN_H
+#define VULKAN_TEST_MIP_CHAIN_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Levels down to 1x1, level 0 included.
+uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+// Bytes of levels firstLevel to levelCount - 1 of an RGBA8 image, tightly packed.
+size_t getMipChainSize(uint32_t width, uint32_t height, uint32_t firstLevel, uint32_t levelCount);
+
+// 2x2 box filters the RGBA8 pixels down into levels 1 to levelCount - 1, written tightly packed one after another
+// into mips (getMipChainSize(width, height, 1, levelCount) bytes). Odd sizes clamp at the last row and column.
+// Normal maps get their xyz renormalized on every level, alpha is filtered as is.
+void generateMipChain(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t levelCount, bool normalMap,
+                      uint8_t *mips);
+
+// Builds the same chain as generateMipChain(), level 0 included, as the rows of level 0 come in. chain receives every
+// level tightly packed (getMipChainSize(width, height, 0, levelCount) bytes) and is only ever written, each byte
+// once, so it may be write combined memory. Only a couple of rows per level are kept on the side.
+class MipChainWriter {
+public:
+    MipChainWriter(uint32_t width, uint32_t height, uint32_t levelCount, bool normalMap, uint8_t *chain);
+
+    // Rows of level 0, top to bottom. Rows of lower levels are filtered as soon as both their source rows are in.
+    void writeRow(const uint8_t *row);
+
+private:
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        uint32_t rowCount;                  // written so far
+        uint8_t *rows;                      // within chain
+        std::vector<uint8_t> evenRow;       // the last even row, waiting for the odd one below it
+        std::vector<uint8_t> filteredRow;   // filtered out of the level above, before it's written
+    };
+
+    void addRow(uint32_t level, const uint8_t *row);
+
+    std::vector<Level> levels;
+    bool normalMap;
+};
+
+
+#endif //VULKAN_TEST_MIP_CHAIN_H
@@ -0,0 +1,784 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include <string.h>
+#include <fstream>
+#include <iterator>
+#include "PNG Decoder.h"
+
+namespace {
+    // Codes up to this long decode with a single table lookup, longer ones bit by bit.
+    const uint32_t HUFFMAN_FAST_BITS = 10;
+    const uint32_t HUFFMAN_MAX_BITS = 15;
+
+    struct Huffman {
+        uint16_t fast[1 << HUFFMAN_FAST_BITS];  // (symbol << 4) | length, 0 when the code is longer
+        uint16_t counts[HUFFMAN_MAX_BITS + 1];  // codes of each length
+        uint16_t symbols[288];                  // in canonical order
+    };
+
+    // Deflate stores Huffman codes starting from their most significant bit, everything else least significant first.
+    uint32_t reverseBits(uint32_t code, uint32_t length) {
+        uint32_t reversed = 0;
+
+        for (uint32_t i = 0; i < length; i++, code >>= 1)
+            reversed = (reversed << 1) | (code & 1);
+
+        return reversed;
+    }
+
+    // Incomplete codes are allowed, a distance code may consist of a single symbol. Decoding a missing one fails.
+    bool buildHuffman(const uint8_t *lengths, uint32_t symbolCount, Huffman *huffman) {
+        uint16_t offsets[HUFFMAN_MAX_BITS + 2];
+        uint32_t nextCode[HUFFMAN_MAX_BITS + 1];
+
+        memset(huffman->fast, 0, sizeof(huffman->fast));
+        memset(huffman->counts, 0, sizeof(huffman->counts));
+
+        for (uint32_t symbol = 0; symbol < symbolCount; symbol++)
+            huffman->counts[lengths[symbol]]++;
+
+        huffman->counts[0] = 0;
+
+        int32_t left = 1;
+
+        for (uint32_t length = 1; length <= HUFFMAN_MAX_BITS; length++) {
+            left = (left << 1) - huffman->counts[length];
+
+            if (left < 0)
+                return false;                   // over-subscribed
+        }
+
+        offsets[1] = 0;
+        nextCode[1] = 0;
+
+        for (uint32_t length = 1; length <= HUFFMAN_MAX_BITS; length++) {
+            offsets[length + 1] = offsets[length] + huffman->counts[length];
+
+            if (length < HUFFMAN_MAX_BITS)
+                nextCode[length + 1] = (nextCode[length] + huffman->counts[length]) << 1;
+        }
+
+        for (uint32_t symbol = 0; symbol < symbolCount; symbol++) {
+            uint32_t length = lengths[symbol];
+
+            if (length == 0)
+                continue;
+
+            huffman->symbols[offsets[length]++] = (uint16_t) symbol;
+
+            uint32_t code = nextCode[length]++;
+
+            if (length > HUFFMAN_FAST_BITS)
+                continue;
+
+            for (uint32_t entry = reverseBits(code, length); entry < (1u << HUFFMAN_FAST_BITS); entry += 1u << length)
+                huffman->fast[entry] = (uint16_t) ((symbol << 4) | length);
+        }
+
+        return true;
+    }
+
+    class BitReader {
+    public:
+        BitReader(const uint8_t *data, size_t size) : data(data), end(data + size) {}
+
+        // Past the end of the data the reader pads with zero bytes, overrun() tells whether any of them were used.
+        void refill() {
+            while (bitCount <= 56) {
+                uint64_t byte = 0;
+
+                if (data < end)
+                    byte = *data++;
+                else
+                    paddingBytes++;
+
+                bits |= byte << bitCount;
+                bitCount += 8;
+            }
+        }
+
+        uint32_t read(uint32_t count) {
+            if (bitCount < count)
+                refill();
+
+            uint32_t value = (uint32_t) (bits & ((1ull << count) - 1));
+
+            bits >>= count;
+            bitCount -= count;
+
+            return value;
+        }
+
+        void alignToByte() {
+            read(bitCount % 8);
+        }
+
+        bool overrun() const {
+            return (uint64_t) paddingBytes * 8 > bitCount;
+        }
+
+        // -1 when the bits don't form a code.
+        int32_t decode(const Huffman &huffman) {
+            if (bitCount < HUFFMAN_MAX_BITS)
+                refill();
+
+            uint32_t entry = huffman.fast[bits & ((1u << HUFFMAN_FAST_BITS) - 1)];
+
+            if (entry != 0) {
+                bits >>= entry & 15;
+                bitCount -= entry & 15;
+
+                return (int32_t) (entry >> 4);
+            }
+
+            int32_t code = 0;
+            int32_t first = 0;
+            int32_t index = 0;
+
+            for (uint32_t length = 1; length <= HUFFMAN_MAX_BITS; length++) {
+                code |= (int32_t) read(1);
+
+                int32_t count = huffman.counts[length];
+
+                if (code - first < count)
+                    return huffman.symbols[index + code - first];
+
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
+            }
+
+            return -1;
+        }
+
+    private:
+        const uint8_t *data;
+        const uint8_t *end;
+        uint64_t bits = 0;
+        uint32_t bitCount = 0;
+        uint32_t paddingBytes = 0;
+    };
+
+    const uint16_t lengthBases[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+                                      99, 115, 131, 163, 195, 227, 258};
+    const uint8_t lengthExtraBits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5,
+                                         5, 5, 0};
+    const uint16_t distanceBases[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+                                        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t distanceExtraBits[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+                                           11, 11, 12, 12, 13, 13};
+
+    bool inflateCodes(BitReader &reader, const Huffman &literals, const Huffman &distances, uint8_t *out,
+                      size_t outSize, size_t *outPosition, std::string *error) {
+        size_t position = *outPosition;
+
+        while (true) {
+            int32_t symbol = reader.decode(literals);
+
+            if (symbol < 0 || reader.overrun()) {
+                *error = "corrupt deflate stream";
+                return false;
+            }
+
+            if (symbol < 256) {
+                if (position == outSize) {
+                    *error = "more image data than the header allows";
+                    return false;
+                }
+
+                out[position++] = (uint8_t) symbol;
+                continue;
+            }
+
+            if (symbol == 256)
+                break;
+
+            symbol -= 257;
+
+            if (symbol >= 29) {
+                *error = "invalid deflate length code";
+                return false;
+            }
+
+            size_t length = lengthBases[symbol] + reader.read(lengthExtraBits[symbol]);
+            int32_t distanceSymbol = reader.decode(distances);
+
+            if (distanceSymbol < 0 || distanceSymbol >= 30) {
+                *error = "invalid deflate distance code";
+                return false;
+            }
+
+            size_t distance = distanceBases[distanceSymbol] + reader.read(distanceExtraBits[distanceSymbol]);
+
+            if (distance > position || length > outSize - position) {
+                *error = "deflate copy out of bounds";
+                return false;
+            }
+
+            uint8_t *destination = out + position;
+            const uint8_t *source = destination - distance;
+
+            // Byte by byte, the source may overlap what's being written.
+            for (size_t i = 0; i < length; i++)
+                destination[i] = source[i];
+
+            position += length;
+        }
+
+        *outPosition = position;
+
+        return true;
+    }
+
+    const Huffman &getFixedLiterals() {
+        static const Huffman fixedLiterals = []() {
+            uint8_t lengths[288];
+            Huffman huffman;
+
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+
+            buildHuffman(lengths, 288, &huffman);
+
+            return huffman;
+        }();
+
+        return fixedLiterals;
+    }
+
+    const Huffman &getFixedDistances() {
+        static const Huffman fixedDistances = []() {
+            uint8_t lengths[30];
+            Huffman huffman;
+
+            memset(lengths, 5, 30);
+
+            buildHuffman(lengths, 30, &huffman);
+
+            return huffman;
+        }();
+
+        return fixedDistances;
+    }
+
+    bool readDynamicHuffman(BitReader &reader, Huffman *literals, Huffman *distances, std::string *error) {
+        static const uint8_t codeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1,
+                                                    15};
+
+        uint32_t literalCount = reader.read(5) + 257;
+        uint32_t distanceCount = reader.read(5) + 1;
+        uint32_t codeLengthCount = reader.read(4) + 4;
+        uint8_t codeLengthLengths[19] = {};
+        Huffman codeLengths;
+
+        for (uint32_t i = 0; i < codeLengthCount; i++)
+            codeLengthLengths[codeLengthOrder[i]] = (uint8_t) reader.read(3);
+
+        if (literalCount > 286 || distanceCount > 30 || !buildHuffman(codeLengthLengths, 19, &codeLengths)) {
+            *error = "invalid dynamic Huffman header";
+            return false;
+        }
+
+        uint8_t lengths[286 + 30];
+        uint32_t lengthCount = 0;
+
+        while (lengthCount < literalCount + distanceCount) {
+            int32_t symbol = reader.decode(codeLengths);
+            uint8_t repeated = 0;
+            uint32_t repeatCount;
+
+            if (symbol < 0 || reader.overrun()) {
+                *error = "corrupt code lengths";
+                return false;
+            }
+
+            if (symbol < 16) {
+                lengths[lengthCount++] = (uint8_t) symbol;
+                continue;
+            } else if (symbol == 16) {
+                if (lengthCount == 0) {
+                    *error = "code length repeat without a previous length";
+                    return false;
+                }
+
+                repeated = lengths[lengthCount - 1];
+                repeatCount = 3 + reader.read(2);
+            } else if (symbol == 17) {
+                repeatCount = 3 + reader.read(3);
+            } else {
+                repeatCount = 11 + reader.read(7);
+            }
+
+            if (lengthCount + repeatCount > literalCount + distanceCount) {
+                *error = "code lengths overflow";
+                return false;
+            }
+
+            memset(lengths + lengthCount, repeated, repeatCount);
+            lengthCount += repeatCount;
+        }
+
+        if (lengths[256] == 0 || !buildHuffman(lengths, literalCount, literals) ||
+            !buildHuffman(lengths + literalCount, distanceCount, distances)) {
+            *error = "invalid Huffman code";
+            return false;
+        }
+
+        return true;
+    }
+
+    // zlib stream to exactly outSize bytes. The Adler-32 checksum isn't verified.
+    bool inflateZlib(const uint8_t *data, size_t size, uint8_t *out, size_t outSize, std::string *error) {
+        if (size < 2 || (data[0] & 15) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 32) != 0) {
+            *error = "invalid zlib header";
+            return false;
+        }
+
+        BitReader reader(data + 2, size - 2);
+        size_t position = 0;
+        bool lastBlock = false;
+
+        while (!lastBlock) {
+            lastBlock = reader.read(1) == 1;
+
+            uint32_t blockType = reader.read(2);
+
+            if (blockType == 0) {
+                reader.alignToByte();
+
+                uint32_t length = reader.read(16);
+                uint32_t lengthComplement = reader.read(16);
+
+                if ((length ^ 0xFFFF) != lengthComplement || length > outSize - position) {
+                    *error = "invalid stored block";
+                    return false;
+                }
+
+                for (uint32_t i = 0; i < length; i++)
+                    out[position++] = (uint8_t) reader.read(8);
+            } else if (blockType == 1) {
+                if (!inflateCodes(reader, getFixedLiterals(), getFixedDistances(), out, outSize, &position, error))
+                    return false;
+            } else if (blockType == 2) {
+                Huffman literals;
+                Huffman distances;
+
+                if (!readDynamicHuffman(reader, &literals, &distances, error) ||
+                    !inflateCodes(reader, literals, distances, out, outSize, &position, error))
+                    return false;
+            } else {
+                *error = "invalid deflate block type";
+                return false;
+            }
+
+            if (reader.overrun()) {
+                *error = "truncated deflate stream";
+                return false;
+            }
+        }
+
+        if (position != outSize) {
+            *error = "less image data than the header requires";
+            return false;
+        }
+
+        return true;
+    }
+
+    uint32_t readBigEndian32(const uint8_t *data) {
+        return ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) | ((uint32_t) data[2] << 8) | data[3];
+    }
+
+    uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+        int32_t p = (int32_t) a + b - c;
+        int32_t pa = p > a ? p - a : a - p;
+        int32_t pb = p > b ? p - b : b - p;
+        int32_t pc = p > c ? p - c : c - p;
+
+        if (pa <= pb && pa <= pc)
+            return a;
+
+        return (pb <= pc) ? (b) : (c);
+    }
+
+    // In place, previousRow is null for the first row of a pass.
+    bool unfilterRow(uint8_t filter, uint8_t *row, const uint8_t *previousRow, size_t rowBytes, size_t pixelBytes) {
+        switch (filter) {
+            case 0:
+                break;
+            case 1:
+                for (size_t i = pixelBytes; i < rowBytes; i++)
+                    row[i] += row[i - pixelBytes];
+                break;
+            case 2:
+                if (previousRow != nullptr)
+                    for (size_t i = 0; i < rowBytes; i++)
+                        row[i] += previousRow[i];
+                break;
+            case 3:
+                for (size_t i = 0; i < rowBytes; i++) {
+                    uint32_t left = (i >= pixelBytes) ? (row[i - pixelBytes]) : (0);
+                    uint32_t up = (previousRow != nullptr) ? (previousRow[i]) : (0);
+
+                    row[i] += (uint8_t) ((left + up) >> 1);
+                }
+                break;
+            case 4:
+                for (size_t i = 0; i < rowBytes; i++) {
+                    uint8_t left = (i >= pixelBytes) ? (row[i - pixelBytes]) : (0);
+                    uint8_t up = (previousRow != nullptr) ? (previousRow[i]) : (0);
+                    uint8_t upLeft = (i >= pixelBytes && previousRow != nullptr) ? (previousRow[i - pixelBytes]) : (0);
+
+                    row[i] += paeth(left, up, upLeft);
+                }
+                break;
+            default:
+                return false;
+        }
+
+        return true;
+    }
+
+    uint32_t readSample(const uint8_t *row, uint32_t index, uint32_t bitDepth) {
+        if (bitDepth == 8)
+            return row[index];
+
+        if (bitDepth == 16)
+            return ((uint32_t) row[index * 2] << 8) | row[index * 2 + 1];
+
+        uint32_t bitOffset = index * bitDepth;
+
+        return (row[bitOffset >> 3] >> (8 - bitDepth - (bitOffset & 7))) & ((1u << bitDepth) - 1);
+    }
+
+    // To 8 bits, replicating the high bits down.
+    uint8_t scaleSample(uint32_t sample, uint32_t bitDepth) {
+        switch (bitDepth) {
+            case 1:
+                return (uint8_t) (sample * 255);
+            case 2:
+                return (uint8_t) (sample * 85);
+            case 4:
+                return (uint8_t) (sample * 17);
+            case 16:
+                return (uint8_t) (sample >> 8);
+            default:
+                return (uint8_t) sample;
+        }
+    }
+
+    const uint32_t adam7XStart[7] = {0, 4, 0, 2, 0, 1, 0};
+    const uint32_t adam7YStart[7] = {0, 0, 4, 0, 2, 0, 1};
+    const uint32_t adam7XStep[7] = {8, 8, 4, 4, 2, 2, 1};
+    const uint32_t adam7YStep[7] = {8, 8, 8, 4, 4, 2, 2};
+}
+
+bool readPngSize(const std::string &path, uint32_t *width, uint32_t *height, std::string *error) {
+    uint8_t start[33];                          // signature and IHDR
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        *error = "couldn't open the file";
+        return false;
+    }
+
+    if (!file.read((char *) start, sizeof(start))) {
+        *error = "not a PNG file";
+        return false;
+    }
+
+    PngDecoder decoder;
+
+    if (!decoder.open(start, sizeof(start), error, false))
+        return false;
+
+    *width = decoder.width;
+    *height = decoder.height;
+
+    return true;
+}
+
+bool PngDecoder::open(const std::string &path, std::string *error) {
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file.is_open()) {
+        *error = "couldn't open the file";
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    return open(data.data(), data.size(), error);
+}
+
+bool PngDecoder::open(const uint8_t *data, size_t size, std::string *error) {
+    return open(data, size, error, true);
+}
+
+bool PngDecoder::open(const uint8_t *data, size_t size, std::string *error, bool wholeFile) {
+    static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+    if (size < 8 || memcmp(data, signature, 8) != 0) {
+        *error = "not a PNG file";
+        return false;
+    }
+
+    bool headerRead = false;
+    bool endRead = false;
+
+    compressed.clear();
+    hasTransparentKey = false;
+
+    // Palette entries the file leaves out read as opaque black.
+    memset(palette, 0, sizeof(palette));
+
+    for (uint32_t i = 0; i < 256; i++)
+        palette[i][3] = 255;
+
+    size_t offset = 8;
+
+    while (!endRead) {
+        if (size - offset < 12) {
+            *error = "truncated chunk";
+            return false;
+        }
+
+        uint32_t length = readBigEndian32(data + offset);
+        const uint8_t *type = data + offset + 4;
+        const uint8_t *chunk = data + offset + 8;
+
+        if (length > size - offset - 12) {
+            *error = "truncated chunk";
+            return false;
+        }
+
+        if (memcmp(type, "IHDR", 4) == 0) {
+            if (headerRead) {
+                *error = "duplicate IHDR chunk";
+                return false;
+            }
+
+            if (!readHeader(chunk, length, error))
+                return false;
+
+            headerRead = true;
+
+            if (!wholeFile)
+                return true;
+        } else if (!headerRead) {
+            *error = "IHDR isn't the first chunk";
+            return false;
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            if (length % 3 != 0 || length > 256 * 3) {
+                *error = "invalid PLTE chunk";
+                return false;
+            }
+
+            for (uint32_t i = 0; i < length / 3; i++)
+                memcpy(palette[i], chunk + i * 3, 3);
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            if (colorType == 3) {
+                for (uint32_t i = 0; i < length && i < 256; i++)
+                    palette[i][3] = chunk[i];
+            } else if ((colorType == 0 && length == 2) || (colorType == 2 && length == 6)) {
+                hasTransparentKey = true;
+
+                for (uint32_t i = 0; i < length / 2; i++)
+                    transparentKey[i] = (uint16_t) ((chunk[i * 2] << 8) | chunk[i * 2 + 1]);
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            endRead = true;
+        } else if ((type[0] & 32) == 0) {
+            *error = "unknown critical chunk";
+            return false;
+        }
+
+        // CRCs aren't verified, a corrupt image either fails to inflate or shows up on screen.
+        offset += (size_t) length + 12;
+    }
+
+    return true;
+}
+
+bool PngDecoder::readHeader(const uint8_t *chunk, uint32_t length, std::string *error) {
+    if (length != 13) {
+        *error = "invalid IHDR chunk";
+        return false;
+    }
+
+    width = readBigEndian32(chunk);
+    height = readBigEndian32(chunk + 4);
+    bitDepth = chunk[8];
+    colorType = chunk[9];
+    interlaced = chunk[12] == 1;
+
+    bool validDepth;
+
+    switch (colorType) {
+        case 0:
+            channelCount = 1;
+            validDepth = bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8 || bitDepth == 16;
+            break;
+        case 3:
+            channelCount = 1;
+            validDepth = bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8;
+            break;
+        case 2:
+        case 4:
+        case 6:
+            channelCount = (colorType == 2) ? (3) : ((colorType == 4) ? (2) : (4));
+            validDepth = bitDepth == 8 || bitDepth == 16;
+            break;
+        default:
+            validDepth = false;
+            break;
+    }
+
+    if (!validDepth || chunk[10] != 0 || chunk[11] != 0 || chunk[12] > 1) {
+        *error = "unsupported or invalid IHDR values";
+        return false;
+    }
+
+    // Keeps every size computation below well clear of overflow.
+    if (width == 0 || height == 0 || width > (1u << 16) || height > (1u << 16) ||
+        (uint64_t) width * height > (1ull << 28)) {
+        *error = "image dimensions out of range";
+        return false;
+    }
+
+    return true;
+}
+
+void PngDecoder::convertRow(const uint8_t *row, uint32_t pixelCount, uint8_t *out, size_t outStride) const {
+    if (colorType == 6 && bitDepth == 8 && outStride == 4) {
+        memcpy(out, row, (size_t) pixelCount * 4);
+        return;
+    }
+
+    for (uint32_t x = 0; x < pixelCount; x++, out += outStride) {
+        uint32_t samples[4];
+
+        for (uint32_t channel = 0; channel < channelCount; channel++)
+            samples[channel] = readSample(row, x * channelCount + channel, bitDepth);
+
+        switch (colorType) {
+            case 0:
+                out[0] = out[1] = out[2] = scaleSample(samples[0], bitDepth);
+                out[3] = (hasTransparentKey && samples[0] == transparentKey[0]) ? (0) : (255);
+                break;
+            case 2:
+                out[0] = scaleSample(samples[0], bitDepth);
+                out[1] = scaleSample(samples[1], bitDepth);
+                out[2] = scaleSample(samples[2], bitDepth);
+                out[3] = (hasTransparentKey && samples[0] == transparentKey[0] && samples[1] == transparentKey[1] &&
+                          samples[2] == transparentKey[2]) ? (0) : (255);
+                break;
+            case 3:
+                memcpy(out, palette[samples[0]], 4);
+                break;
+            case 4:
+                out[0] = out[1] = out[2] = scaleSample(samples[0], bitDepth);
+                out[3] = scaleSample(samples[1], bitDepth);
+                break;
+            default:
+                out[0] = scaleSample(samples[0], bitDepth);
+                out[1] = scaleSample(samples[1], bitDepth);
+                out[2] = scaleSample(samples[2], bitDepth);
+                out[3] = scaleSample(samples[3], bitDepth);
+                break;
+        }
+    }
+}
+
+bool PngDecoder::decode(const std::function<void(const uint8_t *row)> &writeRow, std::string *error) {
+    uint32_t passCount = (interlaced) ? (7) : (1);
+    uint32_t bitsPerPixel = bitDepth * channelCount;
+    size_t pixelBytes = (bitsPerPixel + 7) / 8;
+    uint32_t passWidths[7];
+    uint32_t passHeights[7];
+    size_t passRowBytes[7];
+    size_t filteredSize = 0;
+
+    for (uint32_t pass = 0; pass < passCount; pass++) {
+        uint32_t xStart = (interlaced) ? (adam7XStart[pass]) : (0);
+        uint32_t yStart = (interlaced) ? (adam7YStart[pass]) : (0);
+        uint32_t xStep = (interlaced) ? (adam7XStep[pass]) : (1);
+        uint32_t yStep = (interlaced) ? (adam7YStep[pass]) : (1);
+
+        passWidths[pass] = (width > xStart) ? ((width - xStart + xStep - 1) / xStep) : (0);
+        passHeights[pass] = (height > yStart) ? ((height - yStart + yStep - 1) / yStep) : (0);
+        passRowBytes[pass] = ((size_t) passWidths[pass] * bitsPerPixel + 7) / 8;
+
+        // Empty passes have no filter bytes either.
+        if (passWidths[pass] != 0)
+            filteredSize += (1 + passRowBytes[pass]) * passHeights[pass];
+    }
+
+    std::vector<uint8_t> filtered(filteredSize);
+
+    if (!inflateZlib(compressed.data(), compressed.size(), filtered.data(), filteredSize, error))
+        return false;
+
+    // Interlaced rows are only complete after the last pass, they're assembled in a whole image first.
+    std::vector<uint8_t> rgba((size_t) width * ((interlaced) ? (height) : (1)) * 4);
+    uint8_t *passData = filtered.data();
+
+    for (uint32_t pass = 0; pass < passCount; pass++) {
+        if (passWidths[pass] == 0 || passHeights[pass] == 0)
+            continue;
+
+        uint32_t xStart = (interlaced) ? (adam7XStart[pass]) : (0);
+        uint32_t yStart = (interlaced) ? (adam7YStart[pass]) : (0);
+        uint32_t xStep = (interlaced) ? (adam7XStep[pass]) : (1);
+        uint32_t yStep = (interlaced) ? (adam7YStep[pass]) : (1);
+        size_t rowBytes = passRowBytes[pass];
+        const uint8_t *previousRow = nullptr;
+
+        for (uint32_t y = 0; y < passHeights[pass]; y++) {
+            uint8_t *row = passData + y * (1 + rowBytes) + 1;
+
+            if (!unfilterRow(row[-1], row, previousRow, rowBytes, pixelBytes)) {
+                *error = "invalid filter type";
+                return false;
+            }
+
+            if (interlaced) {
+                convertRow(row, passWidths[pass], rgba.data() +
+                                                  (((size_t) yStart + (size_t) y * yStep) * width + xStart) * 4,
+                           (size_t) xStep * 4);
+            } else {
+                convertRow(row, width, rgba.data(), 4);
+                writeRow(rgba.data());
+            }
+
+            previousRow = row;
+        }
+
+        passData += (1 + rowBytes) * passHeights[pass];
+    }
+
+    if (interlaced)
+        for (uint32_t y = 0; y < height; y++)
+            writeRow(rgba.data() + (size_t) y * width * 4);
+
+    return true;
+}
+
+bool PngDecoder::decode(std::vector<uint8_t> *pixels, std::string *error) {
+    size_t rowSize = (size_t) width * 4;
+
+    pixels->resize(rowSize * height);
+
+    uint8_t *out = pixels->data();
+
+    return decode([&out, rowSize](const uint8_t *row) {
+        memcpy(out, row, rowSize);
+        out += rowSize;
+    }, error);
+}
@@ -0,0 +1,60 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_PNG_DECODER_H
+#define VULKAN_TEST_PNG_DECODER_H
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Reads nothing but the signature and IHDR chunk.
+bool readPngSize(const std::string &path, uint32_t *width, uint32_t *height, std::string *error);
+
+// Decodes any PNG (every color type and bit depth, Adam7 interlacing, tRNS transparency) into RGBA8, top row first.
+// 16 bit samples keep their high byte. Unlike DevIL there is no global state, so any number of threads may decode at
+// once, each with a decoder of its own. Failures are described in error.
+class PngDecoder {
+public:
+    // Reads the file and parses its chunks, width and height are valid afterwards.
+    bool open(const std::string &path, std::string *error);
+
+    // Same, for a PNG already in memory. The data is copied.
+    bool open(const uint8_t *data, size_t size, std::string *error);
+
+    // Hands writeRow every row, in order. The row is only valid during the call. Rows of non-interlaced images are
+    // converted one at a time, the image is never whole in memory, only its inflated data.
+    bool decode(const std::function<void(const uint8_t *row)> &writeRow, std::string *error);
+
+    // Into tightly packed rows.
+    bool decode(std::vector<uint8_t> *pixels, std::string *error);
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+private:
+    friend bool readPngSize(const std::string &path, uint32_t *width, uint32_t *height, std::string *error);
+
+    // Stops right after IHDR unless wholeFile.
+    bool open(const uint8_t *data, size_t size, std::string *error, bool wholeFile);
+
+    bool readHeader(const uint8_t *chunk, uint32_t length, std::string *error);
+
+    void convertRow(const uint8_t *row, uint32_t pixelCount, uint8_t *out, size_t outStride) const;
+
+    uint32_t bitDepth = 0;
+    uint32_t colorType = 0;
+    uint32_t channelCount = 0;
+    bool interlaced = false;
+    uint8_t palette[256][4];
+    bool hasTransparentKey = false;
+    uint16_t transparentKey[3];             // raw samples, gray or RGB
+    std::vector<uint8_t> compressed;        // the IDAT chunks, concatenated
+};
+
+
+#endif //VULKAN_TEST_PNG_DECODER_H
@@ -0,0 +1,138 @@
+#version 450 core
+
+// A workgroup per meshlet. The first invocation culls the meshlet, the triangles of a surviving one are copied into
+// its mesh's region of the culled index buffer, a triangle per invocation.
+layout (local_size_x = 128) in;		// at least MESHLET_MAX_TRIANGLES
+
+// MeshletDescription.
+struct Meshlet {
+	vec3 center;
+	float radius;
+	vec3 coneApex;
+	float coneCutoff;
+	vec3 coneAxis;
+	uint meshIndex;
+	uint firstIndex;		// in the mesh's index type
+	uint triangleCount;
+	uint shortIndices;
+	uint padding;
+};
+
+// VkDrawIndexedIndirectCommand.
+struct DrawCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+// Only the model matrix is read here, the rest is spelled out for the std430 stride.
+struct TextureRegion {
+	vec4 rect;
+	float layer;
+	uint textureIndex;
+	uint virtualTexture;
+};
+
+struct MeshUniforms {
+	mat4 model;
+	vec4 positionOffset;
+	vec4 positionScale;
+	TextureRegion color;
+	TextureRegion normal;
+	TextureRegion spec;
+};
+
+layout (set = 0, binding = 0) readonly buffer Meshlets {
+	Meshlet meshlets[];
+};
+
+// The shared index buffer, 16 bit indices two to a word.
+layout (set = 0, binding = 1) readonly buffer Indices {
+	uint indices[];
+};
+
+layout (set = 0, binding = 2) writeonly buffer CulledIndices {
+	uint culledIndices[];
+};
+
+// One per mesh, the index counts start at 0.
+layout (set = 0, binding = 3) buffer DrawCommands {
+	DrawCommand draws[];
+};
+
+layout (set = 0, binding = 4) readonly buffer Meshes {
+	MeshUniforms meshes[];
+};
+
+layout (set = 1, binding = 0) uniform ViewProjection {
+	mat4 view;
+	mat4 projection;
+} viewProjection;
+
+shared bool visible;
+shared uint culledFirstIndex;
+
+
+uint fetchIndex(Meshlet meshlet, uint corner)
+{
+	uint index = meshlet.firstIndex + corner;
+
+	if (meshlet.shortIndices != 0)
+		return (indices[index >> 1] >> ((index & 1u) * 16u)) & 0xFFFFu;
+
+	return indices[index];
+}
+
+// Both tests in model space, where the bounds were computed, whatever the model matrix scales.
+bool isVisible(Meshlet meshlet)
+{
+	mat4 modelView = viewProjection.view * meshes[meshlet.meshIndex].model;
+	mat4 rows = transpose(viewProjection.projection * modelView);
+
+	// The frustum's planes out of the model to clip space matrix (Gribb and Hartmann). The near plane is that of a -1
+	// to 1 depth range, which only culls less with a 0 to 1 one.
+	vec4 planes[6] = vec4[6](rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1],
+							 rows[3] + rows[2], rows[3] - rows[2]);
+
+	for (int i = 0; i < 6; i++)
+		if (dot(planes[i].xyz, meshlet.center) + planes[i].w < -meshlet.radius * length(planes[i].xyz))
+			return false;
+
+	vec3 cameraPosition = inverse(modelView)[3].xyz;
+
+	// Every triangle faces away from the camera. Negated, so a camera right at the apex keeps the meshlet.
+	return !(dot(normalize(meshlet.coneApex - cameraPosition), meshlet.coneAxis) >= meshlet.coneCutoff);
+}
+
+
+void main()
+{
+	uint meshletIndex = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+
+	// The last row of the dispatch runs past the end. The same for the whole workgroup, ahead of any barrier.
+	if (meshletIndex >= uint(meshlets.length()))
+		return;
+
+	Meshlet meshlet = meshlets[meshletIndex];
+
+	if (gl_LocalInvocationIndex == 0) {
+		visible = isVisible(meshlet);
+
+		if (visible)
+			culledFirstIndex = draws[meshlet.meshIndex].firstIndex +
+							   atomicAdd(draws[meshlet.meshIndex].indexCount, meshlet.triangleCount * 3);
+	}
+
+	barrier();
+
+	if (!visible || gl_LocalInvocationIndex >= meshlet.triangleCount)
+		return;
+
+	uint corner = gl_LocalInvocationIndex * 3;
+
+	culledIndices[culledFirstIndex + corner] = fetchIndex(meshlet, corner);
+	culledIndices[culledFirstIndex + corner + 1] = fetchIndex(meshlet, corner + 1);
+	culledIndices[culledFirstIndex + corner + 2] = fetchIndex(meshlet, corner + 2);
+}
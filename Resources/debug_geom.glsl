@@ -3,11 +3,29 @@
 layout(points) in;
 layout(line_strip, max_vertices = 2) out;
 
-layout (set = 0, binding = 1) uniform sampler2D textureSampler;
+struct TextureRegion {
+	vec4 rect;
+	float layer;
+	uint textureIndex;
+	uint virtualTexture;
+};
 
-layout (set = 0, binding = 2) uniform sampler2D normalSampler;
+struct MeshUniforms {
+	mat4 model;
+	vec4 positionOffset;	// dequantizes QUANTIZED_VERTICES positions
+	vec4 positionScale;
+	TextureRegion color;
+	TextureRegion normal;
+	TextureRegion spec;
+};
 
-layout (set = 0, binding = 3) uniform sampler2D specSampler;
+layout (set = 0, binding = 0) readonly buffer Meshes {
+	MeshUniforms meshes[];
+};
+
+layout (constant_id = 0) const uint TEXTURE_COUNT = 1;
+
+layout (set = 0, binding = 1) uniform sampler2DArray textures[TEXTURE_COUNT];
 
 layout (location = 0) in vec3 iFragPos[];
 
@@ -19,9 +37,11 @@ layout (location = 3) in vec3 iFragTan[];
 
 layout (location = 4) in vec3 iFragBitan[];
 
+layout (location = 5) flat in uint iFragMeshIndex[];
+
 const float normalLength = 1.13;
 
-layout (push_constant) uniform ViewProjection {
+layout (set = 1, binding = 0) uniform ViewProjection {
 	mat4 view;
 	mat4 projection;
 } viewProjection;
@@ -33,7 +53,17 @@ void main() {
         iFragNor[0]
     );
 	
-	vec3 normapFragNor = (texture(normalSampler, iFragUV[0]).rgb * 2.0 - 1.0);
+	TextureRegion normalRegion = meshes[iFragMeshIndex[0]].normal;
+	
+	vec2 normalCoord = normalRegion.rect.xy + fract(iFragUV[0]) * normalRegion.rect.zw;
+	
+	// Virtual textures only hold the pages the fragment shader asked for, their normals are drawn flat.
+	vec2 normapFragNorXY = vec2(0.0);
+	
+	if (normalRegion.virtualTexture == 0u)
+		normapFragNorXY = textureLod(textures[normalRegion.textureIndex], vec3(normalCoord, normalRegion.layer), 0.0).rg * 2.0 - 1.0;
+	
+	vec3 normapFragNor = vec3(normapFragNorXY, sqrt(max(0.0, 1.0 - dot(normapFragNorXY, normapFragNorXY))));
 
 	
 	normapFragNor = normalize(TBN * normapFragNor) * normalLength;
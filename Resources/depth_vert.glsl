@@ -0,0 +1,54 @@
+#version 450 core
+
+// Positions only, for the depth prepass. Only the model matrix and position dequantization are read here, the texture
+// regions are spelled out for the std430 stride.
+struct TextureRegion {
+	vec4 rect;
+	float layer;
+	uint textureIndex;
+	uint virtualTexture;
+};
+
+struct MeshUniforms {
+	mat4 model;
+	vec4 positionOffset;	// dequantizes QUANTIZED_VERTICES positions
+	vec4 positionScale;
+	TextureRegion color;
+	TextureRegion normal;
+	TextureRegion spec;
+};
+
+// Every mesh, indexed with the draw's first instance.
+layout (set = 0, binding = 0) readonly buffer Meshes {
+	MeshUniforms meshes[];
+};
+
+layout (set = 1, binding = 0) uniform ViewProjection {
+	mat4 view;
+	mat4 projection;
+} viewProjection;
+
+#ifdef QUANTIZED_VERTICES
+layout (location = 0) in vec4 inPos;
+#else
+layout (location = 0) in vec3 inPos;
+#endif
+
+// Bit for bit what vert.glsl computes, through the same expressions.
+invariant gl_Position;
+
+
+void main()
+{
+	mat4 model = meshes[gl_InstanceIndex].model;
+
+#ifdef QUANTIZED_VERTICES
+	vec3 inPosition = meshes[gl_InstanceIndex].positionOffset.xyz + meshes[gl_InstanceIndex].positionScale.xyz * inPos.xyz;
+#else
+	vec3 inPosition = inPos;
+#endif
+
+	vec3 fragPos = vec3(viewProjection.view * model * vec4(inPosition, 1.0));
+
+	gl_Position = viewProjection.projection * vec4(fragPos, 1.0);
+}
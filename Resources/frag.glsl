@@ -10,19 +10,38 @@ layout (location = 3) in vec3 fragTan;
 
 layout (location = 4) in vec3 fragBitan;
 
+layout (location = 5) flat in uint fragMeshIndex;
+
 layout (location = 0) out vec4 outFragColor;
 
-layout (set = 0, binding = 0) uniform MVP {
+// Where in its (possibly atlas or virtual) image each texture lives, offset and extent in normalized coordinates, and
+// which element of the texture array holds that image.
+struct TextureRegion {
+	vec4 rect;
+	float layer;
+	uint textureIndex;
+	uint virtualTexture;
+};
+
+struct MeshUniforms {
 	mat4 model;
-} mvp;
+	vec4 positionOffset;	// dequantizes QUANTIZED_VERTICES positions
+	vec4 positionScale;
+	TextureRegion color;
+	TextureRegion normal;
+	TextureRegion spec;
+};
 
-layout (set = 0, binding = 1) uniform sampler2D textureSampler;
+// Every mesh, indexed with the draw's first instance.
+layout (set = 0, binding = 0) readonly buffer Meshes {
+	MeshUniforms meshes[];
+};
 
-layout (set = 0, binding = 2) uniform sampler2D normalSampler;
+layout (constant_id = 0) const uint TEXTURE_COUNT = 1;
 
-layout (set = 0, binding = 3) uniform sampler2D specSampler;
+layout (set = 0, binding = 1) uniform sampler2DArray textures[TEXTURE_COUNT];
 
-layout (push_constant) uniform VP {
+layout (set = 1, binding = 0) uniform ViewProjection {
 	mat4 view;
 	mat4 projection;
 } vp;
@@ -33,15 +52,137 @@ const float lightIntensity = 1.0f;
 
 const float shininess = 50.0;
 
+#ifdef VIRTUAL_TEXTURING
+// Must match the VIRTUAL_TEXTURE_* constants of the engine.
+const float VIRTUAL_TEXTURE_SIZE = 16384.0;
+
+const uint VIRTUAL_TEXTURE_PAGE_SIZE = 128u;
+
+const uint VIRTUAL_TEXTURE_SIZE_PAGES = 128u;               // pages per side of level 0
+
+const uint VIRTUAL_TEXTURE_LEVELS = 8u;
+
+const uint VIRTUAL_TEXTURE_PAGE_BORDER = 1u;
+
+const uint VIRTUAL_TEXTURE_ENTRY_VALID = 0x80000000u;
+
+// The virtual texture is a sparse residency image when true, else a cache image of bordered pages.
+layout (constant_id = 1) const bool VIRTUAL_TEXTURE_SPARSE = false;
+
+// One entry per page of every level, finest level first: the cache slot and level of the finest resident page
+// covering it.
+layout (set = 0, binding = 2) readonly buffer PageTable {
+	uint pageTable[];
+};
+
+// One bit per page, set for every page sampled. Read back and cleared by the engine.
+layout (set = 1, binding = 1) buffer Feedback {
+	uint feedback[];
+};
+
+// Levels are numbered like the page table, (4^8 - 4^(8 - level)) / 3 pages come before a level.
+uint getPageIndex(uint level, uvec2 page)
+{
+	uint pagesPerSide = (VIRTUAL_TEXTURE_SIZE_PAGES >> level);
+	
+	return ((1u << 16) - ((1u << 16) >> (2u * level))) / 3 + page.y * pagesPerSide + page.x;
+}
+
+// Requests the page the footprint needs, then samples the finest resident level at or above it. The software cache
+// only filters bilinearly, within the page and its border.
+vec4 sampleVirtual(sampler2DArray virtualSampler, TextureRegion region, vec2 uv)
+{
+	vec2 coord = region.rect.xy + fract(uv) * region.rect.zw;
+	
+	vec2 unwrappedCoord = region.rect.xy + uv * region.rect.zw;
+	
+	vec2 texelDx = dFdx(unwrappedCoord) * VIRTUAL_TEXTURE_SIZE;
+	
+	vec2 texelDy = dFdy(unwrappedCoord) * VIRTUAL_TEXTURE_SIZE;
+	
+	float lod = clamp(0.5 * log2(max(dot(texelDx, texelDx), dot(texelDy, texelDy))), 0.0, float(VIRTUAL_TEXTURE_LEVELS - 1u));
+	
+	uint level = uint(lod);
+	
+	uvec2 page = min(uvec2(coord * float(VIRTUAL_TEXTURE_SIZE_PAGES)) >> level, uvec2((VIRTUAL_TEXTURE_SIZE_PAGES >> level) - 1u));
+	
+	uint pageIndex = getPageIndex(level, page);
+	
+	atomicOr(feedback[pageIndex >> 5], 1u << (pageIndex & 31u));
+	
+	uint entry = pageTable[pageIndex];
+	
+	// Only until the root page is streamed in.
+	if ((entry & VIRTUAL_TEXTURE_ENTRY_VALID) == 0u)
+		return vec4(0.5, 0.5, 1.0, 1.0);
+	
+	uint residentLevel = (entry >> 16) & 0xFFu;
+	
+	float levelSize = VIRTUAL_TEXTURE_SIZE / float(1u << residentLevel);
+	
+	vec2 halfTexel = min(vec2(0.5 / levelSize), 0.5 * region.rect.zw);
+	
+	coord = clamp(coord, region.rect.xy + halfTexel, region.rect.xy + region.rect.zw - halfTexel);
+	
+	if (VIRTUAL_TEXTURE_SPARSE)
+		return textureLod(virtualSampler, vec3(coord, 0.0), max(lod, float(residentLevel)));
+	
+	uint slot = entry & 0xFFFFu;
+	
+	uint tileSize = VIRTUAL_TEXTURE_PAGE_SIZE + 2u * VIRTUAL_TEXTURE_PAGE_BORDER;
+	
+	uint slotsPerSide = uint(textureSize(virtualSampler, 0).x) / tileSize;
+	
+	vec2 texel = coord * levelSize;
+	
+	// From the page looked up, the clamped coordinate may lie up to half a texel into the border.
+	vec2 residentPage = vec2(page >> (residentLevel - level));
+	
+	vec2 tileTexel = texel - residentPage * float(VIRTUAL_TEXTURE_PAGE_SIZE) + float(VIRTUAL_TEXTURE_PAGE_BORDER);
+	
+	vec2 slotOrigin = vec2(slot % slotsPerSide, slot / slotsPerSide) * float(tileSize);
+	
+	return textureLod(virtualSampler, vec3((slotOrigin + tileTexel) / vec2(textureSize(virtualSampler, 0).xy), 0.0), 0.0);
+}
+#endif
+
+
+// UVs wrap inside the region, and filtering stays half a texel of the sampled level away from its edge so no
+// neighbouring atlas texture bleeds in. The gradients come from the unwrapped coordinate, so the seam keeps its mip.
+vec4 sampleRegion(sampler2DArray regionSampler, TextureRegion region, vec2 uv)
+{
+#ifdef VIRTUAL_TEXTURING
+	if (region.virtualTexture != 0u)
+		return sampleVirtual(regionSampler, region, uv);
+	
+#endif
+	vec2 coord = region.rect.xy + fract(uv) * region.rect.zw;
+	
+	vec2 unwrappedCoord = region.rect.xy + uv * region.rect.zw;
+	
+	vec2 texelSize = exp2(ceil(max(textureQueryLod(regionSampler, unwrappedCoord).x, 0.0))) / vec2(textureSize(regionSampler, 0).xy);
+	
+	vec2 halfTexel = min(0.5 * texelSize, 0.5 * region.rect.zw);
+	
+	coord = clamp(coord, region.rect.xy + halfTexel, region.rect.xy + region.rect.zw - halfTexel);
+	
+	return textureGrad(regionSampler, vec3(coord, region.layer), dFdx(unwrappedCoord), dFdy(unwrappedCoord));
+}
+
 void main()
 {
+	MeshUniforms mesh = meshes[fragMeshIndex];
+	
 	mat3 TBN = transpose(mat3(
         fragTan,
         fragBitan,
         fragNor
     ));
 	
-	vec3 normapFragNor = (texture(normalSampler, fragUV).rgb * 2.0 - 1.0);
+	// Only x and y are stored, BC5 has two channels. z is always positive in tangent space.
+	vec2 normapFragNorXY = sampleRegion(textures[mesh.normal.textureIndex], mesh.normal, fragUV).rg * 2.0 - 1.0;
+	
+	vec3 normapFragNor = vec3(normapFragNorXY, sqrt(max(0.0, 1.0 - dot(normapFragNorXY, normapFragNorXY))));
 	
 	vec3 lightDirectionTangSpace = TBN * (lightPos - fragPos);
 	
@@ -56,9 +197,9 @@ void main()
 	
 	float specular = pow(diffuse, shininess);
 	
-	vec4 texelColor = texture(textureSampler, fragUV);
+	vec4 texelColor = sampleRegion(textures[mesh.color.textureIndex], mesh.color, fragUV);
 	
-	vec3 specularColor = vec3(texture(specSampler, fragUV));
+	vec3 specularColor = vec3(sampleRegion(textures[mesh.spec.textureIndex], mesh.spec, fragUV).r);        // single channel, BC4
 	
 	//vec3 specularColor = vec3(texelColor.a, texelColor.a, texelColor.a);
 	
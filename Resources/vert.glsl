@@ -1,14 +1,42 @@
 #version 450 core
 
-layout (set = 0, binding = 0) uniform ModelMatrix {
+// Only the model matrix and position dequantization are read here, the texture regions are spelled out for the std430
+// stride.
+struct TextureRegion {
+	vec4 rect;
+	float layer;
+	uint textureIndex;
+	uint virtualTexture;
+};
+
+struct MeshUniforms {
 	mat4 model;
-} modelMatrix;
-
-layout (push_constant) uniform ViewProjection {
+	vec4 positionOffset;	// dequantizes QUANTIZED_VERTICES positions
+	vec4 positionScale;
+	TextureRegion color;
+	TextureRegion normal;
+	TextureRegion spec;
+};
+
+// Every mesh, indexed with the draw's first instance.
+layout (set = 0, binding = 0) readonly buffer Meshes {
+	MeshUniforms meshes[];
+};
+
+layout (set = 1, binding = 0) uniform ViewProjection {
 	mat4 view;
 	mat4 projection;
 } viewProjection;
 
+#ifdef QUANTIZED_VERTICES
+// VertexPosition and VertexAttributes<QuantizedVertex>: unorm position within the mesh's bounds, half float UV,
+// tangent frame quaternion with the bitangent's sign in w.
+layout (location = 0) in vec4 inPos;
+
+layout (location = 1) in vec2 inUV;
+
+layout (location = 2) in vec4 inTangentFrame;
+#else
 layout (location = 0) in vec3 inPos;
 
 layout (location = 1) in vec3 inNor;
@@ -18,6 +46,7 @@ layout (location = 2) in vec2 inUV;
 layout (location = 3) in vec3 inTan;
 
 layout (location = 4) in vec3 inBitan;
+#endif
 
 layout (location = 0) out vec3 fragPos;
 
@@ -29,20 +58,45 @@ layout (location = 3) out vec3 fragTan;
 
 layout (location = 4) out vec3 fragBitan;
 
+layout (location = 5) flat out uint fragMeshIndex;
+
+// Bit for bit what depth_vert.glsl computes, the depth prepass leaves equal depth behind.
+invariant gl_Position;
+
+#ifdef QUANTIZED_VERTICES
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+#endif
+
 
 void main()
 {
-	mat3 vp3 = mat3(viewProjection.view * modelMatrix.model);
+	mat4 model = meshes[gl_InstanceIndex].model;
+
+#ifdef QUANTIZED_VERTICES
+	vec3 inPosition = meshes[gl_InstanceIndex].positionOffset.xyz + meshes[gl_InstanceIndex].positionScale.xyz * inPos.xyz;
+	vec4 tangentFrame = normalize(inTangentFrame);
+	vec3 inNor = rotate(tangentFrame, vec3(0.0, 0.0, 1.0));
+	vec3 inTan = rotate(tangentFrame, vec3(1.0, 0.0, 0.0));
+	vec3 inBitan = rotate(tangentFrame, vec3(0.0, 1.0, 0.0)) * ((inTangentFrame.w < 0.0) ? -1.0 : 1.0);
+#else
+	vec3 inPosition = inPos;
+#endif
+	
+	mat3 vp3 = mat3(viewProjection.view * model);
 	mat3 rotation;
 	rotation[0] = vp3[0] / length(vp3[0]);
 	rotation[1] = vp3[1] / length(vp3[1]);
 	rotation[2] = vp3[2] / length(vp3[2]);
 
-	fragPos		= vec3(viewProjection.view * modelMatrix.model * vec4(inPos, 1.0));
+	fragPos		= vec3(viewProjection.view * model * vec4(inPosition, 1.0));
 	fragNor		= rotation * inNor;
 	fragUV		= inUV;
     fragTan		= rotation * inTan;
     fragBitan	= rotation * inBitan;
+	fragMeshIndex	= uint(gl_InstanceIndex);
 	
 
 	gl_Position = viewProjection.projection * vec4(fragPos, 1.0);
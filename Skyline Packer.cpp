@@ -0,0 +1,90 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include "Skyline Packer.h"
+#include <algorithm>
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height) : width(width), height(height) {
+    skyline.push_back({0, 0, width});
+}
+
+bool SkylinePacker::fit(size_t index, uint32_t width, uint32_t height, uint32_t *y) const {
+    uint32_t x = skyline[index].x;
+
+    if (x + width > this->width)
+        return false;
+
+    uint32_t top = 0;
+    uint32_t widthLeft = width;
+
+    for (size_t i = index; widthLeft > 0; i++) {
+        top = std::max(top, skyline[i].y);
+
+        if (top + height > this->height)
+            return false;
+
+        widthLeft -= std::min(widthLeft, skyline[i].width);
+    }
+
+    *y = top;
+
+    return true;
+}
+
+bool SkylinePacker::pack(uint32_t width, uint32_t height, uint32_t *x, uint32_t *y) {
+    if (width == 0 || height == 0)
+        return false;
+
+    size_t bestIndex = skyline.size();
+    uint32_t bestTop = UINT32_MAX;
+
+    for (size_t i = 0; i < skyline.size(); i++) {
+        uint32_t restingY;
+
+        if (fit(i, width, height, &restingY) && restingY + height < bestTop) {
+            bestIndex = i;
+            bestTop = restingY + height;
+        }
+    }
+
+    if (bestIndex == skyline.size())
+        return false;
+
+    *x = skyline[bestIndex].x;
+    *y = bestTop - height;
+
+    // The new segment replaces everything under it, the last covered segment may be cut.
+    Segment placed = {*x, bestTop, width};
+    uint32_t right = *x + width;
+    size_t last = bestIndex;
+
+    while (last < skyline.size() && skyline[last].x + skyline[last].width <= right)
+        last++;
+
+    if (last < skyline.size() && skyline[last].x < right) {
+        skyline[last].width -= right - skyline[last].x;
+        skyline[last].x = right;
+    }
+
+    skyline.erase(skyline.begin() + bestIndex, skyline.begin() + last);
+    skyline.insert(skyline.begin() + bestIndex, placed);
+
+    // Neighbors at the same height become one segment.
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+
+    usedArea += (uint64_t) width * height;
+
+    return true;
+}
+
+uint64_t SkylinePacker::getUsedArea() const {
+    return usedArea;
+}
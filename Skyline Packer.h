@@ -0,0 +1,43 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_SKYLINE_PACKER_H
+#define VULKAN_TEST_SKYLINE_PACKER_H
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Packs rectangles into a fixed size bin, keeping only the skyline of what's packed so far. Each rectangle goes
+// where its top ends lowest, leftmost on ties (bottom-left heuristic). Space under overhangs is lost, in exchange
+// packing is O(segments) per rectangle. Fills best with rectangles sorted by decreasing height.
+class SkylinePacker {
+public:
+    SkylinePacker(uint32_t width, uint32_t height);
+
+    // False, and nothing changes, when the rectangle fits nowhere.
+    bool pack(uint32_t width, uint32_t height, uint32_t *x, uint32_t *y);
+
+    uint64_t getUsedArea() const;
+
+private:
+    struct Segment {
+        uint32_t x;
+        uint32_t y;                         // top of what's packed over [x, x + width)
+        uint32_t width;
+    };
+
+    // Where a rectangle starting at segment index would rest, false if it would leave the bin.
+    bool fit(size_t index, uint32_t width, uint32_t height, uint32_t *y) const;
+
+    uint32_t width;
+    uint32_t height;
+    uint64_t usedArea = 0;
+    std::vector<Segment> skyline;           // left to right, covering the whole width
+};
+
+
+#endif //VULKAN_TEST_SKYLINE_PACKER_H
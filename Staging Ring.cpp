@@ -0,0 +1,129 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include "Staging Ring.h"
+#include "Vulkan Engine Exception.h"
+
+void StagingRing::init(DeviceMemoryAllocator *memoryAllocator, VkDevice device, VkDeviceSize size) {
+    this->memoryAllocator = memoryAllocator;
+    this->device = device;
+    this->size = size;
+
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.pNext = nullptr;
+    bufferCreateInfo.flags = 0;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferCreateInfo.queueFamilyIndexCount = 0;
+    bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+    if (vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS)
+        throw VulkanException("Couldn't create staging ring buffer.");
+
+    memoryAllocator->allocateBufferMemory(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memory);
+}
+
+void StagingRing::destroy() {
+    if (buffer == VK_NULL_HANDLE)
+        return;
+
+    vkDestroyBuffer(device, buffer, nullptr);
+    memoryAllocator->free(&memory);
+
+    buffer = VK_NULL_HANDLE;
+    submissions.clear();
+}
+
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, StagingRegion *region) {
+    if (size > this->size)
+        return false;
+
+    VkDeviceSize ringOffset = head % this->size;
+    VkDeviceSize alignedRingOffset = (ringOffset + alignment - 1) & ~(alignment - 1);
+    uint64_t newHead = head + (alignedRingOffset - ringOffset);
+
+    // Regions never wrap around, the rest of the ring is skipped instead.
+    if (alignedRingOffset + size > this->size) {
+        newHead = head + (this->size - ringOffset);
+        alignedRingOffset = 0;
+    }
+
+    newHead += size;
+
+    if (newHead - tail > this->size)
+        return false;
+
+    head = newHead;
+
+    region->buffer = buffer;
+    region->offset = alignedRingOffset;
+    region->size = size;
+    region->data = memory.mappedData + alignedRingOffset;
+
+    return true;
+}
+
+void StagingRing::flush() {
+    if (head == flushedHead)
+        return;
+
+    VkDeviceSize offsets[2];
+    VkDeviceSize sizes[2];
+    uint32_t rangeCount = 1;
+
+    offsets[0] = flushedHead % size;
+    sizes[0] = head - flushedHead;
+
+    if (offsets[0] + sizes[0] > size) {
+        offsets[1] = 0;
+        sizes[1] = offsets[0] + sizes[0] - size;
+        sizes[0] = size - offsets[0];
+        rangeCount = 2;
+    }
+
+    memoryAllocator->flush(memory, rangeCount, offsets, sizes);
+
+    flushedHead = head;
+}
+
+uint64_t StagingRing::endSubmission() {
+    if (head == submittedHead)
+        return 0;
+
+    Submission submission = {nextSubmissionId++, head, false};
+
+    submissions.push_back(submission);
+    submittedHead = head;
+
+    return submission.id;
+}
+
+void StagingRing::retire(uint64_t submission) {
+    if (submission == 0)
+        return;
+
+    for (Submission &pendingSubmission : submissions)
+        if (pendingSubmission.id == submission)
+            pendingSubmission.retired = true;
+
+    while (!submissions.empty() && submissions.front().retired) {
+        tail = submissions.front().end;
+        submissions.pop_front();
+    }
+}
+
+VkBuffer StagingRing::getBuffer() const {
+    return buffer;
+}
+
+VkDeviceSize StagingRing::getSize() const {
+    return size;
+}
+
+VkDeviceSize StagingRing::getFreeSize() const {
+    return size - (head - tail);
+}
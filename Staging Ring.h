@@ -0,0 +1,73 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_STAGING_RING_H
+#define VULKAN_TEST_STAGING_RING_H
+
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "Device Memory Allocator.h"
+
+struct StagingRegion {
+    VkBuffer buffer = VK_NULL_HANDLE;       // the ring buffer, source of the transfer
+    VkDeviceSize offset = 0;                // within buffer
+    VkDeviceSize size = 0;
+    uint8_t *data = nullptr;                // mapped, write size bytes here
+};
+
+// Persistently mapped, host visible staging buffer used as a ring. Regions are handed out in order, grouped into
+// submissions by endSubmission() and handed back by retire() once the GPU is done with them. Submissions may retire
+// out of order, memory is only reused once all older ones are retired too. Writes are made visible to the device
+// by a single flush() covering everything written since the previous one. Not thread safe.
+class StagingRing {
+public:
+    void init(DeviceMemoryAllocator *memoryAllocator, VkDevice device, VkDeviceSize size);
+
+    void destroy();
+
+    // Returns false when the unretired submissions leave no room, alignment has to be a power of two.
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, StagingRegion *region);
+
+    void flush();
+
+    // Returns the id to retire() the allocations made since the previous call with, 0 if there were none.
+    uint64_t endSubmission();
+
+    void retire(uint64_t submission);
+
+    VkBuffer getBuffer() const;
+
+    VkDeviceSize getSize() const;
+
+    // Bytes not taken by unretired allocations. Regions never wrap around, so up to one region's size of it may be
+    // skipped at the end of the ring.
+    VkDeviceSize getFreeSize() const;
+
+private:
+    struct Submission {
+        uint64_t id;
+        uint64_t end;                       // head when the submission was closed
+        bool retired;
+    };
+
+    DeviceMemoryAllocator *memoryAllocator = nullptr;
+    VkDevice device = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocation memory;
+    VkDeviceSize size = 0;
+    // Monotonic byte positions, the ring offset is position % size.
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    uint64_t flushedHead = 0;
+    uint64_t submittedHead = 0;
+    uint64_t nextSubmissionId = 1;
+    std::deque<Submission> submissions;
+};
+
+
+#endif //VULKAN_TEST_STAGING_RING_H
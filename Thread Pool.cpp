@@ -0,0 +1,118 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include <algorithm>
+#include "Thread Pool.h"
+
+namespace {
+    // The pool and index of the worker running on this thread, if any.
+    thread_local const void *currentPool = nullptr;
+    thread_local uint32_t currentWorkerIndex = 0;
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount) : nextQueue(0) {
+    if (threadCount == 0)
+        threadCount = std::max<uint32_t>(1, std::thread::hardware_concurrency());
+
+    queues.reserve(threadCount);
+
+    for (uint32_t i = 0; i < threadCount; i++)
+        queues.emplace_back(new WorkerQueue);
+
+    workers.reserve(threadCount);
+
+    for (uint32_t i = 0; i < threadCount; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+
+    sleepCondition.notify_all();
+
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+uint32_t ThreadPool::getThreadCount() const {
+    return (uint32_t) workers.size();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    uint32_t queueIndex = (currentPool == this) ? (currentWorkerIndex)
+                                                : (nextQueue.fetch_add(1) % (uint32_t) queues.size());
+
+    // Counted before the push, so a worker that takes the task right away never decrements the count below 0. A
+    // worker woken in between finds nothing and tries again.
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pendingTaskCount++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks.push_back(std::move(task));
+    }
+
+    sleepCondition.notify_one();
+}
+
+bool ThreadPool::takeTask(uint32_t workerIndex, std::function<void()> *task) {
+    {
+        WorkerQueue &ownQueue = *queues[workerIndex];
+        std::lock_guard<std::mutex> lock(ownQueue.mutex);
+
+        if (!ownQueue.tasks.empty()) {
+            *task = std::move(ownQueue.tasks.back());
+            ownQueue.tasks.pop_back();
+
+            return true;
+        }
+    }
+
+    for (uint32_t i = 1; i < queues.size(); i++) {
+        WorkerQueue &victimQueue = *queues[(workerIndex + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victimQueue.mutex);
+
+        if (!victimQueue.tasks.empty()) {
+            *task = std::move(victimQueue.tasks.front());
+            victimQueue.tasks.pop_front();
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::workerLoop(uint32_t workerIndex) {
+    currentPool = this;
+    currentWorkerIndex = workerIndex;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCondition.wait(lock, [this]() { return stopping || pendingTaskCount != 0; });
+
+            if (stopping)
+                return;
+        }
+
+        std::function<void()> task;
+
+        // Another worker may have taken the task that woke this one up.
+        if (!takeTask(workerIndex, &task))
+            continue;
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            pendingTaskCount--;
+        }
+
+        task();
+    }
+}
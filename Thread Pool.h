@@ -0,0 +1,76 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_THREAD_POOL_H
+#define VULKAN_TEST_THREAD_POOL_H
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed set of worker threads, each with a deque of its own. Tasks submitted by a worker go to the back of its own
+// deque, which it works through newest first, others are spread round robin. Idle workers steal the oldest task of
+// the others, so uneven tasks still keep every thread busy. Exceptions thrown by a task are rethrown from the
+// future's get(). The destructor lets running tasks finish, drops the ones that haven't started and joins.
+class ThreadPool {
+public:
+    // 0 picks std::thread::hardware_concurrency().
+    explicit ThreadPool(uint32_t threadCount = 0);
+
+    ~ThreadPool();
+
+    uint32_t getThreadCount() const;
+
+    template<class F>
+    std::future<decltype(std::declval<F &>()())> submit(F task) {
+        typedef decltype(std::declval<F &>()()) Result;
+
+        std::shared_ptr<std::packaged_task<Result()>> packagedTask =
+                std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> future = packagedTask->get_future();
+
+        enqueue([packagedTask]() { (*packagedTask)(); });
+
+        return future;
+    }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void enqueue(std::function<void()> task);
+
+    // Own deque first, then the others'. False when every deque is empty.
+    bool takeTask(uint32_t workerIndex, std::function<void()> *task);
+
+    void workerLoop(uint32_t workerIndex);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::atomic<uint32_t> nextQueue;
+    // Guards pendingTaskCount and stopping, so that sleeping workers can't miss a wakeup.
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    uint64_t pendingTaskCount = 0;
+    bool stopping = false;
+};
+
+
+#endif //VULKAN_TEST_THREAD_POOL_H
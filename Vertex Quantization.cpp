@@ -0,0 +1,159 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include "Vertex Quantization.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+uint16_t quantizeUnorm16(float value) {
+    return (uint16_t) lroundf(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f);
+}
+
+uint16_t quantizeHalf(float value) {
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(float));
+
+    uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000u);
+    int32_t exponent = (int32_t) ((bits >> 23) & 0xFFu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    // NaN stays NaN, infinity and overflows become infinity.
+    if (((bits >> 23) & 0xFFu) == 0xFFu)
+        return (uint16_t) (sign | 0x7C00u | ((mantissa != 0) ? (0x200u) : (0u)));
+
+    if (exponent >= 31)
+        return (uint16_t) (sign | 0x7C00u);
+
+    // Denormal halves, the implicit leading one shifted into the mantissa.
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+
+        mantissa |= 0x800000u;
+
+        uint32_t shift = (uint32_t) (14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+
+        if (remainder > halfway || (remainder == halfway && (half & 1u) != 0))
+            half++;
+
+        return (uint16_t) (sign | half);
+    }
+
+    // Round to nearest even, a mantissa carry correctly bumps the exponent, up to infinity.
+    uint32_t half = ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFFu;
+
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u) != 0))
+        half++;
+
+    return (uint16_t) (sign | half);
+}
+
+static void normalize(float v[3]) {
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+static void cross(const float a[3], const float b[3], float result[3]) {
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void encodeTangentFrame(const float normal[3], const float tangent[3], const float bitangent[3], int16_t frame[4]) {
+    float n[3] = {normal[0], normal[1], normal[2]};
+
+    normalize(n);
+
+    if (n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f)
+        n[2] = 1.0f;
+
+    // Gram-Schmidt, with any tangent orthogonal to the normal where the given one is degenerate.
+    float nDotT = n[0] * tangent[0] + n[1] * tangent[1] + n[2] * tangent[2];
+    float t[3] = {tangent[0] - n[0] * nDotT, tangent[1] - n[1] * nDotT, tangent[2] - n[2] * nDotT};
+
+    if (t[0] * t[0] + t[1] * t[1] + t[2] * t[2] < 1e-12f) {
+        float axis[3] = {(fabsf(n[0]) < 0.9f) ? (1.0f) : (0.0f), (fabsf(n[0]) < 0.9f) ? (0.0f) : (1.0f), 0.0f};
+        float b[3];
+
+        cross(n, axis, b);
+        cross(b, n, t);
+    }
+
+    normalize(t);
+
+    float b[3];
+
+    cross(n, t, b);
+
+    bool mirrored = b[0] * bitangent[0] + b[1] * bitangent[1] + b[2] * bitangent[2] < 0.0f;
+
+    // The rotation matrix with columns t, b and n to a quaternion (Shepperd's method, largest component first).
+    float q[4];
+    float trace = t[0] + b[1] + n[2];
+
+    if (trace > 0.0f) {
+        float s = sqrtf(trace + 1.0f) * 2.0f;
+
+        q[3] = 0.25f * s;
+        q[0] = (b[2] - n[1]) / s;
+        q[1] = (n[0] - t[2]) / s;
+        q[2] = (t[1] - b[0]) / s;
+    } else if (t[0] > b[1] && t[0] > n[2]) {
+        float s = sqrtf(1.0f + t[0] - b[1] - n[2]) * 2.0f;
+
+        q[3] = (b[2] - n[1]) / s;
+        q[0] = 0.25f * s;
+        q[1] = (b[0] + t[1]) / s;
+        q[2] = (n[0] + t[2]) / s;
+    } else if (b[1] > n[2]) {
+        float s = sqrtf(1.0f + b[1] - t[0] - n[2]) * 2.0f;
+
+        q[3] = (n[0] - t[2]) / s;
+        q[0] = (b[0] + t[1]) / s;
+        q[1] = 0.25f * s;
+        q[2] = (n[1] + b[2]) / s;
+    } else {
+        float s = sqrtf(1.0f + n[2] - t[0] - b[1]) * 2.0f;
+
+        q[3] = (t[1] - b[0]) / s;
+        q[0] = (n[0] + t[2]) / s;
+        q[1] = (n[1] + b[2]) / s;
+        q[2] = 0.25f * s;
+    }
+
+    // q and -q are the same rotation, w is free to carry the bitangent's sign. It's kept off 0, where the sign of
+    // the quantized value would be lost.
+    float sign = (q[3] < 0.0f) ? (-1.0f) : (1.0f);
+    float minW = 1.0f / 32767.0f;
+
+    for (int i = 0; i < 4; i++)
+        q[i] *= sign;
+
+    if (q[3] < minW) {
+        float scale = sqrtf(1.0f - minW * minW);
+
+        q[0] *= scale;
+        q[1] *= scale;
+        q[2] *= scale;
+        q[3] = minW;
+    }
+
+    if (mirrored)
+        for (int i = 0; i < 4; i++)
+            q[i] = -q[i];
+
+    for (int i = 0; i < 4; i++)
+        frame[i] = (int16_t) lroundf(std::min(std::max(q[i], -1.0f), 1.0f) * 32767.0f);
+}
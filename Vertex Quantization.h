@@ -0,0 +1,28 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_VERTEX_QUANTIZATION_H
+#define VULKAN_TEST_VERTEX_QUANTIZATION_H
+
+#pragma once
+
+#include <stdint.h>
+
+// Encoders for the compact vertex format, the shaders decode through the matching VkFormats.
+
+// Into [0, 65535] for a VK_FORMAT_R16_UNORM component, value is clamped to [0, 1].
+uint16_t quantizeUnorm16(float value);
+
+// IEEE half float, for a VK_FORMAT_R16_SFLOAT component. Rounds to nearest, overflows to infinity, flushes values
+// too small for a half's denormals to zero.
+uint16_t quantizeHalf(float value);
+
+// The tangent frame as a unit quaternion of VK_FORMAT_R16G16B16A16_SNORM components, rotating the x, y and z axes onto
+// tangent, bitangent and normal. The tangent is orthogonalized against the normal first. w is never 0, its sign is
+// that of the bitangent against cross(normal, tangent), so mirrored UVs survive:
+//  bitangent = sign(w) * rotate(q, (0, 1, 0))
+void encodeTangentFrame(const float normal[3], const float tangent[3], const float bitangent[3], int16_t frame[4]);
+
+
+#endif //VULKAN_TEST_VERTEX_QUANTIZATION_H
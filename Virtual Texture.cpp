@@ -0,0 +1,180 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#include <algorithm>
+#include <functional>
+#include "Virtual Texture.h"
+
+void VirtualTextureResidency::init(uint32_t pagesPerSide, uint32_t levelCount, uint32_t slotCount) {
+    this->pagesPerSide = pagesPerSide;
+    this->levelCount = levelCount;
+
+    levelOffsets.assign(1, 0);
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        uint32_t levelPages = std::max(pagesPerSide >> level, 1u);
+
+        levelOffsets.push_back(levelOffsets.back() + levelPages * levelPages);
+    }
+
+    pages.assign(levelOffsets.back(), Page());
+    slotPages.assign(slotCount, -1);
+    freeSlots.clear();
+    retiringSlots.clear();
+
+    // Handed out lowest first.
+    for (uint32_t slot = slotCount; slot > 0; slot--)
+        freeSlots.push_back(slot - 1);
+
+    pageTableDirty = true;
+}
+
+uint32_t VirtualTextureResidency::getPageCount() const {
+    return (uint32_t) pages.size();
+}
+
+uint32_t VirtualTextureResidency::getSlotCount() const {
+    return (uint32_t) slotPages.size();
+}
+
+uint32_t VirtualTextureResidency::getPageIndex(uint32_t level, uint32_t x, uint32_t y) const {
+    return levelOffsets[level] + y * std::max(pagesPerSide >> level, 1u) + x;
+}
+
+void VirtualTextureResidency::getPageLocation(uint32_t pageIndex, uint32_t *level, uint32_t *x, uint32_t *y) const {
+    uint32_t pageLevel = (uint32_t) (std::upper_bound(levelOffsets.begin(), levelOffsets.end(), pageIndex) -
+                                     levelOffsets.begin()) - 1;
+    uint32_t levelPages = std::max(pagesPerSide >> pageLevel, 1u);
+    uint32_t levelIndex = pageIndex - levelOffsets[pageLevel];
+
+    *level = pageLevel;
+    *x = levelIndex % levelPages;
+    *y = levelIndex / levelPages;
+}
+
+uint32_t VirtualTextureResidency::getParent(uint32_t pageIndex) const {
+    uint32_t level, x, y;
+
+    getPageLocation(pageIndex, &level, &x, &y);
+
+    return getPageIndex(level + 1, x / 2, y / 2);
+}
+
+bool VirtualTextureResidency::isResident(uint32_t pageIndex) const {
+    return pages[pageIndex].slot >= 0;
+}
+
+void VirtualTextureResidency::pin(uint32_t pageIndex) {
+    pages[pageIndex].pinned = true;
+}
+
+void VirtualTextureResidency::request(const uint32_t *requestedBits, uint64_t frame,
+                                      std::vector<uint32_t> *missingPages) {
+    size_t firstMissing = missingPages->size();
+
+    for (uint32_t word = 0; word < (getPageCount() + 31) / 32; word++) {
+        if (requestedBits[word] == 0)
+            continue;
+
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            uint32_t pageIndex = word * 32 + bit;
+
+            if ((requestedBits[word] & (1u << bit)) == 0 || pageIndex >= getPageCount())
+                continue;
+
+            // Up to the root, stopping early at a page some other request already went through this frame.
+            while (pages[pageIndex].lastVisit != frame + 1) {
+                Page &page = pages[pageIndex];
+
+                page.lastUse = frame;
+                page.lastVisit = frame + 1;
+
+                if (page.slot < 0)
+                    missingPages->push_back(pageIndex);
+
+                if (pageIndex >= levelOffsets[levelCount - 1])
+                    break;
+
+                pageIndex = getParent(pageIndex);
+            }
+        }
+    }
+
+    // Higher indices are coarser levels.
+    std::sort(missingPages->begin() + firstMissing, missingPages->end(), std::greater<uint32_t>());
+}
+
+bool VirtualTextureResidency::makeResident(uint32_t pageIndex, uint64_t frame, uint32_t *slot) {
+    if (freeSlots.empty())
+        return false;
+
+    *slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    slotPages[*slot] = (int32_t) pageIndex;
+    pages[pageIndex].slot = (int32_t) *slot;
+    pages[pageIndex].lastUse = std::max(pages[pageIndex].lastUse, frame);
+    pageTableDirty = true;
+
+    return true;
+}
+
+uint32_t VirtualTextureResidency::evictLeastRecentlyUsed(uint64_t frame, uint32_t count) {
+    uint32_t evictedCount = 0;
+
+    for (; evictedCount < count; evictedCount++) {
+        int32_t victim = -1;
+
+        // Lower page indices are finer levels, so on equal age the finest page goes first.
+        for (int32_t pageIndex : slotPages) {
+            if (pageIndex < 0 || pages[pageIndex].pinned || pages[pageIndex].lastUse >= frame)
+                continue;
+
+            if (victim < 0 || pages[pageIndex].lastUse < pages[victim].lastUse ||
+                (pages[pageIndex].lastUse == pages[victim].lastUse && pageIndex < victim))
+                victim = pageIndex;
+        }
+
+        if (victim < 0)
+            break;
+
+        RetiringSlot retiringSlot = {(uint32_t) pages[victim].slot, (uint32_t) victim, frame};
+
+        retiringSlots.push_back(retiringSlot);
+        slotPages[pages[victim].slot] = -1;
+        pages[victim].slot = -1;
+        pageTableDirty = true;
+    }
+
+    return evictedCount;
+}
+
+void VirtualTextureResidency::retireSlots(uint64_t frame, std::vector<uint32_t> *retiredPages) {
+    while (!retiringSlots.empty() && retiringSlots.front().frame <= frame) {
+        freeSlots.push_back(retiringSlots.front().slot);
+        retiredPages->push_back(retiringSlots.front().pageIndex);
+        retiringSlots.pop_front();
+    }
+}
+
+bool VirtualTextureResidency::isPageTableDirty() const {
+    return pageTableDirty;
+}
+
+void VirtualTextureResidency::writePageTable(uint32_t *pageTable) {
+    // Coarsest level first, so every page can inherit the entry of its parent.
+    for (uint32_t level = levelCount; level > 0; level--) {
+        for (uint32_t pageIndex = levelOffsets[level - 1]; pageIndex < levelOffsets[level]; pageIndex++) {
+            if (pages[pageIndex].slot >= 0)
+                pageTable[pageIndex] = VIRTUAL_TEXTURE_ENTRY_VALID | ((level - 1) << VIRTUAL_TEXTURE_ENTRY_LEVEL_SHIFT) |
+                                       (uint32_t) pages[pageIndex].slot;
+            else if (level == levelCount)
+                pageTable[pageIndex] = 0;
+            else
+                pageTable[pageIndex] = pageTable[getParent(pageIndex)];
+        }
+    }
+
+    pageTableDirty = false;
+}
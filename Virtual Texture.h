@@ -0,0 +1,90 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+#ifndef VULKAN_TEST_VIRTUAL_TEXTURE_H
+#define VULKAN_TEST_VIRTUAL_TEXTURE_H
+
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+// Page table entries, one uint per page of every level. An entry is valid when the page or one of its ancestors is
+// resident and then names the finest resident one: its slot and its level.
+#define VIRTUAL_TEXTURE_ENTRY_VALID 0x80000000u
+#define VIRTUAL_TEXTURE_ENTRY_SLOT_MASK 0xFFFFu
+#define VIRTUAL_TEXTURE_ENTRY_LEVEL_SHIFT 16
+
+// Which pages of a mipmapped virtual texture occupy the slots of a fixed size page cache. Pages are numbered level by
+// level, finest first, rows top to bottom, the same way the shaders number their feedback bits. Keeps every ancestor
+// of a resident page resident, so the shaders can always fall back to, and filter between, coarser levels:
+//  - request() lists missing ancestors before their descendants
+//  - ancestors are used whenever a descendant is, and on equal age the finest page is evicted first
+// Evicted slots only become free once retireSlots() says no frame in flight can sample them any more. Not thread safe.
+class VirtualTextureResidency {
+public:
+    // pagesPerSide at level 0 halve down to a single page at level levelCount - 1.
+    void init(uint32_t pagesPerSide, uint32_t levelCount, uint32_t slotCount);
+
+    uint32_t getPageCount() const;
+
+    uint32_t getSlotCount() const;
+
+    uint32_t getPageIndex(uint32_t level, uint32_t x, uint32_t y) const;
+
+    void getPageLocation(uint32_t pageIndex, uint32_t *level, uint32_t *x, uint32_t *y) const;
+
+    bool isResident(uint32_t pageIndex) const;
+
+    // Pinned pages are never evicted, pinning doesn't make them resident.
+    void pin(uint32_t pageIndex);
+
+    // requestedBits holds one bit per page. Marks the requested pages and their ancestors used in frame and appends
+    // those not resident to missingPages, coarsest level first.
+    void request(const uint32_t *requestedBits, uint64_t frame, std::vector<uint32_t> *missingPages);
+
+    // Gives the page a free slot, false if there is none.
+    bool makeResident(uint32_t pageIndex, uint64_t frame, uint32_t *slot);
+
+    // Evicts up to count of the least recently used pages not used in frame, returns how many.
+    uint32_t evictLeastRecentlyUsed(uint64_t frame, uint32_t count);
+
+    // Frees the slots of pages evicted in frame or before, appending those pages to retiredPages.
+    void retireSlots(uint64_t frame, std::vector<uint32_t> *retiredPages);
+
+    // Whether the page table changed since the last writePageTable().
+    bool isPageTableDirty() const;
+
+    // getPageCount() entries.
+    void writePageTable(uint32_t *pageTable);
+
+private:
+    struct Page {
+        int32_t slot = -1;
+        uint64_t lastUse = 0;
+        uint64_t lastVisit = 0;             // the last frame request() went through it in, plus one
+        bool pinned = false;
+    };
+
+    struct RetiringSlot {
+        uint32_t slot;
+        uint32_t pageIndex;
+        uint64_t frame;
+    };
+
+    uint32_t getParent(uint32_t pageIndex) const;
+
+    uint32_t pagesPerSide = 0;
+    uint32_t levelCount = 0;
+    std::vector<uint32_t> levelOffsets;     // index of each level's first page, levelCount + 1 entries
+    std::vector<Page> pages;
+    std::vector<int32_t> slotPages;         // page in each slot, -1 when free or retiring
+    std::vector<uint32_t> freeSlots;
+    std::deque<RetiringSlot> retiringSlots; // in eviction order
+    bool pageTableDirty = true;
+};
+
+
+#endif //VULKAN_TEST_VIRTUAL_TEXTURE_H
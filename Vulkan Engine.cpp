@@ -3,7 +3,16 @@
 //
 
 #include <fstream>
+#include <algorithm>
+#include <cstring>
 #include "Vulkan Engine.h"
+#include "Cache File.h"
+#include "Mip Chain.h"
+#include "Skyline Packer.h"
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
 //#pragma comment(linker, "/STACK:20000000000")
 
 //#pragma comment(linker, "/HEAP:2000000000")
@@ -12,12 +21,46 @@
 
 VulkanEngine **ppUnstableInstance_img = NULL;
 
-VulkanEngine::VulkanEngine(HINSTANCE hInstance, HWND windowHandle, VulkanEngine **ppUnstableInstance) {
+static double millisecondsSince(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// alignment must be a power of two, which every Vulkan alignment is.
+static VkDeviceSize alignDeviceSize(VkDeviceSize size, VkDeviceSize alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Every stage that reads uploaded buffers and textures.
+static const VkPipelineStageFlags uploadReadStageFlags = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                         VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                         VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT |
+                                                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+#ifdef _WIN32
+
+VulkanEngine::VulkanEngine(HINSTANCE hInstance, HWND windowHandle, VulkanEngine **ppUnstableInstance,
+                           const VulkanEngineSettings &settings) {
     *ppUnstableInstance = this;
     ppUnstableInstance_img = ppUnstableInstance;
 
     this->hInstance = hInstance;
     this->windowHandle = windowHandle;
+    this->settings = settings;
+    this->framesInFlight = std::max<uint32_t>(1, std::min<uint32_t>(settings.framesInFlight, MAX_FRAMES_IN_FLIGHT));
+
+    init();
+}
+
+#endif
+
+VulkanEngine::VulkanEngine(VulkanEngine **ppUnstableInstance, const VulkanEngineSettings &settings) {
+    *ppUnstableInstance = this;
+    ppUnstableInstance_img = ppUnstableInstance;
+
+    this->headless = true;
+    this->settings = settings;
+    this->framesInFlight = std::max<uint32_t>(1, std::min<uint32_t>(settings.framesInFlight, MAX_FRAMES_IN_FLIGHT));
 
     init();
 }
@@ -79,41 +122,48 @@ void VulkanEngine::init() {
     enumeratePhysicalDevices();
     getPhysicalDevicePropertiesAndFeatures();
     createLogicalDevice();
+    memoryAllocator.init(physicalDevices[0], logicalDevices[0]);
     createSyncMeans();
     getDeviceExtensions();
     getDeviceLayers();
+    createGraphicsShaderModules(); // compiled on the worker threads while the mesh and textures load
+    getQueues();
+    createTransferCommandPool();
+    createStagingRing();
     loadMesh("nyra.obj");
+    splitMeshesIntoMeshlets(); // only with settings.meshletCulling
     createAllTextures();
+    commitTextures();
     createAllBuffers();
-    getQueues();
-    getQueueFamilyPresentationSupport();
-    createSurface(); // create surface
-    createSwapchain();  // create swapchain
+    commitBuffers();
+    releaseMeshData();
+    submitTransferCommands();
+
+    if (headless) {
+        createOffscreenImages(); // offscreen color images standing in for the swapchain images
+    } else {
+        getQueueFamilyPresentationSupport();
+        createSurface(); // create surface
+        createSwapchain();  // create swapchain
+    }
+
+    createFrameTimestampQueryPool();
     getSupportedDepthFormat();
     createDepthImageAndImageview(); // create depth image and depth imageview (depth-stencil attachment)
     createSwapchainImageViews(); // create swapchain imageviews (framebuffer color attachment)
     createRenderpass(); // create renderpass
     createFramebuffers(); // create framebuffer
-    createGraphicsShaderModule("vert.glsl", &graphicsVertexShaderModule,
-                               shaderc_glsl_default_vertex_shader); // create vertex shader
-    createGraphicsShaderModule("frag.glsl", &graphicsFragmentShaderModule,
-                               shaderc_glsl_default_fragment_shader); // create fragment shader
-    createGraphicsShaderModule("debug_vert.glsl", &graphicsNormalViewerVertexShaderModule,
-                               shaderc_glsl_default_vertex_shader); // create debug vertex shader
-    createGraphicsShaderModule("debug_geom.glsl", &graphicsNormalViewerGeometryShaderModule,
-                               shaderc_glsl_default_geometry_shader); // create debug geometry shader
-    createGraphicsShaderModule("debug_frag.glsl", &graphicsNormalViewerFragmentShaderModule,
-                               shaderc_glsl_default_fragment_shader); // create debug fragment shader
+    waitForGraphicsShaderModules();
     createPipelineAndDescriptorSetsLayout(); // create pipeline layout
-    createGraphicsPipeline(); //create pipeline
-    createGraphicsNormalViewerPipeline();
+    createPipelineCache();
+    createGraphicsPipelines(); // graphics and normal viewer pipelines, concurrently
     createRenderCommandPool(); // create render commandpool
-    createTransferCommandPool(); // create render commandpool
-    commitBuffers();
-    commitTextures();
-    destroyStagingMeans();
+    allocateRenderCommandBuffers(); // one per frame in flight
+    createViewProjectionBuffer();
+    createVirtualTextureBuffers();
     createDescriptorPool(); // create descriptorpool
     createDescriptorSets();
+    recordFramebufferCommandBuffers();
     setupTimer();
 
     inited = true;
@@ -124,11 +174,8 @@ bool VulkanEngine::isInited() {
 }
 
 void VulkanEngine::setupTimer() {
-    // get ticks per second
-    QueryPerformanceFrequency(&frequency);
-
 // start timer
-    QueryPerformanceCounter(&t1);
+    t1 = std::chrono::steady_clock::now();
 }
 
 void VulkanEngine::getSupportedDepthFormat() {
@@ -160,9 +207,175 @@ void VulkanEngine::draw() {
     if (!inited)
         return;
 
+    double fenceWaitTime = 0.0;
+
+    // Only block on the frame that used this slot's semaphores and command buffer, the previous
+    // framesInFlight - 1 frames keep executing on the GPU meanwhile.
+    waitForFrame(currentFrame, &fenceWaitTime);
+
+    // Hands the staging memory of finished uploads back without blocking on the ones still in flight.
+    retireTransferBatches(false);
+
+    std::chrono::steady_clock::time_point phaseBegin = std::chrono::steady_clock::now();
+
     uint32_t drawableImageIndex = acquireNextFramebufferImageIndex();
-    render(drawableImageIndex);
+
+    lastFrameTimings.acquire = millisecondsSince(phaseBegin);
+
+    // With more frames in flight than swapchain images (or images returned out of order) the image's uniform
+    // buffer and pre-recorded command buffer may still be in use by an older frame.
+    VkFence imageFence = swapchainImageFences[drawableImageIndex];
+
+    if (imageFence != VK_NULL_HANDLE && imageFence != queueDoneFences[currentFrame])
+        fenceWaitTime += waitForFence(imageFence);
+
+    swapchainImageFences[drawableImageIndex] = queueDoneFences[currentFrame];
+
+    phaseBegin = std::chrono::steady_clock::now();
+
+    // The frame that last rendered to the image is done, its virtual texture feedback can be read back.
+    updateVirtualTexture(drawableImageIndex);
+
+    VkCommandBuffer uploadCommandBuffer = recordFrameUploads();
+
+    memcpy(viewProjectionMappedMemory + viewProjectionBufferStride * drawableImageIndex, &viewProjection,
+           sizeof(ViewProjectionMatrices<float>));
+
+    double uniformUpdateTime = millisecondsSince(phaseBegin);
+
+    render(drawableImageIndex, uploadCommandBuffer); // fills in the record and submit timings
+
+    lastFrameTimings.record += uniformUpdateTime;
+
+    phaseBegin = std::chrono::steady_clock::now();
+
     present(drawableImageIndex);
+
+    lastFrameTimings.present = millisecondsSince(phaseBegin);
+
+    t2 = std::chrono::steady_clock::now();
+    elapsedTime = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    t1 = t2;
+
+    lastFrameTimings.fenceWait = fenceWaitTime;
+    lastFrameTimings.frame = elapsedTime;
+
+    reportFrameStatistics(elapsedTime, fenceWaitTime);
+
+    currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+const FrameTimings &VulkanEngine::getLastFrameTimings() const {
+    return lastFrameTimings;
+}
+
+void VulkanEngine::invalidateCommandBuffers() {
+    if (framebufferCommandBuffersDirty == nullptr)
+        return;
+
+    for (uint32_t i = 0; i < swapchainImagesCount; i++)
+        framebufferCommandBuffersDirty[i] = true;
+}
+
+double VulkanEngine::waitForFence(VkFence fence) {
+    std::chrono::steady_clock::time_point waitBegin = std::chrono::steady_clock::now();
+
+    VkResult waitForFenceResult = vkWaitForFences(logicalDevices[0], 1, &fence, VK_TRUE,
+                                                  1000000000); // 1sec timeout
+
+    std::chrono::steady_clock::time_point waitEnd = std::chrono::steady_clock::now();
+
+    switch (waitForFenceResult) {
+        case VK_TIMEOUT:
+            throw VulkanException("Queue execution timeout!");
+            break;
+        case VK_SUCCESS:
+            break;
+        default:
+            throw VulkanException("Queue submission failed!");
+    }
+
+    return std::chrono::duration<double, std::milli>(waitEnd - waitBegin).count();
+}
+
+void VulkanEngine::waitForFrame(uint32_t frameIndex, double *fenceWaitTime) {
+    *fenceWaitTime = waitForFence(queueDoneFences[frameIndex]);
+
+    VKASSERT_SUCCESS(vkResetFences(logicalDevices[0], 1, queueDoneFences + frameIndex));
+
+    frameStagingRing.retire(frameStagingSubmissions[frameIndex]);
+    frameStagingSubmissions[frameIndex] = 0;
+
+    // The frame waited on their semaphores, so these transfer batches are done as well.
+    for (TransferBatch &batch : transferBatches)
+        if (batch.state == TRANSFER_BATCH_CONSUMED && batch.consumingFrame == (int32_t) frameIndex) {
+            completeTransferBatch(&batch);
+            recycleTransferBatch(&batch);
+        }
+
+    lastFrameTimings.gpu = -1.0;
+
+    if (frameTimestampQueryPool == VK_NULL_HANDLE || frameTimestampQueryIndices[frameIndex] < 0)
+        return;
+
+    uint64_t timestamps[2];
+
+    // Pre-recorded command buffers own the query pair of their swapchain image, which a later frame may already
+    // have reset again, in that case the results just aren't ready and the sample is skipped.
+    VkResult queryResult = vkGetQueryPoolResults(logicalDevices[0], frameTimestampQueryPool,
+                                                 frameTimestampQueryIndices[frameIndex] * 2, 2,
+                                                 sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                                 VK_QUERY_RESULT_64_BIT);
+
+    if (queryResult == VK_SUCCESS) {
+        uint32_t timestampValidBits = queueFamilyProperties[graphicsQueueFamilyIndex].timestampValidBits;
+        uint64_t timestampMask = (timestampValidBits >= 64) ? (~0ULL) : ((1ULL << timestampValidBits) - 1);
+
+        lastFrameTimings.gpu = ((timestamps[1] - timestamps[0]) & timestampMask) *
+                               (double) deviceProperties.limits.timestampPeriod / 1000000.0;
+
+        statisticsGpuTime += lastFrameTimings.gpu;
+        statisticsGpuFrameCount++;
+    }
+}
+
+void VulkanEngine::reportFrameStatistics(double frameTime, double fenceWaitTime) {
+    if (settings.frameStatisticsInterval == 0)
+        return;
+
+    statisticsFrameCount++;
+    statisticsFrameTime += frameTime;
+    statisticsFenceWaitTime += fenceWaitTime;
+
+    if (statisticsFrameCount < settings.frameStatisticsInterval)
+        return;
+
+    double averageFrameTime = statisticsFrameTime / statisticsFrameCount;
+    double averageFenceWaitTime = statisticsFenceWaitTime / statisticsFrameCount;
+
+    std::cout << "Frames in flight: " << framesInFlight << ", frame time: " << averageFrameTime << "ms ("
+              << 1000.0 / averageFrameTime << " fps), CPU blocked on GPU: " << averageFenceWaitTime << "ms";
+
+    if (statisticsGpuFrameCount > 0) {
+        double averageGpuTime = statisticsGpuTime / statisticsGpuFrameCount;
+
+        // Whatever the CPU busy time (frame time minus fence wait) and the GPU time add up to beyond one frame
+        // must have run concurrently. With a single frame in flight this stays close to zero.
+        double cpuBusyTime = averageFrameTime - averageFenceWaitTime;
+        double overlapTime = std::max(0.0, std::min(cpuBusyTime + averageGpuTime - averageFrameTime,
+                                                    std::min(cpuBusyTime, averageGpuTime)));
+
+        std::cout << ", GPU time: " << averageGpuTime << "ms, CPU/GPU overlap: "
+                  << overlapTime / averageFrameTime * 100.0 << "%";
+    }
+
+    std::cout << std::endl;
+
+    statisticsFrameCount = 0;
+    statisticsFrameTime = 0.0;
+    statisticsFenceWaitTime = 0.0;
+    statisticsGpuTime = 0.0;
+    statisticsGpuFrameCount = 0;
 }
 
 void VulkanEngine::createInstance() {
@@ -174,17 +387,32 @@ void VulkanEngine::createInstance() {
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pNext = nullptr;
 
-    std::vector<const char *> layerNames = {"VK_LAYER_LUNARG_monitor", "VK_LAYER_LUNARG_standard_validation"};
-    std::vector<const char *> extensionNames = {"VK_KHR_surface", "VK_KHR_win32_surface"};
+    std::vector<const char *> layerNames;
+    std::vector<const char *> extensionNames;
 
-    instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    instanceCreateInfo.pNext = nullptr;
-    instanceCreateInfo.enabledExtensionCount = 2;
 #ifndef NDEBUG
-    instanceCreateInfo.enabledLayerCount = 2;
-#else
-    instanceCreateInfo.enabledLayerCount = 0;
+    // Build machines running a software ICD usually come without the SDK layers, skip whatever isn't installed.
+    for (const char *layerName : {"VK_LAYER_LUNARG_monitor", "VK_LAYER_LUNARG_standard_validation"}) {
+        for (uint32_t i = 0; i < layerPropertiesCount; i++) {
+            if (strcmp(layerProperties[i].layerName, layerName) == 0) {
+                layerNames.push_back(layerName);
+                break;
+            }
+        }
+    }
 #endif
+
+#ifdef _WIN32
+    if (!headless) {
+        extensionNames.push_back("VK_KHR_surface");
+        extensionNames.push_back("VK_KHR_win32_surface");
+    }
+#endif
+
+    instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceCreateInfo.pNext = nullptr;
+    instanceCreateInfo.enabledExtensionCount = (uint32_t) extensionNames.size();
+    instanceCreateInfo.enabledLayerCount = (uint32_t) layerNames.size();
     instanceCreateInfo.ppEnabledExtensionNames = extensionNames.data();
     instanceCreateInfo.ppEnabledLayerNames = layerNames.data();
     instanceCreateInfo.flags = 0;
@@ -220,303 +448,422 @@ void VulkanEngine::getInstanceLayers() {
 }
 
 void VulkanEngine::createAllTextures() {
-    uint32_t lastCoveredSizeDevice = 0;
-    uint32_t lastCoveredSize = 0;
-
-    colorTexturesBindOffsetsDevice = new VkDeviceSize[cachedScene->mNumMeshes];
-    normalTexturesBindOffsetsDevice = new VkDeviceSize[cachedScene->mNumMeshes];
-    specTexturesBindOffsetsDevice = new VkDeviceSize[cachedScene->mNumMeshes];
-
-    colorTexturesBindOffsets = new VkDeviceSize[cachedScene->mNumMeshes];
-    normalTexturesBindOffsets = new VkDeviceSize[cachedScene->mNumMeshes];
-    specTexturesBindOffsets = new VkDeviceSize[cachedScene->mNumMeshes];
-
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        uint32_t requiredPaddingDevice = 0;
-        uint32_t requiredPadding = 0;
-
-        VkDeviceSize colorTextureMemoryOffsetDevice;
-        VkDeviceSize colorTextureMemorySizeDevice;
-        VkDeviceSize normalTextureMemoryOffsetDevice;
-        VkDeviceSize normalTextureMemorySizeDevice;
-        VkDeviceSize specTextureMemoryOffsetDevice;
-        VkDeviceSize specTextureMemorySizeDevice;
-
-        VkDeviceSize colorTextureMemoryOffset;
-        VkDeviceSize colorTextureMemorySize;
-        VkDeviceSize normalTextureMemoryOffset;
-        VkDeviceSize normalTextureMemorySize;
-        VkDeviceSize specTextureMemoryOffset;
-        VkDeviceSize specTextureMemorySize;
-
-        VkMemoryRequirements colorTextureDeviceMemoryRequirement = createTexture(colorTextureImagesDevice + meshIndex,
-                                                                                 VK_IMAGE_USAGE_SAMPLED_BIT |
-                                                                                 VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-        VkMemoryRequirements normalTextureDeviceMemoryRequirement = createTexture(normalTextureImagesDevice + meshIndex,
-                                                                                  VK_IMAGE_USAGE_SAMPLED_BIT |
-                                                                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-        VkMemoryRequirements specTextureDeviceMemoryRequirement = createTexture(specTextureImagesDevice + meshIndex,
-                                                                                VK_IMAGE_USAGE_SAMPLED_BIT |
-                                                                                VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-
-        VkMemoryRequirements colorTextureMemoryRequirement = createTexture(colorTextureImages + meshIndex,
-                                                                           VK_IMAGE_USAGE_SAMPLED_BIT |
-                                                                           VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-        VkMemoryRequirements normalTextureMemoryRequirement = createTexture(normalTextureImages + meshIndex,
-                                                                            VK_IMAGE_USAGE_SAMPLED_BIT |
-                                                                            VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-        VkMemoryRequirements specTextureMemoryRequirement = createTexture(specTextureImages + meshIndex,
-                                                                          VK_IMAGE_USAGE_SAMPLED_BIT |
-                                                                          VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-
-        if (meshIndex == 0) {
-            colorTextureMemoryOffsetDevice = 0;
-            colorTexturesBindOffsetsDevice[meshIndex] = colorTextureMemoryOffsetDevice;
-            colorTextureMemorySizeDevice = colorTextureDeviceMemoryRequirement.size;
-
-            lastCoveredSizeDevice += colorTextureMemoryOffsetDevice + colorTextureMemorySizeDevice;
-
-            colorTextureMemoryOffset = 0;
-            colorTexturesBindOffsets[meshIndex] = colorTextureMemoryOffset;
-            colorTextureMemorySize = colorTextureMemoryRequirement.size;
-
-            lastCoveredSize += colorTextureMemoryOffset + colorTextureMemorySize;
-        } else {
-            requiredPaddingDevice = colorTextureDeviceMemoryRequirement.alignment -
-                                    (lastCoveredSizeDevice % colorTextureDeviceMemoryRequirement.alignment);
+    VkFormatProperties textureFormatProperties;
+
+    vkGetPhysicalDeviceFormatProperties(physicalDevices[0], VK_FORMAT_R8G8B8A8_UNORM, &textureFormatProperties);
+
+    VkFormatFeatureFlags textureFormatFeatures = (settings.textureTiling == VK_IMAGE_TILING_LINEAR)
+                                                 ? (textureFormatProperties.linearTilingFeatures)
+                                                 : (textureFormatProperties.optimalTilingFeatures);
+
+    if ((textureFormatFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0)
+        throw VulkanException("Textures can't be sampled with the requested tiling.");
+
+    // Linear images are only guaranteed to support a single level.
+    bool generateMips = settings.textureMips && settings.textureTiling == VK_IMAGE_TILING_OPTIMAL;
+
+    std::vector<VkImage> *textureImageArrays[3] = {&colorTextureImagesDevice, &normalTextureImagesDevice,
+                                                   &specTextureImagesDevice};
+    std::vector<VkImageView> *textureViewArrays[3] = {&colorTextureViews, &normalTextureViews, &specTextureViews};
+    std::vector<MemoryAllocation> *textureMemoryArrays[3] = {&colorTexturesMemoryDevice, &normalTexturesMemoryDevice,
+                                                             &specTexturesMemoryDevice};
+    std::vector<TextureDescription> *textureDescriptionArrays[3] = {&colorTextureDescriptions,
+                                                                    &normalTextureDescriptions,
+                                                                    &specTextureDescriptions};
+
+    for (int textureIndex = 0; textureIndex < 3; textureIndex++) {
+        textureImageArrays[textureIndex]->assign(meshCount, VK_NULL_HANDLE);
+        textureViewArrays[textureIndex]->assign(meshCount, VK_NULL_HANDLE);
+        textureMemoryArrays[textureIndex]->assign(meshCount, MemoryAllocation());
+        textureDescriptionArrays[textureIndex]->assign(meshCount, TextureDescription());
+    }
+
+    VkImage *textureImages[3] = {colorTextureImagesDevice.data(), normalTextureImagesDevice.data(),
+                                 specTextureImagesDevice.data()};
+    VkImageView *textureViews[3] = {colorTextureViews.data(), normalTextureViews.data(), specTextureViews.data()};
+    MemoryAllocation *texturesMemory[3] = {colorTexturesMemoryDevice.data(), normalTexturesMemoryDevice.data(),
+                                           specTexturesMemoryDevice.data()};
+    TextureDescription *textureDescriptions[3] = {colorTextureDescriptions.data(), normalTextureDescriptions.data(),
+                                                  specTextureDescriptions.data()};
+
+    uint32_t compressedTextureCount = 0;
+
+    // Only the headers are read here, commitTextures() decodes the PNGs straight into staging memory.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        for (int textureIndex = 0; textureIndex < 3; textureIndex++) {
+            TextureDescription *textureDescription = textureDescriptions[textureIndex] + meshIndex;
+
+            textureDescription->atlasLayer = -1;
+            textureDescription->atlasX = 0;
+            textureDescription->atlasY = 0;
+            textureDescription->virtualTexture = false;
+
+            if (describeCompressedTexture(meshIndex, textureIndex, textureDescription)) {
+                compressedTextureCount++;
+                continue;
+            }
+
+            std::string pngPath = getTexturePath(meshIndex, textureIndex, ".png");
+            uint32_t width;
+            uint32_t height;
+            std::string pngError;
+
+            if (!readPngSize(pngPath, &width, &height, &pngError))
+                throw VulkanException(("Couldn't load texture file '" + pngPath + "': " + pngError + ".").c_str());
 
-            if (requiredPaddingDevice == colorTextureDeviceMemoryRequirement.alignment)
-                requiredPaddingDevice = 0;
+            textureDescription->format = VK_FORMAT_R8G8B8A8_UNORM;
+            textureDescription->width = width;
+            textureDescription->height = height;
+            textureDescription->levelCount = (generateMips) ? (getMipLevelCount(width, height)) : (1);
+        }
+    }
 
-            colorTextureMemoryOffsetDevice = lastCoveredSizeDevice + requiredPaddingDevice;
-            colorTexturesBindOffsetsDevice[meshIndex] = colorTextureMemoryOffsetDevice;
-            colorTextureMemorySizeDevice = colorTextureDeviceMemoryRequirement.size;
+    uint32_t virtualTextureCount = 0;
+    uint32_t atlasTextureCount = 0;
 
-            lastCoveredSizeDevice += requiredPaddingDevice + colorTextureMemorySizeDevice;
+    // Linear images are only guaranteed to support a single layer, and level.
+    if (settings.virtualTexturing && settings.textureTiling == VK_IMAGE_TILING_OPTIMAL)
+        virtualTextureCount = packVirtualTexture();
 
+    if (settings.textureAtlas && settings.textureTiling == VK_IMAGE_TILING_OPTIMAL)
+        atlasTextureCount = packTextureAtlas(generateMips);
 
-            requiredPadding = colorTextureMemoryRequirement.alignment -
-                              (lastCoveredSize % colorTextureMemoryRequirement.alignment);
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        for (int textureIndex = 0; textureIndex < 3; textureIndex++) {
+            const TextureDescription &textureDescription = textureDescriptions[textureIndex][meshIndex];
+            VkImage *textureImage = textureImages[textureIndex] + meshIndex;
+            VkImageView *textureView = textureViews[textureIndex] + meshIndex;
+
+            if (textureDescription.atlasLayer >= 0 || textureDescription.virtualTexture) {
+                *textureImage = VK_NULL_HANDLE;
+                *textureView = VK_NULL_HANDLE;
+                continue;
+            }
 
-            if (requiredPadding == colorTextureMemoryRequirement.alignment)
-                requiredPadding = 0;
+            createTexture(textureImage, textureDescription, 1,
+                          VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
-            colorTextureMemoryOffset = lastCoveredSize + requiredPadding;
-            colorTexturesBindOffsets[meshIndex] = colorTextureMemoryOffset;
-            colorTextureMemorySize = colorTextureMemoryRequirement.size;
+            memoryAllocator.allocateImageMemory(*textureImage, settings.textureTiling, 0,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                texturesMemory[textureIndex] + meshIndex);
 
-            lastCoveredSize += requiredPadding + colorTextureMemorySize;
+            createTextureView(textureView, *textureImage, textureDescription, 1);
         }
+    }
+
+    // The shaders see every texture through one array, each mesh's regions say which element to sample.
+    textureArrayViews.clear();
 
-        requiredPaddingDevice = normalTextureDeviceMemoryRequirement.alignment -
-                                (lastCoveredSizeDevice % normalTextureDeviceMemoryRequirement.alignment);
+    if (textureAtlasView != VK_NULL_HANDLE)
+        textureArrayViews.push_back(textureAtlasView);
 
-        if (requiredPaddingDevice == normalTextureDeviceMemoryRequirement.alignment)
-            requiredPaddingDevice = 0;
+    uint32_t virtualTextureArrayIndex = (uint32_t) textureArrayViews.size();
 
-        normalTextureMemoryOffsetDevice = lastCoveredSizeDevice + requiredPaddingDevice;
-        normalTexturesBindOffsetsDevice[meshIndex] = normalTextureMemoryOffsetDevice;
-        normalTextureMemorySizeDevice = normalTextureDeviceMemoryRequirement.size;
+    if (virtualTextureView != VK_NULL_HANDLE)
+        textureArrayViews.push_back(virtualTextureView);
 
-        lastCoveredSizeDevice += requiredPaddingDevice + normalTextureMemorySizeDevice;
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        TextureRegion *textureRegions[3] = {&meshTextureRegions[meshIndex].color, &meshTextureRegions[meshIndex].normal,
+                                            &meshTextureRegions[meshIndex].spec};
 
-        requiredPaddingDevice = specTextureDeviceMemoryRequirement.alignment -
-                                (lastCoveredSizeDevice % specTextureDeviceMemoryRequirement.alignment);
+        for (int textureIndex = 0; textureIndex < 3; textureIndex++) {
+            const TextureDescription &textureDescription = textureDescriptions[textureIndex][meshIndex];
+            uint32_t arrayIndex = 0;
 
-        if (requiredPaddingDevice == specTextureDeviceMemoryRequirement.alignment)
-            requiredPaddingDevice = 0;
+            if (textureDescription.virtualTexture) {
+                arrayIndex = virtualTextureArrayIndex;
+            } else if (textureDescription.atlasLayer < 0) {
+                arrayIndex = (uint32_t) textureArrayViews.size();
+                textureArrayViews.push_back(textureViews[textureIndex][meshIndex]);
+            }
 
-        specTextureMemoryOffsetDevice = lastCoveredSizeDevice + requiredPaddingDevice;
-        specTexturesBindOffsetsDevice[meshIndex] = specTextureMemoryOffsetDevice;
-        specTextureMemorySizeDevice = specTextureDeviceMemoryRequirement.size;
+            describeTextureRegion(textureDescription, arrayIndex, textureRegions[textureIndex]);
+        }
+    }
 
-        lastCoveredSizeDevice += requiredPaddingDevice + specTextureMemorySizeDevice;
+    textureArrayCount = (uint32_t) textureArrayViews.size();
 
+    std::cout << "Textures created successfully (" << compressedTextureCount << " of " << meshCount * 3
+              << " block compressed, " << atlasTextureCount << " in " << textureAtlasLayerCount
+              << " atlas layers, " << virtualTextureCount << " virtual)." << std::endl;
+}
 
-        requiredPadding =
-                normalTextureMemoryRequirement.alignment - (lastCoveredSize % normalTextureMemoryRequirement.alignment);
+uint32_t VulkanEngine::packTextureAtlas(bool generateMips) {
+    TextureDescription *textureDescriptions[3] = {colorTextureDescriptions.data(), normalTextureDescriptions.data(),
+                                                  specTextureDescriptions.data()};
+    std::vector<TextureDescription *> atlasTextures;
+    uint32_t maxTextureSize = (settings.textureAtlasMaxTextureSize < TEXTURE_ATLAS_SIZE)
+                              ? (settings.textureAtlasMaxTextureSize) : (TEXTURE_ATLAS_SIZE);
+
+    // Block compressed textures keep their own images, the atlas is RGBA8.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        for (int textureIndex = 0; textureIndex < 3; textureIndex++) {
+            TextureDescription *textureDescription = textureDescriptions[textureIndex] + meshIndex;
+
+            if (textureDescription->format == VK_FORMAT_R8G8B8A8_UNORM && !textureDescription->virtualTexture &&
+                textureDescription->width <= maxTextureSize && textureDescription->height <= maxTextureSize)
+                atlasTextures.push_back(textureDescription);
+        }
+    }
 
-        if (requiredPadding == normalTextureMemoryRequirement.alignment)
-            requiredPadding = 0;
+    if (atlasTextures.empty())
+        return 0;
 
-        normalTextureMemoryOffset = lastCoveredSize + requiredPadding;
-        normalTexturesBindOffsets[meshIndex] = normalTextureMemoryOffset;
-        normalTextureMemorySize = normalTextureMemoryRequirement.size;
+    // Every texture starts on a multiple of 2^(levels - 1) texels and is padded to one, so down to the last level of
+    // the atlas each texture's own mips land on whole texels and never overlap a neighbor's.
+    textureAtlasLevelCount = (generateMips) ? (TEXTURE_ATLAS_MIP_LEVELS) : (1);
 
-        lastCoveredSize += requiredPadding + normalTextureMemorySize;
+    uint32_t alignment = 1u << (textureAtlasLevelCount - 1);
+    std::vector<SkylinePacker> layers;
 
-        requiredPadding =
-                specTextureMemoryRequirement.alignment - (lastCoveredSize % specTextureMemoryRequirement.alignment);
+    std::stable_sort(atlasTextures.begin(), atlasTextures.end(),
+                     [](const TextureDescription *a, const TextureDescription *b) { return a->height > b->height; });
 
-        if (requiredPadding == specTextureMemoryRequirement.alignment)
-            requiredPadding = 0;
+    for (TextureDescription *textureDescription : atlasTextures) {
+        uint32_t paddedWidth = (textureDescription->width + alignment - 1) & ~(alignment - 1);
+        uint32_t paddedHeight = (textureDescription->height + alignment - 1) & ~(alignment - 1);
+        size_t layer = 0;
 
-        specTextureMemoryOffset = lastCoveredSize + requiredPadding;
-        specTexturesBindOffsets[meshIndex] = specTextureMemoryOffset;
-        specTextureMemorySize = specTextureMemoryRequirement.size;
+        while (layer < layers.size() &&
+               !layers[layer].pack(paddedWidth, paddedHeight, &textureDescription->atlasX, &textureDescription->atlasY))
+            layer++;
 
-        lastCoveredSize += requiredPadding + specTextureMemorySize;
+        if (layer == layers.size()) {
+            layers.push_back(SkylinePacker(TEXTURE_ATLAS_SIZE, TEXTURE_ATLAS_SIZE));
+            layers.back().pack(paddedWidth, paddedHeight, &textureDescription->atlasX, &textureDescription->atlasY);
+        }
 
+        textureDescription->atlasLayer = (int32_t) layer;
+        textureDescription->levelCount = textureAtlasLevelCount;
     }
 
-    VkDeviceSize totalRequiredMemorySizeDevice = lastCoveredSizeDevice;
-    VkDeviceSize totalRequiredMemorySize = lastCoveredSize;
+    textureAtlasLayerCount = (uint32_t) layers.size();
 
-    VkMemoryAllocateInfo uniMemoryAllocateInfo = {};
-    uniMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    uniMemoryAllocateInfo.pNext = nullptr;
-    uniMemoryAllocateInfo.allocationSize = totalRequiredMemorySize;
-    uniMemoryAllocateInfo.memoryTypeIndex = deviceLocalMemoryTypeIndex;
+    if (textureAtlasLayerCount > deviceProperties.limits.maxImageArrayLayers)
+        throw VulkanException("Texture atlas needs more array layers than the device supports.");
 
-    VKASSERT_SUCCESS(vkAllocateMemory(logicalDevices[0], &uniMemoryAllocateInfo, nullptr, &uniTexturesMemoryDevice));
+    TextureDescription atlasDescription = {VK_FORMAT_R8G8B8A8_UNORM, TEXTURE_ATLAS_SIZE, TEXTURE_ATLAS_SIZE,
+                                           textureAtlasLevelCount, -1, 0, 0, false};
 
-    uniMemoryAllocateInfo.allocationSize = totalRequiredMemorySizeDevice;
-    uniMemoryAllocateInfo.memoryTypeIndex = hostVisibleMemoryTypeIndex;
+    createTexture(&textureAtlasImage, atlasDescription, textureAtlasLayerCount,
+                  VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
-    VKASSERT_SUCCESS(vkAllocateMemory(logicalDevices[0], &uniMemoryAllocateInfo, nullptr, &uniTexturesMemory));
+    memoryAllocator.allocateImageMemory(textureAtlasImage, settings.textureTiling, 0,
+                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &textureAtlasMemory);
 
-    void *mappedMemory = NULL;
+    createTextureView(&textureAtlasView, textureAtlasImage, atlasDescription, textureAtlasLayerCount);
 
-    VKASSERT_SUCCESS(vkMapMemory(logicalDevices[0], uniTexturesMemory, 0, VK_WHOLE_SIZE, 0, &mappedMemory));
+    return (uint32_t) atlasTextures.size();
+}
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        uint16_t fileNumber = meshIndex;
+uint32_t VulkanEngine::packVirtualTexture() {
+    TextureDescription *textureDescriptions[3] = {colorTextureDescriptions.data(), normalTextureDescriptions.data(),
+                                                  specTextureDescriptions.data()};
+    std::vector<TextureDescription *> virtualTextures;
+
+    // Every virtual texture has all VIRTUAL_TEXTURE_LEVELS levels, down to a texel on the coarsest. Block compressed
+    // textures keep their own images, the virtual texture is RGBA8.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        for (int textureIndex = 0; textureIndex < 3; textureIndex++) {
+            TextureDescription *textureDescription = textureDescriptions[textureIndex] + meshIndex;
+
+            if (textureDescription->format == VK_FORMAT_R8G8B8A8_UNORM &&
+                textureDescription->width >= VIRTUAL_TEXTURE_PAGE_SIZE &&
+                textureDescription->height >= VIRTUAL_TEXTURE_PAGE_SIZE)
+                virtualTextures.push_back(textureDescription);
+        }
+    }
 
-        VkImageSubresource textureImageSubresource = {};
-        VkSubresourceLayout subresourceLayout;
+    if (virtualTextures.empty())
+        return 0;
 
-        textureImageSubresource.arrayLayer = 0;
-        textureImageSubresource.mipLevel = 0;
-        textureImageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    // Every texture starts on a page and is padded to whole pages, so on no level a page holds two textures' texels.
+    uint32_t pageSize = VIRTUAL_TEXTURE_PAGE_SIZE;
+    SkylinePacker packer(VIRTUAL_TEXTURE_SIZE, VIRTUAL_TEXTURE_SIZE);
 
-        vkGetImageSubresourceLayout(logicalDevices[0], colorTextureImagesDevice[meshIndex], &textureImageSubresource,
-                                    &subresourceLayout);
+    std::stable_sort(virtualTextures.begin(), virtualTextures.end(),
+                     [](const TextureDescription *a, const TextureDescription *b) { return a->height > b->height; });
 
-        ILuint imgName = ilGenImage();
+    // What doesn't fit keeps an image of its own.
+    for (TextureDescription *textureDescription : virtualTextures) {
+        uint32_t paddedWidth = (textureDescription->width + pageSize - 1) & ~(pageSize - 1);
+        uint32_t paddedHeight = (textureDescription->height + pageSize - 1) & ~(pageSize - 1);
 
-        ilBindImage(imgName);
+        if (!packer.pack(paddedWidth, paddedHeight, &textureDescription->atlasX, &textureDescription->atlasY))
+            continue;
 
-        std::string colorFileName(resourcesPath);
+        textureDescription->virtualTexture = true;
+        textureDescription->levelCount = VIRTUAL_TEXTURE_LEVELS;
+    }
 
-        colorFileName.append("t");
-        colorFileName.append(std::to_string(fileNumber));
-        colorFileName.append("c.png");
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        for (int textureIndex = 0; textureIndex < 3; textureIndex++) {
+            if (!textureDescriptions[textureIndex][meshIndex].virtualTexture)
+                continue;
 
-        if (ilLoadImage(colorFileName.c_str()) != IL_TRUE)
-            std::cerr << "DevIL: Couldn't load texture file '" << colorFileName.c_str() << "'." << std::endl;
+            VirtualTextureSource virtualTextureSource;
+            virtualTextureSource.textureDescription = textureDescriptions[textureIndex] + meshIndex;
+            virtualTextureSource.meshIndex = meshIndex;
+            virtualTextureSource.textureIndex = textureIndex;
 
-        void *pTextureData = ilGetData();
+            virtualTextureSources.push_back(virtualTextureSource);
+        }
+    }
 
-        for (int i = 0; i < 1024; i++) {
-            uint16_t rowPadding = -1;
+    if (virtualTextureSources.empty())
+        return 0;
 
-            rowPadding = subresourceLayout.rowPitch - ((4 * 1024) % subresourceLayout.rowPitch);
+    // Slot numbers have to fit their page table entries.
+    uint32_t slotCount = std::max(1u, std::min(settings.virtualTextureCachePages, VIRTUAL_TEXTURE_ENTRY_SLOT_MASK + 1));
+    TextureDescription virtualTextureDescription = {VK_FORMAT_R8G8B8A8_UNORM, VIRTUAL_TEXTURE_SIZE,
+                                                    VIRTUAL_TEXTURE_SIZE, VIRTUAL_TEXTURE_LEVELS, -1, 0, 0, true};
 
-            if (rowPadding == subresourceLayout.rowPitch) rowPadding = 0;
+    if (virtualTextureSparse && !createSparseImage(slotCount)) {
+        std::cout << "Sparse virtual texture unsuitable, falling back to the page cache image." << std::endl;
 
-            memcpy((byte *) mappedMemory + (i * (1024 * 4 + rowPadding)) + colorTexturesBindOffsetsDevice[meshIndex],
-                   (byte *) pTextureData + (i * 1024 * 4), 1024 * 4);
-        }
+        virtualTextureSparse = false;
+    }
 
-        ilDeleteImage(imgName);
+    if (virtualTextureSparse) {
+        virtualTexturePageBorder = 0;
+    } else {
+        // The slots are tiles of a square cache image. Filtering never leaves a tile, the borders hold the texels of
+        // the neighbouring pages.
+        virtualTexturePageBorder = VIRTUAL_TEXTURE_PAGE_BORDER;
 
-        textureImageSubresource.arrayLayer = 0;
-        textureImageSubresource.mipLevel = 0;
-        textureImageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        uint32_t tileSize = VIRTUAL_TEXTURE_PAGE_SIZE + 2 * virtualTexturePageBorder;
+        uint32_t maxSlotsPerSide = deviceProperties.limits.maxImageDimension2D / tileSize;
 
-        vkGetImageSubresourceLayout(logicalDevices[0], normalTextureImagesDevice[meshIndex], &textureImageSubresource,
-                                    &subresourceLayout);
+        virtualTextureSlotsPerSide = (uint32_t) ceil(sqrt((double) slotCount));
+        virtualTextureSlotsPerSide = std::min(virtualTextureSlotsPerSide, maxSlotsPerSide);
+        slotCount = std::min(slotCount, virtualTextureSlotsPerSide * virtualTextureSlotsPerSide);
 
-        imgName = ilGenImage();
+        virtualTextureDescription.width = virtualTextureSlotsPerSide * tileSize;
+        virtualTextureDescription.height = virtualTextureSlotsPerSide * tileSize;
+        virtualTextureDescription.levelCount = 1;
 
-        ilBindImage(imgName);
+        createTexture(&virtualTextureImage, virtualTextureDescription, 1,
+                      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
-        std::string normalFileName(resourcesPath);
+        memoryAllocator.allocateImageMemory(virtualTextureImage, settings.textureTiling, 0,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &virtualTextureMemory);
+    }
 
-        normalFileName.append("t");
-        normalFileName.append(std::to_string(fileNumber));
-        normalFileName.append("n.png");
+    uint32_t tileSize = VIRTUAL_TEXTURE_PAGE_SIZE + 2 * virtualTexturePageBorder;
 
-        if (ilLoadImage(normalFileName.c_str()) != IL_TRUE)
-            std::cerr << "DevIL: Couldn't load texture file '" << normalFileName.c_str() << "'." << std::endl;
+    virtualTexturePageBytes = (VkDeviceSize) tileSize * tileSize * 4;
 
-        pTextureData = ilGetData();
+    createTextureView(&virtualTextureView, virtualTextureImage, virtualTextureDescription, 1);
 
-        for (int i = 0; i < 1024; i++) {
-            uint16_t rowPadding = -1;
+    virtualTextureResidency.init(VIRTUAL_TEXTURE_SIZE / VIRTUAL_TEXTURE_PAGE_SIZE, VIRTUAL_TEXTURE_LEVELS, slotCount);
+    virtualTexturePageTable.assign(virtualTextureResidency.getPageCount(), 0);
 
-            rowPadding = subresourceLayout.rowPitch - ((4 * 1024) % subresourceLayout.rowPitch);
+    // The root page is the last resort of every lookup, it stays resident once streamed in.
+    virtualTextureResidency.pin(virtualTextureResidency.getPageCount() - 1);
 
-            if (rowPadding == subresourceLayout.rowPitch) rowPadding = 0;
+    // Pages are copied in and sampled by the frames, the image stays in the general layout for good. Transitioned by
+    // the first frame, whatever the sparse image has bound by then.
+    VkImageMemoryBarrier imageMemoryBarrier = {};
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.pNext = nullptr;
+    imageMemoryBarrier.srcAccessMask = 0;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    imageMemoryBarrier.image = virtualTextureImage;
+    imageMemoryBarrier.subresourceRange.layerCount = 1;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageMemoryBarrier.subresourceRange.levelCount = virtualTextureDescription.levelCount;
+    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-            memcpy((byte *) mappedMemory + (i * (1024 * 4 + rowPadding)) + normalTexturesBindOffsetsDevice[meshIndex],
-                   (byte *) pTextureData + (i * 1024 * 4), 1024 * 4);
-        }
+    pendingFrameImageBarriers.push_back(imageMemoryBarrier);
 
-        ilDeleteImage(imgName);
+    std::cout << "Virtual Texture created successfully (" << ((virtualTextureSparse) ? ("sparse, ") : ("software, "))
+              << slotCount << " pages cached)." << std::endl;
 
-        textureImageSubresource.arrayLayer = 0;
-        textureImageSubresource.mipLevel = 0;
-        textureImageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    return (uint32_t) virtualTextureSources.size();
+}
 
-        vkGetImageSubresourceLayout(logicalDevices[0], specTextureImagesDevice[meshIndex], &textureImageSubresource,
-                                    &subresourceLayout);
+void VulkanEngine::describeTextureRegion(const TextureDescription &textureDescription, uint32_t textureIndex,
+                                         TextureRegion *textureRegion) {
+    if (textureDescription.atlasLayer < 0 && !textureDescription.virtualTexture) {
+        *textureRegion = {{0.0f, 0.0f}, {1.0f, 1.0f}, 0.0f, textureIndex, 0, 0.0f};
+        return;
+    }
 
-        imgName = ilGenImage();
+    float atlasSize = (float) ((textureDescription.virtualTexture) ? (VIRTUAL_TEXTURE_SIZE) : (TEXTURE_ATLAS_SIZE));
 
-        ilBindImage(imgName);
+    textureRegion->offset[0] = textureDescription.atlasX / atlasSize;
+    textureRegion->offset[1] = textureDescription.atlasY / atlasSize;
+    textureRegion->extent[0] = textureDescription.width / atlasSize;
+    textureRegion->extent[1] = textureDescription.height / atlasSize;
+    textureRegion->layer = (textureDescription.virtualTexture) ? (0.0f) : ((float) textureDescription.atlasLayer);
+    textureRegion->textureIndex = textureIndex;
+    textureRegion->virtualTexture = (textureDescription.virtualTexture) ? (1) : (0);
+    textureRegion->padding = 0.0f;
+}
 
-        std::string specFileName(resourcesPath);
+std::string VulkanEngine::getTexturePath(uint16_t meshIndex, int textureIndex, const char *extension) {
+    const char textureRoles[3] = {'c', 'n', 's'};
 
-        specFileName.append("t");
-        specFileName.append(std::to_string(fileNumber));
-        specFileName.append("s.png");
+    std::string texturePath(resourcesPath);
 
-        if (ilLoadImage(specFileName.c_str()) != IL_TRUE)
-            std::cerr << "DevIL: Couldn't load texture file '" << specFileName.c_str() << "'." << std::endl;
+    texturePath.append("t");
+    texturePath.append(std::to_string(meshIndex));
+    texturePath.push_back(textureRoles[textureIndex]);
+    texturePath.append(extension);
 
-        pTextureData = ilGetData();
+    return texturePath;
+}
 
-        for (int i = 0; i < 1024; i++) {
-            uint16_t rowPadding = -1;
+bool VulkanEngine::describeCompressedTexture(uint16_t meshIndex, int textureIndex,
+                                             TextureDescription *textureDescription) {
+    // Written by texture_compressor_main.cpp. BC formats are an optional feature, and can't be linearly tiled.
+    if (desiredDeviceFeatures.textureCompressionBC != VK_TRUE || settings.textureTiling != VK_IMAGE_TILING_OPTIMAL)
+        return false;
 
-            rowPadding = subresourceLayout.rowPitch - ((4 * 1024) % subresourceLayout.rowPitch);
+    Ktx2Texture ktx2Texture;
 
-            if (rowPadding == subresourceLayout.rowPitch) rowPadding = 0;
+    if (!ktx2Texture.open(getTexturePath(meshIndex, textureIndex, ".ktx2")))
+        return false;
 
-            memcpy((byte *) mappedMemory + (i * (1024 * 4 + rowPadding)) + specTexturesBindOffsetsDevice[meshIndex],
-                   (byte *) pTextureData + (i * 1024 * 4), 1024 * 4);
-        }
+    VkFormatProperties ktx2FormatProperties;
 
-        ilDeleteImage(imgName);
-    }
+    vkGetPhysicalDeviceFormatProperties(physicalDevices[0], ktx2Texture.format, &ktx2FormatProperties);
 
-    vkUnmapMemory(logicalDevices[0], uniTexturesMemory);
+    // Uncompressed KTX2 files go through the PNG path, they'd gain nothing.
+    if (ktx2Texture.format == VK_FORMAT_R8G8B8A8_UNORM ||
+        (ktx2FormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0)
+        return false;
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        VKASSERT_SUCCESS(vkBindImageMemory(logicalDevices[0], colorTextureImages[meshIndex], uniTexturesMemory,
-                                           colorTexturesBindOffsets[meshIndex]));
-        VKASSERT_SUCCESS(vkBindImageMemory(logicalDevices[0], normalTextureImages[meshIndex], uniTexturesMemory,
-                                           normalTexturesBindOffsets[meshIndex]));
-        VKASSERT_SUCCESS(vkBindImageMemory(logicalDevices[0], specTextureImages[meshIndex], uniTexturesMemory,
-                                           specTexturesBindOffsets[meshIndex]));
+    textureDescription->format = ktx2Texture.format;
+    textureDescription->width = ktx2Texture.width;
+    textureDescription->height = ktx2Texture.height;
+    textureDescription->levelCount = (settings.textureMips) ? (ktx2Texture.levelCount) : (1);
 
-        VKASSERT_SUCCESS(
-                vkBindImageMemory(logicalDevices[0], colorTextureImagesDevice[meshIndex], uniTexturesMemoryDevice,
-                                  colorTexturesBindOffsetsDevice[meshIndex]));
-        VKASSERT_SUCCESS(
-                vkBindImageMemory(logicalDevices[0], normalTextureImagesDevice[meshIndex], uniTexturesMemoryDevice,
-                                  normalTexturesBindOffsetsDevice[meshIndex]));
-        VKASSERT_SUCCESS(
-                vkBindImageMemory(logicalDevices[0], specTextureImagesDevice[meshIndex], uniTexturesMemoryDevice,
-                                  specTexturesBindOffsetsDevice[meshIndex]));
-    }
+    return true;
+}
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        createTextureView(colorTextureViews + meshIndex, colorTextureImagesDevice[meshIndex]);
-        createTextureView(normalTextureViews + meshIndex, normalTextureImagesDevice[meshIndex]);
-        createTextureView(specTextureViews + meshIndex, specTextureImagesDevice[meshIndex]);
-    }
+void VulkanEngine::decodeTexture(const std::string &pngPath, bool normalMap,
+                                 const TextureDescription &textureDescription, uint8_t *chain) {
+    PngDecoder decoder;
+    std::string decodeError;
+
+    if (!decoder.open(pngPath, &decodeError))
+        throw VulkanException(("Couldn't load texture file '" + pngPath + "': " + decodeError + ".").c_str());
+
+    if (decoder.width != textureDescription.width || decoder.height != textureDescription.height)
+        throw VulkanException(("Texture file '" + pngPath + "' changed while loading.").c_str());
+
+    // Every row is filtered down the chain as it's decoded, and written to chain exactly once, in order.
+    MipChainWriter mipChainWriter(textureDescription.width, textureDescription.height, textureDescription.levelCount,
+                                  normalMap, chain);
+
+    if (!decoder.decode([&mipChainWriter](const uint8_t *row) { mipChainWriter.writeRow(row); }, &decodeError))
+        throw VulkanException(("Couldn't decode texture file '" + pngPath + "': " + decodeError + ".").c_str());
 }
 
 void VulkanEngine::getDeviceLayers() {
@@ -550,147 +897,707 @@ void VulkanEngine::enumeratePhysicalDevices() {
 }
 
 void VulkanEngine::commitBuffers() {
-    VkCommandBuffer commandBuffer;
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.pNext = nullptr;
-    commandBufferAllocateInfo.commandBufferCount = 1;
-    commandBufferAllocateInfo.commandPool = transferCommandPool;
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    modelMatrix.modelMatrix = glm::mat4x4(1.0f);
 
-    VKASSERT_SUCCESS(vkAllocateCommandBuffers(logicalDevices[0], &commandBufferAllocateInfo, &commandBuffer));
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        VkDeviceSize positionOffset = positionStride * (VkDeviceSize) meshRegions[meshIndex].vertexOffset;
+        VkDeviceSize attributeOffset = attributeStreamOffset +
+                                       attributeStride * (VkDeviceSize) meshRegions[meshIndex].vertexOffset;
 
-    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
-    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    commandBufferBeginInfo.pNext = nullptr;
-    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+        if (settings.quantizedVertices) {
+            std::vector<VertexPosition<QuantizedVertex>> positions;
+            std::vector<VertexAttributes<QuantizedVertex>> attributes;
 
-    VKASSERT_SUCCESS(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+            quantizeVertices(meshIndex, &positions, &attributes);
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        VkBufferCopy region = {};
-        region.srcOffset = 0;
-        region.dstOffset = 0;
-        region.size = totalUniformBufferSize;
+            uploadBuffer(vertexBufferDevice, positionOffset, positions.data(),
+                         positionStride * meshRegions[meshIndex].vertexCount);
+            uploadBuffer(vertexBufferDevice, attributeOffset, attributes.data(),
+                         attributeStride * meshRegions[meshIndex].vertexCount);
+        } else {
+            std::vector<VertexPosition<float>> positions;
+            std::vector<VertexAttributes<float>> attributes;
 
-        vkCmdCopyBuffer(commandBuffer, uniformBuffers[meshIndex], uniformBuffersDevice[meshIndex], 1, &region);
+            splitVertices(meshIndex, &positions, &attributes);
 
-        region.size = vertexBuffersSizes[meshIndex];
+            uploadBuffer(vertexBufferDevice, positionOffset, positions.data(),
+                         positionStride * meshRegions[meshIndex].vertexCount);
+            uploadBuffer(vertexBufferDevice, attributeOffset, attributes.data(),
+                         attributeStride * meshRegions[meshIndex].vertexCount);
+        }
 
-        vkCmdCopyBuffer(commandBuffer, vertexBuffers[meshIndex], vertexBuffersDevice[meshIndex], 1, &region);
+        if (meshRegions[meshIndex].indexType == VK_INDEX_TYPE_UINT16) {
+            std::vector<uint16_t> indices(meshData[meshIndex].indices,
+                                          meshData[meshIndex].indices + meshData[meshIndex].indexCount);
 
-        region.size = indexBuffersSizes[meshIndex];
+            uploadBuffer(indexBufferDevice, sizeof(uint16_t) * (VkDeviceSize) meshRegions[meshIndex].firstIndex,
+                         indices.data(), sizeof(uint16_t) * meshRegions[meshIndex].indexCount);
+        } else {
+            uploadBuffer(indexBufferDevice, sizeof(uint32_t) * (VkDeviceSize) meshRegions[meshIndex].firstIndex,
+                         meshData[meshIndex].indices, sizeof(uint32_t) * meshRegions[meshIndex].indexCount);
+        }
 
-        vkCmdCopyBuffer(commandBuffer, indexBuffers[meshIndex], indexBuffersDevice[meshIndex], 1, &region);
+        uploadBuffer(uniformBufferDevice, uniformBufferStride * meshIndex, &modelMatrix, sizeof(ModelMatrix<float>));
+        uploadBuffer(uniformBufferDevice, uniformBufferStride * meshIndex + positionDequantizationOffset,
+                     positionDequantizations + meshIndex, sizeof(PositionDequantization));
+        uploadBuffer(uniformBufferDevice, uniformBufferStride * meshIndex + meshTextureRegionsOffset,
+                     meshTextureRegions + meshIndex, sizeof(MeshTextureRegions));
     }
 
-    VKASSERT_SUCCESS(vkEndCommandBuffer(commandBuffer));
-
-    VkSubmitInfo queueSubmit = {};
-    queueSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    queueSubmit.pNext = nullptr;
-    queueSubmit.waitSemaphoreCount = 0;
-    queueSubmit.pWaitSemaphores = nullptr;
-    queueSubmit.pWaitDstStageMask = nullptr;
-    queueSubmit.commandBufferCount = 1;
-    queueSubmit.pCommandBuffers = &commandBuffer;
-    queueSubmit.signalSemaphoreCount = 0;
-    queueSubmit.pSignalSemaphores = nullptr;
+    if (!settings.meshletCulling || totalMeshletCount == 0)
+        return;
 
-    VKASSERT_SUCCESS(vkQueueSubmit(transferQueue, 1, &queueSubmit, VK_NULL_HANDLE));
+    std::vector<MeshletDescription> meshletDescriptions;
 
-    VKASSERT_SUCCESS(vkDeviceWaitIdle(logicalDevices[0]));
+    meshletDescriptions.reserve(totalMeshletCount);
 
-    vkFreeCommandBuffers(logicalDevices[0], transferCommandPool, 1, &commandBuffer);
-}
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        for (const Meshlet &meshlet : meshlets[meshIndex]) {
+            MeshletDescription meshletDescription = {};
 
-void VulkanEngine::getPhysicalDevicePropertiesAndFeatures() {
-    vkGetPhysicalDeviceProperties(physicalDevices[0], &deviceProperties);
+            memcpy(meshletDescription.center, meshlet.center, sizeof(meshlet.center));
+            meshletDescription.radius = meshlet.radius;
+            memcpy(meshletDescription.coneApex, meshlet.coneApex, sizeof(meshlet.coneApex));
+            meshletDescription.coneCutoff = meshlet.coneCutoff;
+            memcpy(meshletDescription.coneAxis, meshlet.coneAxis, sizeof(meshlet.coneAxis));
+            meshletDescription.meshIndex = meshIndex;
+            meshletDescription.firstIndex = meshRegions[meshIndex].firstIndex + meshlet.firstIndex;
+            meshletDescription.triangleCount = meshlet.triangleCount;
+            meshletDescription.shortIndices = (meshRegions[meshIndex].indexType == VK_INDEX_TYPE_UINT16) ? (1) : (0);
 
-    std::cout << "Highest Supported Vulkan Version:\t" << getVersionString(deviceProperties.apiVersion) << std::endl;
+            meshletDescriptions.push_back(meshletDescription);
+        }
+    }
 
-    vkGetPhysicalDeviceFeatures(physicalDevices[0], &supportedDeviceFeatures);
+    uploadBuffer(meshletBuffer, 0, meshletDescriptions.data(), sizeof(MeshletDescription) * totalMeshletCount);
+}
 
-    std::cout << "Supports Tesselation Shader Feature:\t"
-              << ((supportedDeviceFeatures.tessellationShader) ? ("Yes") : ("No")) << std::endl;
+void VulkanEngine::createStagingRing() {
+    stagingRing.init(&memoryAllocator, logicalDevices[0], settings.stagingRingSize);
+    frameStagingRing.init(&memoryAllocator, logicalDevices[0], settings.frameStagingRingSize);
 
-    std::cout << "Maximum Supported Image Size:\t" << deviceProperties.limits.maxImageDimension1D << "x"
-              << deviceProperties.limits.maxImageDimension2D << "x" << deviceProperties.limits.maxImageDimension3D
-              << std::endl;
+    std::cout << "Staging Rings created successfully (" << settings.stagingRingSize / (1024 * 1024) << " MB + "
+              << settings.frameStagingRingSize / (1024 * 1024) << " MB)." << std::endl;
+}
 
-    std::cout << "Minimum Memory Map Alignment:\t" << deviceProperties.limits.minMemoryMapAlignment << std::endl;
+void VulkanEngine::stageUpload(VkDeviceSize size, VkDeviceSize alignment, StagingRegion *region) {
+    if (stagingRing.allocate(size, alignment, region))
+        return;
 
-    std::cout << "Max Local Working Group Size: " << deviceProperties.limits.maxComputeWorkGroupSize[0] << "x"
-              << deviceProperties.limits.maxComputeWorkGroupSize[1] << "x"
-              << deviceProperties.limits.maxComputeWorkGroupSize[2] << std::endl;
+    // The ring is full, push what is recorded to the GPU and wait for the transfers in flight to hand their staging
+    // memory back. Nothing is released to the graphics queue family yet, the upload isn't complete.
+    submitTransferBatch(false);
+    retireTransferBatches(true);
 
-    std::cout << "Max Total Working Group Invocations: " << deviceProperties.limits.maxComputeWorkGroupInvocations
-              << std::endl;
+    if (!stagingRing.allocate(size, alignment, region))
+        throw VulkanException("Upload doesn't fit into the staging ring.");
+}
 
-    std::cout << "Max bound descriptor sets in a pipeline layout: " << deviceProperties.limits.maxBoundDescriptorSets
-              << std::endl;
+VkCommandBuffer VulkanEngine::getTransferCommandBuffer() {
+    if (recordingTransferBatch >= 0)
+        return transferBatches[recordingTransferBatch].commandBuffer;
 
-    std::cout << "Minimum Uniform Buffer offest alignment: " << deviceProperties.limits.minUniformBufferOffsetAlignment
-              << std::endl;
+    int32_t batchIndex = -1;
 
-    std::cout << "Maximum Texel Buffer elements: " << deviceProperties.limits.maxTexelBufferElements << std::endl;
+    for (size_t i = 0; i < transferBatches.size() && batchIndex < 0; i++)
+        if (transferBatches[i].state == TRANSFER_BATCH_FREE)
+            batchIndex = (int32_t) i;
 
-    std::cout << "Maximum Subpass Color Attachments: " << deviceProperties.limits.maxColorAttachments << std::endl;
+    if (batchIndex < 0) {
+        TransferBatch batch;
 
-    std::cout << "Maximum Framebuffer Width: " << deviceProperties.limits.maxFramebufferWidth << std::endl;
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocateInfo.pNext = nullptr;
+        commandBufferAllocateInfo.commandBufferCount = 1;
+        commandBufferAllocateInfo.commandPool = transferCommandPool;
+        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-    std::cout << "Maximum Framebuffer Height: " << deviceProperties.limits.maxFramebufferHeight << std::endl;
+        VKASSERT_SUCCESS(vkAllocateCommandBuffers(logicalDevices[0], &commandBufferAllocateInfo, &batch.commandBuffer));
 
-    std::cout << "Maximum Framebuffer Layers: " << deviceProperties.limits.maxFramebufferLayers << std::endl;
+        VkFenceCreateInfo fenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, nullptr, 0};
 
-    std::cout << "Maximum Vertex Input bindings: " << deviceProperties.limits.maxVertexInputBindings << std::endl;
+        VKASSERT_SUCCESS(vkCreateFence(logicalDevices[0], &fenceCreateInfo, nullptr, &batch.fence));
 
-    std::cout << "Maximum Vertex Input Attributes: " << deviceProperties.limits.maxVertexInputAttributes << std::endl;
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, nullptr, 0};
 
-    std::cout << "Maximum Vertex Input Binding Stride: " << deviceProperties.limits.maxVertexInputBindingStride
-              << std::endl;
+        VKASSERT_SUCCESS(vkCreateSemaphore(logicalDevices[0], &semaphoreCreateInfo, nullptr, &batch.semaphore));
 
-    std::cout << "Maximum Vertex Input Attribute Offset: " << deviceProperties.limits.maxVertexInputAttributeOffset
-              << std::endl;
+        transferBatches.push_back(batch);
 
-    std::cout << "Maximum Viewports: " << deviceProperties.limits.maxViewports << std::endl;
+        batchIndex = (int32_t) transferBatches.size() - 1;
+    }
 
-    std::cout << "Minimum Line Width: " << deviceProperties.limits.lineWidthRange[0] << std::endl;
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
 
-    std::cout << "Maximum Line Width: " << deviceProperties.limits.lineWidthRange[1] << std::endl;
+    VKASSERT_SUCCESS(vkBeginCommandBuffer(transferBatches[batchIndex].commandBuffer, &commandBufferBeginInfo));
 
-    std::cout << "Line Width Granularity: " << deviceProperties.limits.lineWidthGranularity << std::endl;
+    transferBatches[batchIndex].state = TRANSFER_BATCH_RECORDING;
+    recordingTransferBatch = batchIndex;
 
-    std::cout << "Max Index Value: " << deviceProperties.limits.maxDrawIndexedIndexValue << std::endl;
+    return transferBatches[batchIndex].commandBuffer;
+}
 
-    std::cout << "Max Geometry Produced Vertices: " << deviceProperties.limits.maxGeometryOutputVertices << std::endl;
+void VulkanEngine::submitTransferCommands() {
+    submitTransferBatch(true);
+}
 
-    std::cout << "Max Geometry Produced Components: " << deviceProperties.limits.maxGeometryOutputComponents
-              << std::endl;
+void VulkanEngine::submitTransferBatch(bool releaseUploads) {
+    bool releasing = releaseUploads && (!pendingReleaseBufferBarriers.empty() || !pendingReleaseImageBarriers.empty());
 
-    std::cout << "Max Geometry Total Produced Components: " << deviceProperties.limits.maxGeometryTotalOutputComponents
-              << std::endl;
+    if (recordingTransferBatch < 0 && !releasing)
+        return;
 
-    std::cout << "Max Geometry Consumed Components: " << deviceProperties.limits.maxGeometryInputComponents
-              << std::endl;
+    VkCommandBuffer commandBuffer = getTransferCommandBuffer();
+    TransferBatch &batch = transferBatches[recordingTransferBatch];
+
+    if (releasing) {
+        // Release half of the queue family ownership transfers, plus the texture layout transitions. Covers the
+        // copies of the earlier batches of the upload too, they were submitted to the same queue.
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, (uint32_t) pendingReleaseBufferBarriers.size(),
+                             pendingReleaseBufferBarriers.data(), (uint32_t) pendingReleaseImageBarriers.size(),
+                             pendingReleaseImageBarriers.data());
+
+        // The acquire half, recorded into the frame that waits on the semaphore. Within a single queue family the
+        // semaphore alone makes the writes visible.
+        if (transferQueueFamilyIndex != graphicsQueueFamilyIndex) {
+            batch.acquireBufferBarriers = pendingReleaseBufferBarriers;
+            batch.acquireImageBarriers = pendingReleaseImageBarriers;
+
+            for (VkBufferMemoryBarrier &bufferMemoryBarrier : batch.acquireBufferBarriers) {
+                bufferMemoryBarrier.srcAccessMask = 0;
+                bufferMemoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                                    VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+                                                    VK_ACCESS_TRANSFER_WRITE_BIT;
+            }
 
-    vkGetPhysicalDeviceMemoryProperties(physicalDevices[0], &deviceMemoryProperties);
+            for (VkImageMemoryBarrier &imageMemoryBarrier : batch.acquireImageBarriers) {
+                imageMemoryBarrier.srcAccessMask = 0;
+                imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            }
+        }
 
-    memoryTypeCount = deviceMemoryProperties.memoryTypeCount;
+        pendingReleaseBufferBarriers.clear();
+        pendingReleaseImageBarriers.clear();
 
-    std::cout << "Memory Type count: " << memoryTypeCount << std::endl;
+        batch.signalsSemaphore = true;
+    }
 
-    std::string flagsString;
+    VKASSERT_SUCCESS(vkEndCommandBuffer(commandBuffer));
 
-    for (int i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
-        flagsString = "";
+    recordingTransferBatch = -1;
 
-        int heapIndex = deviceMemoryProperties.memoryTypes[i].heapIndex;
+    // One flush for everything staged since the previous submission.
+    stagingRing.flush();
+
+    VkSubmitInfo queueSubmit = {};
+    queueSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    queueSubmit.pNext = nullptr;
+    queueSubmit.waitSemaphoreCount = 0;
+    queueSubmit.pWaitSemaphores = nullptr;
+    queueSubmit.pWaitDstStageMask = nullptr;
+    queueSubmit.commandBufferCount = 1;
+    queueSubmit.pCommandBuffers = &batch.commandBuffer;
+    queueSubmit.signalSemaphoreCount = (batch.signalsSemaphore) ? (1) : (0);
+    queueSubmit.pSignalSemaphores = &batch.semaphore;
+
+    VKASSERT_SUCCESS(vkQueueSubmit(transferQueue, 1, &queueSubmit, batch.fence));
+
+    batch.stagingSubmission = stagingRing.endSubmission();
+    batch.state = TRANSFER_BATCH_SUBMITTED;
+}
+
+void VulkanEngine::completeTransferBatch(TransferBatch *batch) {
+    if (batch->completed)
+        return;
+
+    waitForFence(batch->fence);
+
+    stagingRing.retire(batch->stagingSubmission);
+
+    batch->completed = true;
+}
+
+void VulkanEngine::recycleTransferBatch(TransferBatch *batch) {
+    VKASSERT_SUCCESS(vkResetFences(logicalDevices[0], 1, &batch->fence));
+
+    batch->state = TRANSFER_BATCH_FREE;
+    batch->signalsSemaphore = false;
+    batch->completed = false;
+    batch->stagingSubmission = 0;
+    batch->consumingFrame = -1;
+    batch->acquireBufferBarriers.clear();
+    batch->acquireImageBarriers.clear();
+}
+
+void VulkanEngine::retireTransferBatches(bool wait) {
+    for (TransferBatch &batch : transferBatches) {
+        if (batch.state != TRANSFER_BATCH_SUBMITTED && batch.state != TRANSFER_BATCH_CONSUMED)
+            continue;
+
+        if (batch.completed || (!wait && vkGetFenceStatus(logicalDevices[0], batch.fence) != VK_SUCCESS))
+            continue;
+
+        completeTransferBatch(&batch);
+
+        // Batches that signal a semaphore are recycled once the frame waiting on it is done, see waitForFrame().
+        if (!batch.signalsSemaphore)
+            recycleTransferBatch(&batch);
+    }
+}
+
+void VulkanEngine::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+    // Split up so a single upload never needs more than a part of the ring.
+    VkDeviceSize maxChunkSize = stagingRing.getSize() / 4;
+
+    for (VkDeviceSize uploadedSize = 0; uploadedSize < size;) {
+        VkDeviceSize chunkSize = std::min(size - uploadedSize, maxChunkSize);
+        StagingRegion stagingRegion;
+
+        stageUpload(chunkSize, 16, &stagingRegion);
+
+        memcpy(stagingRegion.data, (const byte *) data + uploadedSize, chunkSize);
+
+        VkBufferCopy region = {};
+        region.srcOffset = stagingRegion.offset;
+        region.dstOffset = dstOffset + uploadedSize;
+        region.size = chunkSize;
+
+        vkCmdCopyBuffer(getTransferCommandBuffer(), stagingRegion.buffer, dstBuffer, 1, &region);
+
+        uploadedSize += chunkSize;
+    }
+
+    // Handed over to the graphics queue family by the next submitTransferCommands(), as a whole.
+    if (transferQueueFamilyIndex == graphicsQueueFamilyIndex)
+        return;
+
+    for (const VkBufferMemoryBarrier &bufferMemoryBarrier : pendingReleaseBufferBarriers)
+        if (bufferMemoryBarrier.buffer == dstBuffer)
+            return;
+
+    VkBufferMemoryBarrier bufferMemoryBarrier = {};
+    bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferMemoryBarrier.pNext = nullptr;
+    bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferMemoryBarrier.dstAccessMask = 0;
+    bufferMemoryBarrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+    bufferMemoryBarrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+    bufferMemoryBarrier.buffer = dstBuffer;
+    bufferMemoryBarrier.offset = 0;
+    bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+
+    pendingReleaseBufferBarriers.push_back(bufferMemoryBarrier);
+}
+
+void VulkanEngine::uploadCompressedTexture(VkImage textureImage, const TextureDescription &textureDescription,
+                                           const std::string &ktx2Path) {
+    Ktx2Texture ktx2Texture;
+
+    if (!ktx2Texture.open(ktx2Path) || ktx2Texture.format != textureDescription.format ||
+        ktx2Texture.width != textureDescription.width || ktx2Texture.height != textureDescription.height ||
+        ktx2Texture.levelCount < textureDescription.levelCount)
+        throw VulkanException("KTX2 texture changed or vanished while loading.");
+
+    // The blocks go to the GPU as they are, read straight into the staging ring.
+    uploadTextureChain(textureImage, textureDescription,
+                       [&ktx2Texture](uint32_t level, size_t offset, size_t size, uint8_t *dst) {
+                           if (!ktx2Texture.readLevel(level, offset, size, dst))
+                               throw VulkanException("Couldn't read KTX2 texture level.");
+                       });
+}
+
+void VulkanEngine::uploadTextureChain(VkImage textureImage, const TextureDescription &textureDescription,
+                                      const std::function<void(uint32_t, size_t, size_t, uint8_t *)> &readLevel) {
+    bool inAtlas = textureDescription.atlasLayer >= 0;
+
+    if (inAtlas)
+        textureImage = textureAtlasImage;
+    else
+        recordTextureTransition(textureImage, textureDescription.levelCount, 1);
+
+    // A level, or a band of whole block rows of it, at a time, never more than uploadBuffer()'s chunks. The transfer
+    // family copies at any offset, see createLogicalDevice().
+    VkDeviceSize maxChunkSize = stagingRing.getSize() / 4;
+    uint32_t blockExtent;
+    VkDeviceSize blockSize = getKtx2BlockSize(textureDescription.format, &blockExtent);
+
+    for (uint32_t level = 0; level < textureDescription.levelCount; level++) {
+        uint32_t levelWidth = std::max(textureDescription.width >> level, 1u);
+        uint32_t levelHeight = std::max(textureDescription.height >> level, 1u);
+        uint32_t blockRowCount = (levelHeight + blockExtent - 1) / blockExtent;
+        VkDeviceSize blockRowSize = (levelWidth + blockExtent - 1) / blockExtent * blockSize;
+        uint32_t bandRowCount = std::min(std::max((uint32_t) (maxChunkSize / blockRowSize), 1u), blockRowCount);
+
+        for (uint32_t firstRow = 0; firstRow < blockRowCount; firstRow += bandRowCount) {
+            uint32_t rowCount = std::min(bandRowCount, blockRowCount - firstRow);
+            StagingRegion stagingRegion;
+
+            stageUpload(blockRowSize * rowCount, 16, &stagingRegion);
+
+            readLevel(level, (size_t) (blockRowSize * firstRow), (size_t) (blockRowSize * rowCount),
+                      stagingRegion.data);
+
+            VkBufferImageCopy region = {};
+            region.bufferOffset = stagingRegion.offset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.baseArrayLayer = (inAtlas) ? ((uint32_t) textureDescription.atlasLayer) : (0);
+            region.imageSubresource.layerCount = 1;
+            region.imageSubresource.mipLevel = level;
+            region.imageOffset = {(int32_t) (textureDescription.atlasX >> level),
+                                  (int32_t) ((textureDescription.atlasY >> level) + firstRow * blockExtent), 0};
+            region.imageExtent = {levelWidth, std::min(rowCount * blockExtent, levelHeight - firstRow * blockExtent),
+                                  1};
+
+            vkCmdCopyBufferToImage(getTransferCommandBuffer(), stagingRegion.buffer, textureImage,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+    }
+
+    if (!inAtlas)
+        releaseTexture(textureImage, textureDescription.levelCount, 1);
+}
+
+void VulkanEngine::recordTextureUpload(VkImage textureImage, const TextureDescription &textureDescription,
+                                       const StagingRegion &stagingRegion) {
+    // Atlas textures share one image, commitTextures() transitions and releases it as a whole.
+    bool inAtlas = textureDescription.atlasLayer >= 0;
+
+    if (inAtlas)
+        textureImage = textureAtlasImage;
+    else
+        recordTextureTransition(textureImage, textureDescription.levelCount, 1);
+
+    // Levels lie tightly packed in the staging region, one copy region each. Every level is copied whole, so the
+    // block size of the format never matters. Atlas regions sit at any texel offset, which the transfer family
+    // allows, see createLogicalDevice().
+    std::vector<VkBufferImageCopy> regions(textureDescription.levelCount);
+    VkDeviceSize levelOffset = 0;
+
+    for (uint32_t level = 0; level < textureDescription.levelCount; level++) {
+        VkBufferImageCopy &region = regions[level];
+
+        region = {};
+        region.bufferOffset = stagingRegion.offset + levelOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.baseArrayLayer = (inAtlas) ? ((uint32_t) textureDescription.atlasLayer) : (0);
+        region.imageSubresource.layerCount = 1;
+        region.imageSubresource.mipLevel = level;
+        region.imageOffset = {(int32_t) (textureDescription.atlasX >> level),
+                              (int32_t) (textureDescription.atlasY >> level), 0};
+        region.imageExtent = {std::max(textureDescription.width >> level, 1u),
+                              std::max(textureDescription.height >> level, 1u), 1};
+
+        levelOffset += getKtx2LevelSize(textureDescription.format, textureDescription.width,
+                                        textureDescription.height, level);
+    }
+
+    vkCmdCopyBufferToImage(getTransferCommandBuffer(), stagingRegion.buffer, textureImage,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, textureDescription.levelCount, regions.data());
+
+    if (!inAtlas)
+        releaseTexture(textureImage, textureDescription.levelCount, 1);
+}
+
+void VulkanEngine::recordTextureTransition(VkImage textureImage, uint32_t levelCount, uint32_t layerCount) {
+    VkImageMemoryBarrier imageMemoryBarrier = {};
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.pNext = nullptr;
+    imageMemoryBarrier.srcAccessMask = 0;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.image = textureImage;
+    imageMemoryBarrier.subresourceRange.layerCount = layerCount;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageMemoryBarrier.subresourceRange.levelCount = levelCount;
+    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+    vkCmdPipelineBarrier(getTransferCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+}
+
+void VulkanEngine::releaseTexture(VkImage textureImage, uint32_t levelCount, uint32_t layerCount) {
+    VkImageMemoryBarrier imageMemoryBarrier = {};
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.pNext = nullptr;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.dstAccessMask = 0;
+    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageMemoryBarrier.image = textureImage;
+    imageMemoryBarrier.subresourceRange.layerCount = layerCount;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageMemoryBarrier.subresourceRange.levelCount = levelCount;
+    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+    if (transferQueueFamilyIndex != graphicsQueueFamilyIndex) {
+        imageMemoryBarrier.srcQueueFamilyIndex = transferQueueFamilyIndex;
+        imageMemoryBarrier.dstQueueFamilyIndex = graphicsQueueFamilyIndex;
+    }
+
+    pendingReleaseImageBarriers.push_back(imageMemoryBarrier);
+}
+
+void VulkanEngine::stageFrameUpload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size) {
+    StagingRegion stagingRegion;
+
+    if (!frameStagingRing.allocate(size, 16, &stagingRegion))
+        throw VulkanException("Frame staging ring is full, too much data streamed per frame.");
+
+    memcpy(stagingRegion.data, data, size);
+
+    PendingBufferCopy pendingCopy;
+    pendingCopy.dstBuffer = dstBuffer;
+    pendingCopy.region.srcOffset = stagingRegion.offset;
+    pendingCopy.region.dstOffset = dstOffset;
+    pendingCopy.region.size = size;
+
+    pendingFrameBufferCopies.push_back(pendingCopy);
+}
+
+void VulkanEngine::setModelMatrix(uint32_t meshIndex, const glm::mat4x4 &matrix) {
+    ModelMatrix<float> meshModelMatrix;
+
+    meshModelMatrix.modelMatrix = matrix;
+
+    stageFrameUpload(uniformBufferDevice, uniformBufferStride * meshIndex, &meshModelMatrix,
+                     sizeof(ModelMatrix<float>));
+}
+
+VkCommandBuffer VulkanEngine::recordFrameUploads() {
+    std::vector<VkBufferMemoryBarrier> acquireBufferBarriers;
+    std::vector<VkImageMemoryBarrier> acquireImageBarriers;
+
+    frameWaitSemaphores.clear();
+    frameWaitStageFlags.clear();
+
+    // Everything the transfer queue handed over since the previous frame is waited on, and acquired, by this one.
+    for (TransferBatch &batch : transferBatches) {
+        if (batch.state != TRANSFER_BATCH_SUBMITTED || !batch.signalsSemaphore)
+            continue;
+
+        frameWaitSemaphores.push_back(batch.semaphore);
+        frameWaitStageFlags.push_back(uploadReadStageFlags | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        acquireBufferBarriers.insert(acquireBufferBarriers.end(), batch.acquireBufferBarriers.begin(),
+                                     batch.acquireBufferBarriers.end());
+        acquireImageBarriers.insert(acquireImageBarriers.end(), batch.acquireImageBarriers.begin(),
+                                    batch.acquireImageBarriers.end());
+
+        batch.state = TRANSFER_BATCH_CONSUMED;
+        batch.consumingFrame = (int32_t) currentFrame;
+    }
+
+    // The pages updateVirtualTexture() bound for this frame are copied into and sampled right away.
+    if (virtualTextureBindPending) {
+        frameWaitSemaphores.push_back(virtualTextureBindSemaphores[currentFrame]);
+        frameWaitStageFlags.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        virtualTextureBindPending = false;
+    }
+
+    bool copying = !pendingFrameBufferCopies.empty() || !pendingFrameImageCopies.empty() ||
+                   !pendingFrameImageBarriers.empty();
+
+    if (!copying && acquireBufferBarriers.empty() && acquireImageBarriers.empty())
+        return VK_NULL_HANDLE;
+
+    VkCommandBuffer commandBuffer = frameUploadCommandBuffers[currentFrame];
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBeginInfo.pNext = nullptr;
+    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+
+    VKASSERT_SUCCESS(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+
+    // Chained to the semaphore waits through their stages. The frame copies below may overwrite acquired buffers.
+    if (!acquireBufferBarriers.empty() || !acquireImageBarriers.empty())
+        vkCmdPipelineBarrier(commandBuffer, uploadReadStageFlags | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             uploadReadStageFlags | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                             (uint32_t) acquireBufferBarriers.size(), acquireBufferBarriers.data(),
+                             (uint32_t) acquireImageBarriers.size(), acquireImageBarriers.data());
+
+    if (!copying) {
+        VKASSERT_SUCCESS(vkEndCommandBuffer(commandBuffer));
+
+        return commandBuffer;
+    }
+
+    // Older frames still in flight on the same queue may be reading what gets overwritten.
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcAccessMask = 0;
+    memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, uploadReadStageFlags, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier,
+                         0, nullptr, (uint32_t) pendingFrameImageBarriers.size(), pendingFrameImageBarriers.data());
+
+    // One copy command per destination buffer, however many writes went into it.
+    std::stable_sort(pendingFrameBufferCopies.begin(), pendingFrameBufferCopies.end(),
+                     [](const PendingBufferCopy &a, const PendingBufferCopy &b) { return a.dstBuffer < b.dstBuffer; });
+
+    std::vector<VkBufferCopy> regions;
+
+    for (size_t i = 0; i < pendingFrameBufferCopies.size(); i++) {
+        regions.push_back(pendingFrameBufferCopies[i].region);
+
+        if (i + 1 == pendingFrameBufferCopies.size() ||
+            pendingFrameBufferCopies[i + 1].dstBuffer != pendingFrameBufferCopies[i].dstBuffer) {
+            vkCmdCopyBuffer(commandBuffer, frameStagingRing.getBuffer(), pendingFrameBufferCopies[i].dstBuffer,
+                            (uint32_t) regions.size(), regions.data());
+
+            regions.clear();
+        }
+    }
+
+    // Only ever into the virtual texture so far, a single copy command.
+    std::stable_sort(pendingFrameImageCopies.begin(), pendingFrameImageCopies.end(),
+                     [](const PendingImageCopy &a, const PendingImageCopy &b) { return a.dstImage < b.dstImage; });
+
+    std::vector<VkBufferImageCopy> imageRegions;
+
+    for (size_t i = 0; i < pendingFrameImageCopies.size(); i++) {
+        imageRegions.push_back(pendingFrameImageCopies[i].region);
+
+        if (i + 1 == pendingFrameImageCopies.size() ||
+            pendingFrameImageCopies[i + 1].dstImage != pendingFrameImageCopies[i].dstImage) {
+            vkCmdCopyBufferToImage(commandBuffer, frameStagingRing.getBuffer(), pendingFrameImageCopies[i].dstImage,
+                                   VK_IMAGE_LAYOUT_GENERAL, (uint32_t) imageRegions.size(), imageRegions.data());
+
+            imageRegions.clear();
+        }
+    }
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                  VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, uploadReadStageFlags, 0, 1, &memoryBarrier,
+                         0, nullptr, 0, nullptr);
+
+    VKASSERT_SUCCESS(vkEndCommandBuffer(commandBuffer));
+
+    pendingFrameBufferCopies.clear();
+    pendingFrameImageCopies.clear();
+    pendingFrameImageBarriers.clear();
+
+    frameStagingRing.flush();
+    frameStagingSubmissions[currentFrame] = frameStagingRing.endSubmission();
+
+    return commandBuffer;
+}
+
+void VulkanEngine::getPhysicalDevicePropertiesAndFeatures() {
+    vkGetPhysicalDeviceProperties(physicalDevices[0], &deviceProperties);
+
+    std::cout << "Highest Supported Vulkan Version:\t" << getVersionString(deviceProperties.apiVersion) << std::endl;
+
+    vkGetPhysicalDeviceFeatures(physicalDevices[0], &supportedDeviceFeatures);
+
+    std::cout << "Supports Tesselation Shader Feature:\t"
+              << ((supportedDeviceFeatures.tessellationShader) ? ("Yes") : ("No")) << std::endl;
+
+    std::cout << "Maximum Supported Image Size:\t" << deviceProperties.limits.maxImageDimension1D << "x"
+              << deviceProperties.limits.maxImageDimension2D << "x" << deviceProperties.limits.maxImageDimension3D
+              << std::endl;
+
+    std::cout << "Minimum Memory Map Alignment:\t" << deviceProperties.limits.minMemoryMapAlignment << std::endl;
+
+    std::cout << "Max Local Working Group Size: " << deviceProperties.limits.maxComputeWorkGroupSize[0] << "x"
+              << deviceProperties.limits.maxComputeWorkGroupSize[1] << "x"
+              << deviceProperties.limits.maxComputeWorkGroupSize[2] << std::endl;
+
+    std::cout << "Max Total Working Group Invocations: " << deviceProperties.limits.maxComputeWorkGroupInvocations
+              << std::endl;
+
+    std::cout << "Max bound descriptor sets in a pipeline layout: " << deviceProperties.limits.maxBoundDescriptorSets
+              << std::endl;
+
+    std::cout << "Minimum Uniform Buffer offest alignment: " << deviceProperties.limits.minUniformBufferOffsetAlignment
+              << std::endl;
+
+    std::cout << "Maximum Texel Buffer elements: " << deviceProperties.limits.maxTexelBufferElements << std::endl;
+
+    std::cout << "Maximum Subpass Color Attachments: " << deviceProperties.limits.maxColorAttachments << std::endl;
+
+    std::cout << "Maximum Framebuffer Width: " << deviceProperties.limits.maxFramebufferWidth << std::endl;
+
+    std::cout << "Maximum Framebuffer Height: " << deviceProperties.limits.maxFramebufferHeight << std::endl;
+
+    std::cout << "Maximum Framebuffer Layers: " << deviceProperties.limits.maxFramebufferLayers << std::endl;
+
+    std::cout << "Maximum Vertex Input bindings: " << deviceProperties.limits.maxVertexInputBindings << std::endl;
+
+    std::cout << "Maximum Vertex Input Attributes: " << deviceProperties.limits.maxVertexInputAttributes << std::endl;
+
+    std::cout << "Maximum Vertex Input Binding Stride: " << deviceProperties.limits.maxVertexInputBindingStride
+              << std::endl;
+
+    std::cout << "Maximum Vertex Input Attribute Offset: " << deviceProperties.limits.maxVertexInputAttributeOffset
+              << std::endl;
+
+    std::cout << "Maximum Viewports: " << deviceProperties.limits.maxViewports << std::endl;
+
+    std::cout << "Minimum Line Width: " << deviceProperties.limits.lineWidthRange[0] << std::endl;
+
+    std::cout << "Maximum Line Width: " << deviceProperties.limits.lineWidthRange[1] << std::endl;
+
+    std::cout << "Line Width Granularity: " << deviceProperties.limits.lineWidthGranularity << std::endl;
+
+    std::cout << "Max Index Value: " << deviceProperties.limits.maxDrawIndexedIndexValue << std::endl;
+
+    std::cout << "Max Geometry Produced Vertices: " << deviceProperties.limits.maxGeometryOutputVertices << std::endl;
+
+    std::cout << "Max Geometry Produced Components: " << deviceProperties.limits.maxGeometryOutputComponents
+              << std::endl;
+
+    std::cout << "Max Geometry Total Produced Components: " << deviceProperties.limits.maxGeometryTotalOutputComponents
+              << std::endl;
+
+    std::cout << "Max Geometry Consumed Components: " << deviceProperties.limits.maxGeometryInputComponents
+              << std::endl;
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevices[0], &deviceMemoryProperties);
+
+    memoryTypeCount = deviceMemoryProperties.memoryTypeCount;
+
+    std::cout << "Memory Type count: " << memoryTypeCount << std::endl;
+
+    std::string flagsString;
+
+    for (int i = 0; i < deviceMemoryProperties.memoryTypeCount; i++) {
+        flagsString = "";
+
+        int heapIndex = deviceMemoryProperties.memoryTypes[i].heapIndex;
 
         if ((deviceMemoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
             hostVisibleMemoryTypeIndex = i;
 
+        if ((deviceMemoryProperties.memoryTypes[i].propertyFlags &
+             (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) ==
+            (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) &&
+            hostCoherentMemoryTypeIndex == -1)
+            hostCoherentMemoryTypeIndex = i;
+
         if ((deviceMemoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
             deviceLocalMemoryTypeIndex = i;
 
@@ -729,6 +1636,9 @@ void VulkanEngine::getPhysicalDevicePropertiesAndFeatures() {
     if (hostVisibleMemoryTypeIndex == -1)
         throw VulkanException("No host visible memory type found.");
 
+    if (hostCoherentMemoryTypeIndex == -1)
+        throw VulkanException("No host coherent memory type found.");
+
     if (deviceLocalMemoryTypeIndex == -1)
         throw VulkanException("No device local memory type found.");
 
@@ -755,21 +1665,44 @@ void VulkanEngine::terminate() {
 
     std::cout << "Texture Sampler destroyed.\n";
 
-    for (uint16_t i = 0; i < cachedScene->mNumMeshes; i++) {
-        vkDestroyBuffer(logicalDevices[0], uniformBuffersDevice[i], nullptr);
-        std::cout << "Buffer destroyed.\n";
+    vkDestroyBuffer(logicalDevices[0], uniformBufferDevice, nullptr);
+    std::cout << "Buffer destroyed.\n";
 
-        vkDestroyBuffer(logicalDevices[0], vertexBuffersDevice[i], nullptr);
-        std::cout << "Buffer destroyed.\n";
+    vkDestroyBuffer(logicalDevices[0], vertexBufferDevice, nullptr);
+    std::cout << "Buffer destroyed.\n";
 
-        vkDestroyBuffer(logicalDevices[0], indexBuffersDevice[i], nullptr);
-        std::cout << "Buffer destroyed.\n";
-    }
+    vkDestroyBuffer(logicalDevices[0], indexBufferDevice, nullptr);
+    std::cout << "Buffer destroyed.\n";
 
-    vkFreeMemory(logicalDevices[0], uniBuffersMemoryDevice, nullptr);
+    memoryAllocator.free(&uniformBufferMemory);
+    memoryAllocator.free(&vertexBufferMemory);
+    memoryAllocator.free(&indexBufferMemory);
     std::cout << "Buffers Memory released.\n";
 
-    for (uint16_t i = 0; i < cachedScene->mNumMeshes; i++) {
+    vkDestroyBuffer(logicalDevices[0], meshletBuffer, nullptr);
+    memoryAllocator.free(&meshletBufferMemory);
+    vkDestroyBuffer(logicalDevices[0], culledIndexBuffer, nullptr);
+    memoryAllocator.free(&culledIndexBufferMemory);
+    vkDestroyBuffer(logicalDevices[0], meshletDrawBuffer, nullptr);
+    memoryAllocator.free(&meshletDrawBufferMemory);
+    std::cout << "Meshlet Buffers destroyed.\n";
+
+    vkDestroyBuffer(logicalDevices[0], viewProjectionBuffer, nullptr);
+    memoryAllocator.free(&viewProjectionBufferMemory);
+    std::cout << "View Projection Buffer destroyed.\n";
+
+    vkDestroyBuffer(logicalDevices[0], virtualTexturePageTableBuffer, nullptr);
+    memoryAllocator.free(&virtualTexturePageTableMemory);
+    vkDestroyBuffer(logicalDevices[0], virtualTextureFeedbackBuffer, nullptr);
+    memoryAllocator.free(&virtualTextureFeedbackMemory);
+
+    for (uint32_t i = 0; i < framesInFlight; i++)
+        if (virtualTextureBindSemaphores[i] != VK_NULL_HANDLE)
+            vkDestroySemaphore(logicalDevices[0], virtualTextureBindSemaphores[i], nullptr);
+
+    std::cout << "Virtual Texture Buffers destroyed.\n";
+
+    for (uint16_t i = 0; i < meshCount; i++) {
         vkDestroyImageView(logicalDevices[0], specTextureViews[i], nullptr);
         std::cout << "Spec ImageView destroyed.\n";
 
@@ -787,15 +1720,31 @@ void VulkanEngine::terminate() {
 
         vkDestroyImage(logicalDevices[0], colorTextureImagesDevice[i], nullptr);
         std::cout << "Color Texture Image destroyed.\n";
+
+        memoryAllocator.free(&specTexturesMemoryDevice[i]);
+        memoryAllocator.free(&normalTexturesMemoryDevice[i]);
+        memoryAllocator.free(&colorTexturesMemoryDevice[i]);
     }
 
-    vkFreeMemory(logicalDevices[0], uniTexturesMemoryDevice, nullptr);
+    vkDestroyImageView(logicalDevices[0], textureAtlasView, nullptr);
+    vkDestroyImage(logicalDevices[0], textureAtlasImage, nullptr);
+    memoryAllocator.free(&textureAtlasMemory);
+
+    vkDestroyImageView(logicalDevices[0], virtualTextureView, nullptr);
+    vkDestroyImage(logicalDevices[0], virtualTextureImage, nullptr);
+    memoryAllocator.free(&virtualTextureMemory);
+
     std::cout << "Textures Memory released.\n";
 
 
     vkDestroyDescriptorSetLayout(logicalDevices[0], graphicsDescriptorSetLayout, nullptr);
     std::cout << "DescriptorSet Layout destroyed successfully." << std::endl;
 
+    vkDestroyDescriptorSetLayout(logicalDevices[0], viewProjectionDescriptorSetLayout, nullptr);
+    std::cout << "DescriptorSet Layout destroyed successfully." << std::endl;
+
+    vkDestroyDescriptorSetLayout(logicalDevices[0], computeDescriptorSetLayout, nullptr);
+
 
     vkDestroyDescriptorPool(logicalDevices[0], descriptorPool, nullptr);
     std::cout << "Descriptor Set Pool destroyed successfully." << std::endl;
@@ -807,7 +1756,7 @@ void VulkanEngine::terminate() {
     vkDestroyImage(logicalDevices[0], depthImage, nullptr);
     std::cout << "Depth-Stencil Image destroyed.\n";
 
-    vkFreeMemory(logicalDevices[0], depthImageMemory, nullptr);
+    memoryAllocator.free(&depthImageMemory);
     std::cout << "Depth-Stencil Image Memory freed.\n";
 
 
@@ -826,29 +1775,65 @@ void VulkanEngine::terminate() {
 
 
     vkDestroyShaderModule(logicalDevices[0], graphicsVertexShaderModule, nullptr);
+    vkDestroyShaderModule(logicalDevices[0], graphicsDepthVertexShaderModule, nullptr);
     vkDestroyShaderModule(logicalDevices[0], graphicsFragmentShaderModule, nullptr);
+    vkDestroyShaderModule(logicalDevices[0], computeShaderModule, nullptr);
 
     std::cout << "Shader modules destroyed successfully." << std::endl;
 
     vkDestroyPipelineLayout(logicalDevices[0], graphicsPipelineLayout, nullptr);
     std::cout << "Graphics Pipeline layout destroyed successfully." << std::endl;
 
+    vkDestroyPipelineLayout(logicalDevices[0], computePipelineLayout, nullptr);
+
     vkDestroyRenderPass(logicalDevices[0], renderPass, nullptr);
     std::cout << "Renderpass destroyed successfully." << std::endl;
 
     vkDestroyPipeline(logicalDevices[0], graphicsPipeline, nullptr);
+    vkDestroyPipeline(logicalDevices[0], graphicsDepthPipeline, nullptr);
+    vkDestroyPipeline(logicalDevices[0], computePipeline, nullptr);
     std::cout << "Pipeline destroyed successfully." << std::endl;
 
+    savePipelineCache();
+
+    vkDestroyPipelineCache(logicalDevices[0], pipelineCache, nullptr);
+    std::cout << "Pipeline Cache destroyed successfully." << std::endl;
+
     for (int i = 0; i < swapchainImagesCount; i++)
         vkDestroyFramebuffer(logicalDevices[0], framebuffers[i], nullptr);
     std::cout << "Framebuffer(s) destroyed successfully." << std::endl;
 
 
-    vkDestroySwapchainKHR(logicalDevices[0], swapchain, nullptr);
-    std::cout << "Swapchain destroyed successfully." << std::endl;
+    if (headless) {
+        for (uint32_t i = 0; i < swapchainImagesCount; i++) {
+            vkDestroyImage(logicalDevices[0], swapchainImages[i], nullptr);
+            memoryAllocator.free(offscreenImagesMemory + i);
+        }
+
+        delete[] offscreenImagesMemory;
+        std::cout << "Offscreen images destroyed successfully." << std::endl;
+    } else {
+        vkDestroySwapchainKHR(logicalDevices[0], swapchain, nullptr);
+        std::cout << "Swapchain destroyed successfully." << std::endl;
+    }
 
     destroySyncMeans();
 
+    for (TransferBatch &batch : transferBatches) {
+        vkDestroyFence(logicalDevices[0], batch.fence, nullptr);
+        vkDestroySemaphore(logicalDevices[0], batch.semaphore, nullptr);
+    }
+
+    std::cout << "Transfer Batches destroyed.\n";
+
+    stagingRing.destroy();
+    frameStagingRing.destroy();
+    std::cout << "Staging Rings destroyed.\n";
+
+    memoryAllocator.dumpStatistics(std::cout);
+    memoryAllocator.destroy();
+    std::cout << "Device Memory Allocator destroyed.\n";
+
     vkDestroyDevice(logicalDevices[0], nullptr);
     std::cout << "Logical Device destroyed.\n";
 
@@ -907,7 +1892,10 @@ void VulkanEngine::createLogicalDevice() {
             graphicsQueueFamilyNumQueue = queueFamilyProperties[i].queueCount;
         }
 
-        if ((queueFamilyProperties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) != 0 && transferQueueFamilyIndex == -1) {
+        // Graphics and compute families copy at any texel offset (an image transfer granularity of 1x1x1).
+        if ((queueFamilyProperties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) != 0 &&
+            (queueFamilyProperties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) != 0 &&
+            transferQueueFamilyIndex == -1) {
             transferQueueFamilyIndex = i;
             transferQueueFamilyNumQueue = queueFamilyProperties[i].queueCount;
         }
@@ -915,6 +1903,23 @@ void VulkanEngine::createLogicalDevice() {
         queueCount += queueFamilyProperties[i].queueCount;
     }
 
+    // Uploads overlap with rendering best on a family of its own (the copy engines), if the device has one. Only
+    // one that copies at any texel offset, atlas regions, their mips and row bands of big levels aren't aligned to
+    // anything coarser.
+    for (uint32_t i = 0; i < numQueueFamilies; i++) {
+        VkQueueFlags queueFlags = queueFamilyProperties[i].queueFlags;
+        VkExtent3D granularity = queueFamilyProperties[i].minImageTransferGranularity;
+
+        if ((queueFlags & VK_QUEUE_TRANSFER_BIT) != 0 &&
+            (queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0 &&
+            queueFamilyProperties[i].queueCount > 0 &&
+            granularity.width == 1 && granularity.height == 1 && granularity.depth == 1) {
+            transferQueueFamilyIndex = i;
+            transferQueueFamilyNumQueue = queueFamilyProperties[i].queueCount;
+            break;
+        }
+    }
+
     if (graphicsQueueFamilyIndex == -1 || graphicsQueueFamilyNumQueue == 0) {
         throw VulkanException("Cannot find queue family that supports graphics.");
     }
@@ -933,8 +1938,9 @@ void VulkanEngine::createLogicalDevice() {
     deviceQueueCreateInfos[0].queueCount = graphicsQueueFamilyNumQueue;
     float *graphicsQueuePriorities = new float[graphicsQueueFamilyNumQueue];
 
+    // Queue 0 renders, queue 1 (if any, and no dedicated transfer family) uploads in the background.
     for (int i = 0; i < graphicsQueueFamilyNumQueue; i++)
-        graphicsQueuePriorities[i] = (i == 1) ? (1.0f) : (0.0f);
+        graphicsQueuePriorities[i] = (i == 0) ? (1.0f) : (0.0f);
 
     deviceQueueCreateInfos[0].pQueuePriorities = graphicsQueuePriorities;
 
@@ -947,258 +1953,198 @@ void VulkanEngine::createLogicalDevice() {
     float *transferQueuePriorities = new float[transferQueueFamilyNumQueue];
 
     for (int i = 0; i < transferQueueFamilyNumQueue; i++)
-        transferQueuePriorities[i] = (i == 1) ? (1.0f) : (0.0f);
+        transferQueuePriorities[i] = (i == 0) ? (1.0f) : (0.0f);
 
     deviceQueueCreateInfos[1].pQueuePriorities = transferQueuePriorities;
 
 
-    std::vector<const char *> extensionNames = {"VK_KHR_swapchain"};
+    std::vector<const char *> extensionNames;
 
-    desiredDeviceFeatures.geometryShader = VK_TRUE;
-
-    logicalDeviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    logicalDeviceCreateInfo.flags = 0;
-    logicalDeviceCreateInfo.pNext = nullptr;
-    logicalDeviceCreateInfo.queueCreateInfoCount = (deviceQueueCreateInfos[1].queueFamilyIndex ==
-                                                    deviceQueueCreateInfos[0].queueFamilyIndex) ? (1) : (2);
-    logicalDeviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfos;
-    logicalDeviceCreateInfo.enabledExtensionCount = 1;
-    logicalDeviceCreateInfo.enabledLayerCount = 0;
-    logicalDeviceCreateInfo.ppEnabledExtensionNames = extensionNames.data();
-    logicalDeviceCreateInfo.ppEnabledLayerNames = nullptr;
-    logicalDeviceCreateInfo.pEnabledFeatures = &desiredDeviceFeatures;
-
-
-    if (vkCreateDevice(physicalDevices[0], &logicalDeviceCreateInfo, nullptr, logicalDevices) == VK_SUCCESS) {
-        std::cout << "Logical device creation succeeded.\n";
-    } else {
-        throw VulkanException("Logical Device creation failed.\n");
-    }
-
-    delete transferQueuePriorities;
-    delete graphicsQueuePriorities;
-}
-
-void VulkanEngine::createAllBuffers() {
-    uint32_t lastCoveredSizeDevice = 0;
-    uint32_t lastCoveredSize = 0;
-
-    uniformBuffersBindOffsetsDevice = new VkDeviceSize[cachedScene->mNumMeshes];
-    vertexBuffersBindOffsetsDevice = new VkDeviceSize[cachedScene->mNumMeshes];
-    indexBuffersBindOffsetsDevice = new VkDeviceSize[cachedScene->mNumMeshes];
-
-    uniformBuffersBindOffsets = new VkDeviceSize[cachedScene->mNumMeshes];
-    vertexBuffersBindOffsets = new VkDeviceSize[cachedScene->mNumMeshes];
-    indexBuffersBindOffsets = new VkDeviceSize[cachedScene->mNumMeshes];
-
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        uint32_t requiredPaddingDevice = 0;
-        uint32_t requiredPadding = 0;
-
-
-        VkDeviceSize uniformBufferMemoryOffset;
-        VkDeviceSize uniformBufferMemorySize;
-        VkDeviceSize vertexBufferMemoryOffset;
-        VkDeviceSize vertexBufferMemorySize;
-        VkDeviceSize indexBufferMemoryOffset;
-        VkDeviceSize indexBufferMemorySize;
-
-        VkDeviceSize uniformBufferMemoryOffsetDevice;
-        VkDeviceSize uniformBufferMemorySizeDevice;
-        VkDeviceSize vertexBufferMemoryOffsetDevice;
-        VkDeviceSize vertexBufferMemorySizeDevice;
-        VkDeviceSize indexBufferMemoryOffsetDevice;
-        VkDeviceSize indexBufferMemorySizeDevice;
-
-        VkMemoryRequirements uniformBufferDeviceMemoryRequirements = createBuffer(uniformBuffersDevice + meshIndex,
-                                                                                  totalUniformBufferSize,
-                                                                                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
-                                                                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-        VkMemoryRequirements vertexBufferDeviceMemoryRequirements = createBuffer(vertexBuffersDevice + meshIndex,
-                                                                                 vertexBuffersSizes[meshIndex],
-                                                                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                                                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-        VkMemoryRequirements indexBufferDeviceMemoryRequirements = createBuffer(indexBuffersDevice + meshIndex,
-                                                                                indexBuffersSizes[meshIndex],
-                                                                                VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                                                                                VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-        VkMemoryRequirements uniformBufferMemoryRequirements = createBuffer(uniformBuffers + meshIndex,
-                                                                            totalUniformBufferSize,
-                                                                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
-                                                                            VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-        VkMemoryRequirements vertexBufferMemoryRequirements = createBuffer(vertexBuffers + meshIndex,
-                                                                           vertexBuffersSizes[meshIndex],
-                                                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                                                                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-        VkMemoryRequirements indexBufferMemoryRequirements = createBuffer(indexBuffers + meshIndex,
-                                                                          indexBuffersSizes[meshIndex],
-                                                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                                                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-
-        if (meshIndex == 0) {
-            uniformBufferMemoryOffsetDevice = 0;
-            uniformBuffersBindOffsetsDevice[meshIndex] = uniformBufferMemoryOffsetDevice;
-            uniformBufferMemorySizeDevice = totalUniformBufferSize;
-
-            lastCoveredSizeDevice += uniformBufferMemoryOffsetDevice + uniformBufferMemorySizeDevice;
-
-            uniformBufferMemoryOffset = 0;
-            uniformBuffersBindOffsets[meshIndex] = uniformBufferMemoryOffset;
-            uniformBufferMemorySize = totalUniformBufferSize;
-
-            lastCoveredSize += uniformBufferMemoryOffset + uniformBufferMemorySize;
-        } else {
-            requiredPaddingDevice = uniformBufferDeviceMemoryRequirements.alignment -
-                                    (lastCoveredSizeDevice % uniformBufferDeviceMemoryRequirements.alignment);
-
-            if (requiredPaddingDevice == uniformBufferDeviceMemoryRequirements.alignment)
-                requiredPaddingDevice = 0;
-
-            uniformBufferMemoryOffsetDevice = lastCoveredSizeDevice + requiredPaddingDevice;
-            uniformBuffersBindOffsetsDevice[meshIndex] = uniformBufferMemoryOffsetDevice;
-            uniformBufferMemorySizeDevice = totalUniformBufferSize;
-
-            lastCoveredSizeDevice += requiredPaddingDevice + uniformBufferMemorySizeDevice;
-
-
-            requiredPadding = uniformBufferMemoryRequirements.alignment -
-                              (lastCoveredSize % uniformBufferMemoryRequirements.alignment);
-
-            if (requiredPadding == uniformBufferMemoryRequirements.alignment)
-                requiredPadding = 0;
-
-            uniformBufferMemoryOffset = lastCoveredSize + requiredPadding;
-            uniformBuffersBindOffsets[meshIndex] = uniformBufferMemoryOffset;
-            uniformBufferMemorySize = totalUniformBufferSize;
-
-            lastCoveredSize += requiredPadding + uniformBufferMemorySize;
-        }
-
-        requiredPaddingDevice = vertexBufferDeviceMemoryRequirements.alignment -
-                                (lastCoveredSizeDevice % vertexBufferDeviceMemoryRequirements.alignment);
-
-        if (requiredPaddingDevice == vertexBufferDeviceMemoryRequirements.alignment)
-            requiredPaddingDevice = 0;
-
-        vertexBufferMemoryOffsetDevice = lastCoveredSizeDevice + requiredPaddingDevice;
-        vertexBuffersBindOffsetsDevice[meshIndex] = vertexBufferMemoryOffsetDevice;
-        vertexBufferMemorySizeDevice = vertexBuffersSizes[meshIndex];
-
-        lastCoveredSizeDevice += requiredPaddingDevice + vertexBufferMemorySizeDevice;
-
-        requiredPaddingDevice = indexBufferDeviceMemoryRequirements.alignment -
-                                (lastCoveredSizeDevice % indexBufferDeviceMemoryRequirements.alignment);
-
-        if (requiredPaddingDevice == indexBufferDeviceMemoryRequirements.alignment)
-            requiredPaddingDevice = 0;
-
-        indexBufferMemoryOffsetDevice = lastCoveredSizeDevice + requiredPaddingDevice;
-        indexBuffersBindOffsetsDevice[meshIndex] = indexBufferMemoryOffsetDevice;
-        indexBufferMemorySizeDevice = indexBuffersSizes[meshIndex];
-
-        lastCoveredSizeDevice += requiredPaddingDevice + indexBufferMemorySizeDevice;
+    if (!headless)
+        extensionNames.push_back("VK_KHR_swapchain");
 
+    desiredDeviceFeatures.geometryShader = VK_TRUE;
 
-        requiredPadding =
-                vertexBufferMemoryRequirements.alignment - (lastCoveredSize % vertexBufferMemoryRequirements.alignment);
+    // The shaders pick their textures out of one array with a per-draw index.
+    if (supportedDeviceFeatures.shaderSampledImageArrayDynamicIndexing != VK_TRUE)
+        throw VulkanException("Device can't index sampled image arrays dynamically.");
 
-        if (requiredPadding == vertexBufferMemoryRequirements.alignment)
-            requiredPadding = 0;
+    desiredDeviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    // Textures fall back to the uncompressed PNGs without it.
+    desiredDeviceFeatures.textureCompressionBC = supportedDeviceFeatures.textureCompressionBC;
 
-        vertexBufferMemoryOffset = lastCoveredSize + requiredPadding;
-        vertexBuffersBindOffsets[meshIndex] = vertexBufferMemoryOffset;
-        vertexBufferMemorySize = vertexBuffersSizes[meshIndex];
+    // The fragment shader writes the virtual texture feedback.
+    if (settings.virtualTexturing && supportedDeviceFeatures.fragmentStoresAndAtomics != VK_TRUE) {
+        std::cout << "Virtual texturing disabled, fragment shaders can't write storage buffers." << std::endl;
 
-        lastCoveredSize += requiredPadding + vertexBufferMemorySize;
+        settings.virtualTexturing = false;
+    }
 
-        requiredPadding =
-                indexBufferMemoryRequirements.alignment - (lastCoveredSize % indexBufferMemoryRequirements.alignment);
+    desiredDeviceFeatures.fragmentStoresAndAtomics = (settings.virtualTexturing) ? (VK_TRUE) : (VK_FALSE);
 
-        if (requiredPadding == indexBufferMemoryRequirements.alignment)
-            requiredPadding = 0;
+    // Pages are bound on the graphics queue, between the frames sampling them. Without sparse residency they're
+    // copied into a cache image instead.
+    virtualTextureSparse = settings.virtualTexturing &&
+                           (queueFamilyProperties[graphicsQueueFamilyIndex].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) !=
+                           0 && supportedDeviceFeatures.sparseBinding == VK_TRUE &&
+                           supportedDeviceFeatures.sparseResidencyImage2D == VK_TRUE &&
+                           deviceProperties.limits.maxImageDimension2D >= VIRTUAL_TEXTURE_SIZE &&
+                           getPhysicalDeviceSparseImageFormatProperties();
 
-        indexBufferMemoryOffset = lastCoveredSize + requiredPadding;
-        indexBuffersBindOffsets[meshIndex] = indexBufferMemoryOffset;
-        indexBufferMemorySize = indexBuffersSizes[meshIndex];
+    desiredDeviceFeatures.sparseBinding = (virtualTextureSparse) ? (VK_TRUE) : (VK_FALSE);
+    desiredDeviceFeatures.sparseResidencyImage2D = (virtualTextureSparse) ? (VK_TRUE) : (VK_FALSE);
 
-        lastCoveredSize += requiredPadding + indexBufferMemorySize;
+    // Culling is dispatched on the graphics queue, right before the draws. Those are indirect then, with the first
+    // instance still picking the mesh.
+    if (settings.meshletCulling &&
+        ((queueFamilyProperties[graphicsQueueFamilyIndex].queueFlags & VK_QUEUE_COMPUTE_BIT) == 0 ||
+         supportedDeviceFeatures.drawIndirectFirstInstance != VK_TRUE)) {
+        std::cout << "Meshlet culling disabled, the graphics queue can't dispatch it or draw its output." << std::endl;
 
+        settings.meshletCulling = false;
     }
 
-    VkDeviceSize totalRequiredMemorySizeDevice = lastCoveredSizeDevice;
-    VkDeviceSize totalRequiredMemorySize = lastCoveredSize;
+    desiredDeviceFeatures.drawIndirectFirstInstance = (settings.meshletCulling) ? (VK_TRUE) : (VK_FALSE);
+    // Every mesh in a single draw call where supported, else a call each.
+    desiredDeviceFeatures.multiDrawIndirect = (settings.meshletCulling) ? (supportedDeviceFeatures.multiDrawIndirect)
+                                                                        : (VK_FALSE);
+
+    logicalDeviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    logicalDeviceCreateInfo.flags = 0;
+    logicalDeviceCreateInfo.pNext = nullptr;
+    logicalDeviceCreateInfo.queueCreateInfoCount = (deviceQueueCreateInfos[1].queueFamilyIndex ==
+                                                    deviceQueueCreateInfos[0].queueFamilyIndex) ? (1) : (2);
+    logicalDeviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfos;
+    logicalDeviceCreateInfo.enabledExtensionCount = (uint32_t) extensionNames.size();
+    logicalDeviceCreateInfo.enabledLayerCount = 0;
+    logicalDeviceCreateInfo.ppEnabledExtensionNames = extensionNames.data();
+    logicalDeviceCreateInfo.ppEnabledLayerNames = nullptr;
+    logicalDeviceCreateInfo.pEnabledFeatures = &desiredDeviceFeatures;
 
-    VkMemoryAllocateInfo uniMemoryAllocateInfo = {};
-    uniMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    uniMemoryAllocateInfo.pNext = nullptr;
-    uniMemoryAllocateInfo.allocationSize = totalRequiredMemorySize;
-    uniMemoryAllocateInfo.memoryTypeIndex = hostVisibleMemoryTypeIndex;
 
-    VKASSERT_SUCCESS(vkAllocateMemory(logicalDevices[0], &uniMemoryAllocateInfo, nullptr, &uniBuffersMemory));
+    if (vkCreateDevice(physicalDevices[0], &logicalDeviceCreateInfo, nullptr, logicalDevices) == VK_SUCCESS) {
+        std::cout << "Logical device creation succeeded.\n";
+    } else {
+        throw VulkanException("Logical Device creation failed.\n");
+    }
 
-    uniMemoryAllocateInfo.allocationSize = totalRequiredMemorySizeDevice;
-    uniMemoryAllocateInfo.memoryTypeIndex = deviceLocalMemoryTypeIndex;
+    delete transferQueuePriorities;
+    delete graphicsQueuePriorities;
+}
 
-    VKASSERT_SUCCESS(vkAllocateMemory(logicalDevices[0], &uniMemoryAllocateInfo, nullptr, &uniBuffersMemoryDevice));
+void VulkanEngine::createAllBuffers() {
+    // Every mesh lives in the same vertex, index and uniform buffer. A mesh is only a region of them, so drawing
+    // needs no rebinds (but of the index type) and the number of meshes doesn't change the number of buffers.
+    uint32_t totalVertexCount = 0;
+    uint32_t shortIndexCount = 0;
+    uint32_t shortIndexMeshCount = 0;
+
+    // Indices are relative to vertexOffset, a mesh of up to 65536 vertices gets by with 16 bits. Those meshes come
+    // first in the index buffer, the 32 bit indices of the others follow, 4 byte aligned.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        meshRegions[meshIndex].indexCount = meshData[meshIndex].indexCount;
+        meshRegions[meshIndex].vertexOffset = (int32_t) totalVertexCount;
+        meshRegions[meshIndex].vertexCount = meshData[meshIndex].vertexCount;
+        meshRegions[meshIndex].indexType = (meshRegions[meshIndex].vertexCount <= 65536) ? (VK_INDEX_TYPE_UINT16)
+                                                                                          : (VK_INDEX_TYPE_UINT32);
+
+        if (meshRegions[meshIndex].indexType == VK_INDEX_TYPE_UINT16) {
+            meshRegions[meshIndex].firstIndex = shortIndexCount;
+
+            shortIndexCount += meshRegions[meshIndex].indexCount;
+            shortIndexMeshCount++;
+        }
 
-    void *mappedMemory = NULL;
+        totalVertexCount += meshRegions[meshIndex].vertexCount;
+    }
 
-    VKASSERT_SUCCESS(vkMapMemory(logicalDevices[0], uniBuffersMemory, 0, VK_WHOLE_SIZE, 0, &mappedMemory));
+    uint32_t totalIndexCount = (shortIndexCount + 1) / 2;
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        modelMatrix.modelMatrix = glm::mat4x4(1.0f);
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        if (meshRegions[meshIndex].indexType == VK_INDEX_TYPE_UINT32) {
+            meshRegions[meshIndex].firstIndex = totalIndexCount;
 
-        memcpy((byte *) mappedMemory + uniformBuffersBindOffsetsDevice[meshIndex], &modelMatrix,
-               totalUniformBufferSize);
+            totalIndexCount += meshRegions[meshIndex].indexCount;
+        }
+    }
 
-        memoryFlushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        memoryFlushRange.pNext = nullptr;
-        memoryFlushRange.size = totalUniformBufferSize;
-        memoryFlushRange.offset = uniformBuffersBindOffsetsDevice[meshIndex];
-        memoryFlushRange.memory = uniBuffersMemory;
+    // The position dequantization and texture regions of a mesh follow its model matrix. The buffer is bound once for
+    // all meshes, so the stride only has to match the std430 array in the shaders.
+    positionDequantizationOffset = sizeof(ModelMatrix<float>);
+    meshTextureRegionsOffset = positionDequantizationOffset + sizeof(PositionDequantization);
+    uniformBufferStride = meshTextureRegionsOffset + sizeof(MeshTextureRegions);
 
-        VKASSERT_SUCCESS(vkFlushMappedMemoryRanges(logicalDevices[0], 1, &memoryFlushRange));
+    // Identity until quantizeVertices() replaces it.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++)
+        positionDequantizations[meshIndex] = {{0.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f, 1.0f}};
 
-        memcpy((byte *) mappedMemory + vertexBuffersBindOffsetsDevice[meshIndex], sortedAttributes[meshIndex].data(),
-               vertexBuffersSizes[meshIndex]);
+    if (settings.quantizedVertices) {
+        positionStride = sizeof(VertexPosition<QuantizedVertex>);
+        attributeStride = sizeof(VertexAttributes<QuantizedVertex>);
+    } else {
+        positionStride = sizeof(VertexPosition<float>);
+        attributeStride = sizeof(VertexAttributes<float>);
+    }
 
-        memoryFlushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        memoryFlushRange.pNext = nullptr;
-        memoryFlushRange.size = vertexBuffersSizes[meshIndex];
-        memoryFlushRange.offset = vertexBuffersBindOffsetsDevice[meshIndex];
-        memoryFlushRange.memory = uniBuffersMemory;
+    attributeStreamOffset = alignDeviceSize(positionStride * (VkDeviceSize) totalVertexCount, 16);
+    vertexBufferSize = attributeStreamOffset + attributeStride * (VkDeviceSize) totalVertexCount;
+    indexBufferSize = sizeof(uint32_t) * (VkDeviceSize) totalIndexCount;
+    uniformBufferSize = uniformBufferStride * meshCount;
+
+    createBuffer(&vertexBufferDevice, vertexBufferSize,
+                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    // The culling pass reads the indices as a storage buffer.
+    createBuffer(&indexBufferDevice, indexBufferSize,
+                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                 ((settings.meshletCulling) ? (VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) : (0)));
+    createBuffer(&uniformBufferDevice, uniformBufferSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    memoryAllocator.allocateBufferMemory(vertexBufferDevice, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         &vertexBufferMemory);
+    memoryAllocator.allocateBufferMemory(indexBufferDevice, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &indexBufferMemory);
+    memoryAllocator.allocateBufferMemory(uniformBufferDevice, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         &uniformBufferMemory);
+
+    std::cout << "Buffers created successfully (" << shortIndexMeshCount << " of " << meshCount
+              << " meshes with 16 bit indices, " << indexBufferSize << " index bytes)." << std::endl;
+
+    if (!settings.meshletCulling)
+        return;
 
-        VKASSERT_SUCCESS(vkFlushMappedMemoryRanges(logicalDevices[0], 1, &memoryFlushRange));
+    // Room for every triangle of a mesh in its region of the culled index buffer, its draw starts there and counts
+    // only what the culling pass wrote.
+    uint32_t culledIndexCount = 0;
 
-        memcpy((byte *) mappedMemory + indexBuffersBindOffsetsDevice[meshIndex], sortedIndices[meshIndex].data(),
-               indexBuffersSizes[meshIndex]);
+    totalMeshletCount = 0;
+    meshletDraws.resize(meshCount);
 
-        memoryFlushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        memoryFlushRange.pNext = nullptr;
-        memoryFlushRange.size = indexBuffersSizes[meshIndex];
-        memoryFlushRange.offset = indexBuffersBindOffsetsDevice[meshIndex];
-        memoryFlushRange.memory = uniBuffersMemory;
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        meshletDraws[meshIndex].indexCount = 0;
+        meshletDraws[meshIndex].instanceCount = 1;
+        meshletDraws[meshIndex].firstIndex = culledIndexCount;
+        meshletDraws[meshIndex].vertexOffset = meshRegions[meshIndex].vertexOffset;
+        meshletDraws[meshIndex].firstInstance = meshIndex;
 
-        VKASSERT_SUCCESS(vkFlushMappedMemoryRanges(logicalDevices[0], 1, &memoryFlushRange));
+        culledIndexCount += meshRegions[meshIndex].indexCount;
+        totalMeshletCount += (uint32_t) meshlets[meshIndex].size();
     }
 
-    vkUnmapMemory(logicalDevices[0], uniBuffersMemory);
-
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        VKASSERT_SUCCESS(vkBindBufferMemory(logicalDevices[0], uniformBuffers[meshIndex], uniBuffersMemory,
-                                            uniformBuffersBindOffsets[meshIndex]));
-        VKASSERT_SUCCESS(vkBindBufferMemory(logicalDevices[0], vertexBuffers[meshIndex], uniBuffersMemory,
-                                            vertexBuffersBindOffsets[meshIndex]));
-        VKASSERT_SUCCESS(vkBindBufferMemory(logicalDevices[0], indexBuffers[meshIndex], uniBuffersMemory,
-                                            indexBuffersBindOffsets[meshIndex]));
-
-        VKASSERT_SUCCESS(vkBindBufferMemory(logicalDevices[0], uniformBuffersDevice[meshIndex], uniBuffersMemoryDevice,
-                                            uniformBuffersBindOffsetsDevice[meshIndex]));
-        VKASSERT_SUCCESS(vkBindBufferMemory(logicalDevices[0], vertexBuffersDevice[meshIndex], uniBuffersMemoryDevice,
-                                            vertexBuffersBindOffsetsDevice[meshIndex]));
-        VKASSERT_SUCCESS(vkBindBufferMemory(logicalDevices[0], indexBuffersDevice[meshIndex], uniBuffersMemoryDevice,
-                                            indexBuffersBindOffsetsDevice[meshIndex]));
-    }
+    createBuffer(&meshletBuffer, sizeof(MeshletDescription) * (VkDeviceSize) std::max(totalMeshletCount, 1u),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    createBuffer(&culledIndexBuffer, sizeof(uint32_t) * (VkDeviceSize) std::max(culledIndexCount, 1u),
+                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    createBuffer(&meshletDrawBuffer, sizeof(VkDrawIndexedIndirectCommand) * (VkDeviceSize) meshCount,
+                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    memoryAllocator.allocateBufferMemory(meshletBuffer, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &meshletBufferMemory);
+    memoryAllocator.allocateBufferMemory(culledIndexBuffer, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         &culledIndexBufferMemory);
+    memoryAllocator.allocateBufferMemory(meshletDrawBuffer, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         &meshletDrawBufferMemory);
+
+    std::cout << "Meshlet Buffers created successfully (" << totalMeshletCount << " meshlets)." << std::endl;
 }
 
 void VulkanEngine::createDepthImageAndImageview() {
@@ -1208,8 +2154,8 @@ void VulkanEngine::createDepthImageAndImageview() {
     imageCreateInfo.flags = 0;
     imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
     imageCreateInfo.format = depthFormat;
-    imageCreateInfo.extent.width = swapchainCreateInfo.imageExtent.width;
-    imageCreateInfo.extent.height = swapchainCreateInfo.imageExtent.height;
+    imageCreateInfo.extent.width = renderExtent.width;
+    imageCreateInfo.extent.height = renderExtent.height;
     imageCreateInfo.extent.depth = 1;
     imageCreateInfo.arrayLayers = 1;
     imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -1223,20 +2169,8 @@ void VulkanEngine::createDepthImageAndImageview() {
 
     VKASSERT_SUCCESS(vkCreateImage(logicalDevices[0], &imageCreateInfo, nullptr, &depthImage));
 
-    VkMemoryRequirements depthImageMemoryRequirements;
-
-    vkGetImageMemoryRequirements(logicalDevices[0], depthImage, &depthImageMemoryRequirements);
-
-    VkMemoryAllocateInfo depthImageMemoryAllocateInfo = {};
-
-    depthImageMemoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    depthImageMemoryAllocateInfo.pNext = nullptr;
-    depthImageMemoryAllocateInfo.allocationSize = depthImageMemoryRequirements.size;
-    depthImageMemoryAllocateInfo.memoryTypeIndex = deviceLocalMemoryTypeIndex;
-
-    VKASSERT_SUCCESS(vkAllocateMemory(logicalDevices[0], &depthImageMemoryAllocateInfo, nullptr, &depthImageMemory));
-
-    VKASSERT_SUCCESS(vkBindImageMemory(logicalDevices[0], depthImage, depthImageMemory, 0));
+    memoryAllocator.allocateImageMemory(depthImage, VK_IMAGE_TILING_OPTIMAL, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                        &depthImageMemory);
 
     VkImageViewCreateInfo depthImageViewCreateInfo = {};
 
@@ -1603,48 +2537,48 @@ void VulkanEngine::createDepthImageAndImageview() {
 //	}
 //}
 
-void VulkanEngine::createSparseImage() {
+bool VulkanEngine::createSparseImage(uint32_t slotCount) {
     sparseImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     sparseImageCreateInfo.pNext = nullptr;
     sparseImageCreateInfo.flags = VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT | VK_IMAGE_CREATE_SPARSE_BINDING_BIT;
     sparseImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-    sparseImageCreateInfo.format = VK_FORMAT_R32G32B32A32_UINT;
-    sparseImageCreateInfo.extent.width = 4096;
-    sparseImageCreateInfo.extent.height = 4096;
+    sparseImageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    sparseImageCreateInfo.extent.width = VIRTUAL_TEXTURE_SIZE;
+    sparseImageCreateInfo.extent.height = VIRTUAL_TEXTURE_SIZE;
     sparseImageCreateInfo.extent.depth = 1;
     sparseImageCreateInfo.arrayLayers = 1;
     sparseImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     sparseImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    sparseImageCreateInfo.usage =
-            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    sparseImageCreateInfo.mipLevels = imageFormatProperties.maxMipLevels;
+    sparseImageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    sparseImageCreateInfo.mipLevels = VIRTUAL_TEXTURE_LEVELS;
     sparseImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     sparseImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     sparseImageCreateInfo.queueFamilyIndexCount = 0;
     sparseImageCreateInfo.pQueueFamilyIndices = nullptr;
 
-    sparseImages = new VkImage[1];
-
-    VkResult result = vkCreateImage(logicalDevices[0], &sparseImageCreateInfo, nullptr, sparseImages);
+    VkResult result = vkCreateImage(logicalDevices[0], &sparseImageCreateInfo, nullptr, &virtualTextureImage);
 
     switch (result) {
         case VK_SUCCESS:
-            std::cout << "Sparse Image (" << 2048 << "x" << 2048
-                      << ", with different other parameters) created successfully.\n";
+            std::cout << "Sparse Image (" << VIRTUAL_TEXTURE_SIZE << "x" << VIRTUAL_TEXTURE_SIZE << ", "
+                      << VIRTUAL_TEXTURE_LEVELS << " levels) created successfully.\n";
             break;
         default:
             throw VulkanException("Sparse Image creation failed.");
     }
 
-    vkGetImageSparseMemoryRequirements(logicalDevices[0], sparseImages[0], &sparseMemoryRequirementsCount, nullptr);
+    vkGetImageSparseMemoryRequirements(logicalDevices[0], virtualTextureImage, &sparseMemoryRequirementsCount, nullptr);
 
     sparseImageMemoryRequirements = new VkSparseImageMemoryRequirements[sparseMemoryRequirementsCount];
 
-    vkGetImageSparseMemoryRequirements(logicalDevices[0], sparseImages[0], &sparseMemoryRequirementsCount,
+    vkGetImageSparseMemoryRequirements(logicalDevices[0], virtualTextureImage, &sparseMemoryRequirementsCount,
                                        sparseImageMemoryRequirements);
 
     std::cout << "Sparse Image Memory Requirements:\n";
 
+    // Every level has to be made of whole pages, none may be in the mip tail, which is bound as a whole.
+    bool pagesBindable = false;
+
     for (uint32_t i = 0; i < sparseMemoryRequirementsCount; i++) {
         VkSparseImageMemoryRequirements sparseImageMemoryRequirementsElement = sparseImageMemoryRequirements[i];
 
@@ -1702,13 +2636,48 @@ void VulkanEngine::createSparseImage() {
         std::cout << "\tFirst Mip-Tail Stride (between deviant miptails of array): "
                   << sparseImageMemoryRequirementsElement.imageMipTailStride << std::endl;
 
+        if ((sparseImageMemoryRequirementsElement.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) != 0)
+            pagesBindable = sparseImageMemoryRequirementsElement.formatProperties.imageGranularity.width ==
+                            VIRTUAL_TEXTURE_PAGE_SIZE &&
+                            sparseImageMemoryRequirementsElement.formatProperties.imageGranularity.height ==
+                            VIRTUAL_TEXTURE_PAGE_SIZE &&
+                            sparseImageMemoryRequirementsElement.imageMipTailFirstLod >= VIRTUAL_TEXTURE_LEVELS;
+
+        // Metadata would have to be bound too.
+        if ((sparseImageMemoryRequirementsElement.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) != 0) {
+            pagesBindable = false;
+            break;
+        }
+    }
+
+    delete[] sparseImageMemoryRequirements;
+    sparseImageMemoryRequirements = nullptr;
+
+    VkMemoryRequirements memoryRequirements;
+
+    vkGetImageMemoryRequirements(logicalDevices[0], virtualTextureImage, &memoryRequirements);
+
+    // A page is a single sparse block, bound at a multiple of the alignment within one allocation for all slots.
+    VkDeviceSize pageBytes = (VkDeviceSize) VIRTUAL_TEXTURE_PAGE_SIZE * VIRTUAL_TEXTURE_PAGE_SIZE * 4;
+
+    if (!pagesBindable || pageBytes % memoryRequirements.alignment != 0) {
+        vkDestroyImage(logicalDevices[0], virtualTextureImage, nullptr);
+        virtualTextureImage = VK_NULL_HANDLE;
+
+        return false;
     }
+
+    memoryRequirements.size = pageBytes * slotCount;
+
+    memoryAllocator.allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, MEMORY_RESOURCE_OPTIMAL,
+                             &virtualTextureMemory);
+
+    return true;
 }
 
-void VulkanEngine::getPhysicalDeviceSparseImageFormatProperties() {
-    VkImageUsageFlags usageFlags =
-            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    VkFormat format = VK_FORMAT_R16G16B16A16_UNORM;
+bool VulkanEngine::getPhysicalDeviceSparseImageFormatProperties() {
+    VkImageUsageFlags usageFlags = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
     VkSampleCountFlagBits samplesCount = VK_SAMPLE_COUNT_1_BIT;
     VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL;
     VkImageType type = VK_IMAGE_TYPE_2D;
@@ -1724,7 +2693,9 @@ void VulkanEngine::getPhysicalDeviceSparseImageFormatProperties() {
                                                    physicalDeviceSparseImageFormatProperties);
 
     std::cout
-            << "Physical Device support extent pertaining to sparse image format VK_FORMAT_R16G16B16A16_UNORM(2D) with optimal tiling usable as source and destination of transfer commands, as well as sampling, and allowing image view creation off itself, with one multisampling:\n";
+            << "Physical Device support extent pertaining to sparse image format VK_FORMAT_R8G8B8A8_UNORM(2D) with optimal tiling usable as destination of transfer commands, as well as sampling, with one multisampling:\n";
+
+    bool pageGranularity = false;
 
     for (uint32_t i = 0; i < physicalDeviceSparseImageFormatPropertiesCount; i++) {
 
@@ -1771,7 +2742,17 @@ void VulkanEngine::getPhysicalDeviceSparseImageFormatProperties() {
         }
 
         std::cout << "\tFlags: " << flagsString << std::endl;
+
+        if ((physicalDeviceSparseImageFormatProperties[i].aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) != 0 &&
+            physicalDeviceSparseImageFormatProperties[i].imageGranularity.width == VIRTUAL_TEXTURE_PAGE_SIZE &&
+            physicalDeviceSparseImageFormatProperties[i].imageGranularity.height == VIRTUAL_TEXTURE_PAGE_SIZE)
+            pageGranularity = true;
     }
+
+    delete[] physicalDeviceSparseImageFormatProperties;
+    physicalDeviceSparseImageFormatProperties = nullptr;
+
+    return pageGranularity;
 }
 
 void VulkanEngine::getQueues() {
@@ -1783,7 +2764,11 @@ void VulkanEngine::getQueues() {
         std::cout << "Graphics Queue obtained successfully.\n";
     }
 
-    vkGetDeviceQueue(logicalDevices[0], transferQueueFamilyIndex, 0, &transferQueue);
+    // A second queue of the graphics family still lets uploads run alongside the frames.
+    uint32_t transferQueueIndex = (transferQueueFamilyIndex == graphicsQueueFamilyIndex &&
+                                   graphicsQueueFamilyNumQueue > 1) ? (1) : (0);
+
+    vkGetDeviceQueue(logicalDevices[0], transferQueueFamilyIndex, transferQueueIndex, &transferQueue);
 
     if (transferQueue == VK_NULL_HANDLE) {
         throw "Couldn't obtain transfer queue from device.";
@@ -1793,13 +2778,18 @@ void VulkanEngine::getQueues() {
 }
 
 void VulkanEngine::getQueueFamilyPresentationSupport() {
+#ifdef _WIN32
     if (vkGetPhysicalDeviceWin32PresentationSupportKHR(physicalDevices[0], graphicsQueueFamilyIndex) == VK_TRUE) {
         std::cout << "Selected Graphical Queue Family supports presentation." << std::endl;
     } else
         throw VulkanException("Selected queue family (graphical) doesn't support presentation.");
+#else
+    throw VulkanException("Presentation is only implemented for Win32, use the headless engine.");
+#endif
 }
 
 void VulkanEngine::createSurface() {
+#ifdef _WIN32
     VkResult result;
 
     surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
@@ -1814,6 +2804,9 @@ void VulkanEngine::createSurface() {
         std::cout << "Surface created and associated with the window." << std::endl;
     } else
         throw VulkanException("Failed to create and/or assocate surface with the window");
+#else
+    throw VulkanException("Window surfaces are only implemented for Win32, use the headless engine.");
+#endif
 }
 
 void VulkanEngine::createSwapchain() {
@@ -1956,11 +2949,65 @@ void VulkanEngine::createSwapchain() {
         std::cout << "Swapchain images obtained successfully." << std::endl;
     } else
         throw VulkanException("Couldn't get swapchain images.");
+
+    swapchainImageFences = new VkFence[swapchainImagesCount]();
+
+    renderExtent = swapchainCreateInfo.imageExtent;
+}
+
+void VulkanEngine::createOffscreenImages() {
+    renderExtent.width = settings.offscreenWidth;
+    renderExtent.height = settings.offscreenHeight;
+    surfaceImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    swapchainImagesCount = std::max<uint32_t>(1, settings.offscreenImageCount);
+
+    swapchainImages = new VkImage[swapchainImagesCount];
+    swapchainImageFences = new VkFence[swapchainImagesCount]();
+
+    VkImageCreateInfo offscreenImageCreateInfo = {};
+    offscreenImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    offscreenImageCreateInfo.pNext = nullptr;
+    offscreenImageCreateInfo.flags = 0;
+    offscreenImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    offscreenImageCreateInfo.format = surfaceImageFormat;
+    offscreenImageCreateInfo.extent.width = renderExtent.width;
+    offscreenImageCreateInfo.extent.height = renderExtent.height;
+    offscreenImageCreateInfo.extent.depth = 1;
+    offscreenImageCreateInfo.mipLevels = 1;
+    offscreenImageCreateInfo.arrayLayers = 1;
+    offscreenImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    offscreenImageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    offscreenImageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    offscreenImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    offscreenImageCreateInfo.queueFamilyIndexCount = 0;
+    offscreenImageCreateInfo.pQueueFamilyIndices = nullptr;
+    offscreenImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    offscreenImagesMemory = new MemoryAllocation[swapchainImagesCount];
+
+    // Software implementations typically expose a single memory type that is both device local and host visible,
+    // device local is only preferred for that reason.
+    for (uint32_t i = 0; i < swapchainImagesCount; i++) {
+        VKASSERT_SUCCESS(vkCreateImage(logicalDevices[0], &offscreenImageCreateInfo, nullptr, swapchainImages + i));
+
+        memoryAllocator.allocateImageMemory(swapchainImages[i], VK_IMAGE_TILING_OPTIMAL, 0,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, offscreenImagesMemory + i);
+    }
+
+    std::cout << "Offscreen images created successfully (" << swapchainImagesCount << " x " << renderExtent.width
+              << "x" << renderExtent.height << ")." << std::endl;
 }
 
 uint32_t VulkanEngine::acquireNextFramebufferImageIndex() {
     uint32_t imageIndex = -1;
 
+    if (headless) {
+        imageIndex = nextOffscreenImageIndex;
+        nextOffscreenImageIndex = (nextOffscreenImageIndex + 1) % swapchainImagesCount;
+
+        return imageIndex;
+    }
+
     //if (pAcquireNextImageIndexFence == NULL) {
     //	pAcquireNextImageIndexFence = new VkFence;
 
@@ -1975,10 +3022,12 @@ uint32_t VulkanEngine::acquireNextFramebufferImageIndex() {
 
     //vkResetFences(logicalDevices[0], 1, pAcquireNextImageIndexFence);
 
-    vkDeviceWaitIdle(logicalDevices[0]);
+    VkResult acquireNextImageIndexResult = vkAcquireNextImageKHR(logicalDevices[0], swapchain, UINT64_MAX,
+                                                                 indexAcquiredSemaphores[currentFrame],
+                                                                 VK_NULL_HANDLE, &imageIndex);
 
-    VkResult acquireNextImageIndexResult = vkAcquireNextImageKHR(logicalDevices[0], swapchain, 0,
-                                                                 indexAcquiredSemaphore, VK_NULL_HANDLE, &imageIndex);
+    if (acquireNextImageIndexResult != VK_SUCCESS && acquireNextImageIndexResult != VK_SUBOPTIMAL_KHR)
+        throw VulkanException("Failed to acquire next swapchain image.");
 
     //vkDestroyFence(logicalDevices[0], *pAcquireNextImageIndexFence, nullptr);
 
@@ -1990,16 +3039,39 @@ uint32_t VulkanEngine::acquireNextFramebufferImageIndex() {
 }
 
 
-void VulkanEngine::createQueueDoneFence() {
+void VulkanEngine::createQueueDoneFences() {
     VkFenceCreateInfo fenceCreateInfo = {};
     fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceCreateInfo.pNext = nullptr;
-    fenceCreateInfo.flags = 0;
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // the first wait on each frame slot must not block
+
+    for (uint32_t i = 0; i < framesInFlight; i++)
+        VKASSERT_SUCCESS(vkCreateFence(logicalDevices[0], &fenceCreateInfo, nullptr, queueDoneFences + i));
+}
+
+void VulkanEngine::createFrameTimestampQueryPool() {
+    if (queueFamilyProperties[graphicsQueueFamilyIndex].timestampValidBits == 0) {
+        std::cout << "Graphics queue doesn't support timestamps, GPU frame time won't be reported." << std::endl;
+        return;
+    }
 
-    VKASSERT_SUCCESS(vkCreateFence(logicalDevices[0], &fenceCreateInfo, nullptr, &queueDoneFence));
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.pNext = nullptr;
+    queryPoolCreateInfo.flags = 0;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    // Pre-recorded command buffers write the query pair of their swapchain image, otherwise of their frame slot.
+    queryPoolCreateInfo.queryCount = std::max(framesInFlight, swapchainImagesCount) * 2;
+    queryPoolCreateInfo.pipelineStatistics = 0;
+
+    VKASSERT_SUCCESS(
+            vkCreateQueryPool(logicalDevices[0], &queryPoolCreateInfo, nullptr, &frameTimestampQueryPool));
 }
 
 void VulkanEngine::present(uint32_t swapchainPresentImageIndex) {
+    if (headless)
+        return;
+
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.pNext = nullptr;
     presentInfo.pSwapchains = &swapchain;
@@ -2007,7 +3079,7 @@ void VulkanEngine::present(uint32_t swapchainPresentImageIndex) {
     presentInfo.pImageIndices = &swapchainPresentImageIndex;
     presentInfo.pResults = nullptr;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &waitToPresentSemaphore;
+    presentInfo.pWaitSemaphores = waitToPresentSemaphores + currentFrame;
 
     VkResult result = vkQueuePresentKHR(graphicsQueue, &presentInfo);
 
@@ -2018,10 +3090,6 @@ void VulkanEngine::present(uint32_t swapchainPresentImageIndex) {
                 << std::endl;
     else if (result != VK_SUCCESS)
         throw VulkanException("Failed to present.");
-
-    vkQueueWaitIdle(graphicsQueue);
-
-    vkFreeCommandBuffers(logicalDevices[0], renderCommandPool, 1, &renderCommandBuffer);
 }
 
 void VulkanEngine::createRenderpass() {
@@ -2034,7 +3102,8 @@ void VulkanEngine::createRenderpass() {
     attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Offscreen images are left ready to be copied out instead of presented.
+    attachments[0].finalLayout = (headless) ? (VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) : (VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
     attachments[1].flags = 0;
     attachments[1].format = depthFormat;
@@ -2082,10 +3151,17 @@ void VulkanEngine::createRenderpass() {
 
     subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;                                // Producer of the dependency
     subpassDependencies[0].dstSubpass = 0;                                                    // Consumer is our single subpass that will wait for the execution depdendency
-    subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // The depth attachment is shared by all frames in flight, so the previous frame's depth writes have to finish
+    // before this one clears and tests against it.
+    subpassDependencies[0].srcStageMask =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    subpassDependencies[0].dstStageMask =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    subpassDependencies[0].srcAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     subpassDependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
     //// Second dependency at the end the renderpass
@@ -2123,8 +3199,8 @@ void VulkanEngine::createFramebuffers() {
         framebufferCreateInfo.renderPass = renderPass;
         framebufferCreateInfo.attachmentCount = 2;
         framebufferCreateInfo.pAttachments = attachments;
-        framebufferCreateInfo.width = surfaceCapabilities.currentExtent.width;
-        framebufferCreateInfo.height = surfaceCapabilities.currentExtent.height;
+        framebufferCreateInfo.width = renderExtent.width;
+        framebufferCreateInfo.height = renderExtent.height;
         framebufferCreateInfo.layers = 1;
 
         VkResult result = vkCreateFramebuffer(logicalDevices[0], &framebufferCreateInfo, nullptr, framebuffers + i);
@@ -2188,65 +3264,46 @@ void VulkanEngine::createGraphicsPipeline() {
     stageCreateInfos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     stageCreateInfos[1].module = graphicsFragmentShaderModule;
     stageCreateInfos[1].pName = u8"main";
-    stageCreateInfos[1].pSpecializationInfo = nullptr;
-
-    vertexBindingDescription.binding = 0;
-    vertexBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    vertexBindingDescription.stride = sizeof(Attribute<float>);
+    stageCreateInfos[1].pSpecializationInfo = &shaderSpecializationInfo;
 
+    VkVertexInputBindingDescription vertexBindingDescriptions[2];
     VkVertexInputAttributeDescription vertexAttributeDescriptions[5];
+    uint32_t vertexBindingDescriptionCount = 0;
+    uint32_t vertexAttributeDescriptionCount = describeVertexInput(false, vertexBindingDescriptions,
+                                                                   &vertexBindingDescriptionCount,
+                                                                   vertexAttributeDescriptions);
 
-    vertexAttributeDescriptions[0].binding = 0;
-    vertexAttributeDescriptions[0].location = 0;
-    vertexAttributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[0].offset = offsetof(Attribute<float>, position);
-
-    vertexAttributeDescriptions[1].binding = 0;
-    vertexAttributeDescriptions[1].location = 1;
-    vertexAttributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[1].offset = offsetof(Attribute<float>, normal);
-
-    vertexAttributeDescriptions[2].binding = 0;
-    vertexAttributeDescriptions[2].location = 2;
-    vertexAttributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    vertexAttributeDescriptions[2].offset = offsetof(Attribute<float>, uv);
-
-    vertexAttributeDescriptions[3].binding = 0;
-    vertexAttributeDescriptions[3].location = 3;
-    vertexAttributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[3].offset = offsetof(Attribute<float>, tangent);
-
-    vertexAttributeDescriptions[4].binding = 0;
-    vertexAttributeDescriptions[4].location = 4;
-    vertexAttributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[4].offset = offsetof(Attribute<float>, bitangent);
-
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
     vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputStateCreateInfo.pNext = nullptr;
     vertexInputStateCreateInfo.flags = 0;
-    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-    vertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexBindingDescription;
-    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = 5;
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = vertexBindingDescriptionCount;
+    vertexInputStateCreateInfo.pVertexBindingDescriptions = vertexBindingDescriptions;
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexAttributeDescriptionCount;
     vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexAttributeDescriptions;
 
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
     inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssemblyStateCreateInfo.pNext = nullptr;
     inputAssemblyStateCreateInfo.flags = 0;
     inputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
 
-    viewport.width = swapchainCreateInfo.imageExtent.width;
-    viewport.height = swapchainCreateInfo.imageExtent.height;
+    VkViewport viewport = {};
+    viewport.width = renderExtent.width;
+    viewport.height = renderExtent.height;
     viewport.x = 0;
     viewport.y = 0;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
+    VkRect2D scissor = {};
     scissor.offset.x = 0;
     scissor.offset.y = 0;
     scissor.extent.width = viewport.width;
     scissor.extent.height = viewport.height;
 
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
     viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportStateCreateInfo.pNext = nullptr;
     viewportStateCreateInfo.flags = 0;
@@ -2255,6 +3312,7 @@ void VulkanEngine::createGraphicsPipeline() {
     viewportStateCreateInfo.scissorCount = 1;
     viewportStateCreateInfo.pScissors = &scissor;
 
+    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {};
     rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizationStateCreateInfo.pNext = nullptr;
     rasterizationStateCreateInfo.flags = 0;
@@ -2270,6 +3328,7 @@ void VulkanEngine::createGraphicsPipeline() {
     rasterizationStateCreateInfo.lineWidth = 1.0f;
 
 
+    VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
     multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampleStateCreateInfo.pNext = nullptr;
     multisampleStateCreateInfo.flags = 0;
@@ -2288,6 +3347,7 @@ void VulkanEngine::createGraphicsPipeline() {
     colorBlendAttachmentState.colorWriteMask =
             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
+    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {};
     colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlendStateCreateInfo.pNext = nullptr;
     colorBlendStateCreateInfo.flags = 0;
@@ -2301,9 +3361,10 @@ void VulkanEngine::createGraphicsPipeline() {
     depthStencilStateCreateInfo.flags = 0;
     depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
     depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-    depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+    depthStencilStateCreateInfo.depthWriteEnable = (settings.depthPrepass) ? (VK_FALSE) : (VK_TRUE);
     depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
 
+    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {};
     graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     graphicsPipelineCreateInfo.pNext = nullptr;
     graphicsPipelineCreateInfo.flags = 0;
@@ -2324,13 +3385,108 @@ void VulkanEngine::createGraphicsPipeline() {
     graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
     graphicsPipelineCreateInfo.basePipelineIndex = -1;
 
-    VkResult result = vkCreateGraphicsPipelines(logicalDevices[0], VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo,
+    VkResult result = vkCreateGraphicsPipelines(logicalDevices[0], pipelineCache, 1, &graphicsPipelineCreateInfo,
                                                 nullptr, &graphicsPipeline);
 
     if (result == VK_SUCCESS)
         std::cout << "Graphics Pipeline created successfully." << std::endl;
     else
         throw VulkanException("Couldn't create graphics pipeline.");
+
+    if (!settings.depthPrepass)
+        return;
+
+    // The same state but for a vertex shader alone, fetching only the position stream and writing only depth. Both
+    // vertex shaders compute an invariant gl_Position, the main pass finds the depth it wrote equal.
+    stageCreateInfos[0].module = graphicsDepthVertexShaderModule;
+
+    vertexAttributeDescriptionCount = describeVertexInput(true, vertexBindingDescriptions, &vertexBindingDescriptionCount,
+                                                          vertexAttributeDescriptions);
+
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = vertexBindingDescriptionCount;
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexAttributeDescriptionCount;
+
+    colorBlendAttachmentState.colorWriteMask = 0;
+
+    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+
+    graphicsPipelineCreateInfo.stageCount = 1;
+
+    result = vkCreateGraphicsPipelines(logicalDevices[0], pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr,
+                                       &graphicsDepthPipeline);
+
+    if (result == VK_SUCCESS)
+        std::cout << "Graphics Depth Pipeline created successfully." << std::endl;
+    else
+        throw VulkanException("Couldn't create graphics depth pipeline.");
+}
+
+uint32_t VulkanEngine::describeVertexInput(bool positionOnly, VkVertexInputBindingDescription *bindingDescriptions,
+                                           uint32_t *bindingCount,
+                                           VkVertexInputAttributeDescription *attributeDescriptions) {
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescriptions[0].stride = (uint32_t) positionStride;
+
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescriptions[1].stride = (uint32_t) attributeStride;
+
+    *bindingCount = (positionOnly) ? (1) : (2);
+
+    // Every one of these formats is required to be supported for vertex buffers.
+    if (settings.quantizedVertices) {
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attributeDescriptions[0].offset = offsetof(VertexPosition<QuantizedVertex>, position);
+
+        if (positionOnly)
+            return 1;
+
+        attributeDescriptions[1].binding = 1;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(VertexAttributes<QuantizedVertex>, uv);
+
+        attributeDescriptions[2].binding = 1;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attributeDescriptions[2].offset = offsetof(VertexAttributes<QuantizedVertex>, tangentFrame);
+
+        return 3;
+    }
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(VertexPosition<float>, position);
+
+    if (positionOnly)
+        return 1;
+
+    attributeDescriptions[1].binding = 1;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(VertexAttributes<float>, normal);
+
+    attributeDescriptions[2].binding = 1;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(VertexAttributes<float>, uv);
+
+    attributeDescriptions[3].binding = 1;
+    attributeDescriptions[3].location = 3;
+    attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[3].offset = offsetof(VertexAttributes<float>, tangent);
+
+    attributeDescriptions[4].binding = 1;
+    attributeDescriptions[4].location = 4;
+    attributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[4].offset = offsetof(VertexAttributes<float>, bitangent);
+
+    return 5;
 }
 
 //typedef struct shaderc_compiler* shaderc_compiler_t;
@@ -2347,8 +3503,30 @@ void VulkanEngine::createGraphicsShaderModule(const char *shaderFileName, VkShad
 
     std::string shaderCode = loadShaderCode(shaderPath.c_str());
 
-    std::vector<uint32_t> shaderBinary = compileGLSLShader(shaderCode.c_str(), shaderType);
+    std::string shaderCachePath(shaderPath);
+
+    std::string defines;
+
+    // Compiled in rather than specialized, the feedback writes need a device feature even if never executed.
+    if (settings.virtualTexturing) {
+        defines.append("#define VIRTUAL_TEXTURING\n");
+        shaderCachePath.append(".virtual");
+    }
+
+    // Vertex inputs change type, there's no specializing that.
+    if (settings.quantizedVertices) {
+        defines.append("#define QUANTIZED_VERTICES\n");
+        shaderCachePath.append(".quantized");
+    }
+
+    if (!defines.empty())
+        shaderCode.insert(shaderCode.find('\n') + 1, defines + "#line 2\n");
+
+    shaderCachePath.append(".spvcache");
 
+    std::vector<uint32_t> shaderBinary = compileGLSLShader(shaderCode.c_str(), shaderType, shaderCachePath.c_str());
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
     shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     shaderModuleCreateInfo.pNext = nullptr;
     shaderModuleCreateInfo.codeSize = shaderBinary.size() * sizeof(uint32_t);
@@ -2363,6 +3541,173 @@ void VulkanEngine::createGraphicsShaderModule(const char *shaderFileName, VkShad
 
 }
 
+void VulkanEngine::createGraphicsShaderModules() {
+    struct ShaderModuleSource {
+        const char *fileName;
+        VkShaderModule *shaderModule;
+        shaderc_shader_kind shaderType;
+    };
+
+    const ShaderModuleSource shaderModuleSources[] = {
+            {"vert.glsl",       &graphicsVertexShaderModule,               shaderc_glsl_default_vertex_shader},
+            {"depth_vert.glsl", &graphicsDepthVertexShaderModule,          shaderc_glsl_default_vertex_shader},
+            {"frag.glsl",       &graphicsFragmentShaderModule,             shaderc_glsl_default_fragment_shader},
+            {"debug_vert.glsl", &graphicsNormalViewerVertexShaderModule,   shaderc_glsl_default_vertex_shader},
+            {"debug_geom.glsl", &graphicsNormalViewerGeometryShaderModule, shaderc_glsl_default_geometry_shader},
+            {"debug_frag.glsl", &graphicsNormalViewerFragmentShaderModule, shaderc_glsl_default_fragment_shader}
+    };
+
+    // Each task writes only its own shader module handle, vkCreateShaderModule needs no external synchronization.
+    for (const ShaderModuleSource &source : shaderModuleSources)
+        shaderModuleFutures.push_back(threadPool.submit([this, source]() {
+            createGraphicsShaderModule(source.fileName, source.shaderModule, source.shaderType);
+        }));
+
+    if (settings.meshletCulling)
+        shaderModuleFutures.push_back(threadPool.submit([this]() {
+            createGraphicsShaderModule("cull_comp.glsl", &computeShaderModule, shaderc_glsl_default_compute_shader);
+        }));
+}
+
+void VulkanEngine::waitForGraphicsShaderModules() {
+    // get() rethrows a compilation error on this thread.
+    for (std::future<void> &shaderModuleFuture : shaderModuleFutures)
+        shaderModuleFuture.get();
+
+    shaderModuleFutures.clear();
+}
+
+std::string VulkanEngine::getPipelineCachePath() {
+    std::string pipelineCachePath(resourcesPath);
+    pipelineCachePath.append("pipeline.cache");
+
+    return pipelineCachePath;
+}
+
+bool VulkanEngine::loadPipelineCacheData(std::vector<char> *pipelineCacheData) {
+    std::ifstream pipelineCacheFile(getPipelineCachePath(), std::ios::binary | std::ios::ate);
+
+    if (!pipelineCacheFile.is_open())
+        return false;
+
+    std::streamsize fileSize = pipelineCacheFile.tellg();
+
+    // VkPipelineCacheHeaderVersionOne: header size, header version, vendor ID, device ID, pipeline cache UUID
+    const size_t headerSize = sizeof(uint32_t) * 4 + VK_UUID_SIZE;
+
+    if (fileSize < (std::streamsize) headerSize)
+        return false;
+
+    pipelineCacheData->resize((size_t) fileSize);
+    pipelineCacheFile.seekg(0);
+
+    if (!pipelineCacheFile.read(pipelineCacheData->data(), fileSize))
+        return false;
+
+    uint32_t headerFields[4];
+    memcpy(headerFields, pipelineCacheData->data(), sizeof(headerFields));
+
+    // A cache from another driver version or GPU would be rejected by a conforming driver anyway, some drivers
+    // don't check and crash on it instead.
+    if (headerFields[0] < headerSize ||
+        headerFields[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        headerFields[2] != deviceProperties.vendorID ||
+        headerFields[3] != deviceProperties.deviceID ||
+        memcmp(pipelineCacheData->data() + sizeof(headerFields), deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        pipelineCacheData->clear();
+        return false;
+    }
+
+    return true;
+}
+
+void VulkanEngine::createPipelineCache() {
+    std::vector<char> pipelineCacheData;
+
+    bool pipelineCacheLoaded = loadPipelineCacheData(&pipelineCacheData);
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+    pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipelineCacheCreateInfo.pNext = nullptr;
+    pipelineCacheCreateInfo.flags = 0;
+    pipelineCacheCreateInfo.initialDataSize = pipelineCacheData.size();
+    pipelineCacheCreateInfo.pInitialData = (pipelineCacheLoaded) ? (pipelineCacheData.data()) : (nullptr);
+
+    if (vkCreatePipelineCache(logicalDevices[0], &pipelineCacheCreateInfo, nullptr, &pipelineCache) == VK_SUCCESS)
+        std::cout << "Pipeline Cache created successfully"
+                  << ((pipelineCacheLoaded) ? (" from '" + getPipelineCachePath() + "'.") : (".")) << std::endl;
+    else
+        throw VulkanException("Couldn't create pipeline cache.");
+}
+
+void VulkanEngine::savePipelineCache() {
+    size_t pipelineCacheDataSize = 0;
+
+    if (vkGetPipelineCacheData(logicalDevices[0], pipelineCache, &pipelineCacheDataSize, nullptr) != VK_SUCCESS ||
+        pipelineCacheDataSize == 0)
+        return;
+
+    std::vector<char> pipelineCacheData(pipelineCacheDataSize);
+
+    if (vkGetPipelineCacheData(logicalDevices[0], pipelineCache, &pipelineCacheDataSize,
+                               pipelineCacheData.data()) != VK_SUCCESS)
+        return;
+
+    std::string pipelineCachePath = getPipelineCachePath();
+
+    bool written = writeFileAtomically(pipelineCachePath, [&](std::ofstream &pipelineCacheFile) {
+        pipelineCacheFile.write(pipelineCacheData.data(), (std::streamsize) pipelineCacheDataSize);
+    });
+
+    if (written)
+        std::cout << "Pipeline Cache written to '" << pipelineCachePath << "'." << std::endl;
+    else
+        std::cerr << "Couldn't write pipeline cache '" << pipelineCachePath << "'." << std::endl;
+}
+
+void VulkanEngine::createGraphicsPipelines() {
+    // All only read the layouts, render pass and shader modules. Going through the same cache lets the driver reuse
+    // whatever one of them compiled first.
+    std::future<void> normalViewerPipelineFuture = threadPool.submit([this]() {
+        createGraphicsNormalViewerPipeline();
+    });
+    std::future<void> computePipelineFuture = threadPool.submit([this]() {
+        createComputePipeline();
+    });
+
+    createGraphicsPipeline();
+
+    normalViewerPipelineFuture.get();
+    computePipelineFuture.get();
+}
+
+void VulkanEngine::createComputePipeline() {
+    if (!settings.meshletCulling)
+        return;
+
+    computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computePipelineCreateInfo.pNext = nullptr;
+    computePipelineCreateInfo.flags = 0;
+    computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computePipelineCreateInfo.stage.pNext = nullptr;
+    computePipelineCreateInfo.stage.flags = 0;
+    computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computePipelineCreateInfo.stage.module = computeShaderModule;
+    computePipelineCreateInfo.stage.pName = "main";
+    computePipelineCreateInfo.stage.pSpecializationInfo = nullptr;
+    computePipelineCreateInfo.layout = computePipelineLayout;
+    computePipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    computePipelineCreateInfo.basePipelineIndex = -1;
+
+    VkResult result = vkCreateComputePipelines(logicalDevices[0], pipelineCache, 1, &computePipelineCreateInfo,
+                                               nullptr, &computePipeline);
+
+    if (result == VK_SUCCESS)
+        std::cout << "Compute Pipeline created successfully." << std::endl;
+    else
+        throw VulkanException("Couldn't create compute pipeline.");
+}
+
 std::string VulkanEngine::loadShaderCode(const char *fileName) {
     std::string line;
     std::string code = "";
@@ -2418,40 +3763,39 @@ std::string VulkanEngine::loadShaderCode(const char *fileName) {
 void VulkanEngine::createPipelineAndDescriptorSetsLayout() {
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {};
 
-    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[4];
+    // Combined image samplers count against both per-stage limits.
+    if (textureArrayCount > deviceProperties.limits.maxPerStageDescriptorSampledImages ||
+        textureArrayCount > deviceProperties.limits.maxPerStageDescriptorSamplers)
+        throw VulkanException("More textures than the device can bind at once, try settings.textureAtlas.");
+
+    // A single set for every mesh: the per-mesh uniforms, indexed with the draw's first instance, and every texture,
+    // indexed with the texture index in the mesh's regions.
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[3];
     descriptorSetLayoutBindings[0].binding = 0;
     descriptorSetLayoutBindings[0].descriptorCount = 1;
-    descriptorSetLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorSetLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     descriptorSetLayoutBindings[0].pImmutableSamplers = nullptr;
     descriptorSetLayoutBindings[0].stageFlags =
             VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
     descriptorSetLayoutBindings[1].binding = 1;
-    descriptorSetLayoutBindings[1].descriptorCount = 1;
+    descriptorSetLayoutBindings[1].descriptorCount = textureArrayCount;
     descriptorSetLayoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorSetLayoutBindings[1].pImmutableSamplers = nullptr;
-    descriptorSetLayoutBindings[1].stageFlags =
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    descriptorSetLayoutBindings[1].stageFlags = VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
+    // The virtual texture's page table, unused without virtual texturing.
     descriptorSetLayoutBindings[2].binding = 2;
     descriptorSetLayoutBindings[2].descriptorCount = 1;
-    descriptorSetLayoutBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorSetLayoutBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     descriptorSetLayoutBindings[2].pImmutableSamplers = nullptr;
-    descriptorSetLayoutBindings[2].stageFlags =
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    descriptorSetLayoutBindings[3].binding = 3;
-    descriptorSetLayoutBindings[3].descriptorCount = 1;
-    descriptorSetLayoutBindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorSetLayoutBindings[3].pImmutableSamplers = nullptr;
-    descriptorSetLayoutBindings[3].stageFlags =
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    descriptorSetLayoutBindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     descriptorSetLayoutCreateInfo.pNext = nullptr;
     descriptorSetLayoutCreateInfo.flags = 0;
     descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
-    descriptorSetLayoutCreateInfo.bindingCount = 4;
+    descriptorSetLayoutCreateInfo.bindingCount = 3;
 
     VkResult result = vkCreateDescriptorSetLayout(logicalDevices[0], &descriptorSetLayoutCreateInfo, nullptr,
                                                   &graphicsDescriptorSetLayout);
@@ -2461,19 +3805,43 @@ void VulkanEngine::createPipelineAndDescriptorSetsLayout() {
     else
         throw VulkanException("Couldn't create descriptor set layout");
 
-    VkPushConstantRange pushConstantRange = {};
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(ViewProjectionMatrices<float>);
-    pushConstantRange.stageFlags =
-            VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
+    // Per swapchain image: the view and projection, and the virtual texture feedback of the frames rendering to it.
+    VkDescriptorSetLayoutBinding viewProjectionDescriptorSetLayoutBindings[2];
+    viewProjectionDescriptorSetLayoutBindings[0].binding = 0;
+    viewProjectionDescriptorSetLayoutBindings[0].descriptorCount = 1;
+    viewProjectionDescriptorSetLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    viewProjectionDescriptorSetLayoutBindings[0].pImmutableSamplers = nullptr;
+    viewProjectionDescriptorSetLayoutBindings[0].stageFlags =
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_FRAGMENT_BIT |
+            VK_SHADER_STAGE_COMPUTE_BIT;
+
+    viewProjectionDescriptorSetLayoutBindings[1].binding = 1;
+    viewProjectionDescriptorSetLayoutBindings[1].descriptorCount = 1;
+    viewProjectionDescriptorSetLayoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    viewProjectionDescriptorSetLayoutBindings[1].pImmutableSamplers = nullptr;
+    viewProjectionDescriptorSetLayoutBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    descriptorSetLayoutCreateInfo.pBindings = viewProjectionDescriptorSetLayoutBindings;
+    descriptorSetLayoutCreateInfo.bindingCount = 2;
+
+    result = vkCreateDescriptorSetLayout(logicalDevices[0], &descriptorSetLayoutCreateInfo, nullptr,
+                                         &viewProjectionDescriptorSetLayout);
+
+    if (result == VK_SUCCESS)
+        std::cout << "View Projection Descriptor Set Layout created successfully." << std::endl;
+    else
+        throw VulkanException("Couldn't create view projection descriptor set layout");
+
+    VkDescriptorSetLayout pipelineDescriptorSetLayouts[2] = {graphicsDescriptorSetLayout,
+                                                             viewProjectionDescriptorSetLayout};
 
     graphicsPipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     graphicsPipelineLayoutCreateInfo.pNext = nullptr;
     graphicsPipelineLayoutCreateInfo.flags = 0;
-    graphicsPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-    graphicsPipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-    graphicsPipelineLayoutCreateInfo.pSetLayouts = &graphicsDescriptorSetLayout;
-    graphicsPipelineLayoutCreateInfo.setLayoutCount = 1;
+    graphicsPipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+    graphicsPipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+    graphicsPipelineLayoutCreateInfo.pSetLayouts = pipelineDescriptorSetLayouts;
+    graphicsPipelineLayoutCreateInfo.setLayoutCount = 2;
 
     result = vkCreatePipelineLayout(logicalDevices[0], &graphicsPipelineLayoutCreateInfo, nullptr,
                                     &graphicsPipelineLayout);
@@ -2482,11 +3850,65 @@ void VulkanEngine::createPipelineAndDescriptorSetsLayout() {
         std::cout << "Graphics Pipeline Layout created successfully." << std::endl;
     } else
         throw VulkanException("Couldn't create graphics pipeline layout.");
+
+    // The culling pass: the meshlets, the index buffer, the culled indices, the meshes' draws and the meshes'
+    // uniforms, plus the same per swapchain image set for the view and projection.
+    if (settings.meshletCulling) {
+        VkDescriptorSetLayoutBinding computeDescriptorSetLayoutBindings[5];
+
+        for (uint32_t binding = 0; binding < 5; binding++) {
+            computeDescriptorSetLayoutBindings[binding].binding = binding;
+            computeDescriptorSetLayoutBindings[binding].descriptorCount = 1;
+            computeDescriptorSetLayoutBindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            computeDescriptorSetLayoutBindings[binding].pImmutableSamplers = nullptr;
+            computeDescriptorSetLayoutBindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        computeDescriptorSetLayoutCreateInfo = descriptorSetLayoutCreateInfo;
+        computeDescriptorSetLayoutCreateInfo.pBindings = computeDescriptorSetLayoutBindings;
+        computeDescriptorSetLayoutCreateInfo.bindingCount = 5;
+
+        VKASSERT_SUCCESS(vkCreateDescriptorSetLayout(logicalDevices[0], &computeDescriptorSetLayoutCreateInfo,
+                                                     nullptr, &computeDescriptorSetLayout));
+
+        VkDescriptorSetLayout computeDescriptorSetLayouts[2] = {computeDescriptorSetLayout,
+                                                                viewProjectionDescriptorSetLayout};
+
+        computePipelineLayoutCreateInfo = graphicsPipelineLayoutCreateInfo;
+        computePipelineLayoutCreateInfo.pSetLayouts = computeDescriptorSetLayouts;
+
+        result = vkCreatePipelineLayout(logicalDevices[0], &computePipelineLayoutCreateInfo, nullptr,
+                                        &computePipelineLayout);
+
+        if (result == VK_SUCCESS) {
+            std::cout << "Compute Pipeline Layout created successfully." << std::endl;
+        } else
+            throw VulkanException("Couldn't create compute pipeline layout.");
+    }
+
+    // Sizes the texture array of the fragment and geometry shaders, and picks the virtual texture lookup.
+    shaderSpecialization.textureCount = textureArrayCount;
+    shaderSpecialization.virtualTextureSparse = (virtualTextureSparse) ? (VK_TRUE) : (VK_FALSE);
+
+    shaderSpecializationEntries[0].constantID = 0;
+    shaderSpecializationEntries[0].offset = offsetof(ShaderSpecialization, textureCount);
+    shaderSpecializationEntries[0].size = sizeof(uint32_t);
+
+    shaderSpecializationEntries[1].constantID = 1;
+    shaderSpecializationEntries[1].offset = offsetof(ShaderSpecialization, virtualTextureSparse);
+    shaderSpecializationEntries[1].size = sizeof(VkBool32);
+
+    shaderSpecializationInfo.mapEntryCount = 2;
+    shaderSpecializationInfo.pMapEntries = shaderSpecializationEntries;
+    shaderSpecializationInfo.dataSize = sizeof(ShaderSpecialization);
+    shaderSpecializationInfo.pData = &shaderSpecialization;
 }
 
 void VulkanEngine::createRenderCommandPool() {
     VkCommandPoolCreateInfo commandPoolCreateInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
-                                                     VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, graphicsQueueFamilyIndex};
+                                                     VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                                                     VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                                     graphicsQueueFamilyIndex};
     VkResult result = vkCreateCommandPool(logicalDevices[0], &commandPoolCreateInfo, nullptr, &renderCommandPool);
 
     if (result == VK_SUCCESS) {
@@ -2495,35 +3917,152 @@ void VulkanEngine::createRenderCommandPool() {
         throw VulkanException("Couldn't create graphics command pool.");
 }
 
-void VulkanEngine::createTransferCommandPool() {
-    VkCommandPoolCreateInfo commandPoolCreateInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
-                                                     VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, transferQueueFamilyIndex};
-    VkResult result = vkCreateCommandPool(logicalDevices[0], &commandPoolCreateInfo, nullptr, &transferCommandPool);
+void VulkanEngine::allocateRenderCommandBuffers() {
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocateInfo.pNext = nullptr;
+    commandBufferAllocateInfo.commandBufferCount = framesInFlight;
+    commandBufferAllocateInfo.commandPool = renderCommandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+    VkResult result = vkAllocateCommandBuffers(logicalDevices[0], &commandBufferAllocateInfo, renderCommandBuffers);
+
+    if (result == VK_SUCCESS)
+        result = vkAllocateCommandBuffers(logicalDevices[0], &commandBufferAllocateInfo, frameUploadCommandBuffers);
 
     if (result == VK_SUCCESS) {
-        std::cout << "Transfer Command Pool created successfully." << std::endl;
+        std::cout << "Render Command Buffers allocated successfully." << std::endl;
     } else
-        throw VulkanException("Couldn't create transfer command pool.");
+        throw VulkanException("Couldn't allocate render command buffers.");
 }
 
+void VulkanEngine::recordFramebufferCommandBuffers() {
+    if (!settings.prerecordCommandBuffers)
+        return;
+
+    framebufferCommandBuffers = new VkCommandBuffer[swapchainImagesCount];
+    framebufferCommandBuffersDirty = new bool[swapchainImagesCount];
 
-void VulkanEngine::render(uint32_t drawableImageIndex) {
     VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
     commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     commandBufferAllocateInfo.pNext = nullptr;
-    commandBufferAllocateInfo.commandBufferCount = 1;
+    commandBufferAllocateInfo.commandBufferCount = swapchainImagesCount;
     commandBufferAllocateInfo.commandPool = renderCommandPool;
     commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-    VKASSERT_SUCCESS(vkAllocateCommandBuffers(logicalDevices[0], &commandBufferAllocateInfo, &renderCommandBuffer));
+    VkResult result = vkAllocateCommandBuffers(logicalDevices[0], &commandBufferAllocateInfo,
+                                               framebufferCommandBuffers);
+
+    if (result == VK_SUCCESS) {
+        std::cout << "Framebuffer Command Buffers allocated successfully." << std::endl;
+    } else
+        throw VulkanException("Couldn't allocate framebuffer command buffers.");
+
+    for (uint32_t i = 0; i < swapchainImagesCount; i++) {
+        recordRenderCommands(framebufferCommandBuffers[i], i, i, 0);
+
+        framebufferCommandBuffersDirty[i] = false;
+    }
+
+    std::cout << "Framebuffer Command Buffers recorded successfully." << std::endl;
+}
+
+void VulkanEngine::createTransferCommandPool() {
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+                                                     VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                                                     VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                                     transferQueueFamilyIndex};
+    VkResult result = vkCreateCommandPool(logicalDevices[0], &commandPoolCreateInfo, nullptr, &transferCommandPool);
+
+    if (result == VK_SUCCESS) {
+        std::cout << "Transfer Command Pool created successfully." << std::endl;
+    } else
+        throw VulkanException("Couldn't create transfer command pool.");
+}
+
+
+void VulkanEngine::render(uint32_t drawableImageIndex, VkCommandBuffer uploadCommandBuffer) {
+    VkCommandBuffer renderCommandBuffer;
+    uint32_t timestampQueryIndex;
+
+    std::chrono::steady_clock::time_point phaseBegin = std::chrono::steady_clock::now();
+
+    if (settings.prerecordCommandBuffers) {
+        renderCommandBuffer = framebufferCommandBuffers[drawableImageIndex];
+        timestampQueryIndex = drawableImageIndex;
+
+        // draw() already waited for the last frame that rendered to this image, so re-recording is safe.
+        if (framebufferCommandBuffersDirty[drawableImageIndex]) {
+            recordRenderCommands(renderCommandBuffer, drawableImageIndex, timestampQueryIndex, 0);
+
+            framebufferCommandBuffersDirty[drawableImageIndex] = false;
+        }
+    } else {
+        // The fence waited on in draw() guarantees the GPU is done with this frame's command buffer.
+        renderCommandBuffer = renderCommandBuffers[currentFrame];
+        timestampQueryIndex = currentFrame;
+
+        recordRenderCommands(renderCommandBuffer, drawableImageIndex, timestampQueryIndex,
+                             VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    }
+
+    lastFrameTimings.record = millisecondsSince(phaseBegin);
+
+    phaseBegin = std::chrono::steady_clock::now();
+
+    // recordFrameUploads() put the semaphores of the transfer batches to wait on there already. Nothing is acquired
+    // or presented headless, so there is no swapchain image to wait on or signal.
+    if (!headless) {
+        frameWaitSemaphores.push_back(indexAcquiredSemaphores[currentFrame]);
+        frameWaitStageFlags.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    }
+
+    VkSubmitInfo queueSubmit = {};
+    queueSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    queueSubmit.pNext = nullptr;
+    queueSubmit.waitSemaphoreCount = (uint32_t) frameWaitSemaphores.size();
+    queueSubmit.pWaitSemaphores = frameWaitSemaphores.data();
+
+    // The frame's uploads, if any, run right before its render commands.
+    VkCommandBuffer submittedCommandBuffers[2] = {uploadCommandBuffer, renderCommandBuffer};
+
+    queueSubmit.pWaitDstStageMask = frameWaitStageFlags.data();
+    queueSubmit.commandBufferCount = (uploadCommandBuffer != VK_NULL_HANDLE) ? (2) : (1);
+    queueSubmit.pCommandBuffers = submittedCommandBuffers + ((uploadCommandBuffer != VK_NULL_HANDLE) ? (0) : (1));
+    queueSubmit.signalSemaphoreCount = (headless) ? (0) : (1);
+    queueSubmit.pSignalSemaphores = waitToPresentSemaphores + currentFrame;
+
+    VKASSERT_SUCCESS(vkQueueSubmit(graphicsQueue, 1, &queueSubmit, queueDoneFences[currentFrame]));
+
+    lastFrameTimings.submit = millisecondsSince(phaseBegin);
 
+    frameTimestampQueryIndices[currentFrame] = (frameTimestampQueryPool != VK_NULL_HANDLE) ? (timestampQueryIndex)
+                                                                                        : (-1);
 
+    //vkResetCommandPool(logicalDevices[0], renderCommandPool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+
+    //vkResetDescriptorPool(logicalDevices[0], descriptorPool, 0);
+}
+
+void VulkanEngine::recordRenderCommands(VkCommandBuffer renderCommandBuffer, uint32_t drawableImageIndex,
+                                        uint32_t timestampQueryIndex, VkCommandBufferUsageFlags usageFlags) {
     VkCommandBufferBeginInfo commandBufferBeginInfo = {};
     commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     commandBufferBeginInfo.pInheritanceInfo = nullptr;
-    commandBufferBeginInfo.flags = 0;
+    commandBufferBeginInfo.flags = usageFlags;
+
+    // Beginning implicitly resets the command buffer, the pool is created with
+    // VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT.
+    VKASSERT_SUCCESS(vkBeginCommandBuffer(renderCommandBuffer, &commandBufferBeginInfo));
+
+    if (frameTimestampQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(renderCommandBuffer, frameTimestampQueryPool, timestampQueryIndex * 2, 2);
+        vkCmdWriteTimestamp(renderCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameTimestampQueryPool,
+                            timestampQueryIndex * 2);
+    }
 
-    VKASSERT_SUCCESS(vkBeginCommandBuffer(renderCommandBuffer, &commandBufferBeginInfo));
+    if (settings.meshletCulling)
+        recordMeshletCulling(renderCommandBuffer, drawableImageIndex);
 
     VkRenderPassBeginInfo renderPassBeginInfo = {};
 
@@ -2539,8 +4078,8 @@ void VulkanEngine::render(uint32_t drawableImageIndex) {
     renderPassBeginInfo.pNext = nullptr;
     renderPassBeginInfo.clearValueCount = 2;
     renderPassBeginInfo.pClearValues = clearValues;
-    renderPassBeginInfo.renderArea.extent.width = swapchainCreateInfo.imageExtent.width;
-    renderPassBeginInfo.renderArea.extent.height = swapchainCreateInfo.imageExtent.height;
+    renderPassBeginInfo.renderArea.extent.width = renderExtent.width;
+    renderPassBeginInfo.renderArea.extent.height = renderExtent.height;
     renderPassBeginInfo.renderArea.offset.x = 0;
     renderPassBeginInfo.renderArea.offset.y = 0;
     renderPassBeginInfo.renderPass = renderPass;
@@ -2551,147 +4090,208 @@ void VulkanEngine::render(uint32_t drawableImageIndex) {
 
 //    const long long sysTimeMS = GetTickCount();
 
-    vkCmdBindPipeline(renderCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    vkCmdBindPipeline(renderCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      (graphicsDepthPipeline != VK_NULL_HANDLE) ? (graphicsDepthPipeline) : (graphicsPipeline));
+
+    // The only bind of the frame, both sets stay bound across every pipeline since they share the same layout.
+    VkDescriptorSet descriptorSets[2] = {graphicsDescriptorSet, viewProjectionDescriptorSets[drawableImageIndex]};
+
+    vkCmdBindDescriptorSets(renderCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineLayout, 0, 2,
+                            descriptorSets, 0, nullptr);
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        vkCmdPushConstants(renderCommandBuffer, graphicsPipelineLayout,
-                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0,
-                           sizeof(ViewProjectionMatrices<float>),
-                           &viewProjection);
+    // Vertex and index bindings survive pipeline changes, every mesh of every pass draws out of these. The position
+    // only pipeline simply leaves binding 1 unused.
+    VkBuffer vertexBuffers[2] = {vertexBufferDevice, vertexBufferDevice};
+    VkDeviceSize vertexBufferOffsets[2] = {0, attributeStreamOffset};
 
+    vkCmdBindVertexBuffers(renderCommandBuffer, 0, 2, vertexBuffers, vertexBufferOffsets);
+
+    // Both index types read the same buffer from its beginning, only a change of type needs a rebind.
+    VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+    // Depth first where there's a prepass, the main pass then only shades what survives its LESS_OR_EQUAL test.
+    if (graphicsDepthPipeline != VK_NULL_HANDLE) {
+        recordMeshDraws(renderCommandBuffer, &boundIndexType);
+
+        vkCmdBindPipeline(renderCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    }
 
-        vkCmdBindDescriptorSets(renderCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineLayout, 0, 1,
-                                meshDescriptorSets + meshIndex, 0, nullptr);
+    recordMeshDraws(renderCommandBuffer, &boundIndexType);
 
 
-        VkDeviceSize offset = 0;
+    vkCmdBindPipeline(renderCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsDebugPipeline);
 
-        vkCmdBindVertexBuffers(renderCommandBuffer, 0, 1, vertexBuffersDevice + meshIndex, &offset);
+    recordMeshDraws(renderCommandBuffer, &boundIndexType);
 
-        vkCmdBindIndexBuffer(renderCommandBuffer, indexBuffersDevice[meshIndex], 0, VK_INDEX_TYPE_UINT32);
+    vkCmdEndRenderPass(renderCommandBuffer);
 
+    // The feedback is read back once the frame's fence is signaled.
+    if (settings.virtualTexturing) {
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.pNext = nullptr;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
 
-        vkCmdDrawIndexed(renderCommandBuffer, sortedIndices[meshIndex].size(), 1, 0, 0, 0);
+        vkCmdPipelineBarrier(renderCommandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             1, &memoryBarrier, 0, nullptr, 0, nullptr);
     }
 
+    if (frameTimestampQueryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(renderCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameTimestampQueryPool,
+                            timestampQueryIndex * 2 + 1);
 
-    vkCmdBindPipeline(renderCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsDebugPipeline);
+    VKASSERT_SUCCESS(vkEndCommandBuffer(renderCommandBuffer));
+}
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        vkCmdPushConstants(renderCommandBuffer, graphicsPipelineLayout,
-                           VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0,
-                           sizeof(ViewProjectionMatrices<float>),
-                           &viewProjection);
+void VulkanEngine::recordMeshletCulling(VkCommandBuffer renderCommandBuffer, uint32_t drawableImageIndex) {
+    // The draws of the frame before read the draws and culled indices written here, as do this frame's after.
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext = nullptr;
+    memoryBarrier.srcAccessMask = 0;
+    memoryBarrier.dstAccessMask = 0;
 
+    vkCmdPipelineBarrier(renderCommandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 0, nullptr);
 
-        vkCmdBindDescriptorSets(renderCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineLayout, 0, 1,
-                                meshDescriptorSets + meshIndex, 0, nullptr);
+    // Index counts back to 0, the culling pass adds up the triangles that survive.
+    vkCmdUpdateBuffer(renderCommandBuffer, meshletDrawBuffer, 0, sizeof(VkDrawIndexedIndirectCommand) * meshCount,
+                      meshletDraws.data());
 
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-        VkDeviceSize offset = 0;
+    vkCmdPipelineBarrier(renderCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-        vkCmdBindVertexBuffers(renderCommandBuffer, 0, 1, vertexBuffersDevice + meshIndex, &offset);
+    if (totalMeshletCount > 0) {
+        VkDescriptorSet descriptorSets[2] = {computeDescriptorSet, viewProjectionDescriptorSets[drawableImageIndex]};
 
-        vkCmdBindIndexBuffer(renderCommandBuffer, indexBuffersDevice[meshIndex], 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindPipeline(renderCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+        vkCmdBindDescriptorSets(renderCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 2,
+                                descriptorSets, 0, nullptr);
 
+        // A workgroup per meshlet, in rows of up to as many as a dimension of the dispatch can count.
+        uint32_t groupCountX = std::min(totalMeshletCount, deviceProperties.limits.maxComputeWorkGroupCount[0]);
 
-        vkCmdDrawIndexed(renderCommandBuffer, sortedIndices[meshIndex].size(), 1, 0, 0, 0);
+        vkCmdDispatch(renderCommandBuffer, groupCountX, (totalMeshletCount + groupCountX - 1) / groupCountX, 1);
     }
 
-    vkCmdEndRenderPass(renderCommandBuffer);
-
-    VKASSERT_SUCCESS(vkEndCommandBuffer(renderCommandBuffer));
+    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
 
-    VkSubmitInfo queueSubmit = {};
-    queueSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    queueSubmit.pNext = nullptr;
-    queueSubmit.waitSemaphoreCount = 1;
-    queueSubmit.pWaitSemaphores = &indexAcquiredSemaphore;
-    VkPipelineStageFlags dstSemaphoreStageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    vkCmdPipelineBarrier(renderCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1,
+                         &memoryBarrier, 0, nullptr, 0, nullptr);
+}
 
-    queueSubmit.pWaitDstStageMask = &dstSemaphoreStageFlags;
-    queueSubmit.commandBufferCount = 1;
-    queueSubmit.pCommandBuffers = &renderCommandBuffer;
-    queueSubmit.signalSemaphoreCount = 1;
-    queueSubmit.pSignalSemaphores = &waitToPresentSemaphore;
+void VulkanEngine::recordMeshDraws(VkCommandBuffer renderCommandBuffer, VkIndexType *boundIndexType) {
+    if (settings.meshletCulling) {
+        // Only ever 32 bit indices out of the culled index buffer, bound once a frame like the shared one.
+        if (*boundIndexType != VK_INDEX_TYPE_UINT32) {
+            *boundIndexType = VK_INDEX_TYPE_UINT32;
 
-    VKASSERT_SUCCESS(vkQueueSubmit(graphicsQueue, 1, &queueSubmit, queueDoneFence));
+            vkCmdBindIndexBuffer(renderCommandBuffer, culledIndexBuffer, 0, *boundIndexType);
+        }
 
-    VkResult waitForFenceResult = vkWaitForFences(logicalDevices[0], 1, &queueDoneFence, VK_TRUE,
-                                                  1000000000); // 1sec timeout
+        if (desiredDeviceFeatures.multiDrawIndirect == VK_TRUE) {
+            vkCmdDrawIndexedIndirect(renderCommandBuffer, meshletDrawBuffer, 0, meshCount,
+                                     sizeof(VkDrawIndexedIndirectCommand));
+        } else {
+            for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++)
+                vkCmdDrawIndexedIndirect(renderCommandBuffer, meshletDrawBuffer,
+                                         sizeof(VkDrawIndexedIndirectCommand) * meshIndex, 1,
+                                         sizeof(VkDrawIndexedIndirectCommand));
+        }
 
-    switch (waitForFenceResult) {
-        case VK_TIMEOUT:
-            throw VulkanException("Queue execution timeout!");
-            break;
-        case VK_SUCCESS:
-            break;
-        default:
-            throw VulkanException("Queue submission failed!");
+        return;
     }
 
-    VKASSERT_SUCCESS(vkResetFences(logicalDevices[0], 1, &queueDoneFence));
+    // The first instance tells the shaders which mesh they draw.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        if (meshRegions[meshIndex].indexType != *boundIndexType) {
+            *boundIndexType = meshRegions[meshIndex].indexType;
 
-    //vkResetCommandPool(logicalDevices[0], renderCommandPool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+            vkCmdBindIndexBuffer(renderCommandBuffer, indexBufferDevice, 0, *boundIndexType);
+        }
 
-    //vkResetDescriptorPool(logicalDevices[0], descriptorPool, 0);
+        vkCmdDrawIndexed(renderCommandBuffer, meshRegions[meshIndex].indexCount, 1, meshRegions[meshIndex].firstIndex,
+                         meshRegions[meshIndex].vertexOffset, meshIndex);
+    }
 }
 
-void VulkanEngine::createWaitToDrawSemaphore() {
+void VulkanEngine::createWaitToDrawSemaphores() {
     VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 
     semaphoreCreateInfo.flags = 0;
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semaphoreCreateInfo.pNext = nullptr;
 
-    VKASSERT_SUCCESS(vkCreateSemaphore(logicalDevices[0], &semaphoreCreateInfo, nullptr, &indexAcquiredSemaphore));
+    for (uint32_t i = 0; i < framesInFlight; i++)
+        VKASSERT_SUCCESS(
+                vkCreateSemaphore(logicalDevices[0], &semaphoreCreateInfo, nullptr, indexAcquiredSemaphores + i));
 }
 
-void VulkanEngine::createWaitToPresentSemaphore() {
+void VulkanEngine::createWaitToPresentSemaphores() {
     VkSemaphoreCreateInfo semaphoreCreateInfo = {};
 
     semaphoreCreateInfo.flags = 0;
     semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     semaphoreCreateInfo.pNext = nullptr;
 
-    VKASSERT_SUCCESS(vkCreateSemaphore(logicalDevices[0], &semaphoreCreateInfo, nullptr, &waitToPresentSemaphore));
+    for (uint32_t i = 0; i < framesInFlight; i++)
+        VKASSERT_SUCCESS(
+                vkCreateSemaphore(logicalDevices[0], &semaphoreCreateInfo, nullptr, waitToPresentSemaphores + i));
 }
 
 void VulkanEngine::createSyncMeans() {
-    createWaitToDrawSemaphore();
-    createWaitToPresentSemaphore();
-    createQueueDoneFence();
+    createWaitToDrawSemaphores();
+    createWaitToPresentSemaphores();
+    createQueueDoneFences();
 }
 
 void VulkanEngine::destroySyncMeans() {
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        vkDestroySemaphore(logicalDevices[0], indexAcquiredSemaphores[i], nullptr);
+        std::cout << "Semaphore destroyed." << std::endl;
 
-    vkDestroySemaphore(logicalDevices[0], indexAcquiredSemaphore, nullptr);
-    std::cout << "Semaphore destroyed." << std::endl;
 
+        vkDestroySemaphore(logicalDevices[0], waitToPresentSemaphores[i], nullptr);
+        std::cout << "Semaphore destroyed." << std::endl;
 
-    vkDestroySemaphore(logicalDevices[0], waitToPresentSemaphore, nullptr);
-    std::cout << "Semaphore destroyed." << std::endl;
 
+        vkDestroyFence(logicalDevices[0], queueDoneFences[i], nullptr);
+        std::cout << "Fence destroyed." << std::endl;
+    }
 
-    vkDestroyFence(logicalDevices[0], queueDoneFence, nullptr);
-    std::cout << "Fence destroyed." << std::endl;
+    if (frameTimestampQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(logicalDevices[0], frameTimestampQueryPool, nullptr);
+        std::cout << "Query Pool destroyed." << std::endl;
+    }
 }
 
 
 void VulkanEngine::createDescriptorPool() {
-    VkDescriptorPoolSize descriptorPoolSizes[2];
-    descriptorPoolSizes[0].descriptorCount = cachedScene->mNumMeshes;
+    // Set 0 has the meshes' uniforms and the page table, every set 1 its virtual texture feedback, the culling set
+    // its 5 buffers.
+    VkDescriptorPoolSize descriptorPoolSizes[3];
+    descriptorPoolSizes[0].descriptorCount = swapchainImagesCount;
     descriptorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 
-    descriptorPoolSizes[1].descriptorCount = cachedScene->mNumMeshes * 3;
+    descriptorPoolSizes[1].descriptorCount = textureArrayCount;
     descriptorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
+    descriptorPoolSizes[2].descriptorCount = 2 + swapchainImagesCount + 5;
+    descriptorPoolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
     descriptorPoolCreateInfo = {};
     descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     descriptorPoolCreateInfo.pNext = nullptr;
     descriptorPoolCreateInfo.flags = 0;
-    descriptorPoolCreateInfo.maxSets = cachedScene->mNumMeshes;
-    descriptorPoolCreateInfo.poolSizeCount = 2;
+    descriptorPoolCreateInfo.maxSets = 2 + swapchainImagesCount;
+    descriptorPoolCreateInfo.poolSizeCount = 3;
     descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes;
 
     VKASSERT_SUCCESS(vkCreateDescriptorPool(logicalDevices[0], &descriptorPoolCreateInfo, nullptr, &descriptorPool));
@@ -2715,48 +4315,97 @@ void VulkanEngine::createDescriptorSets() {
     samplerCreateInfo.compareEnable = VK_FALSE;
     samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
     samplerCreateInfo.minLod = 0.0f;
-    samplerCreateInfo.maxLod = 1.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;        // the views limit the levels, textures differ
     samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_WHITE;
     samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
 
     VKASSERT_SUCCESS(vkCreateSampler(logicalDevices[0], &samplerCreateInfo, nullptr, &textureSampler));
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
+    descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.pNext = nullptr;
+    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &graphicsDescriptorSetLayout;
+
+    VKASSERT_SUCCESS(vkAllocateDescriptorSets(logicalDevices[0], &descriptorSetAllocateInfo, &graphicsDescriptorSet));
+
+    VkDescriptorBufferInfo descriptorSetBufferInfo = {};
+    descriptorSetBufferInfo.buffer = uniformBufferDevice;
+    descriptorSetBufferInfo.offset = 0;
+    descriptorSetBufferInfo.range = uniformBufferSize;
+
+    std::vector<VkDescriptorImageInfo> descriptorSetImageInfos(textureArrayCount);
+
+    for (uint32_t arrayIndex = 0; arrayIndex < textureArrayCount; arrayIndex++) {
+        descriptorSetImageInfos[arrayIndex].imageView = textureArrayViews[arrayIndex];
+        descriptorSetImageInfos[arrayIndex].imageLayout = (textureArrayViews[arrayIndex] == virtualTextureView)
+                                                          ? (VK_IMAGE_LAYOUT_GENERAL)
+                                                          : (VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        descriptorSetImageInfos[arrayIndex].sampler = textureSampler;
+    }
+
+    VkDescriptorBufferInfo pageTableBufferInfo = {};
+    pageTableBufferInfo.buffer = virtualTexturePageTableBuffer;
+    pageTableBufferInfo.offset = 0;
+    pageTableBufferInfo.range = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet descriptorSetWrites[3];
+    descriptorSetWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorSetWrites[0].pNext = nullptr;
+    descriptorSetWrites[0].dstSet = graphicsDescriptorSet;
+    descriptorSetWrites[0].dstBinding = 0;
+    descriptorSetWrites[0].dstArrayElement = 0;
+    descriptorSetWrites[0].descriptorCount = 1;
+    descriptorSetWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorSetWrites[0].pImageInfo = nullptr;
+    descriptorSetWrites[0].pBufferInfo = &descriptorSetBufferInfo;
+    descriptorSetWrites[0].pTexelBufferView = nullptr;
+
+    descriptorSetWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorSetWrites[1].pNext = nullptr;
+    descriptorSetWrites[1].dstSet = graphicsDescriptorSet;
+    descriptorSetWrites[1].dstBinding = 1;
+    descriptorSetWrites[1].dstArrayElement = 0;
+    descriptorSetWrites[1].descriptorCount = textureArrayCount;
+    descriptorSetWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorSetWrites[1].pImageInfo = descriptorSetImageInfos.data();
+    descriptorSetWrites[1].pBufferInfo = nullptr;
+    descriptorSetWrites[1].pTexelBufferView = nullptr;
+
+    descriptorSetWrites[2] = descriptorSetWrites[0];
+    descriptorSetWrites[2].dstBinding = 2;
+    descriptorSetWrites[2].pBufferInfo = &pageTableBufferInfo;
+
+    vkUpdateDescriptorSets(logicalDevices[0], 3, descriptorSetWrites, 0, nullptr);
+
+    viewProjectionDescriptorSets = new VkDescriptorSet[swapchainImagesCount];
+
+    for (uint32_t imageIndex = 0; imageIndex < swapchainImagesCount; imageIndex++) {
         descriptorSetAllocateInfo = {};
         descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         descriptorSetAllocateInfo.pNext = nullptr;
         descriptorSetAllocateInfo.descriptorPool = descriptorPool;
         descriptorSetAllocateInfo.descriptorSetCount = 1;
-        descriptorSetAllocateInfo.pSetLayouts = &graphicsDescriptorSetLayout;
+        descriptorSetAllocateInfo.pSetLayouts = &viewProjectionDescriptorSetLayout;
 
         VKASSERT_SUCCESS(vkAllocateDescriptorSets(logicalDevices[0], &descriptorSetAllocateInfo,
-                                                  meshDescriptorSets + meshIndex));
-
-        VkDescriptorImageInfo descriptorSetImageInfo = {};
-        descriptorSetImageInfo.imageView = colorTextureViews[meshIndex];
-        descriptorSetImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descriptorSetImageInfo.sampler = textureSampler;
-
-        VkDescriptorImageInfo descriptorSetNormalImageInfo = {};
-        descriptorSetNormalImageInfo.imageView = normalTextureViews[meshIndex];
-        descriptorSetNormalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descriptorSetNormalImageInfo.sampler = textureSampler;
-
-        VkDescriptorImageInfo descriptorSetSpecImageInfo = {};
-        descriptorSetSpecImageInfo.imageView = specTextureViews[meshIndex];
-        descriptorSetSpecImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        descriptorSetSpecImageInfo.sampler = textureSampler;
-
+                                                  viewProjectionDescriptorSets + imageIndex));
 
         VkDescriptorBufferInfo descriptorSetBufferInfo = {};
-        descriptorSetBufferInfo.buffer = uniformBuffersDevice[meshIndex];
-        descriptorSetBufferInfo.offset = 0;
-        descriptorSetBufferInfo.range = VK_WHOLE_SIZE;
+        descriptorSetBufferInfo.buffer = viewProjectionBuffer;
+        descriptorSetBufferInfo.offset = viewProjectionBufferStride * imageIndex;
+        descriptorSetBufferInfo.range = sizeof(ViewProjectionMatrices<float>);
+
+        VkDescriptorBufferInfo feedbackBufferInfo = {};
+        feedbackBufferInfo.buffer = virtualTextureFeedbackBuffer;
+        feedbackBufferInfo.offset = virtualTextureFeedbackStride * imageIndex;
+        feedbackBufferInfo.range = virtualTextureFeedbackStride;
 
-        VkWriteDescriptorSet descriptorSetWrites[4];
+        VkWriteDescriptorSet descriptorSetWrites[2] = {};
         descriptorSetWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorSetWrites[0].pNext = nullptr;
-        descriptorSetWrites[0].dstSet = meshDescriptorSets[meshIndex];
+        descriptorSetWrites[0].dstSet = viewProjectionDescriptorSets[imageIndex];
         descriptorSetWrites[0].dstBinding = 0;
         descriptorSetWrites[0].dstArrayElement = 0;
         descriptorSetWrites[0].descriptorCount = 1;
@@ -2765,67 +4414,411 @@ void VulkanEngine::createDescriptorSets() {
         descriptorSetWrites[0].pBufferInfo = &descriptorSetBufferInfo;
         descriptorSetWrites[0].pTexelBufferView = nullptr;
 
-        descriptorSetWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorSetWrites[1].pNext = nullptr;
-        descriptorSetWrites[1].dstSet = meshDescriptorSets[meshIndex];
+        descriptorSetWrites[1] = descriptorSetWrites[0];
         descriptorSetWrites[1].dstBinding = 1;
-        descriptorSetWrites[1].dstArrayElement = 0;
-        descriptorSetWrites[1].descriptorCount = 1;
-        descriptorSetWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorSetWrites[1].pImageInfo = &descriptorSetImageInfo;
-        descriptorSetWrites[1].pBufferInfo = nullptr;
-        descriptorSetWrites[1].pTexelBufferView = nullptr;
-
-        descriptorSetWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorSetWrites[2].pNext = nullptr;
-        descriptorSetWrites[2].dstSet = meshDescriptorSets[meshIndex];
-        descriptorSetWrites[2].dstBinding = 2;
-        descriptorSetWrites[2].dstArrayElement = 0;
-        descriptorSetWrites[2].descriptorCount = 1;
-        descriptorSetWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorSetWrites[2].pImageInfo = &descriptorSetNormalImageInfo;
-        descriptorSetWrites[2].pBufferInfo = nullptr;
-        descriptorSetWrites[2].pTexelBufferView = nullptr;
-
-        descriptorSetWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorSetWrites[3].pNext = nullptr;
-        descriptorSetWrites[3].dstSet = meshDescriptorSets[meshIndex];
-        descriptorSetWrites[3].dstBinding = 3;
-        descriptorSetWrites[3].dstArrayElement = 0;
-        descriptorSetWrites[3].descriptorCount = 1;
-        descriptorSetWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorSetWrites[3].pImageInfo = &descriptorSetSpecImageInfo;
-        descriptorSetWrites[3].pBufferInfo = nullptr;
-        descriptorSetWrites[3].pTexelBufferView = nullptr;
-
-        vkUpdateDescriptorSets(logicalDevices[0], 4, descriptorSetWrites, 0, nullptr);
+        descriptorSetWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorSetWrites[1].pBufferInfo = &feedbackBufferInfo;
+
+        vkUpdateDescriptorSets(logicalDevices[0], 2, descriptorSetWrites, 0, nullptr);
+    }
+
+    if (!settings.meshletCulling)
+        return;
+
+    descriptorSetAllocateInfo = {};
+    descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocateInfo.pNext = nullptr;
+    descriptorSetAllocateInfo.descriptorPool = descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &computeDescriptorSetLayout;
+
+    VKASSERT_SUCCESS(vkAllocateDescriptorSets(logicalDevices[0], &descriptorSetAllocateInfo, &computeDescriptorSet));
+
+    // Whole buffers, the shader takes the number of meshlets from the length of the first.
+    VkBuffer computeBuffers[5] = {meshletBuffer, indexBufferDevice, culledIndexBuffer, meshletDrawBuffer,
+                                  uniformBufferDevice};
+    VkDescriptorBufferInfo computeBufferInfos[5];
+    VkWriteDescriptorSet computeDescriptorSetWrites[5];
+
+    for (uint32_t binding = 0; binding < 5; binding++) {
+        computeBufferInfos[binding].buffer = computeBuffers[binding];
+        computeBufferInfos[binding].offset = 0;
+        computeBufferInfos[binding].range = VK_WHOLE_SIZE;
+
+        computeDescriptorSetWrites[binding] = descriptorSetWrites[0];
+        computeDescriptorSetWrites[binding].dstSet = computeDescriptorSet;
+        computeDescriptorSetWrites[binding].dstBinding = binding;
+        computeDescriptorSetWrites[binding].pBufferInfo = computeBufferInfos + binding;
+    }
+
+    vkUpdateDescriptorSets(logicalDevices[0], 5, computeDescriptorSetWrites, 0, nullptr);
+}
+
+void VulkanEngine::createViewProjectionBuffer() {
+    // One slice per swapchain image, so a frame still in flight never sees the matrices of a newer one.
+    VkDeviceSize alignment = deviceProperties.limits.minUniformBufferOffsetAlignment;
+
+    viewProjectionBufferStride = (sizeof(ViewProjectionMatrices<float>) + alignment - 1) & ~(alignment - 1);
+
+    createBuffer(&viewProjectionBuffer, viewProjectionBufferStride * swapchainImagesCount,
+                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    // Host coherent memory needs no flushes, the allocator keeps it mapped for the lifetime of the engine.
+    memoryAllocator.allocateBufferMemory(viewProjectionBuffer,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0,
+                                         &viewProjectionBufferMemory);
+
+    viewProjectionMappedMemory = (byte *) viewProjectionBufferMemory.mappedData;
+
+    for (uint32_t imageIndex = 0; imageIndex < swapchainImagesCount; imageIndex++)
+        memcpy(viewProjectionMappedMemory + viewProjectionBufferStride * imageIndex, &viewProjection,
+               sizeof(ViewProjectionMatrices<float>));
+
+    std::cout << "View Projection Buffer created successfully." << std::endl;
+}
+
+void VulkanEngine::createVirtualTextureBuffers() {
+    VkDeviceSize pageTableSize = sizeof(uint32_t) * std::max<VkDeviceSize>(virtualTexturePageTable.size(), 1);
+    VkDeviceSize feedbackSize = sizeof(uint32_t) * ((virtualTexturePageTable.size() + 31) / 32 + 1);
+
+    // Updated through the frame staging ring whenever pages come and go.
+    createBuffer(&virtualTexturePageTableBuffer, pageTableSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    memoryAllocator.allocateBufferMemory(virtualTexturePageTableBuffer, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         &virtualTexturePageTableMemory);
+
+    // One region per swapchain image, like the view projection buffer. Read back by the CPU, cached if possible.
+    virtualTextureFeedbackStride = alignDeviceSize(feedbackSize,
+                                                   deviceProperties.limits.minStorageBufferOffsetAlignment);
+
+    createBuffer(&virtualTextureFeedbackBuffer, virtualTextureFeedbackStride * swapchainImagesCount,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+    memoryAllocator.allocateBufferMemory(virtualTextureFeedbackBuffer,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &virtualTextureFeedbackMemory);
+
+    memset(virtualTextureFeedbackMemory.mappedData, 0, virtualTextureFeedbackStride * swapchainImagesCount);
+
+    if (virtualTextureSparse) {
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, nullptr, 0};
+
+        for (uint32_t i = 0; i < framesInFlight; i++)
+            VKASSERT_SUCCESS(vkCreateSemaphore(logicalDevices[0], &semaphoreCreateInfo, nullptr,
+                                               virtualTextureBindSemaphores + i));
+    }
+
+    std::cout << "Virtual Texture Buffers created successfully." << std::endl;
+}
+
+void VulkanEngine::updateVirtualTexture(uint32_t drawableImageIndex) {
+    if (virtualTextureImage == VK_NULL_HANDLE)
+        return;
+
+    uint64_t frame = ++virtualTextureFrame;
+    uint32_t rootPageIndex = virtualTextureResidency.getPageCount() - 1;
+    std::vector<uint32_t> retiredPages;
+    std::vector<uint32_t> missingPages;
+
+    // Every frame in flight was recorded after the slots evicted framesInFlight frames ago stopped being referenced.
+    if (frame > framesInFlight)
+        virtualTextureResidency.retireSlots(frame - framesInFlight, &retiredPages);
+
+    // Whatever was sampled, the root page is always wanted. Cleared for the next frame to render to the image.
+    uint32_t *feedback = (uint32_t *) (virtualTextureFeedbackMemory.mappedData +
+                                       virtualTextureFeedbackStride * drawableImageIndex);
+
+    feedback[rootPageIndex / 32] |= 1u << (rootPageIndex % 32);
+
+    virtualTextureResidency.request(feedback, frame, &missingPages);
+
+    memset(feedback, 0, sizeof(uint32_t) * ((virtualTextureResidency.getPageCount() + 31) / 32));
+
+    std::vector<VkSparseImageMemoryBind> sparseImageMemoryBinds;
+    StagingRegion pageTableRegion;
+    VkDeviceSize pageTableSize = sizeof(uint32_t) * virtualTexturePageTable.size();
+    uint32_t tileSize = VIRTUAL_TEXTURE_PAGE_SIZE + 2 * virtualTexturePageBorder;
+
+    // Pages only take what the frame staging ring has left beyond a quarter of it, which stays free for
+    // stageFrameUpload() until the next frame. The rest are deferred, the frames sampling them request them again.
+    // Besides the page table, one region's worth is kept back for the skip at the end of the ring.
+    VkDeviceSize reservedSize = frameStagingRing.getSize() / 4 + pageTableSize +
+                                std::max(pageTableSize, virtualTexturePageBytes);
+    VkDeviceSize freeSize = frameStagingRing.getFreeSize();
+    uint32_t pageLimit = 0;
+
+    if (freeSize >= reservedSize)
+        pageLimit = (uint32_t) std::min<VkDeviceSize>((freeSize - reservedSize) / (virtualTexturePageBytes + 16),
+                                                      settings.virtualTexturePagesPerFrame);
+
+    // The page table goes first, it has to be uploaded with the pages it points to. Without room for it, nothing
+    // changes this frame.
+    if (freeSize >= reservedSize &&
+        ((!missingPages.empty() && pageLimit > 0) || virtualTextureResidency.isPageTableDirty()) &&
+        frameStagingRing.allocate(pageTableSize, 16, &pageTableRegion)) {
+        uint32_t streamedPageCount = 0;
+
+        for (uint32_t pageIndex : missingPages) {
+            if (streamedPageCount == pageLimit)
+                break;
+
+            StagingRegion pageRegion;
+            uint32_t slot;
+
+            if (!frameStagingRing.allocate(virtualTexturePageBytes, 16, &pageRegion))
+                break;
+
+            // The evicted slots free up framesInFlight frames later.
+            if (!virtualTextureResidency.makeResident(pageIndex, frame, &slot)) {
+                virtualTextureResidency.evictLeastRecentlyUsed(frame, settings.virtualTexturePagesPerFrame -
+                                                                      streamedPageCount);
+                break;
+            }
+
+            writeVirtualTexturePage(pageIndex, pageRegion.data);
+
+            uint32_t level, pageX, pageY;
+
+            virtualTextureResidency.getPageLocation(pageIndex, &level, &pageX, &pageY);
+
+            PendingImageCopy pendingCopy;
+            pendingCopy.dstImage = virtualTextureImage;
+            pendingCopy.region = {};
+            pendingCopy.region.bufferOffset = pageRegion.offset;
+            pendingCopy.region.bufferRowLength = 0;
+            pendingCopy.region.bufferImageHeight = 0;
+            pendingCopy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            pendingCopy.region.imageSubresource.baseArrayLayer = 0;
+            pendingCopy.region.imageSubresource.layerCount = 1;
+            pendingCopy.region.imageExtent = {tileSize, tileSize, 1};
+
+            if (virtualTextureSparse) {
+                // The page's own place in the image, backed by the slot's memory.
+                VkSparseImageMemoryBind sparseImageMemoryBind = {};
+                sparseImageMemoryBind.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                sparseImageMemoryBind.subresource.mipLevel = level;
+                sparseImageMemoryBind.subresource.arrayLayer = 0;
+                sparseImageMemoryBind.offset = {(int32_t) (pageX * VIRTUAL_TEXTURE_PAGE_SIZE),
+                                                (int32_t) (pageY * VIRTUAL_TEXTURE_PAGE_SIZE), 0};
+                sparseImageMemoryBind.extent = {VIRTUAL_TEXTURE_PAGE_SIZE, VIRTUAL_TEXTURE_PAGE_SIZE, 1};
+                sparseImageMemoryBind.memory = virtualTextureMemory.memory;
+                sparseImageMemoryBind.memoryOffset = virtualTextureMemory.offset + virtualTexturePageBytes * slot;
+                sparseImageMemoryBind.flags = 0;
+
+                sparseImageMemoryBinds.push_back(sparseImageMemoryBind);
+
+                pendingCopy.region.imageSubresource.mipLevel = level;
+                pendingCopy.region.imageOffset = sparseImageMemoryBind.offset;
+            } else {
+                // The slot's tile of the cache image, whatever the level.
+                pendingCopy.region.imageSubresource.mipLevel = 0;
+                pendingCopy.region.imageOffset = {(int32_t) ((slot % virtualTextureSlotsPerSide) * tileSize),
+                                                  (int32_t) ((slot / virtualTextureSlotsPerSide) * tileSize), 0};
+            }
+
+            pendingFrameImageCopies.push_back(pendingCopy);
+
+            streamedPageCount++;
+        }
+
+        if (virtualTextureResidency.isPageTableDirty()) {
+            virtualTextureResidency.writePageTable(virtualTexturePageTable.data());
+
+            memcpy(pageTableRegion.data, virtualTexturePageTable.data(), pageTableSize);
+
+            PendingBufferCopy pendingCopy;
+            pendingCopy.dstBuffer = virtualTexturePageTableBuffer;
+            pendingCopy.region.srcOffset = pageTableRegion.offset;
+            pendingCopy.region.dstOffset = 0;
+            pendingCopy.region.size = pageTableSize;
+
+            pendingFrameBufferCopies.push_back(pendingCopy);
+        }
+    }
+
+    if (!virtualTextureSparse)
+        return;
+
+    // Retired pages lose their memory, unless they just became resident again in another slot.
+    for (uint32_t pageIndex : retiredPages) {
+        if (virtualTextureResidency.isResident(pageIndex))
+            continue;
+
+        uint32_t level, pageX, pageY;
+
+        virtualTextureResidency.getPageLocation(pageIndex, &level, &pageX, &pageY);
+
+        VkSparseImageMemoryBind sparseImageMemoryBind = {};
+        sparseImageMemoryBind.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        sparseImageMemoryBind.subresource.mipLevel = level;
+        sparseImageMemoryBind.subresource.arrayLayer = 0;
+        sparseImageMemoryBind.offset = {(int32_t) (pageX * VIRTUAL_TEXTURE_PAGE_SIZE),
+                                        (int32_t) (pageY * VIRTUAL_TEXTURE_PAGE_SIZE), 0};
+        sparseImageMemoryBind.extent = {VIRTUAL_TEXTURE_PAGE_SIZE, VIRTUAL_TEXTURE_PAGE_SIZE, 1};
+        sparseImageMemoryBind.memory = VK_NULL_HANDLE;
+        sparseImageMemoryBind.memoryOffset = 0;
+        sparseImageMemoryBind.flags = 0;
+
+        sparseImageMemoryBinds.push_back(sparseImageMemoryBind);
+    }
+
+    if (sparseImageMemoryBinds.empty())
+        return;
+
+    VkSparseImageMemoryBindInfo sparseImageMemoryBindInfo = {};
+    sparseImageMemoryBindInfo.image = virtualTextureImage;
+    sparseImageMemoryBindInfo.bindCount = (uint32_t) sparseImageMemoryBinds.size();
+    sparseImageMemoryBindInfo.pBinds = sparseImageMemoryBinds.data();
+
+    // On the graphics queue, the frame's submission waits for it before copying into the pages.
+    VkBindSparseInfo bindSparseInfo = {};
+    bindSparseInfo.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    bindSparseInfo.pNext = nullptr;
+    bindSparseInfo.waitSemaphoreCount = 0;
+    bindSparseInfo.pWaitSemaphores = nullptr;
+    bindSparseInfo.imageBindCount = 1;
+    bindSparseInfo.pImageBinds = &sparseImageMemoryBindInfo;
+    bindSparseInfo.signalSemaphoreCount = 1;
+    bindSparseInfo.pSignalSemaphores = virtualTextureBindSemaphores + currentFrame;
+
+    VKASSERT_SUCCESS(vkQueueBindSparse(graphicsQueue, 1, &bindSparseInfo, VK_NULL_HANDLE));
+
+    virtualTextureBindPending = true;
+}
+
+void VulkanEngine::writeVirtualTexturePage(uint32_t pageIndex, uint8_t *page) {
+    uint32_t level, pageX, pageY;
+
+    virtualTextureResidency.getPageLocation(pageIndex, &level, &pageX, &pageY);
+
+    // In texels of the page's level, the border reaches into the neighbouring pages.
+    uint32_t tileSize = VIRTUAL_TEXTURE_PAGE_SIZE + 2 * virtualTexturePageBorder;
+    int32_t tileX = (int32_t) (pageX * VIRTUAL_TEXTURE_PAGE_SIZE) - (int32_t) virtualTexturePageBorder;
+    int32_t tileY = (int32_t) (pageY * VIRTUAL_TEXTURE_PAGE_SIZE) - (int32_t) virtualTexturePageBorder;
+    std::vector<uint8_t> row(tileSize * 4);
+
+    // Row by row, so page (staging memory) is written only once. Texels between the textures are left black.
+    for (uint32_t y = 0; y < tileSize; y++) {
+        int32_t levelY = tileY + (int32_t) y;
+
+        std::fill(row.begin(), row.end(), 0);
+
+        for (const VirtualTextureSource &virtualTextureSource : virtualTextureSources) {
+            const TextureDescription &textureDescription = *virtualTextureSource.textureDescription;
+            int32_t sourceX = (int32_t) (textureDescription.atlasX >> level);
+            int32_t sourceY = (int32_t) (textureDescription.atlasY >> level);
+            int32_t sourceWidth = (int32_t) std::max(textureDescription.width >> level, 1u);
+            int32_t sourceHeight = (int32_t) std::max(textureDescription.height >> level, 1u);
+            int32_t begin = std::max(tileX, sourceX);
+            int32_t end = std::min(tileX + (int32_t) tileSize, sourceX + sourceWidth);
+
+            if (levelY < sourceY || levelY >= sourceY + sourceHeight || begin >= end)
+                continue;
+
+            const uint8_t *sourceRow = virtualTextureSource.chain.data() +
+                                       getMipChainSize(textureDescription.width, textureDescription.height, 0, level) +
+                                       ((size_t) (levelY - sourceY) * sourceWidth + (begin - sourceX)) * 4;
+
+            memcpy(row.data() + (begin - tileX) * 4, sourceRow, (size_t) (end - begin) * 4);
+        }
+
+        memcpy(page + (size_t) y * tileSize * 4, row.data(), row.size());
     }
 }
 
 typedef const C_STRUCT aiScene *FNP_aiImportFile(const char *, unsigned int);
 
+typedef void FNP_aiReleaseImport(const C_STRUCT aiScene *);
+
 void VulkanEngine::loadMesh(const char *fileName) {
-    std::string err;
+    const uint32_t importFlags = aiProcess_ConvertToLeftHanded | aiProcess_Triangulate | aiProcess_GenNormals |
+                                 aiProcess_JoinIdenticalVertices | aiProcess_CalcTangentSpace;
+
+    std::string meshPath(resourcesPath);
+
+    meshPath.append(fileName);
+
+    std::string meshCachePath(meshPath);
+
+    meshCachePath.append(".meshcache");
+
+    uint64_t sourceHash = 0;
+
+    if (!hashMeshSource(meshPath, importFlags, &sourceHash))
+        throw VulkanException("Couldn't read obj file.");
+
+    if (loadMeshCache(meshCachePath, sourceHash, importFlags))
+        return;
+
+    importMesh(meshPath, importFlags);
+    optimizeMeshes();
+
+    std::vector<MeshCacheSource> cacheSources(meshCount);
+
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        meshData[meshIndex].vertices = sortedAttributes[meshIndex].data();
+        meshData[meshIndex].vertexCount = (uint32_t) sortedAttributes[meshIndex].size();
+        meshData[meshIndex].indices = sortedIndices[meshIndex].data();
+        meshData[meshIndex].indexCount = (uint32_t) sortedIndices[meshIndex].size();
+
+        cacheSources[meshIndex].vertexData = meshData[meshIndex].vertices;
+        cacheSources[meshIndex].vertexCount = meshData[meshIndex].vertexCount;
+        cacheSources[meshIndex].indexData = meshData[meshIndex].indices;
+        cacheSources[meshIndex].indexCount = meshData[meshIndex].indexCount;
+    }
+
+    if (writeMeshCache(meshCachePath, sourceHash, importFlags, sizeof(Attribute<float>), cacheSources))
+        std::cout << "Mesh cache written to '" << meshCachePath << "'." << std::endl;
+    else
+        std::cerr << "Couldn't write mesh cache '" << meshCachePath << "'." << std::endl;
+}
+
+bool VulkanEngine::loadMeshCache(const std::string &meshCachePath, uint64_t sourceHash, uint32_t importFlags) {
+    if (!meshCache.open(meshCachePath, sourceHash, importFlags, sizeof(Attribute<float>)))
+        return false;
+
+    if (meshCache.getMeshCount() > MAX_MESHES) {
+        meshCache.close();
+
+        return false;
+    }
+
+    meshCount = meshCache.getMeshCount();
 
+    // Nothing is copied, only the pages commitBuffers() stages from are ever faulted in.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        meshData[meshIndex].vertices = (const Attribute<float> *) meshCache.getVertexData(meshIndex);
+        meshData[meshIndex].vertexCount = meshCache.getVertexCount(meshIndex);
+        meshData[meshIndex].indices = meshCache.getIndexData(meshIndex);
+        meshData[meshIndex].indexCount = meshCache.getIndexCount(meshIndex);
+    }
+
+    std::cout << "Mesh cache '" << meshCachePath << "' mapped, " << meshCount << " meshes." << std::endl;
+
+    return true;
+}
+
+void VulkanEngine::importMesh(const std::string &meshPath, uint32_t importFlags) {
+#ifdef _WIN32
     HMODULE assimpModule = LoadLibrary("assimp-vc140-mt.dll");
 
     if (assimpModule == NULL)
         throw std::exception();
 
     FNP_aiImportFile *_aiImportFile = (FNP_aiImportFile *) GetProcAddress(assimpModule, "aiImportFile");
+    FNP_aiReleaseImport *_aiReleaseImport = (FNP_aiReleaseImport *) GetProcAddress(assimpModule, "aiReleaseImport");
+#else
+    void *assimpModule = dlopen("libassimp.so", RTLD_NOW);
 
-    cachedScene = (aiScene *) malloc(sizeof(aiScene));
-
-    std::string meshPath(resourcesPath);
-
-    meshPath.append(fileName);
+    if (assimpModule == NULL)
+        throw VulkanException("Couldn't load libassimp.so.");
 
-    const aiScene *scene = _aiImportFile(meshPath.c_str(),
-                                         aiProcess_ConvertToLeftHanded | aiProcess_Triangulate | aiProcess_GenNormals |
-                                         aiProcess_JoinIdenticalVertices | aiProcess_CalcTangentSpace);
-    memcpy(cachedScene, scene, sizeof(aiScene));
+    FNP_aiImportFile *_aiImportFile = (FNP_aiImportFile *) dlsym(assimpModule, "aiImportFile");
+    FNP_aiReleaseImport *_aiReleaseImport = (FNP_aiReleaseImport *) dlsym(assimpModule, "aiReleaseImport");
+#endif
 
-    std::cout << "Number of Meshes reported from Assimp: " << cachedScene->mNumMeshes << std::endl;
+    const aiScene *scene = _aiImportFile(meshPath.c_str(), importFlags);
 
     if (scene == NULL) {
         throw VulkanException("Couldn't load obj file: ");
@@ -2833,38 +4826,197 @@ void VulkanEngine::loadMesh(const char *fileName) {
         std::cout << "OBj File Loaded successfully." << std::endl;
     }
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
+    std::cout << "Number of Meshes reported from Assimp: " << scene->mNumMeshes << std::endl;
 
-        uint32_t numVertices = cachedScene->mMeshes[meshIndex]->mNumVertices;
-        uint32_t numFaces = cachedScene->mMeshes[meshIndex]->mNumFaces;
-        uint32_t numIndices = numFaces * 3; // Triangulated
+    if (scene->mNumMeshes > MAX_MESHES)
+        throw VulkanException("Too many meshes in obj file.");
+
+    meshCount = scene->mNumMeshes;
+
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+
+        uint32_t numVertices = scene->mMeshes[meshIndex]->mNumVertices;
+        uint32_t numFaces = scene->mMeshes[meshIndex]->mNumFaces;
 
         for (int i = 0; i < numVertices; i++) {
 
             Attribute<float> tmpAttribute = {};
             memcpy(((byte *) &tmpAttribute) + offsetof(Attribute<float>, position),
-                   &((aiVector3D *) (cachedScene->mMeshes[meshIndex]->mVertices))[i].x, 3 * sizeof(float));
+                   &((aiVector3D *) (scene->mMeshes[meshIndex]->mVertices))[i].x, 3 * sizeof(float));
             memcpy(((byte *) &tmpAttribute) + offsetof(Attribute<float>, normal),
-                   &((aiVector3D *) (cachedScene->mMeshes[meshIndex]->mNormals))[i].x, 3 * sizeof(float));
+                   &((aiVector3D *) (scene->mMeshes[meshIndex]->mNormals))[i].x, 3 * sizeof(float));
             memcpy(((byte *) &tmpAttribute) + offsetof(Attribute<float>, uv),
-                   &((aiVector3D *) (cachedScene->mMeshes[meshIndex]->mTextureCoords[0]))[i].x, 2 * sizeof(float));
+                   &((aiVector3D *) (scene->mMeshes[meshIndex]->mTextureCoords[0]))[i].x, 2 * sizeof(float));
             memcpy(((byte *) &tmpAttribute) + offsetof(Attribute<float>, tangent),
-                   &((aiVector3D *) (cachedScene->mMeshes[meshIndex]->mTangents))[i].x, 3 * sizeof(float));
+                   &((aiVector3D *) (scene->mMeshes[meshIndex]->mTangents))[i].x, 3 * sizeof(float));
             memcpy(((byte *) &tmpAttribute) + offsetof(Attribute<float>, bitangent),
-                   &((aiVector3D *) (cachedScene->mMeshes[meshIndex]->mBitangents))[i].x, 3 * sizeof(float));
+                   &((aiVector3D *) (scene->mMeshes[meshIndex]->mBitangents))[i].x, 3 * sizeof(float));
 
             sortedAttributes[meshIndex].push_back(tmpAttribute);
         }
 
         for (int i = 0; i < numFaces; i++) {
-            for (int j = 0; j < ((aiFace *) (cachedScene->mMeshes[meshIndex]->mFaces))[i].mNumIndices; j++) {
-                uint32_t index = ((unsigned int *) (((aiFace *) (cachedScene->mMeshes[meshIndex]->mFaces))[i].mIndices))[j];
+            for (int j = 0; j < ((aiFace *) (scene->mMeshes[meshIndex]->mFaces))[i].mNumIndices; j++) {
+                uint32_t index = ((unsigned int *) (((aiFace *) (scene->mMeshes[meshIndex]->mFaces))[i].mIndices))[j];
                 sortedIndices[meshIndex].push_back(index);
             }
         }
+    }
+
+    if (_aiReleaseImport != NULL)
+        _aiReleaseImport(scene);
+}
+
+void VulkanEngine::releaseMeshData() {
+    meshCache.close();
+
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        std::vector<Attribute<float>>().swap(sortedAttributes[meshIndex]);
+        std::vector<uint32_t>().swap(sortedIndices[meshIndex]);
+
+        meshData[meshIndex] = {};
+    }
+}
+
+void VulkanEngine::optimizeMeshes() {
+    std::vector<std::future<void>> optimizeFutures;
+    std::vector<VertexCacheStatistics> statistics(meshCount * 2);
+
+    // Meshes are independent, each task only touches its own vertices, indices and statistics.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        optimizeFutures.push_back(threadPool.submit([this, meshIndex, &statistics]() {
+            std::vector<Attribute<float>> &attributes = sortedAttributes[meshIndex];
+            std::vector<uint32_t> &indices = sortedIndices[meshIndex];
+            uint32_t vertexCount = (uint32_t) attributes.size();
+
+            statistics[meshIndex * 2] = analyzeVertexCache(indices.data(), indices.size(), vertexCount,
+                                                           MESH_OPTIMIZER_CACHE_SIZE);
+            statistics[meshIndex * 2 + 1] = statistics[meshIndex * 2];
+
+            if (indices.empty())
+                return;
+
+            // Cache order first, the overdraw clusters are cut out of it, then the vertices follow the final order.
+            optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+            optimizeOverdraw(indices.data(), indices.size(), attributes[0].position, sizeof(Attribute<float>),
+                             vertexCount, 1.05f);
+            attributes.resize(optimizeVertexFetch(indices.data(), indices.size(), attributes.data(), vertexCount,
+                                                  sizeof(Attribute<float>)));
+
+            statistics[meshIndex * 2 + 1] = analyzeVertexCache(indices.data(), indices.size(),
+                                                               (uint32_t) attributes.size(),
+                                                               MESH_OPTIMIZER_CACHE_SIZE);
+        }));
+    }
+
+    for (std::future<void> &optimizeFuture : optimizeFutures)
+        optimizeFuture.get();
+
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        const VertexCacheStatistics &before = statistics[meshIndex * 2];
+        const VertexCacheStatistics &after = statistics[meshIndex * 2 + 1];
+
+        std::cout << "Mesh " << meshIndex << " optimized, ACMR " << before.acmr << " -> " << after.acmr << ", ATVR "
+                  << before.atvr << " -> " << after.atvr << " (" << before.transformedVertexCount << " -> "
+                  << after.transformedVertexCount << " vertex shader invocations)." << std::endl;
+    }
+}
+
+void VulkanEngine::splitMeshesIntoMeshlets() {
+    if (!settings.meshletCulling)
+        return;
+
+    std::vector<std::future<void>> meshletFutures;
+
+    // The indices stay as loaded, vertex cache order already keeps the triangles of a meshlet close together.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        meshletFutures.push_back(threadPool.submit([this, meshIndex]() {
+            const MeshData &mesh = meshData[meshIndex];
+
+            if (mesh.indexCount == 0)
+                return;
+
+            buildMeshlets(mesh.indices, mesh.indexCount, mesh.vertices[0].position, mesh.vertices[0].normal,
+                          sizeof(Attribute<float>), mesh.vertexCount, &meshlets[meshIndex]);
+        }));
+    }
+
+    for (std::future<void> &meshletFuture : meshletFutures)
+        meshletFuture.get();
+
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        uint32_t coneCount = 0;
+
+        for (const Meshlet &meshlet : meshlets[meshIndex])
+            if (meshlet.coneCutoff <= 1.0f)
+                coneCount++;
+
+        std::cout << "Mesh " << meshIndex << " split into " << meshlets[meshIndex].size() << " meshlets, "
+                  << coneCount << " with a normal cone." << std::endl;
+    }
+}
+
+void VulkanEngine::splitVertices(uint16_t meshIndex, std::vector<VertexPosition<float>> *positions,
+                                 std::vector<VertexAttributes<float>> *attributes) {
+    const Attribute<float> *vertices = meshData[meshIndex].vertices;
+    size_t vertexCount = meshData[meshIndex].vertexCount;
+
+    positions->resize(vertexCount);
+    attributes->resize(vertexCount);
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        memcpy((*positions)[i].position, vertices[i].position, sizeof(vertices[i].position));
+        memcpy((*attributes)[i].normal, vertices[i].normal, sizeof(vertices[i].normal));
+        memcpy((*attributes)[i].uv, vertices[i].uv, sizeof(vertices[i].uv));
+        memcpy((*attributes)[i].tangent, vertices[i].tangent, sizeof(vertices[i].tangent));
+        memcpy((*attributes)[i].bitangent, vertices[i].bitangent, sizeof(vertices[i].bitangent));
+    }
+}
+
+void VulkanEngine::quantizeVertices(uint16_t meshIndex, std::vector<VertexPosition<QuantizedVertex>> *positions,
+                                    std::vector<VertexAttributes<QuantizedVertex>> *attributes) {
+    const Attribute<float> *vertices = meshData[meshIndex].vertices;
+    size_t vertexCount = meshData[meshIndex].vertexCount;
+    float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+    float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+
+    for (size_t i = 0; i < vertexCount; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            boundsMin[axis] = (i == 0) ? (vertices[i].position[axis])
+                                       : (std::min(boundsMin[axis], vertices[i].position[axis]));
+            boundsMax[axis] = (i == 0) ? (vertices[i].position[axis])
+                                       : (std::max(boundsMax[axis], vertices[i].position[axis]));
+        }
+    }
+
+    PositionDequantization &positionDequantization = positionDequantizations[meshIndex];
+
+    for (int axis = 0; axis < 3; axis++) {
+        positionDequantization.offset[axis] = boundsMin[axis];
+        positionDequantization.scale[axis] = boundsMax[axis] - boundsMin[axis];
+    }
+
+    positionDequantization.offset[3] = 0.0f;
+    positionDequantization.scale[3] = 0.0f;
+
+    positions->resize(vertexCount);
+    attributes->resize(vertexCount);
 
-        vertexBuffersSizes[meshIndex] = sortedAttributes[meshIndex].size() * sizeof(Attribute<float>);
-        indexBuffersSizes[meshIndex] = sortedIndices[meshIndex].size() * 4;
+    for (size_t i = 0; i < vertexCount; i++) {
+        VertexPosition<QuantizedVertex> &position = (*positions)[i];
+        VertexAttributes<QuantizedVertex> &attribute = (*attributes)[i];
+
+        for (int axis = 0; axis < 3; axis++)
+            position.position[axis] = quantizeUnorm16(
+                    (positionDequantization.scale[axis] > 0.0f)
+                    ? ((vertices[i].position[axis] - boundsMin[axis]) / positionDequantization.scale[axis])
+                    : (0.0f));
+
+        position.position[3] = 0;
+        attribute.uv[0] = quantizeHalf(vertices[i].uv[0]);
+        attribute.uv[1] = quantizeHalf(vertices[i].uv[1]);
+
+        encodeTangentFrame(vertices[i].normal, vertices[i].tangent, vertices[i].bitangent, attribute.tangentFrame);
     }
 }
 
@@ -2887,24 +5039,25 @@ VkMemoryRequirements VulkanEngine::createBuffer(VkBuffer *buffer, VkDeviceSize s
     return uniformBufferMemoryRequirements;
 }
 
-VkMemoryRequirements VulkanEngine::createTexture(VkImage *textureImage, VkImageUsageFlags usageFlags) {
+VkMemoryRequirements VulkanEngine::createTexture(VkImage *textureImage, const TextureDescription &textureDescription,
+                                                 uint32_t layerCount, VkImageUsageFlags usageFlags) {
     VkImageCreateInfo textureImageCreateInfo = {};
 
     textureImageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     textureImageCreateInfo.pNext = nullptr;
     textureImageCreateInfo.flags = VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
     textureImageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-    textureImageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
-    textureImageCreateInfo.extent.width = 1024;
-    textureImageCreateInfo.extent.height = 1024;
+    textureImageCreateInfo.format = textureDescription.format;
+    textureImageCreateInfo.extent.width = textureDescription.width;
+    textureImageCreateInfo.extent.height = textureDescription.height;
     textureImageCreateInfo.extent.depth = 1;
-    textureImageCreateInfo.arrayLayers = 1;
+    textureImageCreateInfo.arrayLayers = layerCount;
     textureImageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     textureImageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     textureImageCreateInfo.usage = usageFlags;
-    textureImageCreateInfo.mipLevels = 1;
+    textureImageCreateInfo.mipLevels = textureDescription.levelCount;
     textureImageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    textureImageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
+    textureImageCreateInfo.tiling = settings.textureTiling;
     textureImageCreateInfo.queueFamilyIndexCount = 0;
     textureImageCreateInfo.pQueueFamilyIndices = nullptr;
 
@@ -2917,213 +5070,160 @@ VkMemoryRequirements VulkanEngine::createTexture(VkImage *textureImage, VkImageU
     return textureImageMemoryRequirements;
 }
 
-void VulkanEngine::createTextureView(VkImageView *textureImageView, VkImage textureImage) {
+void VulkanEngine::createTextureView(VkImageView *textureImageView, VkImage textureImage,
+                                     const TextureDescription &textureDescription, uint32_t layerCount) {
     VkImageViewCreateInfo textureImageViewCreateInfo = {};
 
     textureImageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     textureImageViewCreateInfo.pNext = NULL;
-    textureImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    textureImageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    // Arrays even with a single layer, the shaders sample every texture the same way, atlas or not.
+    textureImageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    textureImageViewCreateInfo.format = textureDescription.format;
     textureImageViewCreateInfo.flags = 0;
     textureImageViewCreateInfo.image = textureImage;
     textureImageViewCreateInfo.subresourceRange = {};
     textureImageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     textureImageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-    textureImageViewCreateInfo.subresourceRange.levelCount = 1;
+    textureImageViewCreateInfo.subresourceRange.levelCount = textureDescription.levelCount;
     textureImageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-    textureImageViewCreateInfo.subresourceRange.layerCount = 1;
+    textureImageViewCreateInfo.subresourceRange.layerCount = layerCount;
 
     VKASSERT_SUCCESS(vkCreateImageView(logicalDevices[0], &textureImageViewCreateInfo, nullptr, textureImageView));
 }
 
 void VulkanEngine::commitTextures() {
-    VkCommandBuffer commandBuffer;
-    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-    commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandBufferAllocateInfo.pNext = nullptr;
-    commandBufferAllocateInfo.commandBufferCount = 1;
-    commandBufferAllocateInfo.commandPool = transferCommandPool;
-    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    VkImage *textureImages[3] = {colorTextureImagesDevice.data(), normalTextureImagesDevice.data(),
+                                 specTextureImagesDevice.data()};
+    const TextureDescription *textureDescriptions[3] = {colorTextureDescriptions.data(),
+                                                        normalTextureDescriptions.data(),
+                                                        specTextureDescriptions.data()};
+
+    // KTX2 textures are read on this thread, their uploads may submit the transfer batch at any time. So they go
+    // first, before any staging memory is being written by the pool.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++)
+        for (int textureIndex = 0; textureIndex < 3; textureIndex++)
+            if (textureDescriptions[textureIndex][meshIndex].format != VK_FORMAT_R8G8B8A8_UNORM)
+                uploadCompressedTexture(textureImages[textureIndex][meshIndex],
+                                        textureDescriptions[textureIndex][meshIndex],
+                                        getTexturePath(meshIndex, textureIndex, ".ktx2"));
+
+    // Atlas textures are copied into their regions with no barriers between them, the whole atlas is transitioned
+    // once up front and released once all of them are in.
+    if (textureAtlasImage != VK_NULL_HANDLE)
+        recordTextureTransition(textureAtlasImage, textureAtlasLevelCount, textureAtlasLayerCount);
+
+    std::vector<PendingTextureDecode> pendingDecodes;
+    uint32_t decodedTextureCount = 0;
+    std::chrono::steady_clock::time_point decodeBegin = std::chrono::steady_clock::now();
+
+    // The PNGs are decoded on the pool, each straight into its staging region.
+    for (uint16_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+        for (int textureIndex = 0; textureIndex < 3; textureIndex++) {
+            const TextureDescription &textureDescription = textureDescriptions[textureIndex][meshIndex];
+
+            if (textureDescription.format != VK_FORMAT_R8G8B8A8_UNORM || textureDescription.virtualTexture)
+                continue;
+
+            PendingTextureDecode pendingDecode;
+            VkDeviceSize chainSize = getMipChainSize(textureDescription.width, textureDescription.height, 0,
+                                                     textureDescription.levelCount);
+
+            pendingDecode.textureImage = textureImages[textureIndex][meshIndex];
+            pendingDecode.textureDescription = &textureDescription;
+
+            uint8_t *chain;
+
+            // Chains bigger than uploadBuffer()'s chunks are staged a piece at a time, once decoded.
+            if (chainSize > stagingRing.getSize() / 4) {
+                pendingDecode.chain.resize(chainSize);
+                chain = pendingDecode.chain.data();
+            } else {
+                // Making room submits the transfer batch, the regions still being written must not be part of it.
+                if (!stagingRing.allocate(chainSize, 16, &pendingDecode.stagingRegion)) {
+                    finishTextureDecodes(&pendingDecodes);
+                    stageUpload(chainSize, 16, &pendingDecode.stagingRegion);
+                }
+
+                chain = pendingDecode.stagingRegion.data;
+            }
 
-    VKASSERT_SUCCESS(vkAllocateCommandBuffers(logicalDevices[0], &commandBufferAllocateInfo, &commandBuffer));
+            std::string pngPath = getTexturePath(meshIndex, textureIndex, ".png");
+            bool normalMap = textureIndex == 1;
 
-    VkCommandBufferBeginInfo commandBufferBeginInfo = {};
-    commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    commandBufferBeginInfo.pNext = nullptr;
-    commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    commandBufferBeginInfo.pInheritanceInfo = nullptr;
+            pendingDecode.future = threadPool.submit([this, pngPath, normalMap, &textureDescription, chain]() {
+                decodeTexture(pngPath, normalMap, textureDescription, chain);
+            });
 
-    VKASSERT_SUCCESS(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+            pendingDecodes.push_back(std::move(pendingDecode));
+            decodedTextureCount++;
+        }
+    }
 
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-
-        VkImageMemoryBarrier imageMemoryBarriers[6];
-        imageMemoryBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarriers[0].pNext = nullptr;
-        imageMemoryBarriers[0].srcAccessMask = 0;
-        imageMemoryBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageMemoryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageMemoryBarriers[0].image = colorTextureImagesDevice[meshIndex];
-        imageMemoryBarriers[0].subresourceRange.layerCount = 1;
-        imageMemoryBarriers[0].subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarriers[0].subresourceRange.levelCount = 1;
-        imageMemoryBarriers[0].subresourceRange.baseMipLevel = 0;
-        imageMemoryBarriers[0].srcQueueFamilyIndex = transferQueueFamilyIndex;
-        imageMemoryBarriers[0].dstQueueFamilyIndex = transferQueueFamilyIndex;
-
-        imageMemoryBarriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarriers[1].pNext = nullptr;
-        imageMemoryBarriers[1].srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-        imageMemoryBarriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        imageMemoryBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        imageMemoryBarriers[1].image = colorTextureImages[meshIndex];
-        imageMemoryBarriers[1].subresourceRange.layerCount = 1;
-        imageMemoryBarriers[1].subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarriers[1].subresourceRange.levelCount = 1;
-        imageMemoryBarriers[1].subresourceRange.baseMipLevel = 0;
-        imageMemoryBarriers[1].srcQueueFamilyIndex = transferQueueFamilyIndex;
-        imageMemoryBarriers[1].dstQueueFamilyIndex = transferQueueFamilyIndex;
-
-        imageMemoryBarriers[2].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarriers[2].pNext = nullptr;
-        imageMemoryBarriers[2].srcAccessMask = 0;
-        imageMemoryBarriers[2].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageMemoryBarriers[2].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarriers[2].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageMemoryBarriers[2].image = normalTextureImagesDevice[meshIndex];
-        imageMemoryBarriers[2].subresourceRange.layerCount = 1;
-        imageMemoryBarriers[2].subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarriers[2].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarriers[2].subresourceRange.levelCount = 1;
-        imageMemoryBarriers[2].subresourceRange.baseMipLevel = 0;
-        imageMemoryBarriers[2].srcQueueFamilyIndex = transferQueueFamilyIndex;
-        imageMemoryBarriers[2].dstQueueFamilyIndex = transferQueueFamilyIndex;
-
-        imageMemoryBarriers[3].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarriers[3].pNext = nullptr;
-        imageMemoryBarriers[3].srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-        imageMemoryBarriers[3].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        imageMemoryBarriers[3].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarriers[3].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        imageMemoryBarriers[3].image = normalTextureImages[meshIndex];
-        imageMemoryBarriers[3].subresourceRange.layerCount = 1;
-        imageMemoryBarriers[3].subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarriers[3].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarriers[3].subresourceRange.levelCount = 1;
-        imageMemoryBarriers[3].subresourceRange.baseMipLevel = 0;
-        imageMemoryBarriers[3].srcQueueFamilyIndex = transferQueueFamilyIndex;
-        imageMemoryBarriers[3].dstQueueFamilyIndex = transferQueueFamilyIndex;
-
-        imageMemoryBarriers[4].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarriers[4].pNext = nullptr;
-        imageMemoryBarriers[4].srcAccessMask = 0;
-        imageMemoryBarriers[4].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageMemoryBarriers[4].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarriers[4].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageMemoryBarriers[4].image = specTextureImagesDevice[meshIndex];
-        imageMemoryBarriers[4].subresourceRange.layerCount = 1;
-        imageMemoryBarriers[4].subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarriers[4].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarriers[4].subresourceRange.levelCount = 1;
-        imageMemoryBarriers[4].subresourceRange.baseMipLevel = 0;
-        imageMemoryBarriers[4].srcQueueFamilyIndex = transferQueueFamilyIndex;
-        imageMemoryBarriers[4].dstQueueFamilyIndex = transferQueueFamilyIndex;
-
-        imageMemoryBarriers[5].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarriers[5].pNext = nullptr;
-        imageMemoryBarriers[5].srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
-        imageMemoryBarriers[5].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        imageMemoryBarriers[5].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarriers[5].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        imageMemoryBarriers[5].image = specTextureImages[meshIndex];
-        imageMemoryBarriers[5].subresourceRange.layerCount = 1;
-        imageMemoryBarriers[5].subresourceRange.baseArrayLayer = 0;
-        imageMemoryBarriers[5].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        imageMemoryBarriers[5].subresourceRange.levelCount = 1;
-        imageMemoryBarriers[5].subresourceRange.baseMipLevel = 0;
-        imageMemoryBarriers[5].srcQueueFamilyIndex = transferQueueFamilyIndex;
-        imageMemoryBarriers[5].dstQueueFamilyIndex = transferQueueFamilyIndex;
-
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
-                             nullptr, 0, nullptr, 1, imageMemoryBarriers + 0);
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
-                             0, nullptr, 1, imageMemoryBarriers + 1);
-
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
-                             nullptr, 0, nullptr, 1, imageMemoryBarriers + 2);
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
-                             0, nullptr, 1, imageMemoryBarriers + 3);
-
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
-                             nullptr, 0, nullptr, 1, imageMemoryBarriers + 4);
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
-                             0, nullptr, 1, imageMemoryBarriers + 5);
-
-        VkImageCopy region = {};
-        region.srcOffset.x = 0;
-        region.srcOffset.y = 0;
-        region.srcOffset.z = 0;
-        region.dstOffset.x = 0;
-        region.dstOffset.y = 0;
-        region.dstOffset.z = 0;
-        region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.dstSubresource.baseArrayLayer = 0;
-        region.dstSubresource.layerCount = 1;
-        region.dstSubresource.mipLevel = 0;
-        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.srcSubresource.baseArrayLayer = 0;
-        region.srcSubresource.layerCount = 1;
-        region.srcSubresource.mipLevel = 0;
-        region.extent.depth = 1;
-        region.extent.width = 1024;
-        region.extent.height = 1024;
-
-
-        vkCmdCopyImage(commandBuffer, colorTextureImages[meshIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                       colorTextureImagesDevice[meshIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-        vkCmdCopyImage(commandBuffer, normalTextureImages[meshIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                       normalTextureImagesDevice[meshIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-        vkCmdCopyImage(commandBuffer, specTextureImages[meshIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                       specTextureImagesDevice[meshIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    // Virtual textures are kept in memory instead, their pages are streamed in by the frames that sample them.
+    std::vector<std::future<void>> virtualTextureDecodes;
+
+    for (VirtualTextureSource &virtualTextureSource : virtualTextureSources) {
+        const TextureDescription *textureDescription = virtualTextureSource.textureDescription;
+
+        virtualTextureSource.chain.resize(getMipChainSize(textureDescription->width, textureDescription->height, 0,
+                                                          textureDescription->levelCount));
+
+        std::string pngPath = getTexturePath(virtualTextureSource.meshIndex, virtualTextureSource.textureIndex, ".png");
+        bool normalMap = virtualTextureSource.textureIndex == 1;
+        uint8_t *chain = virtualTextureSource.chain.data();
+
+        virtualTextureDecodes.push_back(threadPool.submit([this, pngPath, normalMap, textureDescription, chain]() {
+            decodeTexture(pngPath, normalMap, *textureDescription, chain);
+        }));
+
+        decodedTextureCount++;
     }
 
-    VKASSERT_SUCCESS(vkEndCommandBuffer(commandBuffer));
+    finishTextureDecodes(&pendingDecodes);
 
-    VkSubmitInfo queueSubmit = {};
-    queueSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    queueSubmit.pNext = nullptr;
-    queueSubmit.waitSemaphoreCount = 0;
-    queueSubmit.pWaitSemaphores = nullptr;
-    queueSubmit.pWaitDstStageMask = nullptr;
-    queueSubmit.commandBufferCount = 1;
-    queueSubmit.pCommandBuffers = &commandBuffer;
-    queueSubmit.signalSemaphoreCount = 0;
-    queueSubmit.pSignalSemaphores = nullptr;
+    for (std::future<void> &virtualTextureDecode : virtualTextureDecodes)
+        virtualTextureDecode.wait();
 
-    VKASSERT_SUCCESS(vkQueueSubmit(transferQueue, 1, &queueSubmit, VK_NULL_HANDLE));
+    for (std::future<void> &virtualTextureDecode : virtualTextureDecodes)
+        virtualTextureDecode.get();
 
-    VKASSERT_SUCCESS(vkDeviceWaitIdle(logicalDevices[0]));
+    if (textureAtlasImage != VK_NULL_HANDLE)
+        releaseTexture(textureAtlasImage, textureAtlasLevelCount, textureAtlasLayerCount);
 
-    vkFreeCommandBuffers(logicalDevices[0], transferCommandPool, 1, &commandBuffer);
+    std::cout << decodedTextureCount << " PNG textures decoded on " << threadPool.getThreadCount()
+              << " threads in " << millisecondsSince(decodeBegin) << " ms." << std::endl;
 }
 
-void VulkanEngine::destroyStagingMeans() {
-    for (uint16_t meshIndex = 0; meshIndex < cachedScene->mNumMeshes; meshIndex++) {
-        vkDestroyBuffer(logicalDevices[0], uniformBuffers[meshIndex], nullptr);
-        vkDestroyBuffer(logicalDevices[0], vertexBuffers[meshIndex], nullptr);
-        vkDestroyBuffer(logicalDevices[0], indexBuffers[meshIndex], nullptr);
+void VulkanEngine::finishTextureDecodes(std::vector<PendingTextureDecode> *pendingDecodes) {
+    // All of them finish before the first error is rethrown, none outlives the staging memory it writes to.
+    for (PendingTextureDecode &pendingDecode : *pendingDecodes)
+        pendingDecode.future.wait();
+
+    for (PendingTextureDecode &pendingDecode : *pendingDecodes) {
+        pendingDecode.future.get();
+
+        if (pendingDecode.chain.empty())
+            recordTextureUpload(pendingDecode.textureImage, *pendingDecode.textureDescription,
+                                pendingDecode.stagingRegion);
+    }
+
+    // Staging these may submit the transfer batch, only once every region above is recorded.
+    for (PendingTextureDecode &pendingDecode : *pendingDecodes) {
+        if (pendingDecode.chain.empty())
+            continue;
+
+        const TextureDescription &textureDescription = *pendingDecode.textureDescription;
+        const uint8_t *chain = pendingDecode.chain.data();
 
-        vkDestroyImage(logicalDevices[0], colorTextureImages[meshIndex], nullptr);
-        vkDestroyImage(logicalDevices[0], normalTextureImages[meshIndex], nullptr);
-        vkDestroyImage(logicalDevices[0], specTextureImages[meshIndex], nullptr);
+        uploadTextureChain(pendingDecode.textureImage, textureDescription,
+                           [&textureDescription, chain](uint32_t level, size_t offset, size_t size, uint8_t *dst) {
+                               memcpy(dst, chain + getMipChainSize(textureDescription.width,
+                                                                   textureDescription.height, 0, level) + offset,
+                                      size);
+                           });
     }
 
-    vkFreeMemory(logicalDevices[0], uniBuffersMemory, nullptr);
-    vkFreeMemory(logicalDevices[0], uniTexturesMemory, nullptr);
+    pendingDecodes->clear();
 }
 
 void VulkanEngine::createGraphicsNormalViewerPipeline() {
@@ -3144,7 +5244,7 @@ void VulkanEngine::createGraphicsNormalViewerPipeline() {
     stageCreateInfos[1].stage = VK_SHADER_STAGE_GEOMETRY_BIT;
     stageCreateInfos[1].module = graphicsNormalViewerGeometryShaderModule;
     stageCreateInfos[1].pName = u8"main";
-    stageCreateInfos[1].pSpecializationInfo = nullptr;
+    stageCreateInfos[1].pSpecializationInfo = &shaderSpecializationInfo;
 
     stageCreateInfos[2].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     stageCreateInfos[2].pNext = nullptr;
@@ -3154,63 +5254,44 @@ void VulkanEngine::createGraphicsNormalViewerPipeline() {
     stageCreateInfos[2].pName = u8"main";
     stageCreateInfos[2].pSpecializationInfo = nullptr;
 
-    vertexBindingDescription.binding = 0;
-    vertexBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    vertexBindingDescription.stride = sizeof(Attribute<float>);
-
+    VkVertexInputBindingDescription vertexBindingDescriptions[2];
     VkVertexInputAttributeDescription vertexAttributeDescriptions[5];
+    uint32_t vertexBindingDescriptionCount = 0;
+    uint32_t vertexAttributeDescriptionCount = describeVertexInput(false, vertexBindingDescriptions,
+                                                                   &vertexBindingDescriptionCount,
+                                                                   vertexAttributeDescriptions);
 
-    vertexAttributeDescriptions[0].binding = 0;
-    vertexAttributeDescriptions[0].location = 0;
-    vertexAttributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[0].offset = offsetof(Attribute<float>, position);
-
-    vertexAttributeDescriptions[1].binding = 0;
-    vertexAttributeDescriptions[1].location = 1;
-    vertexAttributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[1].offset = offsetof(Attribute<float>, normal);
-
-    vertexAttributeDescriptions[2].binding = 0;
-    vertexAttributeDescriptions[2].location = 2;
-    vertexAttributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    vertexAttributeDescriptions[2].offset = offsetof(Attribute<float>, uv);
-
-    vertexAttributeDescriptions[3].binding = 0;
-    vertexAttributeDescriptions[3].location = 3;
-    vertexAttributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[3].offset = offsetof(Attribute<float>, tangent);
-
-    vertexAttributeDescriptions[4].binding = 0;
-    vertexAttributeDescriptions[4].location = 4;
-    vertexAttributeDescriptions[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-    vertexAttributeDescriptions[4].offset = offsetof(Attribute<float>, bitangent);
-
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
     vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputStateCreateInfo.pNext = nullptr;
     vertexInputStateCreateInfo.flags = 0;
-    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
-    vertexInputStateCreateInfo.pVertexBindingDescriptions = &vertexBindingDescription;
-    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = 5;
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = vertexBindingDescriptionCount;
+    vertexInputStateCreateInfo.pVertexBindingDescriptions = vertexBindingDescriptions;
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = vertexAttributeDescriptionCount;
     vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexAttributeDescriptions;
 
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
     inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssemblyStateCreateInfo.pNext = nullptr;
     inputAssemblyStateCreateInfo.flags = 0;
     inputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
 
-    viewport.width = swapchainCreateInfo.imageExtent.width;
-    viewport.height = swapchainCreateInfo.imageExtent.height;
+    VkViewport viewport = {};
+    viewport.width = renderExtent.width;
+    viewport.height = renderExtent.height;
     viewport.x = 0;
     viewport.y = 0;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
+    VkRect2D scissor = {};
     scissor.offset.x = 0;
     scissor.offset.y = 0;
     scissor.extent.width = viewport.width;
     scissor.extent.height = viewport.height;
 
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
     viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportStateCreateInfo.pNext = nullptr;
     viewportStateCreateInfo.flags = 0;
@@ -3219,6 +5300,7 @@ void VulkanEngine::createGraphicsNormalViewerPipeline() {
     viewportStateCreateInfo.scissorCount = 1;
     viewportStateCreateInfo.pScissors = &scissor;
 
+    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {};
     rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
     rasterizationStateCreateInfo.pNext = nullptr;
     rasterizationStateCreateInfo.flags = 0;
@@ -3234,6 +5316,7 @@ void VulkanEngine::createGraphicsNormalViewerPipeline() {
     rasterizationStateCreateInfo.lineWidth = 1.0f;
 
 
+    VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
     multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampleStateCreateInfo.pNext = nullptr;
     multisampleStateCreateInfo.flags = 0;
@@ -3252,6 +5335,7 @@ void VulkanEngine::createGraphicsNormalViewerPipeline() {
     colorBlendAttachmentState.colorWriteMask =
             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
+    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {};
     colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlendStateCreateInfo.pNext = nullptr;
     colorBlendStateCreateInfo.flags = 0;
@@ -3268,6 +5352,7 @@ void VulkanEngine::createGraphicsNormalViewerPipeline() {
     depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
     depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
 
+    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {};
     graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     graphicsPipelineCreateInfo.pNext = nullptr;
     graphicsPipelineCreateInfo.flags = 0;
@@ -3288,7 +5373,7 @@ void VulkanEngine::createGraphicsNormalViewerPipeline() {
     graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
     graphicsPipelineCreateInfo.basePipelineIndex = -1;
 
-    VkResult result = vkCreateGraphicsPipelines(logicalDevices[0], VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo,
+    VkResult result = vkCreateGraphicsPipelines(logicalDevices[0], pipelineCache, 1, &graphicsPipelineCreateInfo,
                                                 nullptr, &graphicsDebugPipeline);
 
     if (result == VK_SUCCESS)
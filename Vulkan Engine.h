@@ -8,7 +8,11 @@
 
 #pragma once
 
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
+#else
+typedef unsigned char byte;
+#endif
 
 #ifndef NDEBUG
 #define VKASSERT_SUCCESS(i) assert(i == VK_SUCCESS)
@@ -19,20 +23,31 @@
 #endif
 
 
-#include <vulkan\vulkan.h>
+#include <vulkan/vulkan.h>
 #include <stdlib.h>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <math.h>
-#include <IL\il.h>
+#include <chrono>
+#include <IL/il.h>
 #include <assert.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/cimport.h>
 #include "Vulkan Engine Exception.h"
 #include "shaderc_online_compiler.h"
+#include "Mesh Cache.h"
+#include "Mesh Optimizer.h"
+#include "Vertex Quantization.h"
+#include "Meshlet Builder.h"
+#include "Thread Pool.h"
+#include "Device Memory Allocator.h"
+#include "Staging Ring.h"
+#include "KTX2 Texture.h"
+#include "PNG Decoder.h"
+#include "Virtual Texture.h"
 #include "glm/glm/mat4x4.hpp"
 #include "glm/glm/vec3.hpp"
 #include "glm/glm/vec4.hpp"
@@ -51,22 +66,242 @@ struct Attribute {
     T bitangent[3];
 };
 
+// Attribute<float> is what meshes are imported and cached as. The vertex buffer holds them split into two streams:
+// the VertexPosition of every vertex, followed by the VertexAttributes of every vertex. Passes that need nothing but
+// positions fetch nothing else.
+template<class T>
+struct VertexPosition {
+    T position[3];
+};
+
+template<class T>
+struct VertexAttributes {
+    T normal[3];
+    T uv[2];
+    T tangent[3];
+    T bitangent[3];
+};
+
+// Tag of the compact vertex format, quantized from Attribute<float> while uploading, see
+// VulkanEngineSettings::quantizedVertices.
+struct QuantizedVertex {
+};
+
+// 8 + 12 bytes instead of 12 + 44.
+template<>
+struct VertexPosition<QuantizedVertex> {
+    uint16_t position[4];                   // unorm within the mesh's bounds, see PositionDequantization, w unused
+};
+
+template<>
+struct VertexAttributes<QuantizedVertex> {
+    uint16_t uv[2];                         // half floats
+    int16_t tangentFrame[4];                // snorm quaternion, see encodeTangentFrame()
+};
+
 template<class T>
 struct ModelMatrix {
     mat4x4 modelMatrix;
 };
 
+// Takes the unorm positions of VertexPosition<QuantizedVertex> back into model space: offset + scale * position.
+// Identity for VertexPosition<float>.
+struct PositionDequantization {
+    float offset[4];
+    float scale[4];
+};
+
 template<class T>
 struct ViewProjectionMatrices {
     mat4x4 viewMatrix;
     mat4x4 projectionMatrix;
 };
 
+// Where a mesh lives in the shared vertex and index buffers, in vertices and indices. firstIndex counts indices of
+// the mesh's own type from the beginning of the index buffer.
+struct MeshRegion {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    VkIndexType indexType;          // 16 bit whenever the mesh has few enough vertices
+};
+
+// A loaded mesh's final vertices and indices, in the mesh cache's mapping or in the arrays importMesh() filled.
+// Valid until releaseMeshData().
+struct MeshData {
+    const Attribute<float> *vertices;
+    uint32_t vertexCount;
+    const uint32_t *indices;
+    uint32_t indexCount;
+};
+
+// What a texture image is created with, read from its KTX2 file or the uncompressed RGBA8 default.
+struct TextureDescription {
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    int32_t atlasLayer;                     // -1 for textures with an image of their own
+    uint32_t atlasX;                        // in texels of level 0, multiples of 2^(levelCount - 1)
+    uint32_t atlasY;
+    bool virtualTexture;                    // atlasX and atlasY place it in the virtual texture then, in whole pages
+};
+
+// Where a texture lies within its image, in normalized coordinates, and which element of the shaders' texture array
+// that image is. std430 layout of TextureRegion in the shaders.
+struct TextureRegion {
+    float offset[2];
+    float extent[2];
+    float layer;
+    uint32_t textureIndex;
+    uint32_t virtualTexture;                // sampled through the page table
+    float padding;
+};
+
+struct MeshTextureRegions {
+    TextureRegion color;
+    TextureRegion normal;
+    TextureRegion spec;
+};
+
+// A Meshlet and where its triangles are in the shared index buffer, std430 layout of Meshlet in cull_comp.glsl.
+struct MeshletDescription {
+    float center[3];
+    float radius;
+    float coneApex[3];
+    float coneCutoff;
+    float coneAxis[3];
+    uint32_t meshIndex;
+    uint32_t firstIndex;                    // counts indices of the mesh's own type, like MeshRegion::firstIndex
+    uint32_t triangleCount;
+    uint32_t shortIndices;                  // 16 bit indices
+    uint32_t padding;
+};
+
+// A texture of the virtual texture, decoded whole into memory, so its pages can be cut out of it whenever they're
+// requested.
+struct VirtualTextureSource {
+    const TextureDescription *textureDescription;
+    uint16_t meshIndex;
+    int textureIndex;
+    std::vector<uint8_t> chain;             // every level, tightly packed
+};
+
+// A PNG being decoded on the thread pool, into the staging region its upload will copy from. Chains too big for a
+// single region are decoded into chain instead.
+struct PendingTextureDecode {
+    VkImage textureImage;
+    const TextureDescription *textureDescription;
+    StagingRegion stagingRegion;
+    std::vector<uint8_t> chain;             // every level, tightly packed
+    std::future<void> future;
+};
+
+// CPU time of the phases of the last draw(), in milliseconds.
+struct FrameTimings {
+    double fenceWait;               // blocked on the frame slot's (and the acquired image's) fence
+    double acquire;
+    double record;                  // uniform update plus command buffer recording, if any
+    double submit;
+    double present;
+    double frame;                   // beginning of the previous draw() to the end of this one
+    double gpu;                     // render commands of the frame this draw() waited for, negative if not measured
+};
+
+enum TransferBatchState {
+    TRANSFER_BATCH_FREE = 0,
+    TRANSFER_BATCH_RECORDING = 1,
+    TRANSFER_BATCH_SUBMITTED = 2,           // in flight on the transfer queue, or done but not waited on by a frame yet
+    TRANSFER_BATCH_CONSUMED = 3             // a frame waits on its semaphore, recycled once that frame is done
+};
+
+// One submission to the transfer queue. The batch that completes an upload releases the uploaded resources to the
+// graphics queue family and signals semaphore, the next frame waits on it and acquires them.
+struct TransferBatch {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    TransferBatchState state = TRANSFER_BATCH_FREE;
+    bool signalsSemaphore = false;
+    bool completed = false;                 // fence signaled and staging memory retired
+    uint64_t stagingSubmission = 0;
+    int32_t consumingFrame = -1;
+    std::vector<VkBufferMemoryBarrier> acquireBufferBarriers;   // only with separate queue families
+    std::vector<VkImageMemoryBarrier> acquireImageBarriers;
+};
+
+// A write staged in the frame staging ring, copied to dstBuffer by the next draw().
+struct PendingBufferCopy {
+    VkBuffer dstBuffer;
+    VkBufferCopy region;
+};
+
+// Same, into an image in VK_IMAGE_LAYOUT_GENERAL.
+struct PendingImageCopy {
+    VkImage dstImage;
+    VkBufferImageCopy region;
+};
+
+// Specialization constants of the fragment and geometry shaders.
+struct ShaderSpecialization {
+    uint32_t textureCount;                  // constant_id 0, size of the texture array
+    VkBool32 virtualTextureSparse;          // constant_id 1
+};
+
+struct VulkanEngineSettings {
+    // Number of frames the CPU may record ahead of the GPU. 1 fully serializes recording and execution.
+    uint32_t framesInFlight = 2;
+    // Frame time and CPU/GPU overlap are printed every that many frames, 0 disables the report.
+    uint32_t frameStatisticsInterval = 600;
+    // Record one command buffer per framebuffer up front and only re-record it after invalidateCommandBuffers(),
+    // instead of re-recording every frame.
+    bool prerecordCommandBuffers = true;
+    // Only used by the headless constructor, which renders into offscreen color images instead of a swapchain.
+    uint32_t offscreenWidth = 1280;
+    uint32_t offscreenHeight = 720;
+    uint32_t offscreenImageCount = 2;
+    // Staging for uploads to device local memory: one ring for loading assets, one for data streamed every frame.
+    VkDeviceSize stagingRingSize = 32 * 1024 * 1024;
+    VkDeviceSize frameStagingRingSize = 4 * 1024 * 1024;
+    // Linear textures sample much slower on most GPUs, the setting only exists so the benchmark can show how much.
+    VkImageTiling textureTiling = VK_IMAGE_TILING_OPTIMAL;
+    // Full mip chain for every texture, filtered on the CPU while loading. Only takes effect with optimal tiling.
+    bool textureMips = true;
+    // Packs every PNG texture no larger than textureAtlasMaxTextureSize on either side into the layers of one shared
+    // 2D array image, instead of an image, allocation and view each. Only takes effect with optimal tiling.
+    bool textureAtlas = false;
+    uint32_t textureAtlasMaxTextureSize = 512;
+    // Places every PNG texture of at least 128x128 texels in one huge virtual texture, of which only the 128x128 pages
+    // the last frames sampled are kept in a cache of virtualTextureCachePages pages. At most
+    // virtualTexturePagesPerFrame are streamed in per frame. Pages are bound to a sparse residency image where the
+    // device supports one, else copied into a cache image the shaders reach through the page table. Takes precedence
+    // over the atlas, and only takes effect with optimal tiling.
+    bool virtualTexturing = false;
+    uint32_t virtualTextureCachePages = 256;
+    uint32_t virtualTexturePagesPerFrame = 16;
+    // Uploads the vertices as VertexPosition and VertexAttributes<QuantizedVertex>: 16 bit positions within each
+    // mesh's bounds, half float UVs and the tangent frame as one quaternion.
+    bool quantizedVertices = false;
+    // Lays down depth with a position only pipeline first, the main pass then shades only the visible fragments.
+    bool depthPrepass = false;
+    // Cuts the meshes into meshlets. A compute pass culls them by frustum and normal cone every frame and compacts
+    // the triangles of the rest into an index buffer the meshes are drawn out of indirectly. Backfacing meshlets are
+    // culled even though the pipelines draw both sides, meant for closed meshes.
+    bool meshletCulling = false;
+};
+
 
 class VulkanEngine {
 public:
 
-    VulkanEngine(HINSTANCE hInstance, HWND windowHandle, VulkanEngine **ppUnstableInstance);
+#ifdef _WIN32
+    VulkanEngine(HINSTANCE hInstance, HWND windowHandle, VulkanEngine **ppUnstableInstance,
+                 const VulkanEngineSettings &settings = VulkanEngineSettings());
+#endif
+
+    // Headless: no window, surface or swapchain, frames are rendered into offscreen images.
+    VulkanEngine(VulkanEngine **ppUnstableInstance, const VulkanEngineSettings &settings = VulkanEngineSettings());
 
     ~VulkanEngine() noexcept(false);
 
@@ -80,6 +315,17 @@ public:
 
     void draw();
 
+    // Call whenever anything baked into the pre-recorded command buffers (meshes, pipelines, descriptor sets)
+    // changes. View and projection are read from a per-image uniform buffer and never need this.
+    void invalidateCommandBuffers();
+
+    const FrameTimings &getLastFrameTimings() const;
+
+    // Streamed through the frame staging ring, takes effect with the next draw(). Needs no re-recording.
+    void stageFrameUpload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+
+    void setModelMatrix(uint32_t meshIndex, const glm::mat4x4 &matrix);
+
     bool terminating = false;
 
     float focusDistance = -14.0f;
@@ -104,8 +350,8 @@ public:
 
 
         float frameBufferAspectRatio =
-                ((float) instance->swapchainCreateInfo.imageExtent.width) /
-                ((float) instance->swapchainCreateInfo.imageExtent.height);
+                ((float) instance->renderExtent.width) /
+                ((float) instance->renderExtent.height);
 
 
         instance->viewProjection.projectionMatrix = glm::perspective(glm::radians(instance->fovAngle),
@@ -131,12 +377,13 @@ private:
 //    static //const uint16_t MAX_SPARSE_IMAGE_ARRAY_SIZE = MAX_DEFAULT_ARRAY_SIZE;
 //    static //const uint16_t MAX_SPARSE_IMAGE_MEMORY_REQUIREMENTS_ARRAY_SIZE = MAX_DEFAULT_ARRAY_SIZE;
 //    static //const uint16_t MAX_SPARSE_IMAGE_FORMAT_PROPERTIES_ARRAY_SIZE = MAX_DEFAULT_ARRAY_SIZE;
-    static const uint16_t MAX_COLOR_TEXTURE_ARRAY_SIZE = MAX_MESHES;
-    static const uint16_t MAX_NORMAL_TEXTURE_ARRAY_SIZE = MAX_COLOR_TEXTURE_ARRAY_SIZE;
-    static const uint16_t MAX_SPECULAR_TEXTURE_ARRAY_SIZE = MAX_COLOR_TEXTURE_ARRAY_SIZE;
-    static const uint16_t MAX_UNIFORM_BUFFER_ARRAY_SIZE = MAX_MESHES;
-    static const uint16_t MAX_VERTEX_BUFFER_ARRAY_SIZE = MAX_UNIFORM_BUFFER_ARRAY_SIZE;
-    static const uint16_t MAX_INDEX_BUFFER_ARRAY_SIZE = MAX_UNIFORM_BUFFER_ARRAY_SIZE;
+    static const uint16_t MAX_FRAMES_IN_FLIGHT = 4;
+    static const uint32_t TEXTURE_ATLAS_SIZE = 2048;               // width and height of every layer
+    static const uint32_t TEXTURE_ATLAS_MIP_LEVELS = 5;
+    static const uint32_t VIRTUAL_TEXTURE_SIZE = 16384;            // width and height of level 0, in texels
+    static const uint32_t VIRTUAL_TEXTURE_PAGE_SIZE = 128;         // the sparse block of RGBA8 images on most devices
+    static const uint32_t VIRTUAL_TEXTURE_LEVELS = 8;              // down to a single page
+    static const uint32_t VIRTUAL_TEXTURE_PAGE_BORDER = 1;         // around the pages of the software cache
 
 
     uint32_t instanceExtensionsCount = 0;
@@ -173,11 +420,23 @@ private:
     VkImageView depthImageView;
     uint32_t memoryTypeCount = 0;
     uint32_t hostVisibleMemoryTypeIndex = -1;
+    uint32_t hostCoherentMemoryTypeIndex = -1;
     uint32_t deviceLocalMemoryTypeIndex = -1;
     VkDeviceSize memoryCommittedBytesCount = 0;
+    DeviceMemoryAllocator memoryAllocator;                  // backs every buffer and image of the engine
+    StagingRing stagingRing;                                // asset uploads, retired by the transfer batch fences
+    StagingRing frameStagingRing;                           // per-frame streaming, retired by queueDoneFences
+    std::vector<TransferBatch> transferBatches;             // recycled, never freed before terminate()
+    int32_t recordingTransferBatch = -1;                    // uploads batched until submitTransferCommands()
+    std::vector<VkBufferMemoryBarrier> pendingReleaseBufferBarriers;    // uploaded since submitTransferCommands()
+    std::vector<VkImageMemoryBarrier> pendingReleaseImageBarriers;
+    std::vector<VkSemaphore> frameWaitSemaphores;           // the current frame's submission waits on these
+    std::vector<VkPipelineStageFlags> frameWaitStageFlags;
+    std::vector<PendingBufferCopy> pendingFrameBufferCopies;
     VkMappedMemoryRange memoryFlushRange = {};
+    std::vector<PendingImageCopy> pendingFrameImageCopies;
+    std::vector<VkImageMemoryBarrier> pendingFrameImageBarriers;   // recorded before the frame's copies
     VkMemoryRequirements imageMemoryRequirements = {};
-    VkImage *sparseImages;
     VkSparseImageMemoryRequirements *sparseImageMemoryRequirements;
     uint32_t sparseMemoryRequirementsCount = 0;
     VkImageCreateInfo sparseImageCreateInfo = {};
@@ -185,9 +444,15 @@ private:
     uint32_t physicalDeviceSparseImageFormatPropertiesCount = 0;
     VkQueue graphicsQueue;
     VkQueue transferQueue;
+#ifdef _WIN32
     HINSTANCE hInstance;
     HWND windowHandle;
     VkWin32SurfaceCreateInfoKHR surfaceCreateInfo = {};
+#endif
+    bool headless = false;
+    VkExtent2D renderExtent = {};                           // swapchain or offscreen image extent
+    MemoryAllocation *offscreenImagesMemory = nullptr;
+    uint32_t nextOffscreenImageIndex = 0;
     VkSurfaceKHR surface;
     VkSwapchainKHR swapchain;
     VkSwapchainCreateInfoKHR swapchainCreateInfo = {};
@@ -202,11 +467,12 @@ private:
     VkImage *swapchainImages;
     VkImageView *swapchainImageViews;
     VkPresentInfoKHR presentInfo = {};
-    VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
     VkShaderModule computeShaderModule = {};
     VkComputePipelineCreateInfo computePipelineCreateInfo = {};
-    VkPipeline computePipeline = {};
+    VkPipeline computePipeline = {};                          // meshlet culling, only with settings.meshletCulling
     VkPipeline graphicsPipeline = {};
+    VkPipeline graphicsDepthPipeline = VK_NULL_HANDLE;        // only with settings.depthPrepass
+    VkShaderModule graphicsDepthVertexShaderModule;
     VkDescriptorSetLayoutCreateInfo computeDescriptorSetLayoutCreateInfo = {};
     VkDescriptorSetLayoutCreateInfo graphicsDescriptorSetLayoutCreateInfo = {};
     VkDescriptorSetLayout computeDescriptorSetLayout = {};
@@ -221,73 +487,133 @@ private:
     VkRenderPassCreateInfo renderPassCreateInfo = {};
     VkRenderPass renderPass = {};
     VkFramebuffer *framebuffers;
-    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo = {};
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;           // shared by every pipeline, persisted across runs
     VkShaderModule graphicsVertexShaderModule;
     VkShaderModule graphicsGeometryShaderModule;
     VkShaderModule graphicsFragmentShaderModule;
-    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
-    VkVertexInputBindingDescription vertexBindingDescription = {};
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo = {};
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-    VkViewport viewport = {};
-    VkRect2D scissor = {};
-    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo = {};
-    VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
-    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {};
-    VkSemaphore waitToPresentSemaphore;
-    VkSemaphore indexAcquiredSemaphore;
+    VkSemaphore waitToPresentSemaphores[MAX_FRAMES_IN_FLIGHT];
+    VkSemaphore indexAcquiredSemaphores[MAX_FRAMES_IN_FLIGHT];
 
     VkCommandPool renderCommandPool;
     VkCommandPool transferCommandPool;
-    VkCommandBuffer renderCommandBuffer;
+    VkCommandBuffer renderCommandBuffers[MAX_FRAMES_IN_FLIGHT];
+    VkCommandBuffer frameUploadCommandBuffers[MAX_FRAMES_IN_FLIGHT];
+    uint64_t frameStagingSubmissions[MAX_FRAMES_IN_FLIGHT] = {};  // frameStagingRing submission of each frame slot
+    VkCommandBuffer *framebufferCommandBuffers = nullptr;  // one per swapchain image, pre-recorded mode only
+    bool *framebufferCommandBuffersDirty = nullptr;
+    VkFence *swapchainImageFences = nullptr;                // fence of the frame that last rendered to each image
     VkFormat surfaceImageFormat;
     VkFormat depthFormat;
-    std::vector<Attribute<float>> sortedAttributes[MAX_VERTEX_BUFFER_ARRAY_SIZE];
-    std::vector<uint32_t> sortedIndices[MAX_INDEX_BUFFER_ARRAY_SIZE];
-    uint32_t totalUniformBufferSize = sizeof(ModelMatrix<float>);
-    uint32_t indexBuffersSizes[MAX_INDEX_BUFFER_ARRAY_SIZE];
-    uint32_t vertexBuffersSizes[MAX_VERTEX_BUFFER_ARRAY_SIZE];
-    VkImage colorTextureImagesDevice[MAX_COLOR_TEXTURE_ARRAY_SIZE];
-    VkImage colorTextureImages[MAX_COLOR_TEXTURE_ARRAY_SIZE];
-    VkImageView colorTextureViews[MAX_COLOR_TEXTURE_ARRAY_SIZE];
-    VkImage normalTextureImagesDevice[MAX_NORMAL_TEXTURE_ARRAY_SIZE];
-    VkImage normalTextureImages[MAX_NORMAL_TEXTURE_ARRAY_SIZE];
-    VkImageView normalTextureViews[MAX_NORMAL_TEXTURE_ARRAY_SIZE];
-    VkImage specTextureImagesDevice[MAX_SPECULAR_TEXTURE_ARRAY_SIZE];
-
-    VkImage specTextureImages[MAX_SPECULAR_TEXTURE_ARRAY_SIZE];
-    VkImageView specTextureViews[MAX_SPECULAR_TEXTURE_ARRAY_SIZE];
-    VkDeviceMemory depthImageMemory;
-    VkDeviceMemory uniTexturesMemory;
-    VkDeviceMemory uniBuffersMemory;
-    VkDeviceMemory uniTexturesMemoryDevice;
-    VkDeviceMemory uniBuffersMemoryDevice;
-    VkBuffer uniformBuffersDevice[MAX_UNIFORM_BUFFER_ARRAY_SIZE];
-    VkBuffer vertexBuffersDevice[MAX_VERTEX_BUFFER_ARRAY_SIZE];
-    VkBuffer indexBuffersDevice[MAX_INDEX_BUFFER_ARRAY_SIZE];
-    VkBuffer uniformBuffers[MAX_UNIFORM_BUFFER_ARRAY_SIZE];
-    VkBuffer vertexBuffers[MAX_VERTEX_BUFFER_ARRAY_SIZE];
-    VkBuffer indexBuffers[MAX_INDEX_BUFFER_ARRAY_SIZE];
-    VkDeviceSize *colorTexturesBindOffsetsDevice;
-    VkDeviceSize *normalTexturesBindOffsetsDevice;
-    VkDeviceSize *specTexturesBindOffsetsDevice;
-    VkDeviceSize *colorTexturesBindOffsets;
-    VkDeviceSize *normalTexturesBindOffsets;
-    VkDeviceSize *specTexturesBindOffsets;
-    VkDeviceSize *uniformBuffersBindOffsetsDevice;
-    VkDeviceSize *vertexBuffersBindOffsetsDevice;
-    VkDeviceSize *indexBuffersBindOffsetsDevice;
-    VkDeviceSize *uniformBuffersBindOffsets;
-    VkDeviceSize *vertexBuffersBindOffsets;
-    VkDeviceSize *indexBuffersBindOffsets;
-    aiScene *cachedScene = NULL;
-    VkDescriptorSet meshDescriptorSets[MAX_MESHES];
+    // Only filled by importMesh(), meshes loaded from the cache are read straight out of its mapping.
+    std::vector<Attribute<float>> sortedAttributes[MAX_MESHES];
+    std::vector<uint32_t> sortedIndices[MAX_MESHES];
+    MappedMeshCache meshCache;
+    MeshData meshData[MAX_MESHES];
+    MeshRegion meshRegions[MAX_MESHES];
+    std::vector<Meshlet> meshlets[MAX_MESHES];              // only with settings.meshletCulling
+    // All texture arrays hold one element per mesh, sized by createAllTextures().
+    std::vector<VkImage> colorTextureImagesDevice;
+    std::vector<VkImageView> colorTextureViews;
+    std::vector<VkImage> normalTextureImagesDevice;
+    std::vector<VkImageView> normalTextureViews;
+    std::vector<VkImage> specTextureImagesDevice;
+
+    std::vector<VkImageView> specTextureViews;
+    // Textures in the atlas have neither an image nor a view of their own, see TextureDescription::atlasLayer.
+    VkImage textureAtlasImage = VK_NULL_HANDLE;
+    VkImageView textureAtlasView = VK_NULL_HANDLE;
+    MemoryAllocation textureAtlasMemory;
+    uint32_t textureAtlasLevelCount = 0;
+    uint32_t textureAtlasLayerCount = 0;
+    // Every view the shaders sample, bound once as a single array. The atlas, if any, comes first.
+    std::vector<VkImageView> textureArrayViews;
+    uint32_t textureArrayCount = 0;                        // textureArrayViews.size()
+    ShaderSpecialization shaderSpecialization = {};
+    VkSpecializationMapEntry shaderSpecializationEntries[2] = {};
+    VkSpecializationInfo shaderSpecializationInfo = {};
+    // The virtual texture: a sparse residency image with a page bound wherever one is resident, or, without sparse
+    // residency, a cache image of bordered pages the shaders find through the page table. See updateVirtualTexture().
+    bool virtualTextureSparse = false;
+    VkImage virtualTextureImage = VK_NULL_HANDLE;
+    VkImageView virtualTextureView = VK_NULL_HANDLE;
+    MemoryAllocation virtualTextureMemory;                 // cache image, or the pages bound to the sparse image
+    VkDeviceSize virtualTexturePageBytes = 0;              // staged per page, border included
+    uint32_t virtualTexturePageBorder = 0;
+    uint32_t virtualTextureSlotsPerSide = 0;               // of the cache image
+    VirtualTextureResidency virtualTextureResidency;
+    std::vector<VirtualTextureSource> virtualTextureSources;
+    std::vector<uint32_t> virtualTexturePageTable;
+    uint64_t virtualTextureFrame = 0;
+    VkSemaphore virtualTextureBindSemaphores[MAX_FRAMES_IN_FLIGHT] = {};
+    bool virtualTextureBindPending = false;               // the current frame waits for its sparse binds
+    VkBuffer virtualTexturePageTableBuffer;
+    MemoryAllocation virtualTexturePageTableMemory;
+    // One bit per page, written by the fragment shader, one region per swapchain image. Host coherent and mapped.
+    VkBuffer virtualTextureFeedbackBuffer;
+    MemoryAllocation virtualTextureFeedbackMemory;
+    VkDeviceSize virtualTextureFeedbackStride = 0;
+    MeshTextureRegions meshTextureRegions[MAX_MESHES];
+    VkDeviceSize meshTextureRegionsOffset = 0;             // within each mesh's stride of the uniform buffer
+    PositionDequantization positionDequantizations[MAX_MESHES];
+    VkDeviceSize positionDequantizationOffset = 0;         // same
+    std::vector<TextureDescription> colorTextureDescriptions;
+    std::vector<TextureDescription> normalTextureDescriptions;
+    std::vector<TextureDescription> specTextureDescriptions;
+    MemoryAllocation depthImageMemory;
+    std::vector<MemoryAllocation> colorTexturesMemoryDevice;
+    std::vector<MemoryAllocation> normalTexturesMemoryDevice;
+    std::vector<MemoryAllocation> specTexturesMemoryDevice;
+    MemoryAllocation vertexBufferMemory;
+    MemoryAllocation indexBufferMemory;
+    MemoryAllocation uniformBufferMemory;
+    VkBuffer vertexBufferDevice;                            // all meshes, both streams, see meshRegions
+    VkBuffer indexBufferDevice;
+    // One ModelMatrix, PositionDequantization and MeshTextureRegions per mesh, uniformBufferStride apart. Bound whole as a storage buffer, the
+    // shaders index it with the draw's first instance.
+    VkBuffer uniformBufferDevice;
+    VkDeviceSize vertexBufferSize = 0;
+    VkDeviceSize positionStride = 0;                        // of the VertexPosition stream
+    VkDeviceSize attributeStride = 0;                       // of the VertexAttributes stream
+    VkDeviceSize attributeStreamOffset = 0;                 // within the vertex buffer
+    VkDeviceSize indexBufferSize = 0;
+    VkDeviceSize uniformBufferSize = 0;
+    VkDeviceSize uniformBufferStride = 0;
+    uint32_t meshCount = 0;
+    // The MeshletDescription of every meshlet, the triangles that survive culling as 32 bit indices, each mesh's
+    // within its own region, and the indirect draws of the meshes, counting those indices.
+    VkBuffer meshletBuffer = VK_NULL_HANDLE;
+    MemoryAllocation meshletBufferMemory;
+    VkBuffer culledIndexBuffer = VK_NULL_HANDLE;
+    MemoryAllocation culledIndexBufferMemory;
+    VkBuffer meshletDrawBuffer = VK_NULL_HANDLE;
+    MemoryAllocation meshletDrawBufferMemory;
+    std::vector<VkDrawIndexedIndirectCommand> meshletDraws;  // written to meshletDrawBuffer before every culling pass
+    uint32_t totalMeshletCount = 0;
+    VkDescriptorSet computeDescriptorSet = VK_NULL_HANDLE;
+    VkDescriptorSet graphicsDescriptorSet = VK_NULL_HANDLE;   // the meshes' uniforms and every texture
+    VkDescriptorSetLayout viewProjectionDescriptorSetLayout = {};
+    VkDescriptorSet *viewProjectionDescriptorSets = nullptr;   // one per swapchain image
+    VkBuffer viewProjectionBuffer;
+    MemoryAllocation viewProjectionBufferMemory;
+    VkDeviceSize viewProjectionBufferStride = 0;
+    byte *viewProjectionMappedMemory = nullptr;             // viewProjectionBufferMemory.mappedData, host coherent
     VkSampler textureSampler;
-    VkFence queueDoneFence;
-    LARGE_INTEGER frequency;        // ticks per second
-    LARGE_INTEGER t1, t2;           // ticks
-    double elapsedTime;
+    VkFence queueDoneFences[MAX_FRAMES_IN_FLIGHT];
+    VkQueryPool frameTimestampQueryPool = VK_NULL_HANDLE;    // two timestamps per frame in flight
+    int32_t frameTimestampQueryIndices[MAX_FRAMES_IN_FLIGHT] = {-1, -1, -1, -1};  // pair submitted by each frame
+    VulkanEngineSettings settings;
+    uint32_t framesInFlight = 1;
+    uint32_t currentFrame = 0;
+    std::chrono::steady_clock::time_point t1, t2;
+    double elapsedTime;             // ms
+    uint32_t statisticsFrameCount = 0;
+    double statisticsFrameTime = 0.0;           // ms, beginning of a frame to the beginning of the next one
+    double statisticsFenceWaitTime = 0.0;       // ms the CPU spent blocked on the frame fence
+    double statisticsGpuTime = 0.0;             // ms between the first and last timestamp of a frame
+    FrameTimings lastFrameTimings = {};
+    uint32_t statisticsGpuFrameCount = 0;
     bool inited = false;
+    std::vector<std::future<void>> shaderModuleFutures;
 
 
     void init();
@@ -308,13 +634,15 @@ private:
 
 //    void getPhysicalDeviceImageFormatProperties(VkFormat imageFormat);
 
-    void getPhysicalDeviceSparseImageFormatProperties();
+    // Whether RGBA8 sparse residency images come in VIRTUAL_TEXTURE_PAGE_SIZE square blocks.
+    bool getPhysicalDeviceSparseImageFormatProperties();
 
     void createAllBuffers();
 
     void createDepthImageAndImageview();
 
-    void createSparseImage();
+    // The sparse virtual texture image and the memory of its pages, false if the image turns out unsuitable.
+    bool createSparseImage(uint32_t slotCount);
 
     //void allocateDeviceMemories();
     //void bindBufferMemories();
@@ -326,12 +654,22 @@ private:
 
     void createSwapchain();
 
+    void createOffscreenImages();
+
     uint32_t acquireNextFramebufferImageIndex();
 
     void present(uint32_t swapchainPresentImageIndex);
 
 
-    void createQueueDoneFence();
+    void createQueueDoneFences();
+
+    void createFrameTimestampQueryPool();
+
+    double waitForFence(VkFence fence);
+
+    void waitForFrame(uint32_t frameIndex, double *fenceWaitTime);
+
+    void reportFrameStatistics(double frameTime, double fenceWaitTime);
 
     void createRenderpass();
 
@@ -342,23 +680,59 @@ private:
     void createGraphicsShaderModule(const char *shaderFileName, VkShaderModule *shaderModule,
                                     shaderc_shader_kind shaderType);
 
+    void createGraphicsShaderModules();
+
+    void waitForGraphicsShaderModules();
+
 //    void createFragmentGraphicsShaderModule();
 //
 //    void createGeometryGraphicsShaderModule();
 
     void createGraphicsPipeline();
 
+    void createComputePipeline();
+
+    std::string getPipelineCachePath();
+
+    bool loadPipelineCacheData(std::vector<char> *pipelineCacheData);
+
+    void createPipelineCache();
+
+    void savePipelineCache();
+
+    void createGraphicsPipelines();
+
     void createPipelineAndDescriptorSetsLayout();
 
-    void render(uint32_t drawableImageIndex);
+    void render(uint32_t drawableImageIndex, VkCommandBuffer uploadCommandBuffer);
 
     void createRenderCommandPool();
 
+    void allocateRenderCommandBuffers();
+
+    void recordFramebufferCommandBuffers();
+
+    void recordRenderCommands(VkCommandBuffer renderCommandBuffer, uint32_t drawableImageIndex,
+                              uint32_t timestampQueryIndex, VkCommandBufferUsageFlags usageFlags);
+
+    void createViewProjectionBuffer();
+
+    // Always created, a few bytes each without virtual texturing.
+    void createVirtualTextureBuffers();
+
+    // Reads the feedback of the last frame rendered to the image, then streams in up to
+    // virtualTexturePagesPerFrame missing pages, evicting the least recently used ones when the cache is full. Fewer
+    // when the frame staging ring is short on room, the rest follow in later frames.
+    void updateVirtualTexture(uint32_t drawableImageIndex);
+
+    // The page at its level, border included, composed out of the sources overlapping it. Written front to back.
+    void writeVirtualTexturePage(uint32_t pageIndex, uint8_t *page);
+
     void createTransferCommandPool();
 
-    void createWaitToPresentSemaphore();
+    void createWaitToPresentSemaphores();
 
-    void createWaitToDrawSemaphore();
+    void createWaitToDrawSemaphores();
 
     void destroySyncMeans();
 
@@ -366,14 +740,66 @@ private:
 
     void loadMesh(const char *fileName);
 
+    bool loadMeshCache(const std::string &meshCachePath, uint64_t sourceHash, uint32_t importFlags);
+
+    void importMesh(const std::string &meshPath, uint32_t importFlags);
+
+    void optimizeMeshes();
+
+    // Once commitBuffers() has staged them, the mapping and the imported arrays are let go.
+    void releaseMeshData();
+
+    void splitMeshesIntoMeshlets();
+
+    void splitVertices(uint16_t meshIndex, std::vector<VertexPosition<float>> *positions,
+                       std::vector<VertexAttributes<float>> *attributes);
+
+    void quantizeVertices(uint16_t meshIndex, std::vector<VertexPosition<QuantizedVertex>> *positions,
+                          std::vector<VertexAttributes<QuantizedVertex>> *attributes);
+
+    // Of the vertex buffer's streams, binding 0 the positions, binding 1 the rest unless positionOnly. Fills up to 2
+    // binding descriptions, returns the number of attribute descriptions, at most 5.
+    uint32_t describeVertexInput(bool positionOnly, VkVertexInputBindingDescription *bindingDescriptions,
+                                 uint32_t *bindingCount, VkVertexInputAttributeDescription *attributeDescriptions);
+
+    // Every mesh, rebinding the index buffer whenever the index type changes from the one bound. Indirect, out of
+    // the culled index buffer, with meshlet culling.
+    void recordMeshDraws(VkCommandBuffer renderCommandBuffer, VkIndexType *boundIndexType);
+
+    // Outside of the render pass, before the draws.
+    void recordMeshletCulling(VkCommandBuffer renderCommandBuffer, uint32_t drawableImageIndex);
+
     /*void writeBuffers();*/
     VkMemoryRequirements createBuffer(VkBuffer *buffer, VkDeviceSize size, VkBufferUsageFlags usageFlags);
 
     void getSupportedDepthFormat();
 
-    VkMemoryRequirements createTexture(VkImage *textureImage, VkImageUsageFlags usageFlags);
+    VkMemoryRequirements createTexture(VkImage *textureImage, const TextureDescription &textureDescription,
+                                       uint32_t layerCount, VkImageUsageFlags usageFlags);
+
+    // Always a 2D array view.
+    void createTextureView(VkImageView *textureImageView, VkImage textureImage,
+                           const TextureDescription &textureDescription, uint32_t layerCount);
 
-    void createTextureView(VkImageView *textureImageView, VkImage textureImage);
+    // Places the PNG textures that are small enough, then creates the atlas. Returns how many went in.
+    uint32_t packTextureAtlas(bool generateMips);
+
+    // Places the PNG textures that are large enough, then creates the virtual texture. Returns how many went in.
+    uint32_t packVirtualTexture();
+
+    void describeTextureRegion(const TextureDescription &textureDescription, uint32_t textureIndex,
+                               TextureRegion *textureRegion);
+
+    // textureIndex 0, 1 and 2 are the color, normal and specular texture of the mesh.
+    std::string getTexturePath(uint16_t meshIndex, int textureIndex, const char *extension);
+
+    // False when there is no usable KTX2 file, the PNG is decoded instead.
+    bool describeCompressedTexture(uint16_t meshIndex, int textureIndex, TextureDescription *textureDescription);
+
+    // Runs on the thread pool, any number at once. Writes the whole mip chain of the description to chain, tightly
+    // packed, front to back and without reading it back, so chain may be the mapped staging ring.
+    void decodeTexture(const std::string &pngPath, bool normalMap, const TextureDescription &textureDescription,
+                       uint8_t *chain);
 
     void createAllTextures();
 
@@ -387,7 +813,49 @@ private:
 
     void commitTextures();
 
-    void destroyStagingMeans();
+    // Waits for the decodes, then records their uploads.
+    void finishTextureDecodes(std::vector<PendingTextureDecode> *pendingDecodes);
+
+    void createStagingRing();
+
+    void stageUpload(VkDeviceSize size, VkDeviceSize alignment, StagingRegion *region);
+
+    VkCommandBuffer getTransferCommandBuffer();
+
+    // Submits the uploads recorded so far without waiting for them, the next draw() waits on the GPU instead.
+    void submitTransferCommands();
+
+    void submitTransferBatch(bool releaseUploads);
+
+    void completeTransferBatch(TransferBatch *batch);
+
+    void recycleTransferBatch(TransferBatch *batch);
+
+    void retireTransferBatches(bool wait);
+
+    void uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size);
+
+    // Every level of the description is read from the file, straight into the staging ring.
+    void uploadCompressedTexture(VkImage textureImage, const TextureDescription &textureDescription,
+                                 const std::string &ktx2Path);
+
+    // Stages the levels a piece at a time, each piece read by readLevel(level, offset, size, dst), copies them and
+    // queues the release to the graphics queue family.
+    void uploadTextureChain(VkImage textureImage, const TextureDescription &textureDescription,
+                            const std::function<void(uint32_t, size_t, size_t, uint8_t *)> &readLevel);
+
+    // Copies the levels, tightly packed in stagingRegion, and queues the release to the graphics queue family.
+    void recordTextureUpload(VkImage textureImage, const TextureDescription &textureDescription,
+                             const StagingRegion &stagingRegion);
+
+    // Undefined to transfer destination, every level and layer.
+    void recordTextureTransition(VkImage textureImage, uint32_t levelCount, uint32_t layerCount);
+
+    // Queues the transition for sampling, and the release to the graphics queue family, for the next
+    // submitTransferCommands().
+    void releaseTexture(VkImage textureImage, uint32_t levelCount, uint32_t layerCount);
+
+    VkCommandBuffer recordFrameUploads();
 
     std::string loadShaderCode(const char *fileName);
 
@@ -398,11 +866,14 @@ private:
     VkShaderModule graphicsNormalViewerFragmentShaderModule;
     VkPipeline graphicsDebugPipeline;
 
-    std::string resourcesPath = "..\\Resources\\";
+    std::string resourcesPath = "../Resources/";
     float fovAngle = (3.1415956536f / 180.0f) * 60.0f;
     const float zNear = 0.1f;
     const float zFar = 500.0f;
 
+    // Declared last so it is destroyed first: if init() throws, workers still running one of its tasks are joined
+    // before the members they touch go away.
+    ThreadPool threadPool;
 };
 
 
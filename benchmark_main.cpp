@@ -0,0 +1,352 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+// Replays a camera path through VulkanEngine::calculateViewProjection on the headless engine and reports frame time
+// percentiles plus the per-phase CPU split as JSON, so different builds can be compared on the same machine. The JSON
+// goes to benchmark.json unless --output names another file, stdout is the engine's log.
+//
+// Camera path files hold one keyframe per line: "yaw pitch distance focusX focusY focusZ". Empty lines and lines
+// starting with '#' are skipped. The measured frames are spread evenly over the path and interpolated linearly,
+// warm-up frames replay the beginning of the path.
+//
+// --compare-texture-tiling runs the path twice, with optimal and with linear textures, and reports both runs plus
+// the ratio of their GPU frame times. Best done close up (Resources/camera_closeup.path) at a high resolution, where
+// texture sampling dominates the frame.
+//
+// --no-texture-mips loads every texture as a single level, compare against a default run on
+// Resources/camera_distant.path to see what the mip chains save on minified, fragment bound frames.
+//
+// --texture-atlas packs the PNG textures up to 512 texels (or --texture-atlas-max-size N) into one array image.
+//
+// --virtual-texturing streams the large PNG textures page by page, only what the camera path samples stays resident.
+//
+// --quantized-vertices uploads 20 byte vertices instead of 56, for vertex fetch bound runs.
+//
+// --depth-prepass lays down depth with a position only pass first, for fragment bound runs with overdraw.
+//
+// --meshlet-culling culls meshlets by frustum and normal cone on the GPU and draws the rest indirectly.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Vulkan Engine.h"
+
+struct CameraKeyframe {
+    float yaw;
+    float pitch;
+    float distance;
+    float focusPoint[3];
+};
+
+static bool loadCameraPath(const char *fileName, std::vector<CameraKeyframe> *keyframes) {
+    std::ifstream pathFile(fileName);
+
+    if (!pathFile.is_open())
+        return false;
+
+    std::string line;
+
+    while (std::getline(pathFile, line)) {
+        if (line.empty() || line[0] == '#' || line[0] == '\r')
+            continue;
+
+        std::istringstream lineStream(line);
+        CameraKeyframe keyframe;
+
+        if (!(lineStream >> keyframe.yaw >> keyframe.pitch >> keyframe.distance >> keyframe.focusPoint[0]
+                         >> keyframe.focusPoint[1] >> keyframe.focusPoint[2]))
+            return false;
+
+        keyframes->push_back(keyframe);
+    }
+
+    return !keyframes->empty();
+}
+
+static void applyCamera(VulkanEngine *engine, const std::vector<CameraKeyframe> &keyframes, double pathPosition) {
+    double scaledPosition = pathPosition * (keyframes.size() - 1);
+    size_t keyframeIndex = std::min((size_t) scaledPosition, keyframes.size() - 1);
+    size_t nextKeyframeIndex = std::min(keyframeIndex + 1, keyframes.size() - 1);
+    float t = (float) (scaledPosition - keyframeIndex);
+
+    const CameraKeyframe &a = keyframes[keyframeIndex];
+    const CameraKeyframe &b = keyframes[nextKeyframeIndex];
+
+    engine->focusYaw = a.yaw + (b.yaw - a.yaw) * t;
+    engine->focusPitch = a.pitch + (b.pitch - a.pitch) * t;
+    engine->focusDistance = a.distance + (b.distance - a.distance) * t;
+    engine->focusPointX = a.focusPoint[0] + (b.focusPoint[0] - a.focusPoint[0]) * t;
+    engine->focusPointY = a.focusPoint[1] + (b.focusPoint[1] - a.focusPoint[1]) * t;
+    engine->focusPointZ = a.focusPoint[2] + (b.focusPoint[2] - a.focusPoint[2]) * t;
+
+    VulkanEngine::calculateViewProjection(engine);
+}
+
+// Nearest-rank percentile of an ascending sorted sample.
+static double percentile(const std::vector<double> &sorted, double p) {
+    size_t rank = (size_t) std::ceil(p / 100.0 * sorted.size());
+
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+static double mean(const std::vector<double> &samples) {
+    double sum = 0.0;
+
+    for (double sample : samples)
+        sum += sample;
+
+    return sum / samples.size();
+}
+
+static void writeStatistics(std::ostream &out, const std::string &indent, const char *name,
+                            std::vector<double> samples, bool last) {
+    std::sort(samples.begin(), samples.end());
+
+    out << indent << "  \"" << name << "\": {\"mean\": " << mean(samples) << ", \"p50\": " << percentile(samples, 50.0)
+        << ", \"p95\": " << percentile(samples, 95.0) << ", \"p99\": " << percentile(samples, 99.0)
+        << ", \"max\": " << samples.back() << "}" << (last ? "" : ",") << "\n";
+}
+
+// As a JSON string literal, quoted and escaped. Camera paths are Windows paths more often than not.
+static void writeJsonString(std::ostream &out, const std::string &value) {
+    out << '"';
+
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char) c < 0x20) {
+            char escaped[8];
+
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int) c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+
+    out << '"';
+}
+
+// Per-frame samples of one run, in milliseconds.
+struct BenchmarkRun {
+    std::vector<double> frameTimes, fenceWaitTimes, acquireTimes, recordTimes, submitTimes, presentTimes, gpuTimes;
+};
+
+static void runBenchmark(const VulkanEngineSettings &settings, const std::vector<CameraKeyframe> &keyframes,
+                         uint32_t warmupFrameCount, uint32_t measuredFrameCount, BenchmarkRun *run) {
+    VulkanEngine **pUnstableInstance = new VulkanEngine *;
+    VulkanEngine *engine = new VulkanEngine(pUnstableInstance, settings);
+
+    for (uint32_t frameIndex = 0; frameIndex < warmupFrameCount; frameIndex++) {
+        applyCamera(engine, keyframes, (double) (frameIndex % measuredFrameCount) / measuredFrameCount);
+        engine->draw();
+    }
+
+    for (uint32_t frameIndex = 0; frameIndex < measuredFrameCount; frameIndex++) {
+        applyCamera(engine, keyframes,
+                    (measuredFrameCount > 1) ? ((double) frameIndex / (measuredFrameCount - 1)) : (0.0));
+        engine->draw();
+
+        const FrameTimings &frameTimings = engine->getLastFrameTimings();
+
+        run->frameTimes.push_back(frameTimings.frame);
+        run->fenceWaitTimes.push_back(frameTimings.fenceWait);
+        run->acquireTimes.push_back(frameTimings.acquire);
+        run->recordTimes.push_back(frameTimings.record);
+        run->submitTimes.push_back(frameTimings.submit);
+        run->presentTimes.push_back(frameTimings.present);
+
+        if (frameTimings.gpu >= 0.0)
+            run->gpuTimes.push_back(frameTimings.gpu);
+    }
+
+    delete engine;
+    delete pUnstableInstance;
+}
+
+static void writeRun(std::ostream &out, const std::string &indent, const BenchmarkRun &run,
+                     const VulkanEngineSettings &settings) {
+    out << indent << "\"textureTiling\": \""
+        << ((settings.textureTiling == VK_IMAGE_TILING_LINEAR) ? "linear" : "optimal") << "\",\n";
+    out << indent << "\"frameTimeMs\": {\n";
+
+    // No timestamp support on the graphics queue, or no frame waited on had its results ready.
+    if (!run.gpuTimes.empty()) {
+        writeStatistics(out, indent, "frame", run.frameTimes, false);
+        writeStatistics(out, indent, "gpu", run.gpuTimes, true);
+    } else
+        writeStatistics(out, indent, "frame", run.frameTimes, true);
+
+    out << indent << "},\n";
+    out << indent << "\"phaseTimeMs\": {\n";
+    writeStatistics(out, indent, "fenceWait", run.fenceWaitTimes, false);
+    writeStatistics(out, indent, "acquire", run.acquireTimes, false);
+    writeStatistics(out, indent, "record", run.recordTimes, false);
+    writeStatistics(out, indent, "submit", run.submitTimes, false);
+    writeStatistics(out, indent, "present", run.presentTimes, true);
+    out << indent << "}";
+}
+
+static void printUsage(const char *executableName) {
+    std::cout << "Usage: " << executableName << " --camera-path FILE [--warmup N] [--frames M] [--output FILE]"
+              << " [--width W] [--height H] [--frames-in-flight N] [--no-prerecord]"
+              << " [--texture-tiling optimal|linear] [--compare-texture-tiling] [--no-texture-mips]"
+              << " [--texture-atlas] [--texture-atlas-max-size N] [--virtual-texturing]"
+              << " [--quantized-vertices] [--depth-prepass] [--meshlet-culling]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    const char *cameraPathFileName = nullptr;
+    const char *outputFileName = "benchmark.json";
+    uint32_t warmupFrameCount = 100;
+    uint32_t measuredFrameCount = 1000;
+    bool compareTextureTiling = false;
+    VulkanEngineSettings settings;
+
+    settings.frameStatisticsInterval = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+
+        if (strcmp(argv[i], "--camera-path") == 0 && hasValue)
+            cameraPathFileName = argv[++i];
+        else if (strcmp(argv[i], "--output") == 0 && hasValue)
+            outputFileName = argv[++i];
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+            warmupFrameCount = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+            measuredFrameCount = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--width") == 0 && hasValue)
+            settings.offscreenWidth = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--height") == 0 && hasValue)
+            settings.offscreenHeight = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && hasValue)
+            settings.framesInFlight = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--no-prerecord") == 0)
+            settings.prerecordCommandBuffers = false;
+        else if (strcmp(argv[i], "--texture-tiling") == 0 && hasValue && strcmp(argv[i + 1], "optimal") == 0) {
+            settings.textureTiling = VK_IMAGE_TILING_OPTIMAL;
+            i++;
+        } else if (strcmp(argv[i], "--texture-tiling") == 0 && hasValue && strcmp(argv[i + 1], "linear") == 0) {
+            settings.textureTiling = VK_IMAGE_TILING_LINEAR;
+            i++;
+        } else if (strcmp(argv[i], "--compare-texture-tiling") == 0)
+            compareTextureTiling = true;
+        else if (strcmp(argv[i], "--no-texture-mips") == 0)
+            settings.textureMips = false;
+        else if (strcmp(argv[i], "--texture-atlas") == 0)
+            settings.textureAtlas = true;
+        else if (strcmp(argv[i], "--texture-atlas-max-size") == 0 && hasValue)
+            settings.textureAtlasMaxTextureSize = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--virtual-texturing") == 0)
+            settings.virtualTexturing = true;
+        else if (strcmp(argv[i], "--quantized-vertices") == 0)
+            settings.quantizedVertices = true;
+        else if (strcmp(argv[i], "--depth-prepass") == 0)
+            settings.depthPrepass = true;
+        else if (strcmp(argv[i], "--meshlet-culling") == 0)
+            settings.meshletCulling = true;
+        else {
+            printUsage(argv[0]);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (cameraPathFileName == nullptr || measuredFrameCount == 0 || settings.offscreenWidth == 0 ||
+        settings.offscreenHeight == 0) {
+        printUsage(argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    std::vector<CameraKeyframe> keyframes;
+
+    if (!loadCameraPath(cameraPathFileName, &keyframes)) {
+        std::cerr << "Couldn't load camera path '" << cameraPathFileName << "'." << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    ilInit();
+
+    VulkanEngineSettings linearSettings = settings;
+    BenchmarkRun run, linearRun;
+
+    if (compareTextureTiling) {
+        settings.textureTiling = VK_IMAGE_TILING_OPTIMAL;
+        linearSettings.textureTiling = VK_IMAGE_TILING_LINEAR;
+    }
+
+    try {
+        runBenchmark(settings, keyframes, warmupFrameCount, measuredFrameCount, &run);
+
+        if (compareTextureTiling)
+            runBenchmark(linearSettings, keyframes, warmupFrameCount, measuredFrameCount, &linearRun);
+    }
+    catch (VulkanException &e) {
+        std::cerr << e.what() << std::endl;
+
+        return EXIT_FAILURE;
+    }
+    catch (std::exception &e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    std::ostringstream json;
+
+    json << "{\n";
+    json << "  \"cameraPath\": ";
+    writeJsonString(json, cameraPathFileName);
+    json << ",\n";
+    json << "  \"width\": " << settings.offscreenWidth << ",\n";
+    json << "  \"height\": " << settings.offscreenHeight << ",\n";
+    json << "  \"framesInFlight\": " << settings.framesInFlight << ",\n";
+    json << "  \"prerecordCommandBuffers\": " << (settings.prerecordCommandBuffers ? "true" : "false") << ",\n";
+    json << "  \"textureMips\": " << (settings.textureMips ? "true" : "false") << ",\n";
+    json << "  \"textureAtlas\": " << (settings.textureAtlas ? "true" : "false") << ",\n";
+    json << "  \"virtualTexturing\": " << (settings.virtualTexturing ? "true" : "false") << ",\n";
+    json << "  \"quantizedVertices\": " << (settings.quantizedVertices ? "true" : "false") << ",\n";
+    json << "  \"depthPrepass\": " << (settings.depthPrepass ? "true" : "false") << ",\n";
+    json << "  \"meshletCulling\": " << (settings.meshletCulling ? "true" : "false") << ",\n";
+    json << "  \"warmupFrames\": " << warmupFrameCount << ",\n";
+    json << "  \"measuredFrames\": " << measuredFrameCount << ",\n";
+    writeRun(json, "  ", run, settings);
+
+    if (compareTextureTiling) {
+        json << ",\n";
+        json << "  \"linear\": {\n";
+        writeRun(json, "    ", linearRun, linearSettings);
+        json << "\n  }";
+
+        // Above 1 when linear textures cost GPU time, by how much sampling them is slower.
+        if (!run.gpuTimes.empty() && !linearRun.gpuTimes.empty())
+            json << ",\n  \"linearToOptimalGpuTimeRatio\": " << mean(linearRun.gpuTimes) / mean(run.gpuTimes);
+    }
+
+    json << "\n}\n";
+
+    std::ofstream outputFile(outputFileName);
+
+    if (!outputFile.is_open()) {
+        std::cerr << "Couldn't write '" << outputFileName << "'." << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    outputFile << json.str();
+
+    std::cout << "Benchmark results written to '" << outputFileName << "'." << std::endl;
+
+    return EXIT_SUCCESS;
+}
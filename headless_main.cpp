@@ -0,0 +1,71 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+// Renders a fixed number of frames into offscreen images, without a window, surface or swapchain. Runs on
+// GPU-less machines through a software ICD, e.g. VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "Vulkan Engine.h"
+
+static void printUsage(const char *executableName) {
+    std::cout << "Usage: " << executableName
+              << " [--frames N] [--width W] [--height H] [--frames-in-flight N] [--no-prerecord]" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    uint32_t frameCount = 1000;
+    VulkanEngineSettings settings;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+
+        if (strcmp(argv[i], "--frames") == 0 && hasValue)
+            frameCount = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--width") == 0 && hasValue)
+            settings.offscreenWidth = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--height") == 0 && hasValue)
+            settings.offscreenHeight = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && hasValue)
+            settings.framesInFlight = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--no-prerecord") == 0)
+            settings.prerecordCommandBuffers = false;
+        else {
+            printUsage(argv[0]);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (settings.offscreenWidth == 0 || settings.offscreenHeight == 0) {
+        printUsage(argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    ilInit();
+
+    std::cout << "DevIL library inited." << std::endl;
+
+    VulkanEngine **pUnstableInstance = new VulkanEngine *;
+    VulkanEngine *engine = NULL;
+
+    try {
+        engine = new VulkanEngine(pUnstableInstance, settings);
+        VulkanEngine::calculateViewProjection(engine);
+
+        for (uint32_t frameIndex = 0; frameIndex < frameCount; frameIndex++)
+            engine->draw();
+
+        delete engine;
+    }
+    catch (VulkanException &e) {
+        std::cerr << e.what() << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -9,6 +9,9 @@
 
 //#define FULLSCREEN
 
+// 1 serializes CPU recording and GPU execution, compare the printed frame statistics against the default 2.
+#define FRAMES_IN_FLIGHT 2
+
 
 static bool vulkanInited = false;
 static VulkanEngine *engine = NULL;
@@ -46,7 +49,10 @@ BOOL WINAPI closeHandler(DWORD dwCtrlType) {
 
 bool initVulkanReal(HINSTANCE hInstance, HWND windowHandle) {
     try {
-        engine = new VulkanEngine(hInstance, windowHandle, pUnstableInstance);
+        VulkanEngineSettings settings;
+        settings.framesInFlight = FRAMES_IN_FLIGHT;
+
+        engine = new VulkanEngine(hInstance, windowHandle, pUnstableInstance, settings);
         VulkanEngine::calculateViewProjection(engine);
 
         if (engine != NULL)
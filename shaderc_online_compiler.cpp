@@ -16,58 +16,101 @@
 // For clarity, each method is deliberately self-contained.
 //
 // Techniques demonstrated:
-//  - Preprocessing GLSL source text
-//  - Compiling a shader to SPIR-V assembly text
 //  - Compliing a shader to a SPIR-V binary module
 //  - Performing optimization with compilation
 //  - Setting basic options: setting a preprocessor symbol.
 //  - Checking compilation status and extracting an error message.
+//  - Caching compiled SPIR-V binaries on disk.
 
+#include <fstream>
 #include "shaderc_online_compiler.h"
+#include "Cache File.h"
+
+// Bump whenever the cache layout or the way shaders are compiled changes in a way the cache key doesn't cover.
+#define SPIRV_CACHE_VERSION 1
+
+struct SpirvCacheHeader {
+    char magic[4];                  // "VTSC"
+    uint32_t version;
+    uint64_t key;                   // see spirvCacheKey()
+    uint32_t wordCount;
+    uint32_t reserved;
+};
+
+struct ShaderMacro {
+    const char *name;
+    const char *value;
+};
+
+// Like -DMY_DEFINE=1
+static const ShaderMacro shaderMacros[] = {{"MY_DEFINE", "1"}};
+
+static const char spirvCacheMagic[4] = {'V', 'T', 'S', 'C'};
+// FNV-1a over everything that changes the produced binary: source text, shader kind, macros, optimization level,
+// the SPIR-V version shaderc targets and the cache version. Strings are hashed with their terminators so adjacent
+// fields can't run into each other.
+static uint64_t spirvCacheKey(const std::string &source, shaderc_shader_kind kind,
+                              shaderc_optimization_level optimizationLevel) {
+    uint32_t version = SPIRV_CACHE_VERSION;
+    uint32_t kindValue = (uint32_t) kind;
+    uint32_t optimizationLevelValue = (uint32_t) optimizationLevel;
+    unsigned int spirvVersion = 0, spirvRevision = 0;
+
+    shaderc_get_spv_version(&spirvVersion, &spirvRevision);
+
+    uint64_t key = FNV1A_OFFSET_BASIS;
+    key = fnv1a(key, &version, sizeof(version));
+    key = fnv1a(key, &kindValue, sizeof(kindValue));
+    key = fnv1a(key, &optimizationLevelValue, sizeof(optimizationLevelValue));
+    key = fnv1a(key, &spirvVersion, sizeof(spirvVersion));
+    key = fnv1a(key, &spirvRevision, sizeof(spirvRevision));
+
+    for (const ShaderMacro &macro : shaderMacros) {
+        key = fnv1a(key, macro.name, strlen(macro.name) + 1);
+        key = fnv1a(key, macro.value, strlen(macro.value) + 1);
+    }
 
-// Returns GLSL shader source text after preprocessing.
-std::string preprocess_shader(const std::string &source_name,
-                              shaderc_shader_kind kind,
-                              const std::string &source) {
-    shaderc::Compiler compiler;
-    shaderc::CompileOptions options;
-
-    // Like -DMY_DEFINE=1
-    options.AddMacroDefinition("MY_DEFINE", "1");
+    key = fnv1a(key, source.data(), source.size());
 
-    shaderc::PreprocessedSourceCompilationResult result =
-            compiler.PreprocessGlsl(source, kind, source_name.c_str(), options);
+    return key;
+}
 
-    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
-        throw VulkanException(result.GetErrorMessage().c_str());
-        return "";
-    }
+static bool readSpirvCache(const std::string &cachePath, uint64_t key, std::vector<uint32_t> *spirv) {
+    std::ifstream cacheFile(cachePath, std::ios::binary);
 
-    return {result.cbegin(), result.cend()};
-}
+    if (!cacheFile.is_open())
+        return false;
 
-// Compiles a shader to SPIR-V assembly. Returns the assembly text
-// as a string.
-std::string compile_file_to_assembly(const std::string &source_name,
-                                     shaderc_shader_kind kind,
-                                     const std::string &source,
-                                     bool optimize = false) {
-    shaderc::Compiler compiler;
-    shaderc::CompileOptions options;
+    SpirvCacheHeader header;
 
-    // Like -DMY_DEFINE=1
-    options.AddMacroDefinition("MY_DEFINE", "1");
-    if (optimize) options.SetOptimizationLevel(shaderc_optimization_level_size);
+    if (!cacheFile.read((char *) &header, sizeof(header)) ||
+        memcmp(header.magic, spirvCacheMagic, sizeof(spirvCacheMagic)) != 0 ||
+        header.version != SPIRV_CACHE_VERSION ||
+        header.key != key ||
+        header.wordCount == 0)
+        return false;
 
-    shaderc::AssemblyCompilationResult result = compiler.CompileGlslToSpvAssembly(
-            source, kind, source_name.c_str(), options);
+    spirv->resize(header.wordCount);
 
-    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
-        throw VulkanException(result.GetErrorMessage().c_str());
-        return "";
+    if (!cacheFile.read((char *) spirv->data(), (std::streamsize) sizeof(uint32_t) * header.wordCount)) {
+        spirv->clear();
+        return false;
     }
 
-    return {result.cbegin(), result.cend()};
+    return true;
+}
+
+static bool writeSpirvCache(const std::string &cachePath, uint64_t key, const std::vector<uint32_t> &spirv) {
+    SpirvCacheHeader header = {};
+    memcpy(header.magic, spirvCacheMagic, sizeof(spirvCacheMagic));
+    header.version = SPIRV_CACHE_VERSION;
+    header.key = key;
+    header.wordCount = (uint32_t) spirv.size();
+
+    return writeFileAtomically(cachePath, [&](std::ofstream &cacheFile) {
+        cacheFile.write((const char *) &header, sizeof(header));
+        cacheFile.write((const char *) spirv.data(), (std::streamsize) sizeof(uint32_t) * spirv.size());
+    });
 }
 
 // Compiles a shader to a SPIR-V binary. Returns the binary as
@@ -75,13 +118,14 @@ std::string compile_file_to_assembly(const std::string &source_name,
 std::vector<uint32_t> compile_file(const std::string &source_name,
                                    shaderc_shader_kind kind,
                                    const std::string &source,
-                                   bool optimize = false) {
+                                   shaderc_optimization_level optimizationLevel) {
     shaderc::Compiler compiler;
     shaderc::CompileOptions options;
 
-    // Like -DMY_DEFINE=1
-    options.AddMacroDefinition("MY_DEFINE", "1");
-    if (optimize) options.SetOptimizationLevel(shaderc_optimization_level_size);
+    for (const ShaderMacro &macro : shaderMacros)
+        options.AddMacroDefinition(macro.name, macro.value);
+
+    options.SetOptimizationLevel(optimizationLevel);
 
     shaderc::SpvCompilationResult module =
             compiler.CompileGlslToSpv(source, kind, source_name.c_str(), options);
@@ -94,7 +138,8 @@ std::vector<uint32_t> compile_file(const std::string &source_name,
     return {module.cbegin(), module.cend()};
 }
 
-std::vector<uint32_t> compileGLSLShader(const char kShaderSource[], shaderc_shader_kind shaderType) {
+std::vector<uint32_t> compileGLSLShader(const char kShaderSource[], shaderc_shader_kind shaderType,
+                                        const char *cachePath) {
     std::vector<uint32_t> spirv;
 
     std::string shaderTypeName = "";
@@ -120,40 +165,32 @@ std::vector<uint32_t> compileGLSLShader(const char kShaderSource[], shaderc_shad
             break;
     }
 
-    {  // Preprocessing
-        auto preprocessed = preprocess_shader(
-                "shader_src", shaderType, kShaderSource);
-        std::cout << "Preprocessed a " << shaderTypeName << " Shader successfully." << std::endl;
-    }
-
-//    {  // Compiling
-//        auto assembly = compile_file_to_assembly(
-//                "shader_src", shaderType, kShaderSource);
-//        std::cout << "SPIR-V assembly:" << std::endl << assembly << std::endl;
-//
-//        auto spirv =
-//                compile_file("shader_src", shaderType, kShaderSource);
-//        std::cout << "Compiled to a binary module with " << spirv.size()
-//                  << " words." << std::endl;
-//    }
-
 #ifdef NDEBUG
-    bool optimize = true;
+    shaderc_optimization_level optimizationLevel = shaderc_optimization_level_size;
 #else
-    bool optimize = false;
+    shaderc_optimization_level optimizationLevel = shaderc_optimization_level_zero;
 #endif
 
-    {  // Compiling with optimizing
-        auto assembly =
-                compile_file_to_assembly("shader_src", shaderType,
-                                         kShaderSource, /* optimize = */ optimize);
+    std::string source(kShaderSource);
+    uint64_t cacheKey = spirvCacheKey(source, shaderType, optimizationLevel);
 
-        spirv = compile_file("shader_src", shaderType,
-                             kShaderSource, /* optimize = */ optimize);
-        std::cout << "Compiled to " << ((optimize) ? ("an optimized") : ("a")) << " binary module with " << spirv.size()
+    if (cachePath != nullptr && readSpirvCache(cachePath, cacheKey, &spirv)) {
+        std::cout << "Loaded a cached " << shaderTypeName << " Shader binary module with " << spirv.size()
                   << " words." << std::endl;
+
+        return spirv;
     }
 
+    {  // Compiling with optimizing
+        spirv = compile_file("shader_src", shaderType, source, optimizationLevel);
+        std::cout << "Compiled " << shaderTypeName << " Shader to "
+                  << ((optimizationLevel != shaderc_optimization_level_zero) ? ("an optimized") : ("a"))
+                  << " binary module with " << spirv.size() << " words." << std::endl;
+    }
+
+    if (cachePath != nullptr && !writeSpirvCache(cachePath, cacheKey, spirv))
+        std::cerr << "Couldn't write SPIR-V cache '" << cachePath << "'." << std::endl;
+
 //    {  // Error case
 //        const char kBadShaderSource[] =
 //                "#version 310 es\nint main() { int main_should_be_void; }\n";
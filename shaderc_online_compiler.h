@@ -13,6 +13,9 @@
 #include <shaderc/shaderc.hpp>
 #include "Vulkan Engine Exception.h"
 
-std::vector<uint32_t> compileGLSLShader(const char kShaderSource[], shaderc_shader_kind shaderType);
+// Compiles GLSL to SPIR-V. When cachePath is given, a binary cached there under a matching key (source, kind,
+// macros, optimization level) is returned without compiling, and fresh compilations are written back to it.
+std::vector<uint32_t> compileGLSLShader(const char kShaderSource[], shaderc_shader_kind shaderType,
+                                        const char *cachePath = nullptr);
 
 #endif //VULKAN_TEST_SHADERC_ONLINE_COMPILER_H
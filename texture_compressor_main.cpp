@@ -0,0 +1,150 @@
+//
+// Created by chakmeshma on 17.10.2026.
+//
+
+// Converts the PNG material textures to block compressed KTX2 files with a full mip chain, which the engine loads
+// instead of the PNGs when they sit next to them: t0c.png -> t0c.ktx2 and so on.
+//
+// The format follows the texture's role, taken from the letter before ".png" unless --format says otherwise:
+// 'c' color -> BC7, 'n' normal -> BC5 (x and y only, the shader reconstructs z), 's' specular -> BC4.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Block Compression.h"
+#include "KTX2 Texture.h"
+#include "Mip Chain.h"
+#include "PNG Decoder.h"
+
+static void printUsage(const char *executableName) {
+    std::cout << "Usage: " << executableName << " [--format bc7|bc5|bc4] FILE.png..." << std::endl;
+}
+
+static VkFormat getFormatOfRole(const std::string &pngPath) {
+    if (pngPath.size() < 5 || pngPath.compare(pngPath.size() - 4, 4, ".png") != 0)
+        return VK_FORMAT_UNDEFINED;
+
+    switch (pngPath[pngPath.size() - 5]) {
+        case 'c':
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        case 'n':
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case 's':
+            return VK_FORMAT_BC4_UNORM_BLOCK;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+static bool compressTexture(const std::string &pngPath, VkFormat format) {
+    PngDecoder decoder;
+    std::string decodeError;
+
+    if (!decoder.open(pngPath, &decodeError)) {
+        std::cerr << "Couldn't load texture file '" << pngPath << "': " << decodeError << "." << std::endl;
+
+        return false;
+    }
+
+    uint32_t width = decoder.width;
+    uint32_t height = decoder.height;
+    uint32_t levelCount = getMipLevelCount(width, height);
+    bool normalMap = (format == VK_FORMAT_BC5_UNORM_BLOCK);
+
+    // Same decoder and mip filter as VulkanEngine::decodeTexture, so the compressed texture ends up the same way up
+    // (top row first) and filtered the same as the PNG it replaces.
+    std::vector<uint8_t> chain(getMipChainSize(width, height, 0, levelCount));
+    MipChainWriter mipChainWriter(width, height, levelCount, normalMap, chain.data());
+
+    if (!decoder.decode([&mipChainWriter](const uint8_t *row) { mipChainWriter.writeRow(row); }, &decodeError)) {
+        std::cerr << "Couldn't decode texture file '" << pngPath << "': " << decodeError << "." << std::endl;
+
+        return false;
+    }
+
+    std::vector<std::vector<uint8_t>> levels(levelCount);
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        uint32_t levelWidth = std::max(width >> level, 1u);
+        uint32_t levelHeight = std::max(height >> level, 1u);
+        const uint8_t *levelPixels = chain.data() + getMipChainSize(width, height, 0, level);
+
+        levels[level].resize(getKtx2LevelSize(format, width, height, level));
+
+        switch (format) {
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+                compressBC7(levelPixels, levelWidth, levelHeight, levels[level].data());
+                break;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                compressBC5(levelPixels, levelWidth, levelHeight, levels[level].data());
+                break;
+            default:
+                compressBC4(levelPixels, levelWidth, levelHeight, levels[level].data());
+        }
+    }
+
+    std::string ktx2Path = pngPath.substr(0, pngPath.size() - 4) + ".ktx2";
+
+    if (!writeKtx2Texture(ktx2Path, format, width, height, levelCount, levels)) {
+        std::cerr << "Couldn't write '" << ktx2Path << "'." << std::endl;
+
+        return false;
+    }
+
+    std::cout << pngPath << " -> " << ktx2Path << " (" << width << "x" << height << ", " << levelCount
+              << " levels)" << std::endl;
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    VkFormat forcedFormat = VK_FORMAT_UNDEFINED;
+    std::vector<std::string> pngPaths;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i + 1 < argc);
+
+        if (strcmp(argv[i], "--format") == 0 && hasValue) {
+            i++;
+
+            if (strcmp(argv[i], "bc7") == 0)
+                forcedFormat = VK_FORMAT_BC7_UNORM_BLOCK;
+            else if (strcmp(argv[i], "bc5") == 0)
+                forcedFormat = VK_FORMAT_BC5_UNORM_BLOCK;
+            else if (strcmp(argv[i], "bc4") == 0)
+                forcedFormat = VK_FORMAT_BC4_UNORM_BLOCK;
+            else {
+                printUsage(argv[0]);
+
+                return EXIT_FAILURE;
+            }
+        } else
+            pngPaths.push_back(argv[i]);
+    }
+
+    if (pngPaths.empty()) {
+        printUsage(argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    bool succeeded = true;
+
+    for (const std::string &pngPath : pngPaths) {
+        VkFormat format = (forcedFormat != VK_FORMAT_UNDEFINED) ? (forcedFormat) : (getFormatOfRole(pngPath));
+
+        if (format == VK_FORMAT_UNDEFINED) {
+            std::cerr << "Can't tell the role of '" << pngPath << "', pass --format." << std::endl;
+
+            succeeded = false;
+            continue;
+        }
+
+        succeeded = compressTexture(pngPath, format) && succeeded;
+    }
+
+    return (succeeded) ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+}